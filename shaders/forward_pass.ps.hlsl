@@ -141,8 +141,10 @@ float4 main(RS2PS input) : SV_Target
 	{
 		Texture2D normal_texture = ResourceDescriptorHeap[pbr_material.normal_texture_index];
 		
-		float3 tangent_normal = normal_texture.Sample(g_linear_sampler, uv).xyz * 2.0 - 1.0;
-		//float3 tangent_normal = normal_texture.Sample(g_linear_sampler, uv).xyz * 2.0 - 1.0;
+		// Normal maps are cooked into two channels, Z is reconstructed
+		float3 tangent_normal;
+		tangent_normal.xy = normal_texture.Sample(g_linear_sampler, uv).xy * 2.0 - 1.0;
+		tangent_normal.z = sqrt(saturate(1.0 - dot(tangent_normal.xy, tangent_normal.xy)));
 		normals = normalize(normals + tangent_normal);
 	}
 
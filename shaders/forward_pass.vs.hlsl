@@ -65,8 +65,10 @@ VertexToPixel main(VertexLayout input)
 	float3x3 model_normal_matrix = transpose(Inverse3x3((float3x3)instance_data.model_matrix));
 	
 	VertexToPixel output;
-	output.world_position	= mul(instance_data.model_matrix, float4(input.position, 1.0));
-	output.normal			= mul(model_normal_matrix, input.normal);
+	const float3 position = GetVertexPosition(input, instance_data.position_offset, instance_data.position_scale);
+
+	output.world_position	= mul(instance_data.model_matrix, float4(position, 1.0));
+	output.normal			= mul(model_normal_matrix, GetVertexNormal(input));
 	output.pixel_position	= mul(camera.view_projection, output.world_position);
     output.texcoord_0		= input.texcoord_0;
 
@@ -65,6 +65,12 @@ struct PerInstanceData
     int vertices_before;
     int indices_before; // offset
     int pad;
+
+    // Compact vertices dequantization: position = position_offset + position * position_scale
+    float3 position_offset;
+    float pad1;
+    float3 position_scale;
+    float pad2;
 };
 CHECK_STRUCT_ALIGNMENT(PerInstanceData);
 
@@ -3,6 +3,23 @@
 #define ONE_OVER_PI (1.0f / PI)
 #define ONE_OVER_TWO_PI (1.0f / TWO_PI)
 
+#ifdef COMPACT_VERTICES
+// Matches CompactVertex, unpacked by input assembler
+struct VertexLayout
+{
+	float4 position : POSITION; // [0, 1] inside primitive bounds
+    float2 normal : NORMAL; // Octahedron encoded
+    float2 texcoord_0 : TEXCOORD_0;
+};
+
+// Raw CompactVertex for structured buffer reads
+struct PackedVertexLayout
+{
+	uint2 position;
+	uint normal;
+	uint texcoord_0;
+};
+#else
 struct VertexLayout
 {
 	float3 position : POSITION;
@@ -10,6 +27,7 @@ struct VertexLayout
     //float4 tangent;
     float2 texcoord_0 : TEXCOORD_0;
 };
+#endif
 
 uint JenkinsHash(uint x)
 {
@@ -179,6 +197,37 @@ float3 decodeNormalOctahedron(float2 p)
 	return normalize(n);
 }
 
+#ifdef COMPACT_VERTICES
+VertexLayout UnpackVertex(PackedVertexLayout input)
+{
+	VertexLayout result;
+	result.position = float4(input.position.x & 0xffff, input.position.x >> 16, input.position.y & 0xffff, input.position.y >> 16) / 65535.0f;
+	result.normal = max(float2(asint(input.normal << 16) >> 16, asint(input.normal) >> 16) / 32767.0f, -1.0f);
+	result.texcoord_0 = f16tofloat(uint2(input.texcoord_0 & 0xffff, input.texcoord_0 >> 16));
+	return result;
+}
+
+float3 GetVertexPosition(VertexLayout input, float3 position_offset, float3 position_scale)
+{
+	return position_offset + input.position.xyz * position_scale;
+}
+
+float3 GetVertexNormal(VertexLayout input)
+{
+	return decodeNormalOctahedron(input.normal);
+}
+#else
+float3 GetVertexPosition(VertexLayout input, float3 position_offset, float3 position_scale)
+{
+	return input.position;
+}
+
+float3 GetVertexNormal(VertexLayout input)
+{
+	return input.normal;
+}
+#endif
+
 float4 EncodeNormals(float3 geometryNormal, float3 shadingNormal) {
 	return float4(encodeNormalOctahedron(geometryNormal), encodeNormalOctahedron(shadingNormal));
 }
@@ -1,11 +1,5 @@
 #include "shader_structs.h"
-
-struct IA2VS
-{
-	float3 position		: POSITION;
-    float3 normal		: NORMAL;
-    float2 texcoord_0	: TEXCOORD_0;
-};
+#include "shared.hlsl"
 
 struct VS2RS
 {
@@ -40,15 +34,17 @@ float3x3 Inverse3x3(float3x3 mat)
     return inv / det;
 }
 
-VS2RS main(IA2VS input)
+VS2RS main(VertexLayout input)
 {
 	VS2RS output;
 
 	float3x3 model_normal_matrix = transpose(Inverse3x3((float3x3)instance_data.model_matrix));
 
-	output.position		= mul(instance_data.model_matrix, float4(input.position, 1.0));
+	const float3 position = GetVertexPosition(input, instance_data.position_offset, instance_data.position_scale);
+
+	output.position		= mul(instance_data.model_matrix, float4(position, 1.0));
 	output.position		= mul(parameters.view_projection, output.position);
-	output.normal		= mul(model_normal_matrix, float4(input.normal, 1.0));
+	output.normal		= mul(model_normal_matrix, float4(GetVertexNormal(input), 1.0));
     output.texcoord_0	= input.texcoord_0;
 
 	return output;
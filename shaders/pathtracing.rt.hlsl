@@ -8,7 +8,11 @@ RWTexture2D<float4> accumulation_texture					: register(u1);
 ConstantBuffer<CameraParameters> camera						: register(b0);
 
 RaytracingAccelerationStructure scene_bvh					: register(t0);
+#ifdef COMPACT_VERTICES
+StructuredBuffer<PackedVertexLayout> vertex_buffer			: register(t1);
+#else
 StructuredBuffer<VertexLayout> vertex_buffer				: register(t1);
+#endif
 StructuredBuffer<uint> index_buffer							: register(t2);
 StructuredBuffer<SurfaceShaderParameters> materials_buffer	: register(t3);
 StructuredBuffer<PerInstanceData> per_instance_buffer		: register(t4);
@@ -251,22 +255,32 @@ VertexData GetVertexData(uint geometry_id, uint triangle_index, float3 barycentr
 	// Interpolate the vertex attributes
 	for (uint i = 0; i < 3; i++)
 	{
+#ifdef COMPACT_VERTICES
+		input_vertex[i] = UnpackVertex(vertex_buffer[address + indices[i]]);
+#else
 		input_vertex[i] = vertex_buffer[address + indices[i]];
+#endif
 
 		// Load and interpolate position and transform it to world space
+		// Compact positions are dequantized by the instance transform, see RtxContext
 		triangle_vertices[i] = mul(ObjectToWorld3x4(), float4(input_vertex[i].position.xyz, 1.0f)).xyz;
 
 		v.position += triangle_vertices[i] * barycentrics[i];
 
 		// Load and interpolate normal
-		v.shading_normal += input_vertex[i].normal * barycentrics[i];
+		v.shading_normal += GetVertexNormal(input_vertex[i]) * barycentrics[i];
 
 		// Load and interpolate texture coordinates
 		v.uv += input_vertex[i].texcoord_0 * barycentrics[i];
 	}
 
 	// Transform normal from local to world space
+#ifdef COMPACT_VERTICES
+	// Instance transform contains non uniform dequantization scale, so inverse transpose is required
+	v.shading_normal = normalize(mul(v.shading_normal * per_instance_buffer[geometry_id].position_scale, (float3x3)WorldToObject3x4()));
+#else
 	v.shading_normal = normalize(mul(ObjectToWorld3x4(), float4(v.shading_normal, 0.0f)).xyz);
+#endif
 
 	// Calculate geometry normal from triangle vertices positions
 	float3 edge20 = triangle_vertices[2] - triangle_vertices[0];
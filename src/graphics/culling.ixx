@@ -0,0 +1,400 @@
+module;
+
+#include <DirectXMath.h>
+#include <immintrin.h>
+
+export module graphics.culling;
+
+import std;
+import graphics.aabb;
+
+export namespace ysn
+{
+	// Planes point inside, box is visible when it is in front of every plane
+	struct Frustum
+	{
+		DirectX::XMFLOAT4 planes[6];
+	};
+
+	Frustum CreateFrustum(const DirectX::XMMATRIX& view_projection);
+
+	AABB TransformAabb(const AABB& aabb, const DirectX::XMMATRIX& transform);
+
+	struct CullingStats
+	{
+		uint32_t tested_nodes = 0;
+		uint32_t tested_instances = 0; // Instances of fully visible nodes are accepted without a test
+		uint32_t visible_instances = 0;
+	};
+
+	// Hierarchy over world space instance boxes, leaf boxes are kept in SoA layout and tested several per plane at once
+	class InstanceBvh
+	{
+	public:
+		void Build(std::span<const AABB> instance_boxes);
+
+		// Keeps hierarchy and updates bounds only, boxes count has to match the one used in Build
+		bool Refit(std::span<const AABB> instance_boxes);
+
+		void Cull(const Frustum& frustum, std::vector<uint32_t>& visible_instances, CullingStats& stats) const;
+
+		uint32_t GetInstancesCount() const
+		{
+			return static_cast<uint32_t>(m_instance_ids.size());
+		}
+
+	private:
+		struct Node
+		{
+			AABB bounds;
+			uint32_t first = 0; // Range in m_instance_ids
+			uint32_t count = 0;
+			uint32_t left_child = 0; // Right one follows it, zero for leaves
+		};
+
+		void UpdateLeafBoxes(std::span<const AABB> instance_boxes);
+		AABB ComputeBounds(uint32_t first, uint32_t count) const;
+		void CullLeaf(const Frustum& frustum, const Node& node, std::vector<uint32_t>& visible_instances) const;
+
+		std::vector<Node> m_nodes;
+		std::vector<uint32_t> m_instance_ids;
+
+		// Leaf order, padded to SIMD width
+		std::vector<float> m_min_x;
+		std::vector<float> m_min_y;
+		std::vector<float> m_min_z;
+		std::vector<float> m_max_x;
+		std::vector<float> m_max_y;
+		std::vector<float> m_max_z;
+	};
+}
+
+module :private;
+
+namespace ysn
+{
+	using namespace DirectX;
+
+#ifdef __AVX__
+	constexpr uint32_t g_simd_width = 8;
+#else
+	constexpr uint32_t g_simd_width = 4;
+#endif
+
+	constexpr uint32_t g_bvh_leaf_size = 8;
+	constexpr uint32_t g_bvh_max_depth = 64;
+
+	enum class FrustumTest : uint8_t
+	{
+		Outside,
+		Intersect,
+		Inside
+	};
+
+	static FrustumTest TestAabb(const Frustum& frustum, const AABB& aabb)
+	{
+		FrustumTest result = FrustumTest::Inside;
+
+		for (const XMFLOAT4& plane : frustum.planes)
+		{
+			// Corners furthest along and against plane normal
+			const float positive_distance = plane.x * (plane.x >= 0.0f ? aabb.max.x : aabb.min.x) +
+				plane.y * (plane.y >= 0.0f ? aabb.max.y : aabb.min.y) + plane.z * (plane.z >= 0.0f ? aabb.max.z : aabb.min.z) + plane.w;
+
+			if (positive_distance < 0.0f)
+				return FrustumTest::Outside;
+
+			const float negative_distance = plane.x * (plane.x >= 0.0f ? aabb.min.x : aabb.max.x) +
+				plane.y * (plane.y >= 0.0f ? aabb.min.y : aabb.max.y) + plane.z * (plane.z >= 0.0f ? aabb.min.z : aabb.max.z) + plane.w;
+
+			if (negative_distance < 0.0f)
+				result = FrustumTest::Intersect;
+		}
+
+		return result;
+	}
+
+	static AABB MergeAabb(const AABB& lhs, const AABB& rhs)
+	{
+		return { { std::min(lhs.min.x, rhs.min.x), std::min(lhs.min.y, rhs.min.y), std::min(lhs.min.z, rhs.min.z) },
+				 { std::max(lhs.max.x, rhs.max.x), std::max(lhs.max.y, rhs.max.y), std::max(lhs.max.z, rhs.max.z) } };
+	}
+
+	Frustum CreateFrustum(const XMMATRIX& view_projection)
+	{
+		// Rows of transposed matrix are clip space x, y, z and w
+		const XMMATRIX m = XMMatrixTranspose(view_projection);
+
+		const XMVECTOR planes[6] = {
+			XMVectorAdd(m.r[3], m.r[0]),	  // Left
+			XMVectorSubtract(m.r[3], m.r[0]), // Right
+			XMVectorAdd(m.r[3], m.r[1]),	  // Bottom
+			XMVectorSubtract(m.r[3], m.r[1]), // Top
+			m.r[2],							  // Near, z >= 0
+			XMVectorSubtract(m.r[3], m.r[2]), // Far
+		};
+
+		Frustum result;
+
+		for (int i = 0; i < 6; i++)
+		{
+			XMStoreFloat4(&result.planes[i], XMPlaneNormalize(planes[i]));
+		}
+
+		return result;
+	}
+
+	AABB TransformAabb(const AABB& aabb, const XMMATRIX& transform)
+	{
+		const XMVECTOR min = XMLoadFloat3(&aabb.min);
+		const XMVECTOR max = XMLoadFloat3(&aabb.max);
+
+		const XMVECTOR center = XMVector3Transform(XMVectorScale(XMVectorAdd(min, max), 0.5f), transform);
+		const XMVECTOR extent = XMVectorScale(XMVectorSubtract(max, min), 0.5f);
+
+		// Extent of rotated box is projection of its half sizes on every axis
+		const XMVECTOR world_extent = XMVectorAdd(XMVectorAdd(XMVectorMultiply(XMVectorSplatX(extent), XMVectorAbs(transform.r[0])),
+														   XMVectorMultiply(XMVectorSplatY(extent), XMVectorAbs(transform.r[1]))),
+			XMVectorMultiply(XMVectorSplatZ(extent), XMVectorAbs(transform.r[2])));
+
+		AABB result;
+		XMStoreFloat3(&result.min, XMVectorSubtract(center, world_extent));
+		XMStoreFloat3(&result.max, XMVectorAdd(center, world_extent));
+
+		return result;
+	}
+
+	void InstanceBvh::Build(std::span<const AABB> instance_boxes)
+	{
+		const uint32_t instances_count = static_cast<uint32_t>(instance_boxes.size());
+
+		m_nodes.clear();
+		m_instance_ids.resize(instances_count);
+		std::iota(m_instance_ids.begin(), m_instance_ids.end(), 0);
+
+		if (instances_count == 0)
+		{
+			UpdateLeafBoxes(instance_boxes);
+			return;
+		}
+
+		std::vector<XMFLOAT3> centers(instances_count);
+
+		for (uint32_t i = 0; i < instances_count; i++)
+		{
+			const AABB& box = instance_boxes[i];
+			centers[i] = { (box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f, (box.min.z + box.max.z) * 0.5f };
+		}
+
+		m_nodes.reserve(2 * (instances_count / g_bvh_leaf_size + 1));
+		m_nodes.push_back({ .first = 0, .count = instances_count });
+
+		// Median split along the widest axis of centers, children always come after parent
+		std::vector<uint32_t> nodes_to_split = { 0 };
+
+		while (!nodes_to_split.empty())
+		{
+			const uint32_t node_index = nodes_to_split.back();
+			nodes_to_split.pop_back();
+
+			const Node node = m_nodes[node_index];
+
+			if (node.count <= g_bvh_leaf_size)
+				continue;
+
+			XMVECTOR centers_min = XMLoadFloat3(&centers[m_instance_ids[node.first]]);
+			XMVECTOR centers_max = centers_min;
+
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+			{
+				const XMVECTOR center = XMLoadFloat3(&centers[m_instance_ids[i]]);
+				centers_min = XMVectorMin(centers_min, center);
+				centers_max = XMVectorMax(centers_max, center);
+			}
+
+			XMFLOAT3 centers_extent;
+			XMStoreFloat3(&centers_extent, XMVectorSubtract(centers_max, centers_min));
+
+			int axis = 0;
+
+			if (centers_extent.y > centers_extent.x)
+				axis = 1;
+
+			if (centers_extent.z > (axis == 0 ? centers_extent.x : centers_extent.y))
+				axis = 2;
+
+			const uint32_t left_count = node.count / 2;
+			const auto begin = m_instance_ids.begin() + node.first;
+
+			std::nth_element(begin,
+				begin + left_count,
+				begin + node.count,
+				[&centers, axis](uint32_t lhs, uint32_t rhs) { return (&centers[lhs].x)[axis] < (&centers[rhs].x)[axis]; });
+
+			const uint32_t left_child = static_cast<uint32_t>(m_nodes.size());
+
+			m_nodes[node_index].left_child = left_child;
+			m_nodes.push_back({ .first = node.first, .count = left_count });
+			m_nodes.push_back({ .first = node.first + left_count, .count = node.count - left_count });
+
+			nodes_to_split.push_back(left_child);
+			nodes_to_split.push_back(left_child + 1);
+		}
+
+		Refit(instance_boxes);
+	}
+
+	bool InstanceBvh::Refit(std::span<const AABB> instance_boxes)
+	{
+		if (instance_boxes.size() != m_instance_ids.size())
+			return false;
+
+		UpdateLeafBoxes(instance_boxes);
+
+		for (uint32_t i = static_cast<uint32_t>(m_nodes.size()); i-- > 0;)
+		{
+			Node& node = m_nodes[i];
+
+			if (node.left_child == 0)
+			{
+				node.bounds = ComputeBounds(node.first, node.count);
+			}
+			else
+			{
+				node.bounds = MergeAabb(m_nodes[node.left_child].bounds, m_nodes[node.left_child + 1].bounds);
+			}
+		}
+
+		return true;
+	}
+
+	void InstanceBvh::Cull(const Frustum& frustum, std::vector<uint32_t>& visible_instances, CullingStats& stats) const
+	{
+		visible_instances.clear();
+
+		if (m_nodes.empty())
+			return;
+
+		std::array<uint32_t, g_bvh_max_depth> stack;
+		uint32_t stack_size = 0;
+
+		stack[stack_size++] = 0;
+
+		while (stack_size > 0)
+		{
+			const Node& node = m_nodes[stack[--stack_size]];
+
+			stats.tested_nodes++;
+
+			switch (TestAabb(frustum, node.bounds))
+			{
+				case FrustumTest::Outside:
+					break;
+				case FrustumTest::Inside:
+					visible_instances.insert(visible_instances.end(), m_instance_ids.begin() + node.first, m_instance_ids.begin() + node.first + node.count);
+					break;
+				case FrustumTest::Intersect:
+					if (node.left_child == 0)
+					{
+						stats.tested_instances += node.count;
+						CullLeaf(frustum, node, visible_instances);
+					}
+					else
+					{
+						stack[stack_size++] = node.left_child + 1;
+						stack[stack_size++] = node.left_child;
+					}
+					break;
+			}
+		}
+
+		stats.visible_instances += static_cast<uint32_t>(visible_instances.size());
+	}
+
+	void InstanceBvh::UpdateLeafBoxes(std::span<const AABB> instance_boxes)
+	{
+		// Padding lets the last batch be loaded without bounds checks
+		const std::size_t padded_count = m_instance_ids.size() + g_simd_width;
+
+		for (std::vector<float>* values : { &m_min_x, &m_min_y, &m_min_z, &m_max_x, &m_max_y, &m_max_z })
+		{
+			values->assign(padded_count, 0.0f);
+		}
+
+		for (std::size_t i = 0; i < m_instance_ids.size(); i++)
+		{
+			const AABB& box = instance_boxes[m_instance_ids[i]];
+
+			m_min_x[i] = box.min.x;
+			m_min_y[i] = box.min.y;
+			m_min_z[i] = box.min.z;
+			m_max_x[i] = box.max.x;
+			m_max_y[i] = box.max.y;
+			m_max_z[i] = box.max.z;
+		}
+	}
+
+	AABB InstanceBvh::ComputeBounds(uint32_t first, uint32_t count) const
+	{
+		AABB result = { { m_min_x[first], m_min_y[first], m_min_z[first] }, { m_max_x[first], m_max_y[first], m_max_z[first] } };
+
+		for (uint32_t i = first + 1; i < first + count; i++)
+		{
+			result = MergeAabb(result, { { m_min_x[i], m_min_y[i], m_min_z[i] }, { m_max_x[i], m_max_y[i], m_max_z[i] } });
+		}
+
+		return result;
+	}
+
+	void InstanceBvh::CullLeaf(const Frustum& frustum, const Node& node, std::vector<uint32_t>& visible_instances) const
+	{
+		const uint32_t end = node.first + node.count;
+
+		for (uint32_t batch = node.first; batch < end; batch += g_simd_width)
+		{
+#ifdef __AVX__
+			__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+#else
+			__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+#endif
+
+			for (const XMFLOAT4& plane : frustum.planes)
+			{
+				// Corner furthest along plane normal is picked per plane, not per box
+				const float* x = (plane.x >= 0.0f ? m_max_x.data() : m_min_x.data()) + batch;
+				const float* y = (plane.y >= 0.0f ? m_max_y.data() : m_min_y.data()) + batch;
+				const float* z = (plane.z >= 0.0f ? m_max_z.data() : m_min_z.data()) + batch;
+
+#ifdef __AVX__
+				const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(x), _mm256_set1_ps(plane.x)),
+															  _mm256_mul_ps(_mm256_loadu_ps(y), _mm256_set1_ps(plane.y))),
+					_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(z), _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+
+				visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+#else
+				const __m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x), _mm_set1_ps(plane.x)), _mm_mul_ps(_mm_loadu_ps(y), _mm_set1_ps(plane.y))),
+					_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(z), _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+
+				visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+#endif
+			}
+
+#ifdef __AVX__
+			uint32_t visible_mask = static_cast<uint32_t>(_mm256_movemask_ps(visible));
+#else
+			uint32_t visible_mask = static_cast<uint32_t>(_mm_movemask_ps(visible));
+#endif
+
+			// Lanes past the leaf belong to other leaves or padding
+			const uint32_t lanes_count = std::min(g_simd_width, end - batch);
+			visible_mask &= (1u << lanes_count) - 1;
+
+			while (visible_mask != 0)
+			{
+				visible_instances.push_back(m_instance_ids[batch + std::countr_zero(visible_mask)]);
+				visible_mask &= visible_mask - 1;
+			}
+		}
+	}
+}
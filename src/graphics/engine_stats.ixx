@@ -1,6 +1,7 @@
 export module graphics.engine_stats;
 
 import std;
+import system.profiler;
 
 export namespace engine_stats
 {
@@ -9,6 +10,24 @@ export namespace engine_stats
 	//uint32_t triangle_count = 0; // draw.indexCount / 3;
 	//uint32_t drawcall_count = 0; // increase per draw call
 
+	// Render queue stats, state changes are emitted state setting calls
+	std::uint32_t forward_draw_calls = 0;
+	std::uint32_t forward_state_changes = 0;
+	std::uint32_t shadow_draw_calls = 0;
+	std::uint32_t shadow_state_changes = 0;
+	std::uint32_t forward_missing_pso_draws = 0; // Draws skipped because their PSO isn't ready yet
+	std::uint32_t shadow_missing_pso_draws = 0;
+
 	// Frustum culling stats
+	std::uint32_t culling_instances = 0;
+	std::uint32_t culling_tested_instances = 0; // Boxes tested one by one, camera and shadow passes together
+	std::uint32_t culling_visible_instances = 0;
+	std::uint32_t culling_shadow_visible_instances = 0;
+	double culling_ms = 0;
+
+	// CPU profiler zones, rolling percentiles over last Profiler::zone_history_size samples
+	std::vector<ysn::ProfilerZoneStats> profiler_zones;
+	std::uint64_t profiler_dropped_events = 0;
+
 	// Occlusion culling stats
 };
@@ -0,0 +1,920 @@
+module;
+
+#include <DirectXMath.h>
+#include <d3d12.h>
+
+export module graphics.mesh_optimizer;
+
+import std;
+import graphics.primitive;
+import renderer.vertex_storage;
+
+export namespace ysn
+{
+	struct VertexCacheStatistics
+	{
+		float acmr = 0.0f; // Transformed vertices per triangle, 3 is the worst case
+		float atvr = 0.0f; // Transformed vertices per referenced vertex, 1 is ideal
+	};
+
+	struct MeshOptimizationParameters
+	{
+		uint32_t max_lods_count = 4;   // Including LOD0
+		float lod_reduction = 0.5f;    // Target indices count of next LOD relative to previous one
+		float lod_max_error = 0.02f;   // Error bound of LOD1 relative to primitive extent
+		float lod_error_growth = 2.0f; // Error bound of next LOD relative to previous one, coarser LODs are seen from further away
+	};
+
+	struct MeshOptimizationStatistics
+	{
+		uint32_t vertices_before = 0;
+		uint32_t vertices_after = 0;
+		uint32_t triangles_count = 0;
+		float acmr_before = 0.0f;
+		float acmr_after = 0.0f;
+	};
+
+	// Merges bitwise identical vertices, unreferenced ones are dropped
+	void WeldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	// Reorders triangles for post transform cache locality, Tom Forsyth linear speed algorithm
+	void OptimizeVertexCache(std::span<uint32_t> indices, uint32_t vertices_count);
+
+	// Splits cache optimized triangles into clusters at cache flushes and draws outward facing clusters first
+	void OptimizeOverdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices);
+
+	// Reorders vertices by first use so vertex fetch walks memory linearly, unreferenced ones are dropped
+	void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::span<uint32_t> indices);
+
+	// Quadric error half edge collapse, result references the same vertices. Borders and attribute seams are kept intact.
+	// Errors are relative to mesh extent, result_error is the largest error of performed collapses.
+	std::vector<uint32_t> SimplifyMesh(
+		std::span<const uint32_t> indices, std::span<const Vertex> vertices, uint32_t target_indices_count, float target_error, float& result_error);
+
+	// Simulates FIFO post transform cache
+	VertexCacheStatistics AnalyzeVertexCache(std::span<const uint32_t> indices, uint32_t vertices_count, uint32_t cache_size = 16);
+
+	// Runs all steps above on triangle list primitive and fills its LOD chain
+	MeshOptimizationStatistics OptimizePrimitive(Primitive& primitive, const MeshOptimizationParameters& parameters);
+}
+
+module :private;
+
+namespace ysn
+{
+	constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+	struct VertexHasher
+	{
+		std::size_t operator()(const Vertex* vertex) const
+		{
+			// FNV-1a over raw vertex bytes
+			const auto* bytes = reinterpret_cast<const uint8_t*>(vertex);
+
+			std::size_t hash = 14695981039346656037ull;
+
+			for (std::size_t i = 0; i < sizeof(Vertex); i++)
+			{
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+
+			return hash;
+		}
+	};
+
+	struct VertexEqual
+	{
+		bool operator()(const Vertex* lhs, const Vertex* rhs) const
+		{
+			return std::memcmp(lhs, rhs, sizeof(Vertex)) == 0;
+		}
+	};
+
+	void WeldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::unordered_map<const Vertex*, uint32_t, VertexHasher, VertexEqual> unique_vertices;
+		unique_vertices.reserve(vertices.size());
+
+		std::vector<uint32_t> remap(vertices.size(), INVALID_INDEX);
+
+		std::vector<Vertex> welded_vertices;
+		welded_vertices.reserve(vertices.size());
+
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == INVALID_INDEX)
+			{
+				const auto [it, inserted] = unique_vertices.try_emplace(&vertices[index], static_cast<uint32_t>(welded_vertices.size()));
+
+				if (inserted)
+				{
+					welded_vertices.push_back(vertices[index]);
+				}
+
+				remap[index] = it->second;
+			}
+
+			index = remap[index];
+		}
+
+		vertices = std::move(welded_vertices);
+	}
+
+	VertexCacheStatistics AnalyzeVertexCache(std::span<const uint32_t> indices, uint32_t vertices_count, uint32_t cache_size)
+	{
+		VertexCacheStatistics result;
+
+		if (indices.empty())
+			return result;
+
+		std::vector<uint32_t> cache_timestamps(vertices_count, 0);
+		std::vector<bool> referenced(vertices_count, false);
+
+		uint32_t timestamp = cache_size + 1;
+		uint32_t misses = 0;
+		uint32_t referenced_count = 0;
+
+		for (const uint32_t index : indices)
+		{
+			if (timestamp - cache_timestamps[index] > cache_size)
+			{
+				cache_timestamps[index] = timestamp++;
+				misses++;
+			}
+
+			if (!referenced[index])
+			{
+				referenced[index] = true;
+				referenced_count++;
+			}
+		}
+
+		result.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+		result.atvr = static_cast<float>(misses) / static_cast<float>(referenced_count);
+
+		return result;
+	}
+
+	constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+
+	static float ForsythVertexScore(int cache_position, uint32_t remaining_valence)
+	{
+		if (remaining_valence == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+
+		if (cache_position >= 0)
+		{
+			// Last triangle vertices get fixed score so the next triangle doesn't just reuse them
+			if (cache_position < 3)
+			{
+				score = 0.75f;
+			}
+			else
+			{
+				const float scaler = 1.0f - static_cast<float>(cache_position - 3) / static_cast<float>(FORSYTH_CACHE_SIZE - 3);
+				score = std::pow(scaler, 1.5f);
+			}
+		}
+
+		// Boost vertices with few triangles left to finish them off
+		score += 2.0f * std::pow(static_cast<float>(remaining_valence), -0.5f);
+
+		return score;
+	}
+
+	void OptimizeVertexCache(std::span<uint32_t> indices, uint32_t vertices_count)
+	{
+		const uint32_t triangles_count = static_cast<uint32_t>(indices.size() / 3);
+
+		if (triangles_count == 0)
+			return;
+
+		// Vertex to triangles adjacency, remaining triangles of a vertex are kept at the front of its range
+		std::vector<uint32_t> remaining_valence(vertices_count, 0);
+
+		for (const uint32_t index : indices)
+		{
+			remaining_valence[index]++;
+		}
+
+		std::vector<uint32_t> adjacency_offsets(vertices_count + 1, 0);
+
+		for (uint32_t i = 0; i < vertices_count; i++)
+		{
+			adjacency_offsets[i + 1] = adjacency_offsets[i] + remaining_valence[i];
+		}
+
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> adjacency_fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+
+		for (uint32_t triangle = 0; triangle < triangles_count; triangle++)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t vertex = indices[triangle * 3 + corner];
+				adjacency[adjacency_fill[vertex]++] = triangle;
+			}
+		}
+
+		std::vector<float> vertex_scores(vertices_count);
+		std::vector<int> cache_positions(vertices_count, -1);
+
+		for (uint32_t i = 0; i < vertices_count; i++)
+		{
+			vertex_scores[i] = ForsythVertexScore(-1, remaining_valence[i]);
+		}
+
+		std::vector<float> triangle_scores(triangles_count);
+		std::vector<bool> emitted(triangles_count, false);
+
+		for (uint32_t triangle = 0; triangle < triangles_count; triangle++)
+		{
+			triangle_scores[triangle] = vertex_scores[indices[triangle * 3 + 0]] + vertex_scores[indices[triangle * 3 + 1]] +
+				vertex_scores[indices[triangle * 3 + 2]];
+		}
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+
+		std::vector<uint32_t> cache;
+		std::vector<uint32_t> new_cache;
+		cache.reserve(FORSYTH_CACHE_SIZE + 3);
+		new_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+		uint32_t best_triangle = static_cast<uint32_t>(std::distance(triangle_scores.begin(), std::ranges::max_element(triangle_scores)));
+		uint32_t input_cursor = 0;
+
+		for (uint32_t emitted_count = 0; emitted_count < triangles_count; emitted_count++)
+		{
+			// Dead end, continue from the first triangle which is not emitted yet
+			if (best_triangle == INVALID_INDEX)
+			{
+				while (emitted[input_cursor])
+				{
+					input_cursor++;
+				}
+
+				best_triangle = input_cursor;
+			}
+
+			const uint32_t triangle_vertices[3] = {
+				indices[best_triangle * 3 + 0], indices[best_triangle * 3 + 1], indices[best_triangle * 3 + 2] };
+
+			emitted[best_triangle] = true;
+			result.insert(result.end(), std::begin(triangle_vertices), std::end(triangle_vertices));
+
+			// Detach triangle from its vertices
+			for (const uint32_t vertex : triangle_vertices)
+			{
+				const uint32_t begin = adjacency_offsets[vertex];
+				const uint32_t end = begin + remaining_valence[vertex];
+
+				for (uint32_t i = begin; i < end; i++)
+				{
+					if (adjacency[i] == best_triangle)
+					{
+						std::swap(adjacency[i], adjacency[end - 1]);
+						remaining_valence[vertex]--;
+						break;
+					}
+				}
+			}
+
+			// Emitted triangle vertices go to the front of LRU cache
+			new_cache.assign(std::begin(triangle_vertices), std::end(triangle_vertices));
+
+			for (const uint32_t vertex : cache)
+			{
+				if (vertex != triangle_vertices[0] && vertex != triangle_vertices[1] && vertex != triangle_vertices[2])
+				{
+					new_cache.push_back(vertex);
+				}
+			}
+
+			// Refresh scores of all vertices that were or are in cache, entries past cache size get evicted
+			for (uint32_t i = 0; i < new_cache.size(); i++)
+			{
+				const uint32_t vertex = new_cache[i];
+				const int cache_position = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+
+				cache_positions[vertex] = cache_position;
+
+				const float new_score = ForsythVertexScore(cache_position, remaining_valence[vertex]);
+				const float score_delta = new_score - vertex_scores[vertex];
+				vertex_scores[vertex] = new_score;
+
+				const uint32_t begin = adjacency_offsets[vertex];
+
+				for (uint32_t j = begin; j < begin + remaining_valence[vertex]; j++)
+				{
+					triangle_scores[adjacency[j]] += score_delta;
+				}
+			}
+
+			if (new_cache.size() > FORSYTH_CACHE_SIZE)
+			{
+				new_cache.resize(FORSYTH_CACHE_SIZE);
+			}
+
+			std::swap(cache, new_cache);
+
+			// Next triangle is picked only among ones touching cached vertices
+			best_triangle = INVALID_INDEX;
+			float best_score = -std::numeric_limits<float>::max();
+
+			for (const uint32_t vertex : cache)
+			{
+				const uint32_t begin = adjacency_offsets[vertex];
+
+				for (uint32_t j = begin; j < begin + remaining_valence[vertex]; j++)
+				{
+					const uint32_t triangle = adjacency[j];
+
+					if (triangle_scores[triangle] > best_score)
+					{
+						best_score = triangle_scores[triangle];
+						best_triangle = triangle;
+					}
+				}
+			}
+		}
+
+		std::ranges::copy(result, indices.begin());
+	}
+
+	static DirectX::XMVECTOR LoadPosition(const Vertex& vertex)
+	{
+		return DirectX::XMLoadFloat3(&vertex.position);
+	}
+
+	void OptimizeOverdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices)
+	{
+		using namespace DirectX;
+
+		constexpr uint32_t cache_size = 16;
+
+		const uint32_t triangles_count = static_cast<uint32_t>(indices.size() / 3);
+
+		if (triangles_count == 0)
+			return;
+
+		// Triangle where every vertex misses the cache starts a new cluster, so reordering clusters keeps ACMR almost intact
+		std::vector<uint32_t> cluster_starts;
+		std::vector<uint32_t> cache_timestamps(vertices.size(), 0);
+		uint32_t timestamp = cache_size + 1;
+
+		for (uint32_t triangle = 0; triangle < triangles_count; triangle++)
+		{
+			uint32_t misses = 0;
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t vertex = indices[triangle * 3 + corner];
+
+				if (timestamp - cache_timestamps[vertex] > cache_size)
+				{
+					cache_timestamps[vertex] = timestamp++;
+					misses++;
+				}
+			}
+
+			if (triangle == 0 || misses == 3)
+			{
+				cluster_starts.push_back(triangle);
+			}
+		}
+
+		cluster_starts.push_back(triangles_count);
+
+		const uint32_t clusters_count = static_cast<uint32_t>(cluster_starts.size() - 1);
+
+		if (clusters_count < 2)
+			return;
+
+		std::vector<XMFLOAT3> cluster_centroids(clusters_count);
+		std::vector<XMFLOAT3> cluster_normals(clusters_count);
+
+		XMVECTOR mesh_centroid = XMVectorZero();
+		float mesh_area = 0.0f;
+
+		for (uint32_t cluster = 0; cluster < clusters_count; cluster++)
+		{
+			XMVECTOR centroid = XMVectorZero();
+			XMVECTOR normal = XMVectorZero();
+			float area = 0.0f;
+
+			for (uint32_t triangle = cluster_starts[cluster]; triangle < cluster_starts[cluster + 1]; triangle++)
+			{
+				const XMVECTOR p0 = LoadPosition(vertices[indices[triangle * 3 + 0]]);
+				const XMVECTOR p1 = LoadPosition(vertices[indices[triangle * 3 + 1]]);
+				const XMVECTOR p2 = LoadPosition(vertices[indices[triangle * 3 + 2]]);
+
+				// Length of cross product is twice the area, so sum of these is area weighted normal
+				const XMVECTOR triangle_normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+				const float triangle_area = XMVectorGetX(XMVector3Length(triangle_normal));
+
+				centroid = XMVectorAdd(centroid, XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), triangle_area / 3.0f));
+				normal = XMVectorAdd(normal, triangle_normal);
+				area += triangle_area;
+			}
+
+			mesh_centroid = XMVectorAdd(mesh_centroid, centroid);
+			mesh_area += area;
+
+			XMStoreFloat3(&cluster_centroids[cluster], area > 0.0f ? XMVectorScale(centroid, 1.0f / area) : centroid);
+			XMStoreFloat3(&cluster_normals[cluster], XMVector3Normalize(normal));
+		}
+
+		if (mesh_area > 0.0f)
+		{
+			mesh_centroid = XMVectorScale(mesh_centroid, 1.0f / mesh_area);
+		}
+
+		// Clusters facing away from mesh center tend to occlude the rest, so they go first
+		std::vector<float> cluster_sort_keys(clusters_count);
+
+		for (uint32_t cluster = 0; cluster < clusters_count; cluster++)
+		{
+			const XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&cluster_centroids[cluster]), mesh_centroid);
+			cluster_sort_keys[cluster] = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&cluster_normals[cluster])));
+		}
+
+		std::vector<uint32_t> cluster_order(clusters_count);
+		std::iota(cluster_order.begin(), cluster_order.end(), 0);
+		std::ranges::stable_sort(cluster_order, [&](uint32_t lhs, uint32_t rhs) { return cluster_sort_keys[lhs] > cluster_sort_keys[rhs]; });
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+
+		for (const uint32_t cluster : cluster_order)
+		{
+			result.insert(result.end(), indices.begin() + cluster_starts[cluster] * 3, indices.begin() + cluster_starts[cluster + 1] * 3);
+		}
+
+		std::ranges::copy(result, indices.begin());
+	}
+
+	void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::span<uint32_t> indices)
+	{
+		std::vector<uint32_t> remap(vertices.size(), INVALID_INDEX);
+
+		std::vector<Vertex> result;
+		result.reserve(vertices.size());
+
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == INVALID_INDEX)
+			{
+				remap[index] = static_cast<uint32_t>(result.size());
+				result.push_back(vertices[index]);
+			}
+
+			index = remap[index];
+		}
+
+		vertices = std::move(result);
+	}
+
+	// Sum of squared distances to set of planes
+	struct Quadric
+	{
+		double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+		double b2 = 0.0, bc = 0.0, bd = 0.0;
+		double c2 = 0.0, cd = 0.0;
+		double d2 = 0.0;
+
+		static Quadric FromPlane(double a, double b, double c, double d)
+		{
+			return { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+		}
+
+		Quadric& operator+=(const Quadric& other)
+		{
+			a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+			b2 += other.b2; bc += other.bc; bd += other.bd;
+			c2 += other.c2; cd += other.cd;
+			d2 += other.d2;
+			return *this;
+		}
+
+		double Evaluate(const std::array<double, 3>& p) const
+		{
+			const double x = p[0], y = p[1], z = p[2];
+
+			const double result = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+				b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+				c2 * z * z + 2.0 * cd * z + d2;
+
+			return std::max(result, 0.0);
+		}
+	};
+
+	static std::array<double, 3> Sub(const std::array<double, 3>& lhs, const std::array<double, 3>& rhs)
+	{
+		return { lhs[0] - rhs[0], lhs[1] - rhs[1], lhs[2] - rhs[2] };
+	}
+
+	static std::array<double, 3> Cross(const std::array<double, 3>& lhs, const std::array<double, 3>& rhs)
+	{
+		return { lhs[1] * rhs[2] - lhs[2] * rhs[1], lhs[2] * rhs[0] - lhs[0] * rhs[2], lhs[0] * rhs[1] - lhs[1] * rhs[0] };
+	}
+
+	static double Dot(const std::array<double, 3>& lhs, const std::array<double, 3>& rhs)
+	{
+		return lhs[0] * rhs[0] + lhs[1] * rhs[1] + lhs[2] * rhs[2];
+	}
+
+	class MeshSimplifier
+	{
+	public:
+		MeshSimplifier(std::span<const uint32_t> indices, std::span<const Vertex> vertices) :
+			m_positions(vertices.size()),
+			m_quadrics(vertices.size()),
+			m_vertex_triangles(vertices.size()),
+			m_versions(vertices.size(), 0),
+			m_is_locked(vertices.size(), false),
+			m_is_removed(vertices.size(), false)
+		{
+			std::array<float, 3> min = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+			std::array<float, 3> max = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+
+			for (const uint32_t index : indices)
+			{
+				const DirectX::XMFLOAT3& position = vertices[index].position;
+
+				min = { std::min(min[0], position.x), std::min(min[1], position.y), std::min(min[2], position.z) };
+				max = { std::max(max[0], position.x), std::max(max[1], position.y), std::max(max[2], position.z) };
+			}
+
+			m_extent = std::max({ max[0] - min[0], max[1] - min[1], max[2] - min[2] });
+
+			// Work in unit space so errors are relative to mesh extent
+			const double inverse_extent = m_extent > 0.0f ? 1.0 / m_extent : 0.0;
+
+			for (uint32_t i = 0; i < vertices.size(); i++)
+			{
+				const DirectX::XMFLOAT3& position = vertices[i].position;
+				m_positions[i] = { (position.x - min[0]) * inverse_extent, (position.y - min[1]) * inverse_extent, (position.z - min[2]) * inverse_extent };
+			}
+
+			// Edges used by one triangle are borders, attribute seams look the same since welded vertices differ there.
+			// Edges used by more than two triangles are non manifold. Vertices on both stay in place.
+			std::unordered_map<uint64_t, uint32_t> edge_uses;
+			edge_uses.reserve(indices.size());
+
+			for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				const std::array<uint32_t, 3> triangle = { indices[i + 0], indices[i + 1], indices[i + 2] };
+
+				if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2])
+					continue;
+
+				const uint32_t triangle_id = static_cast<uint32_t>(m_triangles.size());
+				m_triangles.push_back(triangle);
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					m_vertex_triangles[triangle[corner]].push_back(triangle_id);
+					edge_uses[EdgeKey(triangle[corner], triangle[(corner + 1) % 3])]++;
+				}
+
+				const std::array<double, 3> normal = Cross(Sub(m_positions[triangle[1]], m_positions[triangle[0]]), Sub(m_positions[triangle[2]], m_positions[triangle[0]]));
+				const double length = std::sqrt(Dot(normal, normal));
+
+				if (length > 0.0)
+				{
+					const std::array<double, 3> n = { normal[0] / length, normal[1] / length, normal[2] / length };
+					const Quadric quadric = Quadric::FromPlane(n[0], n[1], n[2], -Dot(n, m_positions[triangle[0]]));
+
+					for (const uint32_t vertex : triangle)
+					{
+						m_quadrics[vertex] += quadric;
+					}
+				}
+			}
+
+			m_is_triangle_removed.resize(m_triangles.size(), false);
+			m_alive_triangles_count = static_cast<uint32_t>(m_triangles.size());
+
+			for (const auto& [edge, uses] : edge_uses)
+			{
+				if (uses != 2)
+				{
+					m_is_locked[edge >> 32] = true;
+					m_is_locked[edge & 0xFFFFFFFF] = true;
+				}
+			}
+		}
+
+		std::vector<uint32_t> Simplify(uint32_t target_indices_count, float target_error, float& result_error)
+		{
+			const double max_cost = static_cast<double>(target_error) * static_cast<double>(target_error);
+			double result_cost = 0.0;
+
+			for (uint32_t vertex = 0; vertex < m_positions.size(); vertex++)
+			{
+				PushCollapses(vertex);
+			}
+
+			while (m_alive_triangles_count * 3 > target_indices_count && !m_collapses.empty())
+			{
+				const Collapse collapse = m_collapses.top();
+				m_collapses.pop();
+
+				// Cheapest collapse is over the bound, nothing else will fit either
+				if (collapse.cost > max_cost)
+					break;
+
+				if (collapse.version != m_versions[collapse.from] || m_is_removed[collapse.from] || m_is_removed[collapse.to])
+					continue;
+
+				if (!CanCollapse(collapse.from, collapse.to))
+					continue;
+
+				ApplyCollapse(collapse.from, collapse.to);
+
+				result_cost = std::max(result_cost, collapse.cost);
+			}
+
+			result_error = static_cast<float>(std::sqrt(result_cost));
+
+			std::vector<uint32_t> result;
+			result.reserve(m_alive_triangles_count * 3);
+
+			for (uint32_t triangle = 0; triangle < m_triangles.size(); triangle++)
+			{
+				if (!m_is_triangle_removed[triangle])
+				{
+					result.insert(result.end(), m_triangles[triangle].begin(), m_triangles[triangle].end());
+				}
+			}
+
+			return result;
+		}
+
+	private:
+		struct Collapse
+		{
+			double cost = 0.0;
+			uint32_t from = 0;
+			uint32_t to = 0;
+			uint32_t version = 0;
+
+			bool operator>(const Collapse& other) const
+			{
+				return cost > other.cost;
+			}
+		};
+
+		static uint64_t EdgeKey(uint32_t a, uint32_t b)
+		{
+			return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+		}
+
+		void GatherNeighbors(uint32_t vertex, std::vector<uint32_t>& neighbors) const
+		{
+			neighbors.clear();
+
+			for (const uint32_t triangle : m_vertex_triangles[vertex])
+			{
+				if (m_is_triangle_removed[triangle])
+					continue;
+
+				for (const uint32_t other : m_triangles[triangle])
+				{
+					if (other != vertex)
+					{
+						neighbors.push_back(other);
+					}
+				}
+			}
+
+			std::ranges::sort(neighbors);
+			neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+		}
+
+		void PushCollapses(uint32_t vertex)
+		{
+			if (m_is_locked[vertex] || m_is_removed[vertex])
+				return;
+
+			GatherNeighbors(vertex, m_neighbors);
+
+			for (const uint32_t neighbor : m_neighbors)
+			{
+				Quadric quadric = m_quadrics[vertex];
+				quadric += m_quadrics[neighbor];
+
+				m_collapses.push({ .cost = quadric.Evaluate(m_positions[neighbor]), .from = vertex, .to = neighbor, .version = m_versions[vertex] });
+			}
+		}
+
+		bool CanCollapse(uint32_t from, uint32_t to)
+		{
+			// Link condition, vertices shared by both ends have to be exactly the ones of the edge triangles, otherwise topology breaks
+			uint32_t edge_triangles_count = 0;
+
+			for (const uint32_t triangle : m_vertex_triangles[from])
+			{
+				if (!m_is_triangle_removed[triangle] && std::ranges::contains(m_triangles[triangle], to))
+				{
+					edge_triangles_count++;
+				}
+			}
+
+			if (edge_triangles_count == 0)
+				return false;
+
+			GatherNeighbors(from, m_neighbors);
+			GatherNeighbors(to, m_other_neighbors);
+
+			uint32_t shared_neighbors_count = 0;
+
+			for (const uint32_t neighbor : m_neighbors)
+			{
+				if (std::ranges::binary_search(m_other_neighbors, neighbor))
+				{
+					shared_neighbors_count++;
+				}
+			}
+
+			if (shared_neighbors_count != edge_triangles_count)
+				return false;
+
+			// Remaining triangles must not flip or collapse into a line
+			for (const uint32_t triangle : m_vertex_triangles[from])
+			{
+				if (m_is_triangle_removed[triangle] || std::ranges::contains(m_triangles[triangle], to))
+					continue;
+
+				std::array<std::array<double, 3>, 3> positions;
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					positions[corner] = m_positions[m_triangles[triangle][corner]];
+				}
+
+				const std::array<double, 3> normal_before = Cross(Sub(positions[1], positions[0]), Sub(positions[2], positions[0]));
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					if (m_triangles[triangle][corner] == from)
+					{
+						positions[corner] = m_positions[to];
+					}
+				}
+
+				const std::array<double, 3> normal_after = Cross(Sub(positions[1], positions[0]), Sub(positions[2], positions[0]));
+
+				const double dot = Dot(normal_before, normal_after);
+
+				if (dot <= 0.0 || Dot(normal_after, normal_after) < 1e-24)
+					return false;
+			}
+
+			return true;
+		}
+
+		void ApplyCollapse(uint32_t from, uint32_t to)
+		{
+			for (const uint32_t triangle : m_vertex_triangles[from])
+			{
+				if (m_is_triangle_removed[triangle])
+					continue;
+
+				if (std::ranges::contains(m_triangles[triangle], to))
+				{
+					m_is_triangle_removed[triangle] = true;
+					m_alive_triangles_count--;
+					continue;
+				}
+
+				for (uint32_t& vertex : m_triangles[triangle])
+				{
+					if (vertex == from)
+					{
+						vertex = to;
+					}
+				}
+
+				m_vertex_triangles[to].push_back(triangle);
+			}
+
+			std::erase_if(m_vertex_triangles[to], [this](uint32_t triangle) { return m_is_triangle_removed[triangle]; });
+
+			m_vertex_triangles[from].clear();
+			m_is_removed[from] = true;
+			m_quadrics[to] += m_quadrics[from];
+
+			// Costs around target changed, older heap entries are dropped by version mismatch
+			GatherNeighbors(to, m_affected);
+
+			m_versions[to]++;
+			PushCollapses(to);
+
+			for (const uint32_t neighbor : m_affected)
+			{
+				m_versions[neighbor]++;
+				PushCollapses(neighbor);
+			}
+		}
+
+		std::vector<std::array<double, 3>> m_positions;
+		std::vector<Quadric> m_quadrics;
+		std::vector<std::array<uint32_t, 3>> m_triangles;
+		std::vector<std::vector<uint32_t>> m_vertex_triangles;
+		std::vector<uint32_t> m_versions;
+		std::vector<bool> m_is_locked;
+		std::vector<bool> m_is_removed;
+		std::vector<bool> m_is_triangle_removed;
+		uint32_t m_alive_triangles_count = 0;
+		float m_extent = 0.0f;
+
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> m_collapses;
+
+		// Scratch storage
+		std::vector<uint32_t> m_neighbors;
+		std::vector<uint32_t> m_other_neighbors;
+		std::vector<uint32_t> m_affected;
+	};
+
+	std::vector<uint32_t> SimplifyMesh(
+		std::span<const uint32_t> indices, std::span<const Vertex> vertices, uint32_t target_indices_count, float target_error, float& result_error)
+	{
+		result_error = 0.0f;
+
+		if (indices.size() <= target_indices_count)
+			return std::vector<uint32_t>(indices.begin(), indices.end());
+
+		MeshSimplifier simplifier(indices, vertices);
+		return simplifier.Simplify(target_indices_count, target_error, result_error);
+	}
+
+	MeshOptimizationStatistics OptimizePrimitive(Primitive& primitive, const MeshOptimizationParameters& parameters)
+	{
+		MeshOptimizationStatistics statistics;
+		statistics.vertices_before = static_cast<uint32_t>(primitive.vertices.size());
+		statistics.triangles_count = static_cast<uint32_t>(primitive.indices.size() / 3);
+		statistics.acmr_before = AnalyzeVertexCache(primitive.indices, statistics.vertices_before).acmr;
+
+		if (primitive.topology != D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST || primitive.indices.empty() || primitive.indices.size() % 3 != 0)
+		{
+			statistics.vertices_after = statistics.vertices_before;
+			statistics.acmr_after = statistics.acmr_before;
+			return statistics;
+		}
+
+		WeldVertices(primitive.vertices, primitive.indices);
+
+		const uint32_t vertices_count = static_cast<uint32_t>(primitive.vertices.size());
+
+		OptimizeVertexCache(primitive.indices, vertices_count);
+		OptimizeOverdraw(primitive.indices, primitive.vertices);
+
+		const float extent = std::max({ primitive.bbox.max.x - primitive.bbox.min.x,
+			primitive.bbox.max.y - primitive.bbox.min.y,
+			primitive.bbox.max.z - primitive.bbox.min.z });
+
+		// Every LOD is simplified from LOD0, so its error is measured against the source mesh and doesn't pile up
+		std::vector<PrimitiveLod> lods = { { .index_offset = 0, .index_count = static_cast<uint32_t>(primitive.indices.size()), .error = 0.0f } };
+		std::vector<uint32_t> all_lods_indices = primitive.indices;
+
+		float max_error = parameters.lod_max_error;
+
+		for (uint32_t lod = 1; lod < parameters.max_lods_count; lod++, max_error *= parameters.lod_error_growth)
+		{
+			const uint32_t target_indices_count = static_cast<uint32_t>(lods.back().index_count * parameters.lod_reduction) / 3 * 3;
+
+			if (target_indices_count < 3)
+				break;
+
+			float lod_error = 0.0f;
+			std::vector<uint32_t> lod_indices = SimplifyMesh(primitive.indices, primitive.vertices, target_indices_count, max_error, lod_error);
+
+			// Simplification got stuck on borders or error bound, LOD wouldn't pay off
+			if (lod_indices.empty() || lod_indices.size() > lods.back().index_count * 0.8f)
+				break;
+
+			OptimizeVertexCache(lod_indices, vertices_count);
+
+			lods.push_back({ .index_offset = static_cast<uint32_t>(all_lods_indices.size()),
+				.index_count = static_cast<uint32_t>(lod_indices.size()),
+				.error = lod_error * extent });
+
+			all_lods_indices.insert(all_lods_indices.end(), lod_indices.begin(), lod_indices.end());
+		}
+
+		// LOD0 goes first, so fetch order is tuned for it
+		OptimizeVertexFetch(primitive.vertices, all_lods_indices);
+
+		primitive.indices = std::move(all_lods_indices);
+		primitive.lods = std::move(lods);
+
+		statistics.vertices_after = static_cast<uint32_t>(primitive.vertices.size());
+		statistics.acmr_after = AnalyzeVertexCache(std::span(primitive.indices).first(primitive.lods[0].index_count), statistics.vertices_after).acmr;
+
+		return statistics;
+	}
+}
@@ -15,6 +15,13 @@ import system.logger;
 
 export namespace ysn
 {
+	struct PrimitiveLod
+	{
+		uint32_t index_offset = 0; // Relative to the first index of primitive
+		uint32_t index_count = 0;
+		float error = 0.0f; // Object space distance to LOD0 surface
+	};
+
 	struct Primitive
 	{
 		uint32_t index = 0;
@@ -40,6 +47,47 @@ export namespace ysn
 		std::vector<uint32_t> indices;
 		uint32_t global_vertex_offset = 0;
 		uint32_t global_index_offset = 0;
+
+		// Point into memory mapped scene cache when model is loaded from it, vectors above stay empty then
+		std::span<const Vertex> cooked_vertices;
+		std::span<const uint32_t> cooked_indices;
+
+		std::span<const Vertex> GetVertices() const
+		{
+			return cooked_vertices.empty() ? std::span<const Vertex>(vertices) : cooked_vertices;
+		}
+
+		std::span<const uint32_t> GetIndices() const
+		{
+			return cooked_indices.empty() ? std::span<const uint32_t>(indices) : cooked_indices;
+		}
+
+		// Filled by mesh optimizer, indices of all LODs follow each other starting from LOD0
+		std::vector<PrimitiveLod> lods;
+
+		PrimitiveLod GetLod(uint32_t lod) const
+		{
+			if (lods.empty())
+				return { .index_offset = 0, .index_count = index_count, .error = 0.0f };
+
+			return lods[std::min<std::size_t>(lod, lods.size() - 1)];
+		}
+
+		// Coarsest LOD which error projects to no more than max_screen_error pixels
+		uint32_t SelectLod(float distance, float projection_scale, float max_screen_error) const
+		{
+			uint32_t selected_lod = 0;
+
+			for (uint32_t lod = 1; lod < lods.size(); lod++)
+			{
+				if (lods[lod].error * projection_scale > max_screen_error * distance)
+					break;
+
+				selected_lod = lod;
+			}
+
+			return selected_lod;
+		}
 	};
 
 	// TODO: Rename it into some CSG mesh
@@ -11,10 +11,19 @@ import yasno.camera_controller;
 import yasno.camera;
 import graphics.material;
 import graphics.mesh;
+import graphics.primitive;
+import graphics.aabb;
+import graphics.culling;
+import graphics.engine_stats;
 import graphics.lights;
 import renderer.gpu_texture;
 import renderer.gpu_buffer;
 import renderer.descriptor_heap;
+import renderer.vertex_storage;
+import renderer.pso;
+import renderer.render_queue;
+import system.filesystem;
+import system.profiler;
 
 export namespace ysn
 {
@@ -39,6 +48,17 @@ export namespace ysn
 
 		// Not sure about that x2
 		std::vector<D3D12_SAMPLER_DESC> sampler_descs;
+
+		// Keeps scene cache mapped while primitives point into it
+		std::shared_ptr<MappedFile> cooked_data;
+	};
+
+	// Flat index of primitive, same as instance id used by passes and PerInstanceData
+	struct PrimitiveInstance
+	{
+		uint32_t model_id = 0;
+		uint32_t mesh_id = 0;
+		uint32_t primitive_id = 0;
 	};
 
 	struct RenderScene
@@ -57,6 +77,7 @@ export namespace ysn
 		D3D12_INDEX_BUFFER_VIEW index_buffer_view;
 
 		// Vertices
+		VertexFormat vertex_format = VertexFormat::Full; // Compact one has to be chosen before content is loaded
 		uint32_t vertices_count = 0;
 		GpuBuffer vertices_buffer;
 		D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view;
@@ -70,5 +91,248 @@ export namespace ysn
 		uint32_t primitives_count = 0;
 		GpuBuffer instance_buffer;
 		DescriptorHandle instance_buffer_srv;
+
+		// LOD per primitive instance, selected for the main camera every frame
+		float lod_max_screen_error = 1.0f; // In pixels
+		std::vector<uint32_t> primitive_lods;
+
+		// Frustum culling, SetTransform bumps transforms_version so instance BVH is refitted
+		bool is_culling_enabled = true;
+		uint32_t transforms_version = 0;
+		uint32_t culled_transforms_version = 0;
+		std::vector<PrimitiveInstance> primitive_instances;
+		std::vector<AABB> instance_boxes; // World space
+		InstanceBvh instance_bvh;
+
+		// Instance ids to draw, filled every frame
+		std::vector<uint32_t> visible_instances;
+		std::vector<uint32_t> shadow_visible_instances;
+
+		const Primitive& GetPrimitive(uint32_t instance_id) const
+		{
+			const PrimitiveInstance& instance = primitive_instances[instance_id];
+			return models[instance.model_id].meshes[instance.mesh_id].primitives[instance.primitive_id];
+		}
+
+		// Transforms of loaded models change only here, so culling and GPU copies of transforms can tell they are outdated
+		void SetTransform(uint32_t model_id, uint32_t mesh_id, const DirectX::XMMATRIX& transform)
+		{
+			models[model_id].transforms[mesh_id] = transform;
+			transforms_version++;
+		}
 	};
+
+	void UpdatePrimitiveLods(RenderScene& render_scene, float viewport_height);
+
+	// Fills visible instance lists of camera and shadow passes
+	void CullRenderScene(RenderScene& render_scene, const DirectX::XMMATRIX& shadow_view_projection);
+
+	// Queues instances with selected LODs from scene wide vertex and index buffers
+	// Without view position draws are sorted only by state
+	void FillRenderQueue(RenderQueue& render_queue,
+		const RenderScene& render_scene,
+		std::span<const uint32_t> instances,
+		PsoId Primitive::* pso_id,
+		const std::optional<DirectX::XMFLOAT3>& view_position);
+}
+
+module :private;
+
+namespace ysn
+{
+	void UpdatePrimitiveLods(RenderScene& render_scene, float viewport_height)
+	{
+		using namespace DirectX;
+
+		render_scene.primitive_lods.resize(render_scene.primitives_count, 0);
+
+		// Pixels covered by one unit at unit distance
+		const float projection_scale = viewport_height / (2.0f * std::tan(XMConvertToRadians(render_scene.camera->fov) * 0.5f));
+		const XMFLOAT3 camera_position_float = render_scene.camera->GetPosition();
+		const XMVECTOR camera_position = XMLoadFloat3(&camera_position_float);
+
+		uint32_t instance_id = 0;
+
+		for (const Model& model : render_scene.models)
+		{
+			for (int mesh_id = 0; mesh_id < model.meshes.size(); mesh_id++)
+			{
+				const XMMATRIX& transform = model.transforms[mesh_id];
+
+				// Errors are in object space, largest axis scale keeps selection conservative
+				const float scale = std::max({ XMVectorGetX(XMVector3Length(transform.r[0])),
+					XMVectorGetX(XMVector3Length(transform.r[1])),
+					XMVectorGetX(XMVector3Length(transform.r[2])) });
+
+				for (const Primitive& primitive : model.meshes[mesh_id].primitives)
+				{
+					if (instance_id >= render_scene.primitive_lods.size())
+						return;
+
+					const XMVECTOR bbox_min = XMLoadFloat3(&primitive.bbox.min);
+					const XMVECTOR bbox_max = XMLoadFloat3(&primitive.bbox.max);
+
+					const XMVECTOR center = XMVector3Transform(XMVectorScale(XMVectorAdd(bbox_min, bbox_max), 0.5f), transform);
+					const float radius = XMVectorGetX(XMVector3Length(XMVectorSubtract(bbox_max, bbox_min))) * 0.5f * scale;
+
+					// Distance to bounding sphere surface, inside of it always gets full detail
+					const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, camera_position))) - radius;
+
+					render_scene.primitive_lods[instance_id] =
+						distance > 0.0f && scale > 0.0f ? primitive.SelectLod(distance / scale, projection_scale, render_scene.lod_max_screen_error) : 0;
+
+					instance_id++;
+				}
+			}
+		}
+	}
+
+	static void UpdateInstanceBvh(RenderScene& render_scene)
+	{
+		const bool is_topology_changed = render_scene.primitive_instances.size() != render_scene.primitives_count;
+
+		if (is_topology_changed)
+		{
+			render_scene.primitive_instances.clear();
+			render_scene.primitive_instances.reserve(render_scene.primitives_count);
+
+			for (uint32_t model_id = 0; model_id < render_scene.models.size(); model_id++)
+			{
+				const Model& model = render_scene.models[model_id];
+
+				for (uint32_t mesh_id = 0; mesh_id < model.meshes.size(); mesh_id++)
+				{
+					for (uint32_t primitive_id = 0; primitive_id < model.meshes[mesh_id].primitives.size(); primitive_id++)
+					{
+						render_scene.primitive_instances.push_back({ model_id, mesh_id, primitive_id });
+					}
+				}
+			}
+		}
+		else if (render_scene.culled_transforms_version == render_scene.transforms_version)
+		{
+			return;
+		}
+
+		render_scene.instance_boxes.resize(render_scene.primitive_instances.size());
+
+		for (uint32_t instance_id = 0; instance_id < render_scene.primitive_instances.size(); instance_id++)
+		{
+			const PrimitiveInstance& instance = render_scene.primitive_instances[instance_id];
+
+			render_scene.instance_boxes[instance_id] = TransformAabb(
+				render_scene.GetPrimitive(instance_id).bbox, render_scene.models[instance.model_id].transforms[instance.mesh_id]);
+		}
+
+		// Moved instances only need bounds update, new ones need new hierarchy
+		if (is_topology_changed || !render_scene.instance_bvh.Refit(render_scene.instance_boxes))
+		{
+			render_scene.instance_bvh.Build(render_scene.instance_boxes);
+		}
+
+		render_scene.culled_transforms_version = render_scene.transforms_version;
+	}
+
+	void CullRenderScene(RenderScene& render_scene, const DirectX::XMMATRIX& shadow_view_projection)
+	{
+		ScopedZone zone("Culling");
+
+		const auto culling_start_time = std::chrono::high_resolution_clock::now();
+
+		UpdateInstanceBvh(render_scene);
+
+		CullingStats stats;
+		CullingStats shadow_stats;
+
+		if (render_scene.is_culling_enabled)
+		{
+			const DirectX::XMMATRIX view_projection = render_scene.camera->GetViewMatrix() * render_scene.camera->GetProjectionMatrix();
+
+			render_scene.instance_bvh.Cull(CreateFrustum(view_projection), render_scene.visible_instances, stats);
+			render_scene.instance_bvh.Cull(CreateFrustum(shadow_view_projection), render_scene.shadow_visible_instances, shadow_stats);
+		}
+		else
+		{
+			render_scene.visible_instances.resize(render_scene.primitive_instances.size());
+			std::iota(render_scene.visible_instances.begin(), render_scene.visible_instances.end(), 0);
+
+			render_scene.shadow_visible_instances = render_scene.visible_instances;
+		}
+
+		const std::chrono::duration<double, std::milli> culling_duration = std::chrono::high_resolution_clock::now() - culling_start_time;
+
+		engine_stats::culling_instances = static_cast<uint32_t>(render_scene.primitive_instances.size());
+		engine_stats::culling_tested_instances = stats.tested_instances + shadow_stats.tested_instances;
+		engine_stats::culling_visible_instances = static_cast<uint32_t>(render_scene.visible_instances.size());
+		engine_stats::culling_shadow_visible_instances = static_cast<uint32_t>(render_scene.shadow_visible_instances.size());
+		engine_stats::culling_ms = culling_duration.count();
+
+		ProfilerCounter("Visible Instances", static_cast<double>(render_scene.visible_instances.size()));
+		ProfilerCounter("Shadow Visible Instances", static_cast<double>(render_scene.shadow_visible_instances.size()));
+	}
+
+	void FillRenderQueue(RenderQueue& render_queue,
+		const RenderScene& render_scene,
+		std::span<const uint32_t> instances,
+		PsoId Primitive::* pso_id,
+		const std::optional<DirectX::XMFLOAT3>& view_position)
+	{
+		using namespace DirectX;
+
+		render_queue.Clear();
+
+		// Depth key only needs ordering, so distances are normalized by the farthest instance
+		std::vector<float> distances(instances.size(), 0.0f);
+		float max_distance = 0.0f;
+
+		if (view_position.has_value() && render_scene.instance_boxes.size() == render_scene.primitive_instances.size())
+		{
+			const XMVECTOR position = XMLoadFloat3(&view_position.value());
+
+			for (std::size_t i = 0; i < instances.size(); i++)
+			{
+				const AABB& box = render_scene.instance_boxes[instances[i]];
+				const XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&box.min), XMLoadFloat3(&box.max)), 0.5f);
+
+				distances[i] = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, position)));
+				max_distance = std::max(max_distance, distances[i]);
+			}
+		}
+
+		for (std::size_t i = 0; i < instances.size(); i++)
+		{
+			const uint32_t instance_id = instances[i];
+			const Primitive& primitive = render_scene.GetPrimitive(instance_id);
+			const Model& model = render_scene.models[render_scene.primitive_instances[instance_id].model_id];
+
+			const bool has_material = primitive.material_id >= 0 && static_cast<std::size_t>(primitive.material_id) < model.materials.size();
+
+			DrawCommand command;
+			command.pso_id = primitive.*pso_id;
+			command.material_id = has_material ? static_cast<uint32_t>(primitive.material_id) : 0;
+			command.depth = max_distance > 0.0f ? distances[i] / max_distance : 0.0f;
+			command.is_translucent = has_material && model.materials[primitive.material_id].blend_desc.RenderTarget[0].BlendEnable;
+			command.instance_id = instance_id;
+			command.topology = primitive.topology;
+			command.vertex_buffer_view = render_scene.vertex_buffer_view;
+
+			if (primitive.index_count)
+			{
+				const uint32_t lod_index = instance_id < render_scene.primitive_lods.size() ? render_scene.primitive_lods[instance_id] : 0;
+				const PrimitiveLod lod = primitive.GetLod(lod_index);
+
+				command.index_buffer_view = render_scene.index_buffer_view;
+				command.count = lod.index_count;
+				command.start_index = primitive.global_index_offset + lod.index_offset;
+				command.base_vertex = static_cast<int32_t>(primitive.global_vertex_offset);
+			}
+			else
+			{
+				command.count = primitive.vertex_count;
+				command.start_index = primitive.global_vertex_offset;
+			}
+
+			render_queue.Add(command);
+		}
+	}
 }
@@ -8,6 +8,7 @@ module;
 
 export module graphics.techniques.forward_pass;
 
+import std;
 import graphics.primitive;
 import graphics.render_scene;
 import graphics.material;
@@ -19,6 +20,9 @@ import renderer.descriptor_heap;
 import renderer.gpu_texture;
 import renderer.gpu_buffer;
 import renderer.gpu_pixel_buffer;
+import renderer.vertex_storage;
+import renderer.render_queue;
+import graphics.engine_stats;
 import system.filesystem;
 import system.application;
 import system.logger;
@@ -74,28 +78,23 @@ export namespace ysn
 
 	struct ForwardPass
 	{
-		bool Initialize(
-			const RenderScene& render_scene,
-			wil::com_ptr<ID3D12Resource> camera_gpu_buffer,
-			wil::com_ptr<ID3D12Resource> scene_parameters_gpu_buffer,
-			const GpuBuffer& instance_buffer,
-			wil::com_ptr<ID3D12GraphicsCommandList4> cmd_list);
-		bool InitializeIndirectPipeline(
-			const RenderScene& render_scene,
-			wil::com_ptr<ID3D12Resource> camera_gpu_buffer,
-			wil::com_ptr<ID3D12Resource> scene_parameters_gpu_buffer,
-			const GpuBuffer& instance_buffer,
-			wil::com_ptr<ID3D12GraphicsCommandList4> cmd_list);
-		bool CompilePrimitivePso(ysn::Primitive& primitive, std::vector<Material> materials);
+		bool Initialize(const RenderScene& render_scene);
+		bool InitializeIndirectPipeline(const RenderScene& render_scene);
+		bool CompilePrimitivePso(ysn::Primitive& primitive, std::vector<Material> materials, VertexFormat vertex_format);
 		bool Render(const RenderScene& render_scene, const ForwardPassRenderParameters& render_parameters);
 		bool RenderIndirect(const RenderScene& render_scene, const ForwardPassRenderParameters& render_parameters);
 
+		RenderQueue m_render_queue;
+		uint32_t m_missing_pso_draws_count = 0; // Of the last frame
+
 		// Indirect data
 		wil::com_ptr<ID3D12RootSignature> m_indirect_root_signature;
 		wil::com_ptr<ID3D12CommandSignature> m_command_signature;
-		GpuBuffer m_command_buffer;
+		GpuBuffer m_command_buffer; // Upload ring, one region per frame in flight
+		IndirectCommand* m_mapped_commands = nullptr;
 		PsoId indirect_pso_id = 0;
 		uint32_t m_command_buffer_size = 0; // PrimitiveCount * sizeof(IndirectCommand)
+		uint32_t m_command_buffer_frame = 0;
 	};
 }
 
@@ -103,7 +102,7 @@ module :private;
 
 namespace ysn
 {
-	bool ForwardPass::CompilePrimitivePso(ysn::Primitive& primitive, std::vector<Material> materials)
+	bool ForwardPass::CompilePrimitivePso(ysn::Primitive& primitive, std::vector<Material> materials, VertexFormat vertex_format)
 	{
 		std::shared_ptr<DxRenderer> renderer = Application::Get().GetRenderer();
 
@@ -255,11 +254,11 @@ namespace ysn
 			pso_desc.SetRootSignature(root_signature);
 		}
 
-		pso_desc.AddShader({ ShaderType::Vertex, VfsPath(L"shaders/forward_pass.vs.hlsl") });
+		pso_desc.AddShader({ ShaderType::Vertex, VfsPath(L"shaders/forward_pass.vs.hlsl"), GetVertexFormatDefines(vertex_format) });
 		pso_desc.AddShader({ ShaderType::Pixel, VfsPath(L"shaders/forward_pass.ps.hlsl") });
 		pso_desc.SetDepthStencilState(
 			{ .DepthEnable = true, .DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL, .DepthFunc = D3D12_COMPARISON_FUNC_LESS });
-		pso_desc.SetInputLayout(Vertex::GetVertexLayoutDesc());
+		pso_desc.SetInputLayout(GetVertexLayoutDesc(vertex_format));
 		pso_desc.SetSampleMask(UINT_MAX);
 
 		const auto material = materials[primitive.material_id];
@@ -323,66 +322,44 @@ namespace ysn
 			command_list->ResourceBarrier(1, &barrier);
 		}
 
-		uint32_t instance_id = 0;
+		FillRenderQueue(m_render_queue, render_scene, render_scene.visible_instances, &Primitive::pso_id, render_scene.camera->GetPosition());
+		m_render_queue.ResolvePsos([&renderer](PsoId pso_id) { return renderer->GetPso(pso_id); });
+		m_render_queue.Sort();
 
-		for (auto& model : render_scene.models)
-		{
-			for (int mesh_id = 0; mesh_id < model.meshes.size(); mesh_id++)
-			{
-				const Mesh& mesh = model.meshes[mesh_id];
+		const uint32_t missing_pso_draws_count = m_render_queue.GetMissingPsoDrawsCount();
 
-				for (int primitive_id = 0; primitive_id < mesh.primitives.size(); primitive_id++)
-				{
-					const Primitive& primitive = mesh.primitives[primitive_id];
-
-					command_list->IASetVertexBuffers(0, 1, &primitive.vertex_buffer_view);
-
-					// TODO: check for -1 as pso_id
-					const std::optional<Pso> pso = renderer->GetPso(primitive.pso_id);
-
-					if (pso.has_value())
-					{
-						command_list->SetGraphicsRootSignature(pso.value().root_signature.get());
-						command_list->SetPipelineState(pso.value().pso.get());
-
-						command_list->IASetPrimitiveTopology(primitive.topology);
-
-						command_list->SetGraphicsRootConstantBufferView(0, render_parameters.camera_gpu_buffer->GetGPUVirtualAddress());
-						command_list->SetGraphicsRootConstantBufferView(1, render_parameters.scene_parameters_gpu_buffer->GetGPUVirtualAddress());
-						command_list->SetGraphicsRoot32BitConstant(2, instance_id, 0); // InstanceID
-
-						command_list->SetGraphicsRootDescriptorTable(3, render_scene.instance_buffer_srv.gpu);
-						command_list->SetGraphicsRootDescriptorTable(4, render_scene.materials_buffer_srv.gpu);
-						command_list->SetGraphicsRootDescriptorTable(5, render_parameters.shadow_map_buffer.srv_handle.gpu);
-
-						command_list->SetGraphicsRootDescriptorTable(6, render_parameters.cubemap_texture.srv.gpu);
-						command_list->SetGraphicsRootDescriptorTable(7, render_parameters.irradiance_texture.srv.gpu);
-						command_list->SetGraphicsRootDescriptorTable(8, render_parameters.radiance_texture.srv.gpu);
-						command_list->SetGraphicsRootDescriptorTable(9, render_parameters.brdf_texture_handle.gpu);
-
-						command_list->SetGraphicsRootDescriptorTable(10, render_parameters.debug_vertices_buffer_uav.gpu);
-						command_list->SetGraphicsRootDescriptorTable(11, render_parameters.debug_counter_buffer_uav.gpu);
-
-						if (primitive.index_count)
-						{
-							command_list->IASetIndexBuffer(&primitive.index_buffer_view);
-							command_list->DrawIndexedInstanced(primitive.index_count, 1, 0, 0, 0);
-						}
-						else
-						{
-							command_list->DrawInstanced(primitive.vertex_count, 1, 0, 0);
-						}
-					}
-					else
-					{
-						LogInfo << "Can't render primitive because it haven't any PSO\n";
-					}
-
-					instance_id++;
-				}
-			}
+		// Same draws miss their PSOs for many frames while those compile, so only changes are logged
+		if (missing_pso_draws_count != m_missing_pso_draws_count && missing_pso_draws_count)
+		{
+			LogInfo << "Can't render " << missing_pso_draws_count << " primitives because they haven't any PSO\n";
 		}
 
+		m_missing_pso_draws_count = missing_pso_draws_count;
+		engine_stats::forward_missing_pso_draws = missing_pso_draws_count;
+
+		// Everything except InstanceID is the same for all draws
+		D3D12CommandRecorder recorder(command_list.get(), 2, [&](ID3D12GraphicsCommandList* cmd_list) {
+			cmd_list->SetGraphicsRootConstantBufferView(0, render_parameters.camera_gpu_buffer->GetGPUVirtualAddress());
+			cmd_list->SetGraphicsRootConstantBufferView(1, render_parameters.scene_parameters_gpu_buffer->GetGPUVirtualAddress());
+
+			cmd_list->SetGraphicsRootDescriptorTable(3, render_scene.instance_buffer_srv.gpu);
+			cmd_list->SetGraphicsRootDescriptorTable(4, render_scene.materials_buffer_srv.gpu);
+			cmd_list->SetGraphicsRootDescriptorTable(5, render_parameters.shadow_map_buffer.srv_handle.gpu);
+
+			cmd_list->SetGraphicsRootDescriptorTable(6, render_parameters.cubemap_texture.srv.gpu);
+			cmd_list->SetGraphicsRootDescriptorTable(7, render_parameters.irradiance_texture.srv.gpu);
+			cmd_list->SetGraphicsRootDescriptorTable(8, render_parameters.radiance_texture.srv.gpu);
+			cmd_list->SetGraphicsRootDescriptorTable(9, render_parameters.brdf_texture_handle.gpu);
+
+			cmd_list->SetGraphicsRootDescriptorTable(10, render_parameters.debug_vertices_buffer_uav.gpu);
+			cmd_list->SetGraphicsRootDescriptorTable(11, render_parameters.debug_counter_buffer_uav.gpu);
+		});
+
+		m_render_queue.Submit(recorder);
+
+		engine_stats::forward_draw_calls = recorder.stats.draws;
+		engine_stats::forward_state_changes = recorder.stats.GetStateChanges();
+
 		{
 			CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
 				render_parameters.shadow_map_buffer.buffer.get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE);
@@ -394,14 +371,9 @@ namespace ysn
 		return true;
 	}
 
-	bool ForwardPass::Initialize(
-		const RenderScene& render_scene,
-		wil::com_ptr<ID3D12Resource> camera_gpu_buffer,
-		wil::com_ptr<ID3D12Resource> scene_parameters_gpu_buffer,
-		const GpuBuffer& instance_buffer,
-		wil::com_ptr<ID3D12GraphicsCommandList4> cmd_list)
+	bool ForwardPass::Initialize(const RenderScene& render_scene)
 	{
-		bool result = InitializeIndirectPipeline(render_scene, camera_gpu_buffer, scene_parameters_gpu_buffer, instance_buffer, cmd_list);
+		bool result = InitializeIndirectPipeline(render_scene);
 
 		if (!result)
 		{
@@ -412,12 +384,7 @@ namespace ysn
 		return true;
 	}
 
-	bool ForwardPass::InitializeIndirectPipeline(
-		const RenderScene& render_scene,
-		wil::com_ptr<ID3D12Resource> camera_gpu_buffer,
-		wil::com_ptr<ID3D12Resource> scene_parameters_gpu_buffer,
-		const GpuBuffer& instance_buffer,
-		wil::com_ptr<ID3D12GraphicsCommandList4> cmd_list)
+	bool ForwardPass::InitializeIndirectPipeline(const RenderScene& render_scene)
 	{
 		auto renderer = Application::Get().GetRenderer();
 
@@ -494,11 +461,11 @@ namespace ysn
 		// Create PSO
 		GraphicsPsoDesc pso_desc("Indirect Primitive PSO");
 		pso_desc.SetRootSignature(m_indirect_root_signature.get());
-		pso_desc.AddShader({ ShaderType::Vertex, VfsPath(L"shaders/indirect_forward_pass.vs.hlsl") });
+		pso_desc.AddShader({ ShaderType::Vertex, VfsPath(L"shaders/indirect_forward_pass.vs.hlsl"), GetVertexFormatDefines(render_scene.vertex_format) });
 		pso_desc.AddShader({ ShaderType::Pixel, VfsPath(L"shaders/indirect_forward_pass.ps.hlsl") });
 		pso_desc.SetDepthStencilState(
 			{ .DepthEnable = true, .DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL, .DepthFunc = D3D12_COMPARISON_FUNC_LESS });
-		pso_desc.SetInputLayout(Vertex::GetVertexLayoutDesc());
+		pso_desc.SetInputLayout(GetVertexLayoutDesc(render_scene.vertex_format));
 		pso_desc.SetSampleMask(UINT_MAX);
 
 		// TODO: Should use GLTFs parameters
@@ -531,61 +498,31 @@ namespace ysn
 
 		indirect_pso_id = *result_pso;
 
-		// Create commands
-		//m_indirect_commands.resize(render_scene.primitives_count);
+		// Commands are packed from sorted render queue every frame
+		m_command_buffer_size = render_scene.primitives_count * sizeof(IndirectCommand);
 
-		D3D12_GPU_VIRTUAL_ADDRESS instance_data_buffer_gpu_address = instance_buffer.GPUVirtualAddress();
-		UINT command_index = 0;
+		GpuBufferCreateInfo create_info{ .size = std::max(m_command_buffer_size, 1u) * Window::BufferCount,
+			.heap_type = D3D12_HEAP_TYPE_UPLOAD, .state = D3D12_RESOURCE_STATE_GENERIC_READ };
 
-		std::vector<IndirectCommand> m_indirect_commands;
+		const auto command_buffer_result = CreateGpuBuffer(create_info, "Indirect Command Buffer");
 
-		// Fill commands
-		for (auto& model : render_scene.models)
+		if (!command_buffer_result.has_value())
 		{
-			for (int mesh_id = 0; mesh_id < model.meshes.size(); mesh_id++)
-			{
-				const Mesh& mesh = model.meshes[mesh_id];
-
-				for (int primitive_id = 0; primitive_id < mesh.primitives.size(); primitive_id++)
-				{
-					const Primitive& primitive = mesh.primitives[primitive_id];
-
-					IndirectCommand command;
-
-					command.camera_parameters_cbv = camera_gpu_buffer->GetGPUVirtualAddress();
-					command.scene_parameters_cbv = scene_parameters_gpu_buffer->GetGPUVirtualAddress();
-					command.per_instance_data_cbv = instance_data_buffer_gpu_address;
-
-					command.draw_arguments.IndexCountPerInstance = primitive.index_count;
-					command.draw_arguments.InstanceCount = 1;
-					command.draw_arguments.StartIndexLocation = primitive.global_index_offset;
-					command.draw_arguments.BaseVertexLocation = primitive.global_vertex_offset;
-					command.draw_arguments.StartInstanceLocation = 0;
-
-					m_indirect_commands.push_back(command);
-
-					command_index++;
-					instance_data_buffer_gpu_address += sizeof(PerInstanceData);
-				}
-			}
+			LogError << "Can't create indirect command buffer\n";
+			return false;
 		}
 
-		m_command_buffer_size = command_index * sizeof(IndirectCommand);
-
-		GpuBufferCreateInfo create_info{ .size = m_command_buffer_size,
-			.heap_type = D3D12_HEAP_TYPE_DEFAULT, .state = D3D12_RESOURCE_STATE_COPY_DEST };
+		m_command_buffer = command_buffer_result.value();
 
-		const auto command_buffer_result = CreateGpuBuffer(create_info, "RenderInstance Buffer");
+		void* data = nullptr;
 
-		if (!command_buffer_result.has_value())
+		if (m_command_buffer->Map(0, nullptr, &data) != S_OK)
 		{
-			LogError << "Can't create indirect command buffer\n";
+			LogError << "Can't map indirect command buffer\n";
 			return false;
 		}
 
-		m_command_buffer = command_buffer_result.value();
-
-		UploadToGpuBuffer(cmd_list, m_command_buffer, m_indirect_commands.data(), {}, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+		m_mapped_commands = static_cast<IndirectCommand*>(data);
 
 		return true;
 	}
@@ -621,13 +558,63 @@ namespace ysn
 
 			command_list->SetPipelineState(pso.value().pso.get());
 			command_list->SetGraphicsRootSignature(m_indirect_root_signature.get());
-			command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 			command_list->IASetVertexBuffers(0, 1, &render_scene.vertex_buffer_view);
 			command_list->IASetIndexBuffer(&render_scene.index_buffer_view);
 
+			// Every primitive is drawn with indirect PSO, so runs are split only by topology
+			FillRenderQueue(m_render_queue, render_scene, render_scene.visible_instances, &Primitive::pso_id, render_scene.camera->GetPosition());
+			m_render_queue.ResolvePsos([&pso](PsoId) { return pso; });
+			m_render_queue.Sort();
+
+			// Region of this frame is free after frames in flight are waited on
+			m_command_buffer_frame = (m_command_buffer_frame + 1) % Window::BufferCount;
+
+			const uint32_t commands_offset = m_command_buffer_frame * m_command_buffer_size;
+			IndirectCommand* commands = m_mapped_commands + commands_offset / sizeof(IndirectCommand);
+			uint32_t commands_count = 0;
+
+			const std::span<const DrawCommand> draws = m_render_queue.GetSortedDraws();
+			uint32_t execute_count = 0;
+
+			for (const DrawRun& run : m_render_queue.BuildRuns())
+			{
+				const uint32_t first_command = commands_count;
+
+				for (const DrawCommand& draw : draws.subspan(run.first, run.count))
+				{
+					// Command signature has indexed draws only
+					if (draw.index_buffer_view.SizeInBytes == 0)
+						continue;
+
+					IndirectCommand& command = commands[commands_count++];
+
+					command.camera_parameters_cbv = render_parameters.camera_gpu_buffer->GetGPUVirtualAddress();
+					command.scene_parameters_cbv = render_parameters.scene_parameters_gpu_buffer->GetGPUVirtualAddress();
+					command.per_instance_data_cbv = render_scene.instance_buffer.GPUVirtualAddress() + draw.instance_id * sizeof(PerInstanceData);
+
+					command.draw_arguments.IndexCountPerInstance = draw.count;
+					command.draw_arguments.InstanceCount = 1;
+					command.draw_arguments.StartIndexLocation = draw.start_index;
+					command.draw_arguments.BaseVertexLocation = draw.base_vertex;
+					command.draw_arguments.StartInstanceLocation = 0;
+				}
+
+				if (commands_count == first_command)
+					continue;
+
+				command_list->IASetPrimitiveTopology(draws[run.first].topology);
+				command_list->ExecuteIndirect(m_command_signature.get(),
+					commands_count - first_command,
+					m_command_buffer.Resource(),
+					commands_offset + first_command * sizeof(IndirectCommand),
+					nullptr,
+					0);
+
+				execute_count++;
+			}
 
-			// render_scene.primitives_count
-			command_list->ExecuteIndirect(m_command_signature.get(), render_scene.primitives_count, m_command_buffer.Resource(), 0, nullptr, 0);
+			engine_stats::forward_draw_calls = commands_count;
+			engine_stats::forward_state_changes = execute_count;
 		}
 		else
 		{
@@ -274,9 +274,10 @@ export namespace ysn
 			uint32_t vertices_count,
 			uint32_t indices_count,
 			uint32_t materials_count,
-			uint32_t primitives_count);
+			uint32_t primitives_count,
+			VertexFormat vertex_format);
 
-		bool CreateRaytracingPipeline(std::shared_ptr<ysn::DxRenderer> renderer);
+		bool CreateRaytracingPipeline(std::shared_ptr<ysn::DxRenderer> renderer, VertexFormat vertex_format);
 		bool CreateShaderBindingTable();
 		bool CreateRootSignatures(std::shared_ptr<ysn::DxRenderer> renderer);
 
@@ -334,7 +335,8 @@ namespace ysn
 		uint32_t vertices_count,
 		uint32_t indices_count,
 		uint32_t materials_count,
-		uint32_t primitives_count)
+		uint32_t primitives_count,
+		VertexFormat vertex_format)
 	{
 		if (!CreateRootSignatures(renderer))
 		{
@@ -342,7 +344,7 @@ namespace ysn
 			return false;
 		}
 
-		if (!CreateRaytracingPipeline(renderer))
+		if (!CreateRaytracingPipeline(renderer, vertex_format))
 		{
 			LogError << "Can't create raytracing pass pipeline\n";
 			return false;
@@ -361,7 +363,7 @@ namespace ysn
 			srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
 			srv_desc.Buffer.FirstElement = 0;
 			srv_desc.Buffer.NumElements = static_cast<UINT>(vertices_count);
-			srv_desc.Buffer.StructureByteStride = sizeof(Vertex);
+			srv_desc.Buffer.StructureByteStride = GetVertexStride(vertex_format);
 			srv_desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
 			srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 
@@ -411,11 +413,12 @@ namespace ysn
 		return true;
 	}
 
-	bool PathtracingPass::CreateRaytracingPipeline(std::shared_ptr<ysn::DxRenderer> renderer)
+	bool PathtracingPass::CreateRaytracingPipeline(std::shared_ptr<ysn::DxRenderer> renderer, VertexFormat vertex_format)
 	{
 		// Load shaders
 		{
-			ShaderCompileParameters pathtracing_parameters(ShaderType::Library, VfsPath(L"shaders/pathtracing.rt.hlsl"));
+			ShaderCompileParameters pathtracing_parameters(
+				ShaderType::Library, VfsPath(L"shaders/pathtracing.rt.hlsl"), GetVertexFormatDefines(vertex_format));
 			const auto compiled_shader_hash = renderer->GetShaderStorage()->CompileShader(pathtracing_parameters);
 
 			if (!compiled_shader_hash.has_value())
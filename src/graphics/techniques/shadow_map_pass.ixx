@@ -13,10 +13,14 @@ import std;
 import renderer.dx_renderer;
 import renderer.descriptor_heap;
 import renderer.command_queue;
+import renderer.vertex_storage;
+import renderer.render_queue;
+import renderer.pso;
 import graphics.primitive;
 import graphics.material;
 import graphics.lights;
 import graphics.render_scene;
+import graphics.engine_stats;
 import system.math;
 import system.filesystem;
 import system.application;
@@ -44,7 +48,7 @@ export namespace ysn
 	{
 	public:
 		void Initialize(std::shared_ptr<DxRenderer> p_renderer);
-		bool CompilePrimitivePso(Primitive& primitive, std::vector<Material> materials);
+		bool CompilePrimitivePso(Primitive& primitive, std::vector<Material> materials, VertexFormat vertex_format);
 		void UpdateLight(const DirectionalLight& Light);
 		bool Render(const RenderScene& render_scene, const ShadowRenderParameters& parameters);
 
@@ -64,6 +68,8 @@ export namespace ysn
 		bool InitializeCamera(std::shared_ptr<ysn::DxRenderer> p_renderer);
 
 		wil::com_ptr<ID3D12Resource> m_camera_buffer;
+		RenderQueue m_render_queue;
+		uint32_t m_missing_pso_draws_count = 0; // Of the last frame
 	};
 }
 
@@ -106,7 +112,7 @@ namespace ysn
 		InitializeCamera(p_renderer);
 	}
 
-	bool ShadowMapPass::CompilePrimitivePso(ysn::Primitive& primitive, std::vector<Material> materials)
+	bool ShadowMapPass::CompilePrimitivePso(ysn::Primitive& primitive, std::vector<Material> materials, VertexFormat vertex_format)
 	{
 		std::shared_ptr<DxRenderer> renderer = Application::Get().GetRenderer();
 
@@ -158,7 +164,10 @@ namespace ysn
 			pso_desc.SetRootSignature(root_signature);
 		}
 
-		pso_desc.AddShader({ ShaderType::Vertex, VfsPath(L"shaders/forward_pass.vs.hlsl"), {L"SHADOW_PASS"} });
+		std::set<std::wstring> vertex_shader_defines = GetVertexFormatDefines(vertex_format);
+		vertex_shader_defines.insert(L"SHADOW_PASS");
+
+		pso_desc.AddShader({ ShaderType::Vertex, VfsPath(L"shaders/forward_pass.vs.hlsl"), vertex_shader_defines });
 		pso_desc.AddShader({ ShaderType::Pixel, VfsPath(L"shaders/shadow_pass.ps.hlsl") });
 
 		D3D12_DEPTH_STENCIL_DESC depth_stencil_desc = {};
@@ -167,7 +176,7 @@ namespace ysn
 		depth_stencil_desc.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
 
 		pso_desc.SetDepthStencilState(depth_stencil_desc);
-		pso_desc.SetInputLayout(Vertex::GetVertexLayoutDesc());
+		pso_desc.SetInputLayout(GetVertexLayoutDesc(vertex_format));
 		pso_desc.SetSampleMask(UINT_MAX);
 
 		const auto material = materials[primitive.material_id];
@@ -305,57 +314,33 @@ namespace ysn
 			m_camera_buffer->Unmap(0, nullptr);
 		}
 
-		uint32_t instance_id = 0;
+		// Depth only, so draws are ordered by state alone
+		FillRenderQueue(m_render_queue, render_scene, render_scene.shadow_visible_instances, &Primitive::shadow_pso_id, std::nullopt);
+		m_render_queue.ResolvePsos([&renderer](PsoId pso_id) { return renderer->GetPso(pso_id); });
+		m_render_queue.Sort();
+
+		const uint32_t missing_pso_draws_count = m_render_queue.GetMissingPsoDrawsCount();
 
-		for (auto& model : render_scene.models)
+		// Logged on change only, otherwise it repeats every frame until shadow PSOs are compiled
+		if (missing_pso_draws_count != m_missing_pso_draws_count && missing_pso_draws_count)
 		{
-			for (int mesh_id = 0; mesh_id < model.meshes.size(); mesh_id++)
-			{
-				const Mesh& mesh = model.meshes[mesh_id];
-
-				for (int primitive_id = 0; primitive_id < mesh.primitives.size(); primitive_id++)
-				{
-					const Primitive& primitive = mesh.primitives[primitive_id];
-
-					command_list->IASetVertexBuffers(0, 1, &primitive.vertex_buffer_view);
-
-					// TODO: check for -1 as pso_id
-					const std::optional<Pso> pso = renderer->GetPso(primitive.shadow_pso_id);
-
-					if (pso.has_value())
-					{
-						command_list->SetGraphicsRootSignature(pso.value().root_signature.get());
-						command_list->SetPipelineState(pso.value().pso.get());
-
-						command_list->IASetPrimitiveTopology(primitive.topology);
-
-						command_list->SetGraphicsRootConstantBufferView(0, m_camera_buffer->GetGPUVirtualAddress());
-						command_list->SetGraphicsRootConstantBufferView(
-							1, parameters.scene_parameters_gpu_buffer->GetGPUVirtualAddress());
-						command_list->SetGraphicsRoot32BitConstant(2, instance_id, 0); // InstanceID
-
-						command_list->SetGraphicsRootDescriptorTable(3, render_scene.instance_buffer_srv.gpu); // PerInstanceData
-
-						if (primitive.index_count)
-						{
-							command_list->IASetIndexBuffer(&primitive.index_buffer_view);
-							command_list->DrawIndexedInstanced(primitive.index_count, 1, 0, 0, 0);
-						}
-						else
-						{
-							command_list->DrawInstanced(primitive.vertex_count, 1, 0, 0);
-						}
-					}
-					else
-					{
-						LogInfo << "Can't render primitive because it has't any pso attached\n";
-					}
-
-					instance_id++;
-				}
-			}
+			LogInfo << "Can't render " << missing_pso_draws_count << " shadow primitives because they haven't any PSO\n";
 		}
 
+		m_missing_pso_draws_count = missing_pso_draws_count;
+		engine_stats::shadow_missing_pso_draws = missing_pso_draws_count;
+
+		D3D12CommandRecorder recorder(command_list.get(), 2, [&](ID3D12GraphicsCommandList* cmd_list) {
+			cmd_list->SetGraphicsRootConstantBufferView(0, m_camera_buffer->GetGPUVirtualAddress());
+			cmd_list->SetGraphicsRootConstantBufferView(1, parameters.scene_parameters_gpu_buffer->GetGPUVirtualAddress());
+			cmd_list->SetGraphicsRootDescriptorTable(3, render_scene.instance_buffer_srv.gpu); // PerInstanceData
+		});
+
+		m_render_queue.Submit(recorder);
+
+		engine_stats::shadow_draw_calls = recorder.stats.draws;
+		engine_stats::shadow_state_changes = recorder.stats.GetStateChanges();
+
 		parameters.command_queue->CloseCommandList(command_list);
 
 		return true;
@@ -0,0 +1,1340 @@
+module;
+
+#include <immintrin.h>
+
+export module graphics.texture_cooker;
+
+import std;
+import system.filesystem;
+import system.job_system;
+import system.logger;
+
+export namespace ysn
+{
+	// Bump when filtering, encoders or cooked file layout change, older cooked textures are recooked
+	constexpr std::uint32_t COOKED_TEXTURE_VERSION = 1;
+
+	// How materials sample the image, decides mip filtering and compression
+	enum class TextureUsage : std::uint8_t
+	{
+		Unknown, // Not referenced by materials
+		Color,	 // Albedo and emissive, sRGB
+		Normal,	 // Tangent space XY, Z is reconstructed in shaders
+		Data,	 // Metallic roughness, may be packed with occlusion
+		Mask,	 // Occlusion only, red channel
+	};
+
+	enum class CookedTextureFormat : std::uint8_t
+	{
+		Rgba8,
+		Bc1,
+		Bc5,
+		Bc7,
+	};
+
+	struct CookedMip
+	{
+		std::uint32_t width = 0;
+		std::uint32_t height = 0;
+		std::uint32_t row_size = 0;	  // Bytes per row of blocks, row of pixels for Rgba8
+		std::uint32_t rows_count = 0; // Rows of blocks, rows of pixels for Rgba8
+		std::uint64_t offset = 0;	  // Into CookedTexture::data, rows are tightly packed
+	};
+
+	struct CookedTexture
+	{
+		CookedTextureFormat format = CookedTextureFormat::Rgba8;
+		bool is_srgb = false;
+		std::vector<CookedMip> mips;
+		std::vector<std::uint8_t> data;
+	};
+
+	// Cooked file is stale as soon as source image changes or it was cooked for another usage
+	struct CookedTextureKey
+	{
+		std::uint64_t source_size = 0;
+		std::int64_t source_write_time = 0;
+		TextureUsage usage = TextureUsage::Unknown;
+		CookedTextureFormat format = CookedTextureFormat::Rgba8;
+	};
+
+	bool IsSrgbUsage(TextureUsage usage);
+
+	// Block compression needs top mip aligned to blocks, other images stay uncompressed
+	CookedTextureFormat ChooseCookedTextureFormat(TextureUsage usage, std::uint32_t width, std::uint32_t height);
+
+	// Full chain down to 1x1
+	std::uint32_t GetCookedMipsCount(std::uint32_t width, std::uint32_t height);
+
+	// Filters mips in linear space and encodes all of them, rows of blocks are spread over job system workers
+	CookedTexture CookTexture(std::span<const std::uint8_t> rgba,
+		std::uint32_t width,
+		std::uint32_t height,
+		TextureUsage usage,
+		CookedTextureFormat format,
+		JobSystem* job_system = nullptr);
+
+	// Back to RGBA8, missing channels are 0 and alpha is 255
+	std::vector<std::uint8_t> DecodeCookedMip(const CookedTexture& texture, std::uint32_t mip);
+
+	// Over channels set in channels_mask, infinity for identical images
+	double ComputePsnr(std::span<const std::uint8_t> reference, std::span<const std::uint8_t> image, std::uint32_t channels_mask);
+
+	// Channels compressed format keeps, to compare against source
+	std::uint32_t GetCookedChannelsMask(CookedTextureFormat format);
+
+	std::string_view GetCookedTextureFormatName(CookedTextureFormat format);
+
+	std::wstring GetCookedTexturePath(const std::wstring& image_path);
+
+	std::optional<CookedTextureKey> MakeCookedTextureKey(const std::wstring& image_path, TextureUsage usage, CookedTextureFormat format);
+
+	std::optional<CookedTexture> ReadCookedTexture(const std::wstring& cooked_path, const CookedTextureKey& key);
+	bool WriteCookedTexture(const std::wstring& cooked_path, const CookedTexture& texture, const CookedTextureKey& key);
+}
+
+module :private;
+
+namespace ysn
+{
+	constexpr std::uint32_t COOKED_TEXTURE_MAGIC = 0x5854'4E59; // "YNTX"
+
+	constexpr std::uint32_t ENCODE_ROWS_BATCH_SIZE = 4;
+	constexpr std::uint32_t DOWNSAMPLE_ROWS_BATCH_SIZE = 16;
+
+	struct CookedTextureHeader
+	{
+		std::uint32_t magic = COOKED_TEXTURE_MAGIC;
+		std::uint32_t version = COOKED_TEXTURE_VERSION;
+		std::uint64_t source_size = 0;
+		std::int64_t source_write_time = 0;
+		std::uint8_t usage = 0;
+		std::uint8_t format = 0;
+		std::uint8_t is_srgb = 0;
+		std::uint8_t padding = 0;
+		std::uint32_t mips_count = 0;
+		std::uint64_t data_size = 0;
+	};
+
+	static_assert(sizeof(CookedMip) == 24);
+	static_assert(sizeof(CookedTextureHeader) == 40);
+
+	// Block pixels split by channel, so four pixels are processed at once
+	struct BlockPixels
+	{
+		float channels[4][16] = {};
+	};
+
+	static std::uint32_t GetBlockSize(CookedTextureFormat format)
+	{
+		return format == CookedTextureFormat::Bc1 ? 8 : 16;
+	}
+
+	static const std::array<float, 256>& GetSrgbToLinearTable()
+	{
+		static const std::array<float, 256> table = []()
+		{
+			std::array<float, 256> result = {};
+
+			for (std::uint32_t i = 0; i < 256; i++)
+			{
+				const float value = static_cast<float>(i) / 255.0f;
+				result[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+			}
+
+			return result;
+		}();
+
+		return table;
+	}
+
+	// 16 bit linear input keeps darkest sRGB steps apart
+	static const std::vector<std::uint8_t>& GetLinearToSrgbTable()
+	{
+		static const std::vector<std::uint8_t> table = []()
+		{
+			std::vector<std::uint8_t> result(65536);
+
+			for (std::uint32_t i = 0; i < result.size(); i++)
+			{
+				const float value = static_cast<float>(i) / 65535.0f;
+				const float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+				result[i] = static_cast<std::uint8_t>(std::clamp(srgb * 255.0f + 0.5f, 0.0f, 255.0f));
+			}
+
+			return result;
+		}();
+
+		return table;
+	}
+
+	static std::uint8_t QuantizeUnorm8(float value)
+	{
+		return static_cast<std::uint8_t>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+	}
+
+	struct FilterTap
+	{
+		std::uint32_t source = 0;
+		float weight = 0.0f;
+	};
+
+	// Box filter footprint of every destination texel, odd sizes get three partially covered taps
+	static std::vector<std::vector<FilterTap>> ComputeFilterTaps(std::uint32_t source_size, std::uint32_t destination_size)
+	{
+		std::vector<std::vector<FilterTap>> taps(destination_size);
+
+		const float scale = static_cast<float>(source_size) / static_cast<float>(destination_size);
+
+		for (std::uint32_t i = 0; i < destination_size; i++)
+		{
+			const float begin = static_cast<float>(i) * scale;
+			const float end = begin + scale;
+
+			for (std::uint32_t source = static_cast<std::uint32_t>(begin); source < source_size && static_cast<float>(source) < end; source++)
+			{
+				const float coverage = std::min(end, static_cast<float>(source + 1)) - std::max(begin, static_cast<float>(source));
+
+				if (coverage > 0.0f)
+					taps[i].push_back({ source, coverage / scale });
+			}
+		}
+
+		return taps;
+	}
+
+	static void DownsampleRows(std::span<const std::uint8_t> source,
+		std::uint32_t source_width,
+		std::span<std::uint8_t> destination,
+		std::uint32_t destination_width,
+		const std::vector<FilterTap>& row_taps,
+		const std::vector<std::vector<FilterTap>>& column_taps,
+		std::uint32_t row,
+		TextureUsage usage)
+	{
+		const std::array<float, 256>& srgb_to_linear = GetSrgbToLinearTable();
+		const std::vector<std::uint8_t>& linear_to_srgb = GetLinearToSrgbTable();
+
+		for (std::uint32_t x = 0; x < destination_width; x++)
+		{
+			float sum[4] = {};
+
+			for (const FilterTap& tap_y : row_taps)
+			{
+				for (const FilterTap& tap_x : column_taps[x])
+				{
+					const std::uint8_t* texel = &source[(static_cast<std::size_t>(tap_y.source) * source_width + tap_x.source) * 4];
+					const float weight = tap_y.weight * tap_x.weight;
+
+					for (std::uint32_t c = 0; c < 4; c++)
+					{
+						// Alpha is always linear
+						const float value = usage == TextureUsage::Color && c < 3 ? srgb_to_linear[texel[c]] : static_cast<float>(texel[c]) / 255.0f;
+						sum[c] += value * weight;
+					}
+				}
+			}
+
+			std::uint8_t* result = &destination[(static_cast<std::size_t>(row) * destination_width + x) * 4];
+
+			if (usage == TextureUsage::Color)
+			{
+				for (std::uint32_t c = 0; c < 3; c++)
+					result[c] = linear_to_srgb[static_cast<std::uint32_t>(std::clamp(sum[c], 0.0f, 1.0f) * 65535.0f + 0.5f)];
+
+				result[3] = QuantizeUnorm8(sum[3]);
+			}
+			else if (usage == TextureUsage::Normal)
+			{
+				// Averaged normals get shorter, filtered ones are renormalized
+				float normal[3] = { sum[0] * 2.0f - 1.0f, sum[1] * 2.0f - 1.0f, sum[2] * 2.0f - 1.0f };
+				const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+				for (std::uint32_t c = 0; c < 3; c++)
+					result[c] = QuantizeUnorm8((length > 1e-6f ? normal[c] / length : (c == 2 ? 1.0f : 0.0f)) * 0.5f + 0.5f);
+
+				result[3] = QuantizeUnorm8(sum[3]);
+			}
+			else
+			{
+				for (std::uint32_t c = 0; c < 4; c++)
+					result[c] = QuantizeUnorm8(sum[c]);
+			}
+		}
+	}
+
+	static std::vector<std::uint8_t> DownsampleImage(std::span<const std::uint8_t> source,
+		std::uint32_t source_width,
+		std::uint32_t source_height,
+		std::uint32_t destination_width,
+		std::uint32_t destination_height,
+		TextureUsage usage,
+		JobSystem* job_system)
+	{
+		std::vector<std::uint8_t> destination(static_cast<std::size_t>(destination_width) * destination_height * 4);
+
+		const std::vector<std::vector<FilterTap>> row_taps = ComputeFilterTaps(source_height, destination_height);
+		const std::vector<std::vector<FilterTap>> column_taps = ComputeFilterTaps(source_width, destination_width);
+
+		const auto downsample_row = [&](std::uint32_t row)
+		{ DownsampleRows(source, source_width, destination, destination_width, row_taps[row], column_taps, row, usage); };
+
+		if (job_system && destination_height > DOWNSAMPLE_ROWS_BATCH_SIZE)
+		{
+			job_system->ParallelFor(destination_height, DOWNSAMPLE_ROWS_BATCH_SIZE, downsample_row);
+		}
+		else
+		{
+			for (std::uint32_t row = 0; row < destination_height; row++)
+				downsample_row(row);
+		}
+
+		return destination;
+	}
+
+	// Edge texels are repeated for mips smaller than a block
+	static void LoadBlock(std::span<const std::uint8_t> image, std::uint32_t width, std::uint32_t height, std::uint32_t block_x, std::uint32_t block_y, std::uint8_t* pixels)
+	{
+		for (std::uint32_t y = 0; y < 4; y++)
+		{
+			const std::uint32_t source_y = std::min(block_y * 4 + y, height - 1);
+
+			for (std::uint32_t x = 0; x < 4; x++)
+			{
+				const std::uint32_t source_x = std::min(block_x * 4 + x, width - 1);
+				std::memcpy(&pixels[(y * 4 + x) * 4], &image[(static_cast<std::size_t>(source_y) * width + source_x) * 4], 4);
+			}
+		}
+	}
+
+	static BlockPixels MakeBlockPixels(const std::uint8_t* pixels, std::uint32_t channels_mask)
+	{
+		BlockPixels result;
+
+		for (std::uint32_t i = 0; i < 16; i++)
+		{
+			for (std::uint32_t c = 0; c < 4; c++)
+				result.channels[c][i] = (channels_mask & (1u << c)) ? static_cast<float>(pixels[i * 4 + c]) : 0.0f;
+		}
+
+		return result;
+	}
+
+	// Nearest palette entry of every pixel, four pixels per iteration, returns sum of squared errors
+	static float FindClosestIndices(const BlockPixels& pixels, const float (*palette)[4], std::uint32_t palette_size, std::uint8_t* indices)
+	{
+		__m128 total_error = _mm_setzero_ps();
+
+		for (std::uint32_t i = 0; i < 16; i += 4)
+		{
+			const __m128 r = _mm_loadu_ps(&pixels.channels[0][i]);
+			const __m128 g = _mm_loadu_ps(&pixels.channels[1][i]);
+			const __m128 b = _mm_loadu_ps(&pixels.channels[2][i]);
+			const __m128 a = _mm_loadu_ps(&pixels.channels[3][i]);
+
+			__m128 best_error = _mm_set1_ps(std::numeric_limits<float>::max());
+			__m128i best_index = _mm_setzero_si128();
+
+			for (std::uint32_t k = 0; k < palette_size; k++)
+			{
+				const __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+				const __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+				const __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+				const __m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[k][3]));
+
+				const __m128 error =
+					_mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_add_ps(_mm_mul_ps(db, db), _mm_mul_ps(da, da)));
+
+				const __m128i is_better = _mm_castps_si128(_mm_cmplt_ps(error, best_error));
+
+				best_error = _mm_min_ps(error, best_error);
+				best_index = _mm_or_si128(
+					_mm_and_si128(is_better, _mm_set1_epi32(static_cast<int>(k))), _mm_andnot_si128(is_better, best_index));
+			}
+
+			std::int32_t block_indices[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(block_indices), best_index);
+
+			for (std::uint32_t j = 0; j < 4; j++)
+				indices[i + j] = static_cast<std::uint8_t>(block_indices[j]);
+
+			total_error = _mm_add_ps(total_error, best_error);
+		}
+
+		float errors[4];
+		_mm_storeu_ps(errors, total_error);
+
+		return errors[0] + errors[1] + errors[2] + errors[3];
+	}
+
+	// Mean and dominant direction of block colors, power iteration on covariance matrix
+	static void ComputePrincipalAxis(const BlockPixels& pixels, float* mean, float* axis)
+	{
+		for (std::uint32_t c = 0; c < 4; c++)
+		{
+			mean[c] = 0.0f;
+
+			for (std::uint32_t i = 0; i < 16; i++)
+				mean[c] += pixels.channels[c][i];
+
+			mean[c] /= 16.0f;
+		}
+
+		float covariance[4][4] = {};
+
+		for (std::uint32_t i = 0; i < 16; i++)
+		{
+			for (std::uint32_t c0 = 0; c0 < 4; c0++)
+			{
+				for (std::uint32_t c1 = c0; c1 < 4; c1++)
+					covariance[c0][c1] += (pixels.channels[c0][i] - mean[c0]) * (pixels.channels[c1][i] - mean[c1]);
+			}
+		}
+
+		for (std::uint32_t c0 = 0; c0 < 4; c0++)
+		{
+			for (std::uint32_t c1 = 0; c1 < c0; c1++)
+				covariance[c0][c1] = covariance[c1][c0];
+		}
+
+		// Starting from the most varying channel avoids direction orthogonal to the axis
+		std::uint32_t start_channel = 0;
+
+		for (std::uint32_t c = 1; c < 4; c++)
+		{
+			if (covariance[c][c] > covariance[start_channel][start_channel])
+				start_channel = c;
+		}
+
+		float direction[4] = { covariance[start_channel][0], covariance[start_channel][1], covariance[start_channel][2], covariance[start_channel][3] };
+
+		if (covariance[start_channel][start_channel] < 1e-6f)
+		{
+			axis[0] = 1.0f;
+			axis[1] = axis[2] = axis[3] = 0.0f;
+			return;
+		}
+
+		for (std::uint32_t iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+
+			for (std::uint32_t c0 = 0; c0 < 4; c0++)
+			{
+				for (std::uint32_t c1 = 0; c1 < 4; c1++)
+					next[c0] += covariance[c0][c1] * direction[c1];
+			}
+
+			const float max_component = std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]), std::abs(next[3]) });
+
+			if (max_component < 1e-6f)
+				break;
+
+			for (std::uint32_t c = 0; c < 4; c++)
+				direction[c] = next[c] / max_component;
+		}
+
+		const float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2] + direction[3] * direction[3]);
+
+		for (std::uint32_t c = 0; c < 4; c++)
+			axis[c] = direction[c] / length;
+	}
+
+	// Block extent along principal axis
+	static void ComputeAxisEndpoints(const BlockPixels& pixels, float* endpoint0, float* endpoint1)
+	{
+		float mean[4];
+		float axis[4];
+		ComputePrincipalAxis(pixels, mean, axis);
+
+		float min_projection = std::numeric_limits<float>::max();
+		float max_projection = std::numeric_limits<float>::lowest();
+
+		for (std::uint32_t i = 0; i < 16; i++)
+		{
+			float projection = 0.0f;
+
+			for (std::uint32_t c = 0; c < 4; c++)
+				projection += (pixels.channels[c][i] - mean[c]) * axis[c];
+
+			min_projection = std::min(min_projection, projection);
+			max_projection = std::max(max_projection, projection);
+		}
+
+		for (std::uint32_t c = 0; c < 4; c++)
+		{
+			endpoint0[c] = std::clamp(mean[c] + axis[c] * min_projection, 0.0f, 255.0f);
+			endpoint1[c] = std::clamp(mean[c] + axis[c] * max_projection, 0.0f, 255.0f);
+		}
+	}
+
+	// Endpoints minimizing squared error for fixed interpolation weights, false for degenerate weights
+	static bool SolveEndpoints(const BlockPixels& pixels, const std::uint8_t* indices, const float* weights, float* endpoint0, float* endpoint1)
+	{
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+
+		for (std::uint32_t i = 0; i < 16; i++)
+		{
+			const float b = weights[indices[i]];
+			const float a = 1.0f - b;
+
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+
+			for (std::uint32_t c = 0; c < 4; c++)
+			{
+				ax[c] += a * pixels.channels[c][i];
+				bx[c] += b * pixels.channels[c][i];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+
+		if (std::abs(determinant) < 1e-6f)
+			return false;
+
+		for (std::uint32_t c = 0; c < 4; c++)
+		{
+			endpoint0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+			endpoint1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+		}
+
+		return true;
+	}
+
+	// BC1, 4 color mode only, 565 endpoints
+	static std::uint16_t QuantizeRgb565(const float* color)
+	{
+		const std::uint32_t r = static_cast<std::uint32_t>(std::clamp(color[0] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f));
+		const std::uint32_t g = static_cast<std::uint32_t>(std::clamp(color[1] * 63.0f / 255.0f + 0.5f, 0.0f, 63.0f));
+		const std::uint32_t b = static_cast<std::uint32_t>(std::clamp(color[2] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f));
+
+		return static_cast<std::uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	static void ExpandRgb565(std::uint16_t color, std::uint32_t* rgb)
+	{
+		const std::uint32_t r = (color >> 11) & 31;
+		const std::uint32_t g = (color >> 5) & 63;
+		const std::uint32_t b = color & 31;
+
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	static void BuildBc1Palette(std::uint16_t color0, std::uint16_t color1, std::uint32_t (*palette)[4])
+	{
+		ExpandRgb565(color0, palette[0]);
+		ExpandRgb565(color1, palette[1]);
+
+		for (std::uint32_t c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (std::uint32_t i = 0; i < 4; i++)
+			palette[i][3] = 0;
+	}
+
+	static float EvaluateBc1(const BlockPixels& pixels, std::uint16_t color0, std::uint16_t color1, std::uint8_t* indices)
+	{
+		std::uint32_t palette[4][4];
+		BuildBc1Palette(color0, color1, palette);
+
+		float palette_float[4][4];
+
+		for (std::uint32_t i = 0; i < 4; i++)
+		{
+			for (std::uint32_t c = 0; c < 4; c++)
+				palette_float[i][c] = static_cast<float>(palette[i][c]);
+		}
+
+		return FindClosestIndices(pixels, palette_float, 4, indices);
+	}
+
+	static void EncodeBc1Block(const std::uint8_t* source, std::uint8_t* block)
+	{
+		const BlockPixels pixels = MakeBlockPixels(source, 0b0111);
+
+		float endpoint0[4];
+		float endpoint1[4];
+		ComputeAxisEndpoints(pixels, endpoint0, endpoint1);
+
+		std::uint16_t best_color0 = QuantizeRgb565(endpoint1);
+		std::uint16_t best_color1 = QuantizeRgb565(endpoint0);
+		std::uint8_t best_indices[16];
+		float best_error = EvaluateBc1(pixels, best_color0, best_color1, best_indices);
+
+		// Weight of second endpoint for every index
+		static constexpr float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+		for (std::uint32_t iteration = 0; iteration < 2 && best_error > 0.0f; iteration++)
+		{
+			if (!SolveEndpoints(pixels, best_indices, weights, endpoint0, endpoint1))
+				break;
+
+			const std::uint16_t color0 = QuantizeRgb565(endpoint0);
+			const std::uint16_t color1 = QuantizeRgb565(endpoint1);
+
+			std::uint8_t indices[16];
+			const float error = EvaluateBc1(pixels, color0, color1, indices);
+
+			if (error >= best_error)
+				break;
+
+			best_color0 = color0;
+			best_color1 = color1;
+			best_error = error;
+			std::memcpy(best_indices, indices, sizeof(indices));
+		}
+
+		// Hardware picks 4 color mode from endpoints order
+		if (best_color0 < best_color1)
+		{
+			std::swap(best_color0, best_color1);
+
+			for (std::uint8_t& index : best_indices)
+				index ^= 1;
+		}
+		else if (best_color0 == best_color1)
+		{
+			std::memset(best_indices, 0, sizeof(best_indices));
+		}
+
+		std::uint32_t packed_indices = 0;
+
+		for (std::uint32_t i = 0; i < 16; i++)
+			packed_indices |= static_cast<std::uint32_t>(best_indices[i]) << (i * 2);
+
+		std::memcpy(block, &best_color0, 2);
+		std::memcpy(block + 2, &best_color1, 2);
+		std::memcpy(block + 4, &packed_indices, 4);
+	}
+
+	static void DecodeBc1Block(const std::uint8_t* block, std::uint8_t* pixels)
+	{
+		std::uint16_t color0 = 0;
+		std::uint16_t color1 = 0;
+		std::uint32_t packed_indices = 0;
+
+		std::memcpy(&color0, block, 2);
+		std::memcpy(&color1, block + 2, 2);
+		std::memcpy(&packed_indices, block + 4, 4);
+
+		std::uint32_t palette[4][4];
+		BuildBc1Palette(color0, color1, palette);
+
+		// 3 color mode with black, never written by encoder
+		if (color0 <= color1)
+		{
+			for (std::uint32_t c = 0; c < 3; c++)
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+
+		for (std::uint32_t i = 0; i < 16; i++)
+		{
+			const std::uint32_t index = (packed_indices >> (i * 2)) & 3;
+
+			for (std::uint32_t c = 0; c < 3; c++)
+				pixels[i * 4 + c] = static_cast<std::uint8_t>(palette[index][c]);
+
+			pixels[i * 4 + 3] = 255;
+		}
+	}
+
+	// BC4 of one channel, 8 value mode only
+	static void BuildBc4Palette(std::uint32_t value0, std::uint32_t value1, std::uint32_t* palette)
+	{
+		palette[0] = value0;
+		palette[1] = value1;
+
+		if (value0 > value1)
+		{
+			for (std::uint32_t i = 2; i < 8; i++)
+				palette[i] = ((8 - i) * value0 + (i - 1) * value1) / 7;
+		}
+		else
+		{
+			for (std::uint32_t i = 2; i < 6; i++)
+				palette[i] = ((6 - i) * value0 + (i - 1) * value1) / 5;
+
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	static float EvaluateBc4(const BlockPixels& pixels, std::uint32_t value0, std::uint32_t value1, std::uint8_t* indices)
+	{
+		std::uint32_t palette[8];
+		BuildBc4Palette(value0, value1, palette);
+
+		float palette_float[8][4] = {};
+
+		for (std::uint32_t i = 0; i < 8; i++)
+			palette_float[i][0] = static_cast<float>(palette[i]);
+
+		return FindClosestIndices(pixels, palette_float, 8, indices);
+	}
+
+	static void EncodeBc4Block(const std::uint8_t* source, std::uint32_t channel, std::uint8_t* block)
+	{
+		BlockPixels pixels;
+
+		for (std::uint32_t i = 0; i < 16; i++)
+			pixels.channels[0][i] = static_cast<float>(source[i * 4 + channel]);
+
+		float min_value = 255.0f;
+		float max_value = 0.0f;
+
+		for (std::uint32_t i = 0; i < 16; i++)
+		{
+			min_value = std::min(min_value, pixels.channels[0][i]);
+			max_value = std::max(max_value, pixels.channels[0][i]);
+		}
+
+		std::uint32_t best_value0 = static_cast<std::uint32_t>(max_value);
+		std::uint32_t best_value1 = static_cast<std::uint32_t>(min_value);
+		std::uint8_t best_indices[16] = {};
+		float best_error = 0.0f;
+
+		if (best_value0 != best_value1)
+		{
+			best_error = EvaluateBc4(pixels, best_value0, best_value1, best_indices);
+
+			static constexpr float weights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+
+			float endpoint0[4];
+			float endpoint1[4];
+
+			// Only ordered refits are kept, equal or swapped endpoints would switch palette mode
+			if (best_error > 0.0f && SolveEndpoints(pixels, best_indices, weights, endpoint0, endpoint1))
+			{
+				const std::uint32_t value0 = static_cast<std::uint32_t>(endpoint0[0] + 0.5f);
+				const std::uint32_t value1 = static_cast<std::uint32_t>(endpoint1[0] + 0.5f);
+
+				std::uint8_t indices[16];
+
+				if (value0 > value1)
+				{
+					const float error = EvaluateBc4(pixels, value0, value1, indices);
+
+					if (error < best_error)
+					{
+						best_value0 = value0;
+						best_value1 = value1;
+						std::memcpy(best_indices, indices, sizeof(indices));
+					}
+				}
+			}
+		}
+
+		block[0] = static_cast<std::uint8_t>(best_value0);
+		block[1] = static_cast<std::uint8_t>(best_value1);
+
+		std::uint64_t packed_indices = 0;
+
+		for (std::uint32_t i = 0; i < 16; i++)
+			packed_indices |= static_cast<std::uint64_t>(best_indices[i]) << (i * 3);
+
+		std::memcpy(block + 2, &packed_indices, 6);
+	}
+
+	static void DecodeBc4Block(const std::uint8_t* block, std::uint32_t channel, std::uint8_t* pixels)
+	{
+		std::uint32_t palette[8];
+		BuildBc4Palette(block[0], block[1], palette);
+
+		std::uint64_t packed_indices = 0;
+		std::memcpy(&packed_indices, block + 2, 6);
+
+		for (std::uint32_t i = 0; i < 16; i++)
+			pixels[i * 4 + channel] = static_cast<std::uint8_t>(palette[(packed_indices >> (i * 3)) & 7]);
+	}
+
+	// BC7 mode 6, single subset with RGBA 7777 endpoints, unique p-bits and 4 bit indices
+	static constexpr std::uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct Bc7Endpoint
+	{
+		std::uint32_t values[4] = {}; // 7 bit
+		std::uint32_t pbit = 0;
+	};
+
+	static Bc7Endpoint QuantizeBc7Endpoint(const float* endpoint, std::uint32_t pbit)
+	{
+		Bc7Endpoint result;
+		result.pbit = pbit;
+
+		for (std::uint32_t c = 0; c < 4; c++)
+			result.values[c] = static_cast<std::uint32_t>(std::clamp((endpoint[c] - static_cast<float>(pbit)) * 0.5f + 0.5f, 0.0f, 127.0f));
+
+		return result;
+	}
+
+	static void BuildBc7Palette(const Bc7Endpoint& endpoint0, const Bc7Endpoint& endpoint1, std::uint32_t (*palette)[4])
+	{
+		for (std::uint32_t c = 0; c < 4; c++)
+		{
+			const std::uint32_t value0 = (endpoint0.values[c] << 1) | endpoint0.pbit;
+			const std::uint32_t value1 = (endpoint1.values[c] << 1) | endpoint1.pbit;
+
+			for (std::uint32_t i = 0; i < 16; i++)
+				palette[i][c] = ((64 - BC7_WEIGHTS[i]) * value0 + BC7_WEIGHTS[i] * value1 + 32) >> 6;
+		}
+	}
+
+	static float EvaluateBc7(const BlockPixels& pixels, const Bc7Endpoint& endpoint0, const Bc7Endpoint& endpoint1, std::uint8_t* indices)
+	{
+		std::uint32_t palette[16][4];
+		BuildBc7Palette(endpoint0, endpoint1, palette);
+
+		float palette_float[16][4];
+
+		for (std::uint32_t i = 0; i < 16; i++)
+		{
+			for (std::uint32_t c = 0; c < 4; c++)
+				palette_float[i][c] = static_cast<float>(palette[i][c]);
+		}
+
+		return FindClosestIndices(pixels, palette_float, 16, indices);
+	}
+
+	class BlockBitWriter
+	{
+	public:
+		explicit BlockBitWriter(std::uint8_t* block) : m_block(block)
+		{
+			std::memset(m_block, 0, 16);
+		}
+
+		void Write(std::uint32_t value, std::uint32_t bits_count)
+		{
+			for (std::uint32_t i = 0; i < bits_count; i++, m_position++)
+				m_block[m_position / 8] |= static_cast<std::uint8_t>(((value >> i) & 1) << (m_position % 8));
+		}
+
+	private:
+		std::uint8_t* m_block = nullptr;
+		std::uint32_t m_position = 0;
+	};
+
+	class BlockBitReader
+	{
+	public:
+		explicit BlockBitReader(const std::uint8_t* block) : m_block(block)
+		{
+		}
+
+		std::uint32_t Read(std::uint32_t bits_count)
+		{
+			std::uint32_t value = 0;
+
+			for (std::uint32_t i = 0; i < bits_count; i++, m_position++)
+				value |= static_cast<std::uint32_t>((m_block[m_position / 8] >> (m_position % 8)) & 1) << i;
+
+			return value;
+		}
+
+	private:
+		const std::uint8_t* m_block = nullptr;
+		std::uint32_t m_position = 0;
+	};
+
+	static void EncodeBc7Block(const std::uint8_t* source, std::uint8_t* block)
+	{
+		const BlockPixels pixels = MakeBlockPixels(source, 0b1111);
+
+		bool is_opaque = true;
+
+		for (std::uint32_t i = 0; i < 16; i++)
+			is_opaque = is_opaque && source[i * 4 + 3] == 255;
+
+		float endpoint0[4];
+		float endpoint1[4];
+		ComputeAxisEndpoints(pixels, endpoint0, endpoint1);
+
+		Bc7Endpoint best_endpoint0;
+		Bc7Endpoint best_endpoint1;
+		std::uint8_t best_indices[16] = {};
+		float best_error = std::numeric_limits<float>::max();
+
+		static constexpr float weights[16] = { 0.0f / 64.0f, 4.0f / 64.0f, 9.0f / 64.0f, 13.0f / 64.0f, 17.0f / 64.0f, 21.0f / 64.0f, 26.0f / 64.0f,
+			30.0f / 64.0f, 34.0f / 64.0f, 38.0f / 64.0f, 43.0f / 64.0f, 47.0f / 64.0f, 51.0f / 64.0f, 55.0f / 64.0f, 60.0f / 64.0f, 64.0f / 64.0f };
+
+		for (std::uint32_t iteration = 0; iteration < 3; iteration++)
+		{
+			const float previous_error = best_error;
+
+			// Opaque blocks keep alpha exactly 255, which needs both p-bits set
+			for (std::uint32_t pbits = is_opaque ? 3 : 0; pbits < 4; pbits++)
+			{
+				const Bc7Endpoint quantized0 = QuantizeBc7Endpoint(endpoint0, pbits & 1);
+				const Bc7Endpoint quantized1 = QuantizeBc7Endpoint(endpoint1, pbits >> 1);
+
+				std::uint8_t indices[16];
+				const float error = EvaluateBc7(pixels, quantized0, quantized1, indices);
+
+				if (error < best_error)
+				{
+					best_endpoint0 = quantized0;
+					best_endpoint1 = quantized1;
+					best_error = error;
+					std::memcpy(best_indices, indices, sizeof(indices));
+				}
+			}
+
+			if (best_error == 0.0f || best_error >= previous_error || !SolveEndpoints(pixels, best_indices, weights, endpoint0, endpoint1))
+				break;
+		}
+
+		// Highest bit of the first index is implicit zero
+		if (best_indices[0] & 8)
+		{
+			std::swap(best_endpoint0, best_endpoint1);
+
+			for (std::uint8_t& index : best_indices)
+				index = static_cast<std::uint8_t>(15 - index);
+		}
+
+		BlockBitWriter writer(block);
+		writer.Write(1 << 6, 7);
+
+		for (std::uint32_t c = 0; c < 4; c++)
+		{
+			writer.Write(best_endpoint0.values[c], 7);
+			writer.Write(best_endpoint1.values[c], 7);
+		}
+
+		writer.Write(best_endpoint0.pbit, 1);
+		writer.Write(best_endpoint1.pbit, 1);
+
+		for (std::uint32_t i = 0; i < 16; i++)
+			writer.Write(best_indices[i], i == 0 ? 3 : 4);
+	}
+
+	// Only mode 6 is decoded, everything else comes out as magenta
+	static void DecodeBc7Block(const std::uint8_t* block, std::uint8_t* pixels)
+	{
+		BlockBitReader reader(block);
+
+		if (reader.Read(7) != 1 << 6)
+		{
+			for (std::uint32_t i = 0; i < 16; i++)
+			{
+				const std::uint8_t magenta[4] = { 255, 0, 255, 255 };
+				std::memcpy(&pixels[i * 4], magenta, 4);
+			}
+
+			return;
+		}
+
+		Bc7Endpoint endpoint0;
+		Bc7Endpoint endpoint1;
+
+		for (std::uint32_t c = 0; c < 4; c++)
+		{
+			endpoint0.values[c] = reader.Read(7);
+			endpoint1.values[c] = reader.Read(7);
+		}
+
+		endpoint0.pbit = reader.Read(1);
+		endpoint1.pbit = reader.Read(1);
+
+		std::uint32_t palette[16][4];
+		BuildBc7Palette(endpoint0, endpoint1, palette);
+
+		for (std::uint32_t i = 0; i < 16; i++)
+		{
+			const std::uint32_t index = reader.Read(i == 0 ? 3 : 4);
+
+			for (std::uint32_t c = 0; c < 4; c++)
+				pixels[i * 4 + c] = static_cast<std::uint8_t>(palette[index][c]);
+		}
+	}
+
+	static void EncodeBlock(CookedTextureFormat format, const std::uint8_t* pixels, std::uint8_t* block)
+	{
+		switch (format)
+		{
+			case CookedTextureFormat::Bc1:
+				EncodeBc1Block(pixels, block);
+				break;
+
+			case CookedTextureFormat::Bc5:
+				EncodeBc4Block(pixels, 0, block);
+				EncodeBc4Block(pixels, 1, block + 8);
+				break;
+
+			case CookedTextureFormat::Bc7:
+				EncodeBc7Block(pixels, block);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	bool IsSrgbUsage(TextureUsage usage)
+	{
+		return usage == TextureUsage::Color;
+	}
+
+	CookedTextureFormat ChooseCookedTextureFormat(TextureUsage usage, std::uint32_t width, std::uint32_t height)
+	{
+		if (width % 4 != 0 || height % 4 != 0)
+			return CookedTextureFormat::Rgba8;
+
+		switch (usage)
+		{
+			case TextureUsage::Color:
+			case TextureUsage::Data:
+				return CookedTextureFormat::Bc7;
+
+			case TextureUsage::Normal:
+				return CookedTextureFormat::Bc5;
+
+			case TextureUsage::Mask:
+				return CookedTextureFormat::Bc1;
+
+			default:
+				return CookedTextureFormat::Rgba8;
+		}
+	}
+
+	std::uint32_t GetCookedMipsCount(std::uint32_t width, std::uint32_t height)
+	{
+		return static_cast<std::uint32_t>(std::bit_width(std::max({ width, height, 1u })));
+	}
+
+	CookedTexture CookTexture(std::span<const std::uint8_t> rgba,
+		std::uint32_t width,
+		std::uint32_t height,
+		TextureUsage usage,
+		CookedTextureFormat format,
+		JobSystem* job_system)
+	{
+		CookedTexture texture;
+		texture.format = format;
+		texture.is_srgb = IsSrgbUsage(usage);
+
+		const bool is_compressed = format != CookedTextureFormat::Rgba8;
+		const std::uint32_t mips_count = GetCookedMipsCount(width, height);
+
+		// Every mip is filtered from previous one
+		std::vector<std::vector<std::uint8_t>> mip_images(mips_count);
+		mip_images[0].assign(rgba.begin(), rgba.end());
+
+		std::uint64_t data_size = 0;
+
+		for (std::uint32_t mip = 0; mip < mips_count; mip++)
+		{
+			CookedMip& cooked_mip = texture.mips.emplace_back();
+			cooked_mip.width = std::max(width >> mip, 1u);
+			cooked_mip.height = std::max(height >> mip, 1u);
+			cooked_mip.row_size = is_compressed ? (cooked_mip.width + 3) / 4 * GetBlockSize(format) : cooked_mip.width * 4;
+			cooked_mip.rows_count = is_compressed ? (cooked_mip.height + 3) / 4 : cooked_mip.height;
+			cooked_mip.offset = data_size;
+
+			data_size += static_cast<std::uint64_t>(cooked_mip.row_size) * cooked_mip.rows_count;
+
+			if (mip > 0)
+			{
+				const CookedMip& previous_mip = texture.mips[mip - 1];
+				mip_images[mip] = DownsampleImage(
+					mip_images[mip - 1], previous_mip.width, previous_mip.height, cooked_mip.width, cooked_mip.height, usage, job_system);
+			}
+		}
+
+		texture.data.resize(data_size);
+
+		if (!is_compressed)
+		{
+			for (std::uint32_t mip = 0; mip < mips_count; mip++)
+				std::memcpy(&texture.data[texture.mips[mip].offset], mip_images[mip].data(), mip_images[mip].size());
+
+			return texture;
+		}
+
+		// Rows of blocks of all mips are independent, so they are encoded as one parallel loop
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> block_rows;
+
+		for (std::uint32_t mip = 0; mip < mips_count; mip++)
+		{
+			for (std::uint32_t row = 0; row < texture.mips[mip].rows_count; row++)
+				block_rows.emplace_back(mip, row);
+		}
+
+		const auto encode_row = [&](std::uint32_t i)
+		{
+			const auto [mip, row] = block_rows[i];
+			const CookedMip& cooked_mip = texture.mips[mip];
+
+			std::uint8_t* row_data = &texture.data[cooked_mip.offset + static_cast<std::uint64_t>(row) * cooked_mip.row_size];
+
+			for (std::uint32_t block_x = 0; block_x < (cooked_mip.width + 3) / 4; block_x++)
+			{
+				std::uint8_t pixels[16 * 4];
+				LoadBlock(mip_images[mip], cooked_mip.width, cooked_mip.height, block_x, row, pixels);
+				EncodeBlock(format, pixels, row_data + block_x * GetBlockSize(format));
+			}
+		};
+
+		if (job_system)
+		{
+			job_system->ParallelFor(static_cast<std::uint32_t>(block_rows.size()), ENCODE_ROWS_BATCH_SIZE, encode_row);
+		}
+		else
+		{
+			for (std::uint32_t i = 0; i < block_rows.size(); i++)
+				encode_row(i);
+		}
+
+		return texture;
+	}
+
+	std::vector<std::uint8_t> DecodeCookedMip(const CookedTexture& texture, std::uint32_t mip)
+	{
+		const CookedMip& cooked_mip = texture.mips[mip];
+		const std::uint8_t* mip_data = &texture.data[cooked_mip.offset];
+
+		if (texture.format == CookedTextureFormat::Rgba8)
+			return std::vector<std::uint8_t>(mip_data, mip_data + static_cast<std::size_t>(cooked_mip.row_size) * cooked_mip.rows_count);
+
+		std::vector<std::uint8_t> image(static_cast<std::size_t>(cooked_mip.width) * cooked_mip.height * 4);
+
+		for (std::uint32_t block_y = 0; block_y < cooked_mip.rows_count; block_y++)
+		{
+			for (std::uint32_t block_x = 0; block_x < (cooked_mip.width + 3) / 4; block_x++)
+			{
+				const std::uint8_t* block = mip_data + static_cast<std::size_t>(block_y) * cooked_mip.row_size + block_x * GetBlockSize(texture.format);
+
+				std::uint8_t pixels[16 * 4] = {};
+
+				switch (texture.format)
+				{
+					case CookedTextureFormat::Bc1:
+						DecodeBc1Block(block, pixels);
+						break;
+
+					case CookedTextureFormat::Bc5:
+						DecodeBc4Block(block, 0, pixels);
+						DecodeBc4Block(block + 8, 1, pixels);
+
+						for (std::uint32_t i = 0; i < 16; i++)
+							pixels[i * 4 + 3] = 255;
+						break;
+
+					case CookedTextureFormat::Bc7:
+						DecodeBc7Block(block, pixels);
+						break;
+
+					default:
+						break;
+				}
+
+				for (std::uint32_t y = 0; y < 4 && block_y * 4 + y < cooked_mip.height; y++)
+				{
+					for (std::uint32_t x = 0; x < 4 && block_x * 4 + x < cooked_mip.width; x++)
+					{
+						std::memcpy(
+							&image[(static_cast<std::size_t>(block_y * 4 + y) * cooked_mip.width + block_x * 4 + x) * 4], &pixels[(y * 4 + x) * 4], 4);
+					}
+				}
+			}
+		}
+
+		return image;
+	}
+
+	double ComputePsnr(std::span<const std::uint8_t> reference, std::span<const std::uint8_t> image, std::uint32_t channels_mask)
+	{
+		double squared_error = 0.0;
+		std::uint64_t samples_count = 0;
+
+		for (std::size_t i = 0; i < std::min(reference.size(), image.size()); i++)
+		{
+			if (!(channels_mask & (1u << (i % 4))))
+				continue;
+
+			const double difference = static_cast<double>(reference[i]) - static_cast<double>(image[i]);
+			squared_error += difference * difference;
+			samples_count++;
+		}
+
+		if (squared_error == 0.0 || samples_count == 0)
+			return std::numeric_limits<double>::infinity();
+
+		return 10.0 * std::log10(255.0 * 255.0 * static_cast<double>(samples_count) / squared_error);
+	}
+
+	std::uint32_t GetCookedChannelsMask(CookedTextureFormat format)
+	{
+		switch (format)
+		{
+			case CookedTextureFormat::Bc1:
+				return 0b0111;
+
+			case CookedTextureFormat::Bc5:
+				return 0b0011;
+
+			default:
+				return 0b1111;
+		}
+	}
+
+	std::string_view GetCookedTextureFormatName(CookedTextureFormat format)
+	{
+		switch (format)
+		{
+			case CookedTextureFormat::Bc1:
+				return "BC1";
+
+			case CookedTextureFormat::Bc5:
+				return "BC5";
+
+			case CookedTextureFormat::Bc7:
+				return "BC7";
+
+			default:
+				return "RGBA8";
+		}
+	}
+
+	std::wstring GetCookedTexturePath(const std::wstring& image_path)
+	{
+		return image_path + L".ysntex";
+	}
+
+	std::optional<CookedTextureKey> MakeCookedTextureKey(const std::wstring& image_path, TextureUsage usage, CookedTextureFormat format)
+	{
+		std::error_code error_code;
+
+		const std::uintmax_t size = std::filesystem::file_size(image_path, error_code);
+
+		if (error_code)
+			return std::nullopt;
+
+		const std::filesystem::file_time_type write_time = std::filesystem::last_write_time(image_path, error_code);
+
+		if (error_code)
+			return std::nullopt;
+
+		CookedTextureKey key;
+		key.source_size = static_cast<std::uint64_t>(size);
+		key.source_write_time = static_cast<std::int64_t>(write_time.time_since_epoch().count());
+		key.usage = usage;
+		key.format = format;
+
+		return key;
+	}
+
+	std::optional<CookedTexture> ReadCookedTexture(const std::wstring& cooked_path, const CookedTextureKey& key)
+	{
+		MappedFile file;
+
+		if (!file.Open(cooked_path))
+			return std::nullopt;
+
+		CookedTextureHeader header;
+
+		if (file.Size() < sizeof(header))
+			return std::nullopt;
+
+		std::memcpy(&header, file.Data(), sizeof(header));
+
+		// Stale files are silently recooked
+		if (header.magic != COOKED_TEXTURE_MAGIC || header.version != COOKED_TEXTURE_VERSION || header.source_size != key.source_size ||
+			header.source_write_time != key.source_write_time || header.usage != static_cast<std::uint8_t>(key.usage) ||
+			header.format != static_cast<std::uint8_t>(key.format))
+		{
+			return std::nullopt;
+		}
+
+		const std::uint64_t mips_size = static_cast<std::uint64_t>(header.mips_count) * sizeof(CookedMip);
+
+		if (file.Size() - sizeof(header) < mips_size || file.Size() - sizeof(header) - mips_size != header.data_size)
+		{
+			LogWarning << "Cooked texture is corrupted: " << std::filesystem::path(cooked_path).string() << "\n";
+			return std::nullopt;
+		}
+
+		CookedTexture texture;
+		texture.format = key.format;
+		texture.is_srgb = header.is_srgb != 0;
+		texture.mips.resize(header.mips_count);
+		texture.data.resize(header.data_size);
+
+		std::memcpy(texture.mips.data(), file.Data() + sizeof(header), mips_size);
+		std::memcpy(texture.data.data(), file.Data() + sizeof(header) + mips_size, header.data_size);
+
+		for (const CookedMip& mip : texture.mips)
+		{
+			if (mip.offset + static_cast<std::uint64_t>(mip.row_size) * mip.rows_count > texture.data.size())
+			{
+				LogWarning << "Cooked texture is corrupted: " << std::filesystem::path(cooked_path).string() << "\n";
+				return std::nullopt;
+			}
+		}
+
+		return texture;
+	}
+
+	bool WriteCookedTexture(const std::wstring& cooked_path, const CookedTexture& texture, const CookedTextureKey& key)
+	{
+		CookedTextureHeader header;
+		header.source_size = key.source_size;
+		header.source_write_time = key.source_write_time;
+		header.usage = static_cast<std::uint8_t>(key.usage);
+		header.format = static_cast<std::uint8_t>(texture.format);
+		header.is_srgb = texture.is_srgb;
+		header.mips_count = static_cast<std::uint32_t>(texture.mips.size());
+		header.data_size = texture.data.size();
+
+		// Write next to the destination and swap, so interrupted cook never leaves half written file behind
+		const std::filesystem::path final_path(cooked_path);
+		std::filesystem::path temp_path = final_path;
+		temp_path += L".tmp";
+
+		{
+			std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+
+			if (!file.is_open())
+			{
+				LogError << "Texture cooker can't open file for writing: " << temp_path.string() << "\n";
+				return false;
+			}
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(texture.mips.data()), static_cast<std::streamsize>(texture.mips.size() * sizeof(CookedMip)));
+			file.write(reinterpret_cast<const char*>(texture.data.data()), static_cast<std::streamsize>(texture.data.size()));
+
+			if (!file.good())
+			{
+				LogError << "Texture cooker can't write file: " << temp_path.string() << "\n";
+				return false;
+			}
+		}
+
+		std::error_code error_code;
+		std::filesystem::rename(temp_path, final_path, error_code);
+
+		if (error_code)
+		{
+			LogError << "Texture cooker can't replace file: " << final_path.string() << "\n";
+			std::filesystem::remove(temp_path, error_code);
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -3,19 +3,27 @@
 import std;
 import yasno;
 import yasno.settings;
+import renderer.vertex_storage;
 import system.application;
 import system.profiler;
 
-int WINAPI wWinMain(_In_ HINSTANCE hinstance, _In_opt_ HINSTANCE, _In_ LPWSTR, _In_ int)
+int WINAPI wWinMain(_In_ HINSTANCE hinstance, _In_opt_ HINSTANCE, _In_ LPWSTR command_line, _In_ int)
 {
 	ysn::ProfilerSetThreadName("Ysn Main Thread");
 
 	ysn::GraphicsSettings gs;
 
+	ysn::ContentSettings content_settings;
+
+	if (std::wstring_view(command_line).contains(L"-compact_vertices"))
+	{
+		content_settings.vertex_format = ysn::VertexFormat::Compact;
+	}
+
 	ysn::Application::Create(hinstance);
 	auto window = ysn::Application::Get().CreateRenderWindow(L"Yasno", 1920, 1080, false);
 
-	auto yasno_core = std::make_shared<ysn::Yasno>(L"Yasno", 1920, 1080);
+	auto yasno_core = std::make_shared<ysn::Yasno>(L"Yasno", 1920, 1080, false, content_settings);
 	yasno_core->SetWindow(window);
 	window->RegisterCallbacks(yasno_core);
 	window->Show();
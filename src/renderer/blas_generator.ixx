@@ -20,6 +20,7 @@ export namespace ysn
 			D3D12_INDEX_BUFFER_VIEW index_buffer_view,
 			std::uint32_t vertex_count,
 			std::uint32_t index_count,
+			DXGI_FORMAT vertex_format,
 			ID3D12Resource* transform_buffer,
 			UINT64 transform_offset_in_bytes,
 			bool is_opaque = true);
@@ -52,6 +53,7 @@ namespace ysn
 		D3D12_INDEX_BUFFER_VIEW index_buffer_view,
 		std::uint32_t vertex_count,
 		std::uint32_t index_count,
+		DXGI_FORMAT vertex_format,
 		ID3D12Resource* transform_buffer,
 		UINT64 transform_offset_in_bytes,
 		bool is_opaque)
@@ -61,7 +63,7 @@ namespace ysn
 		descriptor.Triangles.VertexBuffer.StartAddress = vertex_buffer_view.BufferLocation;
 		descriptor.Triangles.VertexBuffer.StrideInBytes = vertex_buffer_view.StrideInBytes;
 		descriptor.Triangles.VertexCount = vertex_count;
-		descriptor.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+		descriptor.Triangles.VertexFormat = vertex_format;
 		descriptor.Triangles.IndexBuffer = index_buffer_view.BufferLocation;
 		descriptor.Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
 		descriptor.Triangles.IndexCount = index_count;
@@ -30,6 +30,9 @@ export namespace ysn
 		std::optional<uint64_t> ExecuteCommandLists();
 		void CloseCommandList(wil::com_ptr<DxGraphicsCommandList> cmd_list);
 
+		// Gives command list back to the pool without executing it, recorded commands are dropped
+		void DiscardCommandList(wil::com_ptr<DxGraphicsCommandList> cmd_list);
+
 		std::optional<uint64_t> Signal();
 
 		bool IsFenceComplete(uint64_t fence_value);
@@ -296,4 +299,29 @@ namespace ysn
 
 		m_cmd_list_queue.push_back(cmd_list);
 	}
+
+	void CommandQueue::DiscardCommandList(wil::com_ptr<DxGraphicsCommandList> cmd_list)
+	{
+		if constexpr (!IsReleaseActive())
+		{
+			PIXEndEvent(cmd_list.get());
+		}
+
+		cmd_list->Close();
+
+		ID3D12CommandAllocator* cmd_allocator = nullptr;
+		UINT data_size = sizeof(cmd_allocator);
+
+		if (auto result = cmd_list->GetPrivateData(__uuidof(ID3D12CommandAllocator), &data_size, &cmd_allocator); result != S_OK)
+		{
+			LogError << "Can't retrieve cmd allocator from cmd list: " << ConvertHrToString(result) << "\n";
+			return;
+		}
+
+		// Nothing was submitted, allocator can be reset as soon as work already in flight is done
+		m_cmd_allocator_pool.emplace(CommandAllocatorEntry{ m_fence_value, cmd_allocator });
+		m_cmd_list_pool.push(cmd_list);
+
+		cmd_allocator->Release();
+	}
 }
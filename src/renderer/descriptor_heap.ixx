@@ -30,6 +30,15 @@ export namespace ysn
 		bool Initialize();
 
 		DescriptorHandle GetNewHandle();
+
+		// Handles are allocated linearly, so only the newest ones can be given back
+		uint32_t GetHandlesCount() const
+		{
+			return m_num_descriptors;
+		}
+
+		void ReleaseHandlesAfter(uint32_t handles_count);
+
 		CD3DX12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(DescriptorHandle handle);
 		CD3DX12_GPU_DESCRIPTOR_HANDLE GetGpuHandle(DescriptorHandle handle);
 
@@ -167,6 +176,14 @@ namespace ysn
 		return handle;
 	}
 
+	void DescriptorHeap::ReleaseHandlesAfter(uint32_t handles_count)
+	{
+		if (handles_count < m_num_descriptors)
+		{
+			m_num_descriptors = handles_count;
+		}
+	}
+
 	CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetCpuHandle(DescriptorHandle handle)
 	{
 		const D3D12_CPU_DESCRIPTOR_HANDLE start = m_descriptor_heap->GetCPUDescriptorHandleForHeapStart();
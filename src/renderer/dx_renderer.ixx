@@ -13,6 +13,7 @@ import system.logger;
 import system.asserts;
 import system.helpers;
 import system.compilation;
+import system.job_system;
 import renderer.vertex_storage;
 import renderer.index_storage;
 import renderer.command_queue;
@@ -27,7 +28,7 @@ export namespace ysn
 	class DxRenderer
 	{
 	public:
-		bool Initialize();
+		bool Initialize(std::shared_ptr<JobSystem> job_system);
 		void Shutdown();
 
 		bool CreateRootSignature(D3D12_ROOT_SIGNATURE_DESC* pRootSignatureDesc, ID3D12RootSignature** ppRootSignature) const;
@@ -255,7 +256,7 @@ std::optional<wil::com_ptr<DxDevice>> CreateDevice(wil::com_ptr<DxAdapter> adapt
 
 namespace ysn
 {
-	bool DxRenderer::Initialize()
+	bool DxRenderer::Initialize(std::shared_ptr<JobSystem> job_system)
 	{
 		if constexpr (IsDebugActive())
 		{
@@ -310,7 +311,7 @@ namespace ysn
 
 		m_is_raytracing_supported = CheckRaytracingSupport();
 
-		if (!m_pso_storage.Initialize())
+		if (!m_pso_storage.Initialize(job_system))
 		{
 			LogError << "Can't initialize pso storage\n";
 			return false;
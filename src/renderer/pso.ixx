@@ -11,6 +11,7 @@ import system.logger;
 import system.hash;
 import system.string_helpers;
 import system.asserts;
+import system.job_system;
 import renderer.shader_storage;
 import renderer.dx_types;
 
@@ -151,7 +152,7 @@ export namespace ysn
 	class PsoStorage
 	{
 	public:
-		bool Initialize();
+		bool Initialize(std::shared_ptr<JobSystem> job_system);
 
 		// old pso id if we recompile PSO and want to keep id
 		std::optional<PsoId> BuildPso(wil::com_ptr<DxDevice> device, PsoDesc* pso_desc, PsoId old_pso_id = -1);
@@ -300,19 +301,21 @@ namespace ysn
 
 	std::optional<std::vector<ShaderHash>> GraphicsPsoDesc::BuildShaders(wil::com_ptr<DxDevice> device, std::shared_ptr<ShaderStorage> shader_storage)
 	{
-		std::vector<ShaderHash> result;
+		// All stages at once, so cold cache compiles them in parallel
+		const auto compiled_shader_hashes = shader_storage->CompileShaders(m_shaders_to_compile);
 
-		for (const auto& shader : m_shaders_to_compile)
+		if (!compiled_shader_hashes.has_value())
 		{
-			const auto& compiled_shader_hash = shader_storage->CompileShader(shader);
+			LogError << "Can't compile shader\n";
+			return std::nullopt;
+		}
 
-			if (!compiled_shader_hash.has_value())
-			{
-				LogError << "Can't compile shader\n";
-				return std::nullopt;
-			}
+		for (std::size_t i = 0; i < m_shaders_to_compile.size(); i++)
+		{
+			const ShaderCompileParameters& shader = m_shaders_to_compile[i];
+			const ShaderHash compiled_shader_hash = compiled_shader_hashes->at(i);
 
-			wil::com_ptr<IDxcBlob> blob = shader_storage->GetShader(*compiled_shader_hash).value();
+			wil::com_ptr<IDxcBlob> blob = shader_storage->GetShader(compiled_shader_hash).value();
 			const auto bytecode = CD3DX12_SHADER_BYTECODE(const_cast<void*>(blob->GetBufferPointer()), blob->GetBufferSize());
 
 			switch (shader.type)
@@ -325,11 +328,9 @@ namespace ysn
 					break;
 					// TODO: finish and sanitize
 			}
-
-			result.emplace_back(*compiled_shader_hash);
 		}
 
-		return result;
+		return compiled_shader_hashes;
 	}
 
 	const D3D12_GRAPHICS_PIPELINE_STATE_DESC& GraphicsPsoDesc::GetDesc() const
@@ -449,11 +450,11 @@ namespace ysn
 		m_shaders_to_compile.push_back(shader_parameter);
 	}
 
-	bool PsoStorage::Initialize()
+	bool PsoStorage::Initialize(std::shared_ptr<JobSystem> job_system)
 	{
 		m_shader_storage = std::make_shared<ShaderStorage>();
 
-		if (!m_shader_storage->Initialize())
+		if (!m_shader_storage->Initialize(job_system))
 		{
 			LogError << "Can't create shader storage\n";
 			return false;
@@ -0,0 +1,462 @@
+module;
+
+#include <d3d12.h>
+#include <wil/com.h>
+
+export module renderer.render_queue;
+
+import std;
+import renderer.pso;
+
+export namespace ysn
+{
+	// Opaque: 0 | pso 20 bits | material 20 bits | depth 23 bits, grouped by state and drawn front to back
+	// Translucent: 1 | inverted depth 23 bits | pso 20 bits | material 20 bits, drawn last and back to front
+	using DrawKey = uint64_t;
+
+	DrawKey MakeDrawKey(uint32_t pso_index, uint32_t material_id, float depth, bool is_translucent);
+
+	struct DrawCommand
+	{
+		PsoId pso_id = -1;
+		uint32_t material_id = 0;
+		float depth = 0.0f; // Normalized distance to viewer
+		bool is_translucent = false;
+
+		uint32_t instance_id = 0;
+		D3D_PRIMITIVE_TOPOLOGY topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view = {};
+		D3D12_INDEX_BUFFER_VIEW index_buffer_view = {}; // Empty for non indexed draws
+		uint32_t count = 0;							   // Indices or vertices
+		uint32_t start_index = 0;					   // First index or vertex
+		int32_t base_vertex = 0;
+	};
+
+	// Sorted draws sharing pipeline state and topology
+	struct DrawRun
+	{
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+
+	// Receives only state that actually changed, in submission order
+	class CommandRecorder
+	{
+	public:
+		virtual ~CommandRecorder() = default;
+
+		virtual void SetPipelineState(ID3D12PipelineState* pipeline_state) = 0;
+		virtual void SetRootSignature(ID3D12RootSignature* root_signature) = 0;
+		virtual void SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY topology) = 0;
+		virtual void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& vertex_buffer_view) = 0;
+		virtual void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& index_buffer_view) = 0;
+		virtual void SetInstanceId(uint32_t instance_id) = 0;
+		virtual void DrawIndexed(uint32_t index_count, uint32_t start_index, int32_t base_vertex) = 0;
+		virtual void Draw(uint32_t vertex_count, uint32_t start_vertex) = 0;
+	};
+
+	struct CommandRecorderStats
+	{
+		uint32_t pipeline_states = 0;
+		uint32_t root_signatures = 0;
+		uint32_t topologies = 0;
+		uint32_t vertex_buffers = 0;
+		uint32_t index_buffers = 0;
+		uint32_t instance_ids = 0;
+		uint32_t draws = 0;
+
+		uint32_t GetStateChanges() const
+		{
+			return pipeline_states + root_signatures + topologies + vertex_buffers + index_buffers + instance_ids;
+		}
+	};
+
+	class D3D12CommandRecorder : public CommandRecorder
+	{
+	public:
+		// Root signature change resets root arguments, so per pass ones are rebound by bind_root_parameters
+		D3D12CommandRecorder(ID3D12GraphicsCommandList* command_list,
+			uint32_t instance_id_root_index,
+			std::function<void(ID3D12GraphicsCommandList*)> bind_root_parameters);
+
+		void SetPipelineState(ID3D12PipelineState* pipeline_state) override;
+		void SetRootSignature(ID3D12RootSignature* root_signature) override;
+		void SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY topology) override;
+		void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& vertex_buffer_view) override;
+		void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& index_buffer_view) override;
+		void SetInstanceId(uint32_t instance_id) override;
+		void DrawIndexed(uint32_t index_count, uint32_t start_index, int32_t base_vertex) override;
+		void Draw(uint32_t vertex_count, uint32_t start_vertex) override;
+
+		CommandRecorderStats stats;
+
+	private:
+		ID3D12GraphicsCommandList* m_command_list = nullptr;
+		uint32_t m_instance_id_root_index = 0;
+		std::function<void(ID3D12GraphicsCommandList*)> m_bind_root_parameters;
+	};
+
+	class RenderQueue
+	{
+	public:
+		void Clear();
+		void Add(const DrawCommand& command);
+
+		// Looks up every used PSO once, draws with missing PSO are dropped
+		void ResolvePsos(const std::function<std::optional<Pso>(PsoId)>& get_pso);
+
+		void Sort();
+
+		// Emits sorted draws, every state is set only when it differs from the previous draw
+		void Submit(CommandRecorder& recorder) const;
+
+		std::vector<DrawRun> BuildRuns() const;
+
+		std::span<const DrawCommand> GetSortedDraws() const
+		{
+			return m_sorted_draws;
+		}
+
+		uint32_t GetMissingPsoDrawsCount() const
+		{
+			return m_missing_pso_draws_count;
+		}
+
+	private:
+		struct SortItem
+		{
+			DrawKey key = 0;
+			uint32_t draw_index = 0;
+		};
+
+		void SubmitDraws(CommandRecorder& recorder, std::span<const uint32_t> draw_order) const;
+		uint32_t GetPipelineIndex(uint32_t pso_index) const;
+
+		std::vector<DrawCommand> m_draws;
+		std::vector<uint32_t> m_draw_pso_indices;
+
+		std::unordered_map<PsoId, uint32_t> m_pso_indices;
+		std::vector<PsoId> m_pso_ids;
+		std::vector<std::optional<Pso>> m_psos;
+		std::vector<uint32_t> m_pipeline_indices; // Different ids resolved into the same pipeline share index
+
+		std::vector<SortItem> m_sort_items;
+		std::vector<SortItem> m_sort_scratch;
+		std::vector<uint32_t> m_sorted_indices;
+		std::vector<DrawCommand> m_sorted_draws;
+
+		uint32_t m_missing_pso_draws_count = 0;
+	};
+}
+
+module :private;
+
+namespace ysn
+{
+	constexpr uint32_t g_pso_bits = 20;
+	constexpr uint32_t g_material_bits = 20;
+	constexpr uint32_t g_depth_bits = 23;
+
+	DrawKey MakeDrawKey(uint32_t pso_index, uint32_t material_id, float depth, bool is_translucent)
+	{
+		const DrawKey pso = pso_index & ((1u << g_pso_bits) - 1);
+		const DrawKey material = material_id & ((1u << g_material_bits) - 1);
+		const DrawKey max_depth = (1u << g_depth_bits) - 1;
+		const DrawKey depth_bucket = static_cast<DrawKey>(std::clamp(depth, 0.0f, 1.0f) * static_cast<float>(max_depth));
+
+		if (is_translucent)
+		{
+			return (1ull << 63) | ((max_depth - depth_bucket) << (g_pso_bits + g_material_bits)) | (pso << g_material_bits) | material;
+		}
+
+		return (pso << (g_material_bits + g_depth_bits)) | (material << g_depth_bits) | depth_bucket;
+	}
+
+	D3D12CommandRecorder::D3D12CommandRecorder(ID3D12GraphicsCommandList* command_list,
+		uint32_t instance_id_root_index,
+		std::function<void(ID3D12GraphicsCommandList*)> bind_root_parameters) :
+		m_command_list(command_list), m_instance_id_root_index(instance_id_root_index), m_bind_root_parameters(std::move(bind_root_parameters))
+	{
+	}
+
+	void D3D12CommandRecorder::SetPipelineState(ID3D12PipelineState* pipeline_state)
+	{
+		stats.pipeline_states++;
+		m_command_list->SetPipelineState(pipeline_state);
+	}
+
+	void D3D12CommandRecorder::SetRootSignature(ID3D12RootSignature* root_signature)
+	{
+		stats.root_signatures++;
+		m_command_list->SetGraphicsRootSignature(root_signature);
+
+		if (m_bind_root_parameters)
+			m_bind_root_parameters(m_command_list);
+	}
+
+	void D3D12CommandRecorder::SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY topology)
+	{
+		stats.topologies++;
+		m_command_list->IASetPrimitiveTopology(topology);
+	}
+
+	void D3D12CommandRecorder::SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& vertex_buffer_view)
+	{
+		stats.vertex_buffers++;
+		m_command_list->IASetVertexBuffers(0, 1, &vertex_buffer_view);
+	}
+
+	void D3D12CommandRecorder::SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& index_buffer_view)
+	{
+		stats.index_buffers++;
+		m_command_list->IASetIndexBuffer(&index_buffer_view);
+	}
+
+	void D3D12CommandRecorder::SetInstanceId(uint32_t instance_id)
+	{
+		stats.instance_ids++;
+		m_command_list->SetGraphicsRoot32BitConstant(m_instance_id_root_index, instance_id, 0);
+	}
+
+	void D3D12CommandRecorder::DrawIndexed(uint32_t index_count, uint32_t start_index, int32_t base_vertex)
+	{
+		stats.draws++;
+		m_command_list->DrawIndexedInstanced(index_count, 1, start_index, base_vertex, 0);
+	}
+
+	void D3D12CommandRecorder::Draw(uint32_t vertex_count, uint32_t start_vertex)
+	{
+		stats.draws++;
+		m_command_list->DrawInstanced(vertex_count, 1, start_vertex, 0);
+	}
+
+	static bool IsSameVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& lhs, const D3D12_VERTEX_BUFFER_VIEW& rhs)
+	{
+		return lhs.BufferLocation == rhs.BufferLocation && lhs.SizeInBytes == rhs.SizeInBytes && lhs.StrideInBytes == rhs.StrideInBytes;
+	}
+
+	static bool IsSameIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& lhs, const D3D12_INDEX_BUFFER_VIEW& rhs)
+	{
+		return lhs.BufferLocation == rhs.BufferLocation && lhs.SizeInBytes == rhs.SizeInBytes && lhs.Format == rhs.Format;
+	}
+
+	static bool IsIndexed(const DrawCommand& draw)
+	{
+		return draw.index_buffer_view.SizeInBytes != 0;
+	}
+
+	void RenderQueue::Clear()
+	{
+		m_draws.clear();
+		m_draw_pso_indices.clear();
+		m_pso_indices.clear();
+		m_pso_ids.clear();
+		m_psos.clear();
+		m_pipeline_indices.clear();
+		m_sorted_indices.clear();
+		m_sorted_draws.clear();
+		m_missing_pso_draws_count = 0;
+	}
+
+	void RenderQueue::Add(const DrawCommand& command)
+	{
+		const auto [it, is_inserted] = m_pso_indices.try_emplace(command.pso_id, static_cast<uint32_t>(m_pso_ids.size()));
+
+		if (is_inserted)
+			m_pso_ids.push_back(command.pso_id);
+
+		m_draws.push_back(command);
+		m_draw_pso_indices.push_back(it->second);
+	}
+
+	void RenderQueue::ResolvePsos(const std::function<std::optional<Pso>(PsoId)>& get_pso)
+	{
+		m_psos.resize(m_pso_ids.size());
+		m_pipeline_indices.resize(m_pso_ids.size());
+
+		std::unordered_map<ID3D12PipelineState*, uint32_t> pipeline_indices;
+
+		for (uint32_t i = 0; i < m_pso_ids.size(); i++)
+		{
+			m_psos[i] = m_pso_ids[i] == -1 ? std::nullopt : get_pso(m_pso_ids[i]);
+			m_pipeline_indices[i] = m_psos[i].has_value() ? pipeline_indices.try_emplace(m_psos[i]->pso.get(), i).first->second : i;
+		}
+	}
+
+	uint32_t RenderQueue::GetPipelineIndex(uint32_t pso_index) const
+	{
+		return pso_index < m_pipeline_indices.size() ? m_pipeline_indices[pso_index] : pso_index;
+	}
+
+	void RenderQueue::Sort()
+	{
+		m_sort_items.clear();
+		m_sort_items.reserve(m_draws.size());
+
+		m_missing_pso_draws_count = 0;
+
+		for (uint32_t i = 0; i < m_draws.size(); i++)
+		{
+			const uint32_t pso_index = m_draw_pso_indices[i];
+
+			if (pso_index < m_psos.size() && !m_psos[pso_index].has_value())
+			{
+				m_missing_pso_draws_count++;
+				continue;
+			}
+
+			const DrawCommand& draw = m_draws[i];
+			m_sort_items.push_back({ MakeDrawKey(GetPipelineIndex(pso_index), draw.material_id, draw.depth, draw.is_translucent), i });
+		}
+
+		// LSD radix sort by bytes, stable so equal keys keep submission order
+		m_sort_scratch.resize(m_sort_items.size());
+
+		for (uint32_t shift = 0; shift < 64; shift += 8)
+		{
+			std::array<uint32_t, 256> histogram = {};
+
+			for (const SortItem& item : m_sort_items)
+			{
+				histogram[(item.key >> shift) & 0xff]++;
+			}
+
+			// Byte is the same for every key
+			if (m_sort_items.empty() || histogram[(m_sort_items.front().key >> shift) & 0xff] == m_sort_items.size())
+				continue;
+
+			uint32_t offset = 0;
+
+			for (uint32_t& bucket : histogram)
+			{
+				const uint32_t count = bucket;
+				bucket = offset;
+				offset += count;
+			}
+
+			for (const SortItem& item : m_sort_items)
+			{
+				m_sort_scratch[histogram[(item.key >> shift) & 0xff]++] = item;
+			}
+
+			m_sort_items.swap(m_sort_scratch);
+		}
+
+		m_sorted_indices.resize(m_sort_items.size());
+		m_sorted_draws.resize(m_sort_items.size());
+
+		for (std::size_t i = 0; i < m_sort_items.size(); i++)
+		{
+			m_sorted_indices[i] = m_sort_items[i].draw_index;
+			m_sorted_draws[i] = m_draws[m_sort_items[i].draw_index];
+		}
+	}
+
+	void RenderQueue::Submit(CommandRecorder& recorder) const
+	{
+		SubmitDraws(recorder, m_sorted_indices);
+	}
+
+	void RenderQueue::SubmitDraws(CommandRecorder& recorder, std::span<const uint32_t> draw_order) const
+	{
+		std::optional<uint32_t> current_pipeline_index;
+		std::optional<ID3D12RootSignature*> current_root_signature;
+		std::optional<D3D_PRIMITIVE_TOPOLOGY> current_topology;
+		std::optional<D3D12_VERTEX_BUFFER_VIEW> current_vertex_buffer;
+		std::optional<D3D12_INDEX_BUFFER_VIEW> current_index_buffer;
+		std::optional<uint32_t> current_instance_id;
+
+		for (const uint32_t draw_index : draw_order)
+		{
+			const DrawCommand& draw = m_draws[draw_index];
+			const uint32_t pso_index = m_draw_pso_indices[draw_index];
+
+			// Queue may be submitted without resolved PSOs, tests do it without device
+			const Pso* pso = nullptr;
+
+			if (pso_index < m_psos.size())
+			{
+				if (!m_psos[pso_index].has_value())
+					continue;
+
+				pso = &m_psos[pso_index].value();
+			}
+
+			ID3D12RootSignature* root_signature = pso ? pso->root_signature.get() : nullptr;
+
+			if (current_root_signature != root_signature)
+			{
+				recorder.SetRootSignature(root_signature);
+				current_root_signature = root_signature;
+
+				// Root arguments are reset with signature
+				current_instance_id.reset();
+			}
+
+			if (const uint32_t pipeline_index = GetPipelineIndex(pso_index); current_pipeline_index != pipeline_index)
+			{
+				recorder.SetPipelineState(pso ? pso->pso.get() : nullptr);
+				current_pipeline_index = pipeline_index;
+			}
+
+			if (current_topology != draw.topology)
+			{
+				recorder.SetPrimitiveTopology(draw.topology);
+				current_topology = draw.topology;
+			}
+
+			if (!current_vertex_buffer || !IsSameVertexBuffer(*current_vertex_buffer, draw.vertex_buffer_view))
+			{
+				recorder.SetVertexBuffer(draw.vertex_buffer_view);
+				current_vertex_buffer = draw.vertex_buffer_view;
+			}
+
+			if (current_instance_id != draw.instance_id)
+			{
+				recorder.SetInstanceId(draw.instance_id);
+				current_instance_id = draw.instance_id;
+			}
+
+			if (IsIndexed(draw))
+			{
+				if (!current_index_buffer || !IsSameIndexBuffer(*current_index_buffer, draw.index_buffer_view))
+				{
+					recorder.SetIndexBuffer(draw.index_buffer_view);
+					current_index_buffer = draw.index_buffer_view;
+				}
+
+				recorder.DrawIndexed(draw.count, draw.start_index, draw.base_vertex);
+			}
+			else
+			{
+				recorder.Draw(draw.count, draw.start_index);
+			}
+		}
+	}
+
+	std::vector<DrawRun> RenderQueue::BuildRuns() const
+	{
+		std::vector<DrawRun> runs;
+
+		for (uint32_t i = 0; i < m_sorted_indices.size(); i++)
+		{
+			const uint32_t draw_index = m_sorted_indices[i];
+
+			if (!runs.empty())
+			{
+				const uint32_t previous_index = m_sorted_indices[i - 1];
+
+				if (GetPipelineIndex(m_draw_pso_indices[previous_index]) == GetPipelineIndex(m_draw_pso_indices[draw_index]) &&
+					m_draws[previous_index].topology == m_draws[draw_index].topology)
+				{
+					runs.back().count++;
+					continue;
+				}
+			}
+
+			runs.push_back({ .first = i, .count = 1 });
+		}
+
+		return runs;
+	}
+}
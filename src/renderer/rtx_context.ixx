@@ -9,6 +9,7 @@ export module renderer.rtx_context;
 import std;
 import system.application;
 import system.gltf_loader;
+import graphics.primitive;
 import graphics.render_scene;
 import renderer.dx_renderer;
 import renderer.descriptor_heap;
@@ -16,6 +17,7 @@ import renderer.tlas_generator;
 import renderer.blas_generator;
 import renderer.dx_types;
 import renderer.gpu_buffer;
+import renderer.vertex_storage;
 
 export namespace ysn
 {
@@ -23,7 +25,6 @@ export namespace ysn
 	{
 		GpuBuffer scratch;
 		GpuBuffer result;
-		GpuBuffer instance_desc;
 		DescriptorHandle tlas_srv;
 	};
 
@@ -33,6 +34,7 @@ export namespace ysn
 		D3D12_INDEX_BUFFER_VIEW index_buffer_view;
 		uint32_t vertex_count;
 		uint32_t index_count;
+		DXGI_FORMAT vertex_format = DXGI_FORMAT_R32G32B32_FLOAT;
 	};
 
 	struct TlasInput
@@ -52,12 +54,19 @@ export namespace ysn
 		void CreateTlasSrv(std::shared_ptr<ysn::DxRenderer> renderer);
 		void CreateAccelerationStructures(wil::com_ptr<DxGraphicsCommandList> command_list, const RenderScene& render_scene);
 
+		// Refits TLAS in place with current transforms of render scene, instances have to be the ones it was created with.
+		// Frame index is the back buffer index of the frame command list belongs to.
+		void UpdateTlasTransforms(wil::com_ptr<DxGraphicsCommandList> command_list, const RenderScene& render_scene, uint32_t frame_index);
+
 		TlasGenerator tlas_generator;
 
 		std::vector<AccelerationStructureBuffers> blas_res;
 
 		AccelerationStructureBuffers tlas_buffers;
 		std::vector<TlasInput> instances;
+
+		// Upload heap is written by CPU right away, so every frame in flight has its own instance descriptors
+		std::array<GpuBuffer, Window::BufferCount> tlas_instance_descs;
 	};
 }
 
@@ -72,7 +81,7 @@ ysn::AccelerationStructureBuffers ysn::RtxContext::CreateBlas(
 
 	for (const auto& buffer : vertex_buffers)
 	{
-		blas_generator.AddVertexBuffer(buffer.vertex_buffer_view, buffer.index_buffer_view, buffer.vertex_count, buffer.index_count, 0, 0);
+		blas_generator.AddVertexBuffer(buffer.vertex_buffer_view, buffer.index_buffer_view, buffer.vertex_count, buffer.index_count, buffer.vertex_format, 0, 0);
 	}
 
 	// The AS build requires some scratch space to store temporary information.
@@ -155,17 +164,21 @@ void ysn::RtxContext::CreateTlas(
 
 	const std::optional<GpuBuffer> scratch_result = CreateGpuBuffer(scratch_create_info, "Tlas Scratch Buffer");
 	const std::optional<GpuBuffer> tlas_result = CreateGpuBuffer(tlas_create_info, "Tlas Buffer");
-	const std::optional<GpuBuffer> instances_result = CreateGpuBuffer(instances_create_info, "Tlas Instances Buffer");
 
 	tlas_buffers.scratch = scratch_result.value();
 	tlas_buffers.result = tlas_result.value();
-	tlas_buffers.instance_desc = instances_result.value();
+
+	for (std::size_t i = 0; i < tlas_instance_descs.size(); i++)
+	{
+		const std::optional<GpuBuffer> instances_result = CreateGpuBuffer(instances_create_info, std::format("Tlas Instances Buffer {}", i));
+		tlas_instance_descs[i] = instances_result.value();
+	}
 
 	// After all the buffers are allocated, or if only an update is required, we
 	// can build the acceleration structure. Note that in the case of the update
 	// we also pass the existing AS as the 'previous' AS, so that it can be
 	// refitted in place.
-	tlas_generator.Generate(command_list.get(), tlas_buffers.scratch, tlas_buffers.result, tlas_buffers.instance_desc);
+	tlas_generator.Generate(command_list.get(), tlas_buffers.scratch, tlas_buffers.result, tlas_instance_descs[0]);
 }
 
 void ysn::RtxContext::CreateTlasSrv(std::shared_ptr<ysn::DxRenderer> renderer)
@@ -182,6 +195,18 @@ void ysn::RtxContext::CreateTlasSrv(std::shared_ptr<ysn::DxRenderer> renderer)
 	renderer->GetDevice()->CreateShaderResourceView(nullptr, &srv_desc, tlas_buffers.tlas_srv.cpu);
 }
 
+// Compact positions are built in quantized space, dequantization goes into instance transform
+static DirectX::XMMATRIX GetInstanceTransform(const ysn::RenderScene& render_scene, const ysn::Primitive& primitive, const DirectX::XMMATRIX& transform)
+{
+	if (render_scene.vertex_format != ysn::VertexFormat::Compact)
+		return transform;
+
+	const ysn::PositionQuantization quantization = ysn::GetPositionQuantization(primitive.bbox.min, primitive.bbox.max);
+
+	return DirectX::XMMatrixScaling(quantization.position_scale.x, quantization.position_scale.y, quantization.position_scale.z) *
+		DirectX::XMMatrixTranslation(quantization.position_offset.x, quantization.position_offset.y, quantization.position_offset.z) * transform;
+}
+
 // Combine the BLAS and TLAS builds to construct the entire acceleration structure required to raytrace the scene
 
 void ysn::RtxContext::CreateAccelerationStructures(wil::com_ptr<DxGraphicsCommandList> command_list, const RenderScene& render_scene)
@@ -206,6 +231,11 @@ void ysn::RtxContext::CreateAccelerationStructures(wil::com_ptr<DxGraphicsComman
 				blas_input.vertex_buffer_view = primitive.vertex_buffer_view;
 				blas_input.index_buffer_view = primitive.index_buffer_view;
 
+				if (render_scene.vertex_format == VertexFormat::Compact)
+				{
+					blas_input.vertex_format = DXGI_FORMAT_R16G16B16A16_UNORM;
+				}
+
 				vertex_buffers.push_back(blas_input);
 
 				// Build the bottom AS from the Triangle vertex buffer
@@ -213,7 +243,7 @@ void ysn::RtxContext::CreateAccelerationStructures(wil::com_ptr<DxGraphicsComman
 
 				TlasInput tlas_input;
 				tlas_input.blas = blas_buffers.result;
-				tlas_input.transform = transform;
+				tlas_input.transform = GetInstanceTransform(render_scene, primitive, transform);
 				tlas_input.instance_id = primitive.index;
 
 				instances.emplace_back(tlas_input);
@@ -225,3 +255,28 @@ void ysn::RtxContext::CreateAccelerationStructures(wil::com_ptr<DxGraphicsComman
 
 	CreateTlas(renderer->GetDevice(), command_list, instances);
 }
+
+void ysn::RtxContext::UpdateTlasTransforms(wil::com_ptr<DxGraphicsCommandList> command_list, const RenderScene& render_scene, uint32_t frame_index)
+{
+	std::size_t instance_id = 0;
+
+	for (const Model& model : render_scene.models)
+	{
+		for (std::size_t i = 0; i < model.meshes.size(); i++)
+		{
+			for (const Primitive& primitive : model.meshes[i].primitives)
+			{
+				if (instance_id >= instances.size())
+					return;
+
+				instances[instance_id++].transform = GetInstanceTransform(render_scene, primitive, model.transforms[i]);
+			}
+		}
+	}
+
+	// Generator references transforms of instances above, so it writes new ones into instance descriptors.
+	// Descriptors of this frame were last read by the frame which had the same back buffer, it is finished before this one is recorded.
+	GpuBuffer& instance_descs = tlas_instance_descs[frame_index % tlas_instance_descs.size()];
+
+	tlas_generator.Generate(command_list.get(), tlas_buffers.scratch, tlas_buffers.result, instance_descs, true, tlas_buffers.result.Resource());
+}
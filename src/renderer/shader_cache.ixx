@@ -0,0 +1,819 @@
+export module renderer.shader_cache;
+
+import std;
+import system.content_hash;
+import system.logger;
+
+export namespace ysn
+{
+	using ShaderHash = std::size_t;
+	using ShaderDigest = Hash128;
+	using ShaderBytecode = std::vector<std::uint8_t>;
+
+	enum class ShaderType
+	{
+		Pixel,
+		Vertex,
+		Compute,
+		Library,
+		NotSpecified
+	};
+
+	class ShaderCompileParameters
+	{
+	public:
+		ShaderCompileParameters() = default;
+
+		ShaderCompileParameters(ShaderType type, std::wstring_view path, const std::set<std::wstring>& defines = {}) :
+			type(type), shader_path(path), defines(defines)
+		{
+		}
+
+		ShaderType type = ShaderType::NotSpecified;
+		std::wstring shader_path = L"";
+		std::wstring entry_point = L"main";
+		std::set<std::wstring> defines;
+		bool disable_optimizations = false;
+
+		bool operator==(const ShaderCompileParameters& p) const
+		{
+			static_assert(ysn::ShaderCompileParameters::VERSION == 1, "ShaderCompileParameters changed, fix comparation parameters");
+
+			return type == p.type && shader_path == p.shader_path && entry_point == p.entry_point && defines == p.defines &&
+				disable_optimizations == p.disable_optimizations;
+		}
+
+		// Bump version when changing any of the fields
+		constexpr static int VERSION = 1;
+
+	private:
+	};
+
+	// Length prefixed and ordered, so different parameters never serialize into the same bytes
+	void SerializeShaderCompileParameters(const ShaderCompileParameters& parameters, std::string& output);
+
+	std::wstring GetShaderProfile(ShaderType type);
+
+	// Compiler behind the cache, DXC on Windows, stub one can be used for testing cache anywhere
+	class ShaderCompiler
+	{
+	public:
+		virtual ~ShaderCompiler() = default;
+
+		// Part of the cache key, so compiler update invalidates every entry
+		virtual std::string GetVersion() const = 0;
+
+		// Called from several threads at once during parallel compilation
+		virtual std::optional<ShaderBytecode> Compile(const ShaderCompileParameters& parameters, const std::string& source, const std::wstring& profile) = 0;
+	};
+
+	// Runs function for every index in [0, count) and returns when all of them are done, engine passes its job system here
+	using ShaderCompileExecutor = std::function<void(std::uint32_t count, const std::function<void(std::uint32_t)>& function)>;
+
+	struct ShaderCacheStats
+	{
+		std::uint64_t memory_hits = 0;
+		std::uint64_t disk_hits = 0;
+		std::uint64_t misses = 0; // Compiled
+		std::uint64_t failures = 0;
+	};
+
+	// Compiled shaders addressed by 128 bit digest of source with whole include closure, defines, profile and compiler version.
+	// Changing any of those gives new digest, so entries are never updated in place and stale ones are removed on startup.
+	class ShaderCache
+	{
+	public:
+		ShaderCache(std::shared_ptr<ShaderCompiler> compiler,
+			std::filesystem::path cache_directory,
+			std::vector<std::filesystem::path> include_directories,
+			ShaderCompileExecutor executor = nullptr);
+
+		// Validates shaders used by previous runs, loads valid ones and compiles the rest in parallel
+		bool Initialize();
+
+		std::optional<ShaderDigest> ComputeDigest(const ShaderCompileParameters& parameters) const;
+
+		std::shared_ptr<const ShaderBytecode> GetOrCompile(const ShaderCompileParameters& parameters);
+
+		// Misses are compiled in parallel, result has nullptr for shaders which failed
+		std::vector<std::shared_ptr<const ShaderBytecode>> GetOrCompile(std::span<const ShaderCompileParameters> parameters);
+
+		ShaderCacheStats GetStats() const;
+
+		std::filesystem::path GetEntryPath(const ShaderDigest& digest) const;
+
+	private:
+		struct PendingShader
+		{
+			ShaderCompileParameters parameters;
+			ShaderDigest digest;
+			std::string source;
+		};
+
+		bool CollectSources(const std::filesystem::path& path, std::unordered_set<std::wstring>& visited, std::string& output) const;
+		std::optional<PendingShader> Prepare(const ShaderCompileParameters& parameters) const;
+
+		std::shared_ptr<const ShaderBytecode> FindInMemory(const ShaderDigest& digest);
+		std::shared_ptr<const ShaderBytecode> LoadEntry(const ShaderDigest& digest) const;
+		bool StoreEntry(const ShaderDigest& digest, const ShaderBytecode& bytecode) const;
+		std::shared_ptr<const ShaderBytecode> Compile(const PendingShader& shader);
+		void CompilePending(std::span<const PendingShader> shaders, std::span<std::shared_ptr<const ShaderBytecode>> results);
+
+		void AddToManifest(const ShaderCompileParameters& parameters);
+		bool LoadManifest();
+		bool SaveManifest();
+		void RemoveStaleEntries();
+
+		std::shared_ptr<ShaderCompiler> m_compiler;
+		ShaderCompileExecutor m_executor;
+		std::filesystem::path m_cache_directory;
+		std::vector<std::filesystem::path> m_include_directories;
+		std::string m_compiler_version;
+
+		mutable std::mutex m_mutex;
+		std::unordered_map<ShaderDigest, std::shared_ptr<const ShaderBytecode>> m_shaders;
+		std::vector<ShaderCompileParameters> m_manifest; // Everything requested so far, validated next startup
+		bool m_is_manifest_dirty = false;
+
+		std::atomic<std::uint64_t> m_memory_hits = 0;
+		std::atomic<std::uint64_t> m_disk_hits = 0;
+		std::atomic<std::uint64_t> m_misses = 0;
+		std::atomic<std::uint64_t> m_failures = 0;
+	};
+}
+
+export namespace std
+{
+	template <>
+	struct hash<ysn::ShaderCompileParameters>
+	{
+		std::size_t operator()(const ysn::ShaderCompileParameters& params) const
+		{
+			static_assert(ysn::ShaderCompileParameters::VERSION == 1, "ShaderCompileParameters changed, update the hash function");
+
+			std::string data;
+			ysn::SerializeShaderCompileParameters(params, data);
+
+			return static_cast<std::size_t>(ysn::HashBytes128(data.data(), data.size()).low);
+		}
+	};
+} // namespace std
+
+module :private;
+
+namespace ysn
+{
+	constexpr std::uint32_t g_entry_magic = 0x43485359; // YSHC
+	constexpr std::uint32_t g_manifest_magic = 0x4d485359; // YSHM
+	constexpr std::uint32_t g_cache_version = 1;
+
+	struct ShaderCacheEntryHeader
+	{
+		std::uint32_t magic = g_entry_magic;
+		std::uint32_t version = g_cache_version;
+		std::uint64_t bytecode_size = 0;
+		Hash128 digest;
+		Hash128 bytecode_hash;
+	};
+
+	static void AppendValue(std::string& output, std::uint64_t value)
+	{
+		output.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	static void AppendString(std::string& output, std::wstring_view value)
+	{
+		AppendValue(output, value.size());
+
+		// Fixed width code units, wchar_t size differs between platforms
+		for (const wchar_t character : value)
+		{
+			const std::uint32_t code_unit = static_cast<std::uint32_t>(character);
+			output.append(reinterpret_cast<const char*>(&code_unit), sizeof(code_unit));
+		}
+	}
+
+	static void AppendString(std::string& output, std::string_view value)
+	{
+		AppendValue(output, value.size());
+		output.append(value);
+	}
+
+	void SerializeShaderCompileParameters(const ShaderCompileParameters& parameters, std::string& output)
+	{
+		static_assert(ysn::ShaderCompileParameters::VERSION == 1, "ShaderCompileParameters changed, update serialization");
+
+		AppendValue(output, static_cast<std::uint64_t>(parameters.type));
+		AppendString(output, parameters.shader_path);
+		AppendString(output, parameters.entry_point);
+		AppendValue(output, parameters.disable_optimizations ? 1 : 0);
+		AppendValue(output, parameters.defines.size());
+
+		for (const std::wstring& define : parameters.defines)
+		{
+			AppendString(output, define);
+		}
+	}
+
+	class ByteReader
+	{
+	public:
+		explicit ByteReader(std::string_view data) : m_data(data)
+		{
+		}
+
+		bool ReadValue(std::uint64_t& value)
+		{
+			if (m_data.size() - m_offset < sizeof(value))
+				return false;
+
+			std::memcpy(&value, m_data.data() + m_offset, sizeof(value));
+			m_offset += sizeof(value);
+			return true;
+		}
+
+		bool ReadString(std::wstring& value)
+		{
+			std::uint64_t size = 0;
+
+			if (!ReadValue(size) || (m_data.size() - m_offset) / sizeof(std::uint32_t) < size)
+				return false;
+
+			value.resize(size);
+
+			for (wchar_t& character : value)
+			{
+				std::uint32_t code_unit = 0;
+				std::memcpy(&code_unit, m_data.data() + m_offset, sizeof(code_unit));
+				m_offset += sizeof(code_unit);
+
+				character = static_cast<wchar_t>(code_unit);
+			}
+
+			return true;
+		}
+
+		bool ReadParameters(ShaderCompileParameters& parameters)
+		{
+			std::uint64_t type = 0;
+			std::uint64_t disable_optimizations = 0;
+			std::uint64_t defines_count = 0;
+
+			if (!ReadValue(type) || !ReadString(parameters.shader_path) || !ReadString(parameters.entry_point) ||
+				!ReadValue(disable_optimizations) || !ReadValue(defines_count))
+				return false;
+
+			if (type >= static_cast<std::uint64_t>(ShaderType::NotSpecified))
+				return false;
+
+			parameters.type = static_cast<ShaderType>(type);
+			parameters.disable_optimizations = disable_optimizations != 0;
+			parameters.defines.clear();
+
+			for (std::uint64_t i = 0; i < defines_count; i++)
+			{
+				std::wstring define;
+
+				if (!ReadString(define))
+					return false;
+
+				parameters.defines.insert(define);
+			}
+
+			return true;
+		}
+
+	private:
+		std::string_view m_data;
+		std::size_t m_offset = 0;
+	};
+
+	static std::optional<std::string> ReadWholeFile(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+
+		if (!file.good())
+			return std::nullopt;
+
+		std::stringstream str_stream;
+		str_stream << file.rdbuf();
+		return str_stream.str();
+	}
+
+	// Written next to destination and renamed, so other process never sees half written file
+	static bool WriteWholeFile(const std::filesystem::path& path, std::span<const std::string_view> parts)
+	{
+		std::filesystem::path temp_path = path;
+		temp_path += std::format(".{}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+		{
+			std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+
+			if (!file.good())
+				return false;
+
+			for (const std::string_view part : parts)
+			{
+				file.write(part.data(), part.size());
+			}
+
+			if (!file.good())
+				return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temp_path, path, error);
+
+		if (error)
+		{
+			std::filesystem::remove(temp_path, error);
+			return false;
+		}
+
+		return true;
+	}
+
+	static std::optional<std::filesystem::path> ParseInclude(std::string_view line)
+	{
+		const std::size_t first = line.find_first_not_of(" \t");
+
+		if (first == std::string_view::npos || line[first] != '#')
+			return std::nullopt;
+
+		line.remove_prefix(first + 1);
+		line.remove_prefix(std::min(line.find_first_not_of(" \t"), line.size()));
+
+		if (!line.starts_with("include"))
+			return std::nullopt;
+
+		const std::size_t begin = line.find_first_of("\"<");
+
+		if (begin == std::string_view::npos)
+			return std::nullopt;
+
+		const std::size_t end = line.find(line[begin] == '"' ? '"' : '>', begin + 1);
+
+		if (end == std::string_view::npos)
+			return std::nullopt;
+
+		return std::filesystem::path(line.substr(begin + 1, end - begin - 1));
+	}
+
+	std::wstring GetShaderProfile(ShaderType type)
+	{
+		if (type == ShaderType::Library)
+			return L"lib_6_6";
+		else if (type == ShaderType::Pixel)
+			return L"ps_6_6";
+		else if (type == ShaderType::Vertex)
+			return L"vs_6_6";
+		else if (type == ShaderType::Compute)
+			return L"cs_6_6";
+
+		return L"";
+	}
+
+	ShaderCache::ShaderCache(std::shared_ptr<ShaderCompiler> compiler,
+		std::filesystem::path cache_directory,
+		std::vector<std::filesystem::path> include_directories,
+		ShaderCompileExecutor executor) :
+		m_compiler(std::move(compiler)),
+		m_executor(std::move(executor)),
+		m_cache_directory(std::move(cache_directory)),
+		m_include_directories(std::move(include_directories)),
+		m_compiler_version(m_compiler->GetVersion())
+	{
+	}
+
+	bool ShaderCache::Initialize()
+	{
+		std::error_code error;
+		std::filesystem::create_directories(m_cache_directory, error);
+
+		if (error)
+		{
+			LogError << "Can't create shader cache directory " << m_cache_directory.string() << "\n";
+			return false;
+		}
+
+		if (!LoadManifest())
+			return true;
+
+		const auto start_time = std::chrono::high_resolution_clock::now();
+
+		std::vector<PendingShader> pending;
+		std::vector<ShaderCompileParameters> valid_manifest;
+
+		for (const ShaderCompileParameters& parameters : m_manifest)
+		{
+			std::optional<PendingShader> shader = Prepare(parameters);
+
+			// Source is gone, forget about it
+			if (!shader.has_value())
+				continue;
+
+			valid_manifest.push_back(parameters);
+
+			if (std::shared_ptr<const ShaderBytecode> bytecode = LoadEntry(shader->digest))
+			{
+				m_disk_hits++;
+
+				std::scoped_lock lock(m_mutex);
+				m_shaders.emplace(shader->digest, std::move(bytecode));
+			}
+			else
+			{
+				pending.push_back(std::move(shader.value()));
+			}
+		}
+
+		{
+			std::scoped_lock lock(m_mutex);
+			m_is_manifest_dirty = valid_manifest.size() != m_manifest.size();
+			m_manifest = std::move(valid_manifest);
+		}
+
+		std::vector<std::shared_ptr<const ShaderBytecode>> results(pending.size());
+		CompilePending(pending, results);
+
+		RemoveStaleEntries();
+		SaveManifest();
+
+		const std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start_time;
+
+		LogInfo << "Shader cache validated " << std::to_string(m_manifest.size()) << " shaders, loaded " << std::to_string(m_disk_hits.load())
+				<< ", compiled " << std::to_string(m_misses.load()) << " in " << std::to_string(duration.count()) << " ms\n";
+
+		return true;
+	}
+
+	bool ShaderCache::CollectSources(const std::filesystem::path& path, std::unordered_set<std::wstring>& visited, std::string& output) const
+	{
+		const std::filesystem::path normalized_path = path.lexically_normal();
+
+		if (!visited.insert(normalized_path.wstring()).second)
+			return true;
+
+		const std::optional<std::string> source = ReadWholeFile(normalized_path);
+
+		if (!source.has_value())
+			return false;
+
+		AppendString(output, normalized_path.generic_wstring());
+		AppendString(output, source.value());
+
+		std::string_view remaining = source.value();
+
+		while (!remaining.empty())
+		{
+			const std::size_t line_end = std::min(remaining.find('\n'), remaining.size());
+			const std::optional<std::filesystem::path> include = ParseInclude(remaining.substr(0, line_end));
+			remaining.remove_prefix(std::min(line_end + 1, remaining.size()));
+
+			if (!include.has_value())
+				continue;
+
+			// Same search order as compiler, which gets shader path as source name and include directories as -I arguments
+			std::optional<std::filesystem::path> include_path;
+
+			if (std::filesystem::exists(normalized_path.parent_path() / include.value()))
+			{
+				include_path = normalized_path.parent_path() / include.value();
+			}
+			else
+			{
+				for (const std::filesystem::path& include_directory : m_include_directories)
+				{
+					if (std::filesystem::exists(include_directory / include.value()))
+					{
+						include_path = include_directory / include.value();
+						break;
+					}
+				}
+			}
+
+			// System headers guarded out of HLSL, name is enough to key them
+			if (!include_path.has_value())
+			{
+				AppendString(output, include->generic_wstring());
+				continue;
+			}
+
+			if (!CollectSources(include_path.value(), visited, output))
+				return false;
+		}
+
+		return true;
+	}
+
+	std::optional<ShaderCache::PendingShader> ShaderCache::Prepare(const ShaderCompileParameters& parameters) const
+	{
+		PendingShader shader;
+		shader.parameters = parameters;
+
+		std::optional<std::string> source = ReadWholeFile(parameters.shader_path);
+
+		if (!source.has_value())
+			return std::nullopt;
+
+		shader.source = std::move(source.value());
+
+		std::string key_data;
+		AppendValue(key_data, g_cache_version);
+		AppendString(key_data, m_compiler_version);
+		AppendString(key_data, GetShaderProfile(parameters.type));
+		SerializeShaderCompileParameters(parameters, key_data);
+
+		std::unordered_set<std::wstring> visited;
+
+		if (!CollectSources(parameters.shader_path, visited, key_data))
+			return std::nullopt;
+
+		shader.digest = HashBytes128(key_data.data(), key_data.size());
+
+		return shader;
+	}
+
+	std::optional<ShaderDigest> ShaderCache::ComputeDigest(const ShaderCompileParameters& parameters) const
+	{
+		const std::optional<PendingShader> shader = Prepare(parameters);
+
+		if (!shader.has_value())
+			return std::nullopt;
+
+		return shader->digest;
+	}
+
+	std::filesystem::path ShaderCache::GetEntryPath(const ShaderDigest& digest) const
+	{
+		return m_cache_directory / (digest.ToString() + ".dxil");
+	}
+
+	std::shared_ptr<const ShaderBytecode> ShaderCache::FindInMemory(const ShaderDigest& digest)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		if (const auto it = m_shaders.find(digest); it != m_shaders.end())
+			return it->second;
+
+		return nullptr;
+	}
+
+	std::shared_ptr<const ShaderBytecode> ShaderCache::LoadEntry(const ShaderDigest& digest) const
+	{
+		const std::optional<std::string> data = ReadWholeFile(GetEntryPath(digest));
+
+		if (!data.has_value())
+			return nullptr;
+
+		ShaderCacheEntryHeader header;
+
+		if (data->size() < sizeof(header))
+			return nullptr;
+
+		std::memcpy(&header, data->data(), sizeof(header));
+
+		if (header.magic != g_entry_magic || header.version != g_cache_version || header.digest != digest ||
+			header.bytecode_size != data->size() - sizeof(header))
+		{
+			LogError << "Shader cache entry " << digest.ToString() << " is invalid\n";
+			return nullptr;
+		}
+
+		if (HashBytes128(data->data() + sizeof(header), header.bytecode_size) != header.bytecode_hash)
+		{
+			LogError << "Shader cache entry " << digest.ToString() << " is corrupted\n";
+			return nullptr;
+		}
+
+		return std::make_shared<ShaderBytecode>(data->begin() + sizeof(header), data->end());
+	}
+
+	bool ShaderCache::StoreEntry(const ShaderDigest& digest, const ShaderBytecode& bytecode) const
+	{
+		ShaderCacheEntryHeader header;
+		header.bytecode_size = bytecode.size();
+		header.digest = digest;
+		header.bytecode_hash = HashBytes128(bytecode.data(), bytecode.size());
+
+		const std::string_view parts[] = { { reinterpret_cast<const char*>(&header), sizeof(header) },
+			{ reinterpret_cast<const char*>(bytecode.data()), bytecode.size() } };
+
+		return WriteWholeFile(GetEntryPath(digest), parts);
+	}
+
+	std::shared_ptr<const ShaderBytecode> ShaderCache::Compile(const PendingShader& shader)
+	{
+		std::optional<ShaderBytecode> bytecode = m_compiler->Compile(shader.parameters, shader.source, GetShaderProfile(shader.parameters.type));
+
+		if (!bytecode.has_value())
+		{
+			m_failures++;
+			return nullptr;
+		}
+
+		m_misses++;
+
+		if (!StoreEntry(shader.digest, bytecode.value()))
+		{
+			LogError << "Can't store shader cache entry " << shader.digest.ToString() << "\n";
+		}
+
+		auto result = std::make_shared<const ShaderBytecode>(std::move(bytecode.value()));
+
+		std::scoped_lock lock(m_mutex);
+		return m_shaders.try_emplace(shader.digest, std::move(result)).first->second;
+	}
+
+	void ShaderCache::CompilePending(std::span<const PendingShader> shaders, std::span<std::shared_ptr<const ShaderBytecode>> results)
+	{
+		if (m_executor && shaders.size() > 1)
+		{
+			m_executor(static_cast<std::uint32_t>(shaders.size()), [&](std::uint32_t i) { results[i] = Compile(shaders[i]); });
+		}
+		else
+		{
+			for (std::size_t i = 0; i < shaders.size(); i++)
+			{
+				results[i] = Compile(shaders[i]);
+			}
+		}
+	}
+
+	std::shared_ptr<const ShaderBytecode> ShaderCache::GetOrCompile(const ShaderCompileParameters& parameters)
+	{
+		return GetOrCompile(std::span<const ShaderCompileParameters>(&parameters, 1)).front();
+	}
+
+	std::vector<std::shared_ptr<const ShaderBytecode>> ShaderCache::GetOrCompile(std::span<const ShaderCompileParameters> parameters)
+	{
+		std::vector<std::shared_ptr<const ShaderBytecode>> results(parameters.size());
+
+		std::vector<PendingShader> pending;
+		std::vector<std::size_t> pending_indices;
+
+		for (std::size_t i = 0; i < parameters.size(); i++)
+		{
+			std::optional<PendingShader> shader = Prepare(parameters[i]);
+
+			if (!shader.has_value())
+			{
+				LogError << "Can't read shader sources for cache key\n";
+				m_failures++;
+				continue;
+			}
+
+			AddToManifest(parameters[i]);
+
+			if ((results[i] = FindInMemory(shader->digest)))
+			{
+				m_memory_hits++;
+			}
+			else if ((results[i] = LoadEntry(shader->digest)))
+			{
+				m_disk_hits++;
+
+				std::scoped_lock lock(m_mutex);
+				m_shaders.try_emplace(shader->digest, results[i]);
+			}
+			else
+			{
+				pending.push_back(std::move(shader.value()));
+				pending_indices.push_back(i);
+			}
+		}
+
+		std::vector<std::shared_ptr<const ShaderBytecode>> compiled(pending.size());
+		CompilePending(pending, compiled);
+
+		for (std::size_t i = 0; i < pending.size(); i++)
+		{
+			results[pending_indices[i]] = compiled[i];
+		}
+
+		SaveManifest();
+
+		return results;
+	}
+
+	ShaderCacheStats ShaderCache::GetStats() const
+	{
+		return { .memory_hits = m_memory_hits, .disk_hits = m_disk_hits, .misses = m_misses, .failures = m_failures };
+	}
+
+	void ShaderCache::AddToManifest(const ShaderCompileParameters& parameters)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		if (std::ranges::find(m_manifest, parameters) == m_manifest.end())
+		{
+			m_manifest.push_back(parameters);
+			m_is_manifest_dirty = true;
+		}
+	}
+
+	bool ShaderCache::LoadManifest()
+	{
+		const std::optional<std::string> data = ReadWholeFile(m_cache_directory / "manifest.bin");
+
+		if (!data.has_value())
+			return false;
+
+		ByteReader reader(data.value());
+
+		std::uint64_t magic = 0;
+		std::uint64_t version = 0;
+		std::uint64_t count = 0;
+
+		if (!reader.ReadValue(magic) || !reader.ReadValue(version) || !reader.ReadValue(count) || magic != g_manifest_magic ||
+			version != g_cache_version)
+		{
+			LogError << "Shader cache manifest is invalid, starting from scratch\n";
+			return false;
+		}
+
+		std::vector<ShaderCompileParameters> manifest;
+
+		for (std::uint64_t i = 0; i < count; i++)
+		{
+			ShaderCompileParameters parameters;
+
+			if (!reader.ReadParameters(parameters))
+			{
+				LogError << "Shader cache manifest is truncated\n";
+				break;
+			}
+
+			manifest.push_back(std::move(parameters));
+		}
+
+		std::scoped_lock lock(m_mutex);
+		m_manifest = std::move(manifest);
+
+		return true;
+	}
+
+	bool ShaderCache::SaveManifest()
+	{
+		std::string data;
+
+		{
+			std::scoped_lock lock(m_mutex);
+
+			if (!m_is_manifest_dirty)
+				return true;
+
+			AppendValue(data, g_manifest_magic);
+			AppendValue(data, g_cache_version);
+			AppendValue(data, m_manifest.size());
+
+			for (const ShaderCompileParameters& parameters : m_manifest)
+			{
+				SerializeShaderCompileParameters(parameters, data);
+			}
+
+			m_is_manifest_dirty = false;
+		}
+
+		const std::string_view parts[] = { data };
+
+		if (!WriteWholeFile(m_cache_directory / "manifest.bin", parts))
+		{
+			LogError << "Can't write shader cache manifest\n";
+			return false;
+		}
+
+		return true;
+	}
+
+	void ShaderCache::RemoveStaleEntries()
+	{
+		std::unordered_set<std::filesystem::path::string_type> used_entries;
+
+		{
+			std::scoped_lock lock(m_mutex);
+
+			for (const auto& [digest, bytecode] : m_shaders)
+			{
+				used_entries.insert(GetEntryPath(digest).filename().native());
+			}
+		}
+
+		std::error_code error;
+		std::uint32_t removed_count = 0;
+
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(m_cache_directory, error))
+		{
+			if (entry.path().extension() == ".dxil" && !used_entries.contains(entry.path().filename().native()))
+			{
+				std::filesystem::remove(entry.path(), error);
+				removed_count++;
+			}
+		}
+
+		if (removed_count)
+		{
+			LogInfo << "Shader cache removed " << std::to_string(removed_count) << " stale entries\n";
+		}
+	}
+}
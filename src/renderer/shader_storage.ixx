@@ -24,50 +24,11 @@ import system.string_helpers;
 import system.filesystem;
 import system.logger;
 import system.asserts;
+import system.job_system;
+export import renderer.shader_cache;
 
 export namespace ysn
 {
-	using ShaderHash = std::size_t;
-
-	enum class ShaderType
-	{
-		Pixel,
-		Vertex,
-		Compute,
-		Library,
-		NotSpecified
-	};
-
-	class ShaderCompileParameters
-	{
-	public:
-		ShaderCompileParameters() = default;
-
-		ShaderCompileParameters(ShaderType type, std::wstring_view path, const std::set<std::wstring>& defines = {}) :
-			type(type), shader_path(path), defines(defines)
-		{
-		}
-
-		ShaderType type = ShaderType::NotSpecified;
-		std::wstring shader_path = L"";
-		std::wstring entry_point = L"main";
-		std::set<std::wstring> defines;
-		bool disable_optimizations = false;
-
-		bool operator==(const ShaderCompileParameters& p) const
-		{
-			static_assert(ysn::ShaderCompileParameters::VERSION == 1, "ShaderCompileParameters changed, fix comparation parameters");
-
-			return type == p.type && shader_path == p.shader_path && entry_point == p.entry_point && defines == p.defines &&
-				disable_optimizations == p.disable_optimizations;
-		}
-
-		// Bump version when changing any of the fields
-		constexpr static int VERSION = 1;
-
-	private:
-	};
-
 	class ShaderModificationData
 	{
 	public:
@@ -83,21 +44,44 @@ export namespace ysn
 		std::time_t modification_time;
 	};
 
+	// Compiles with DXC, safe to use from several threads because every compilation has its own DXC instances
+	class DxcShaderCompiler : public ShaderCompiler
+	{
+	public:
+		bool Initialize(const std::wstring& debug_data_path, std::span<const std::filesystem::path> include_directories);
+
+		std::string GetVersion() const override;
+		std::optional<ShaderBytecode> Compile(const ShaderCompileParameters& parameters, const std::string& source, const std::wstring& profile) override;
+
+	private:
+		void StoreDebugData(IDxcResult* dxc_op_result);
+
+		std::string m_version;
+		std::wstring m_debug_data_path;
+		std::vector<std::wstring> m_include_directories;
+
+		bool m_treat_warnings_as_errors = false;
+	};
+
 	class ShaderStorage
 	{
 	public:
-		bool Initialize();
+		bool Initialize(std::shared_ptr<JobSystem> job_system);
 
 		std::optional<ShaderHash> CompileShader(const ShaderCompileParameters& parameters);
+
+		// Shaders missing in cache are compiled in parallel
+		std::optional<std::vector<ShaderHash>> CompileShaders(std::span<const ShaderCompileParameters> parameters);
+
 		std::optional<wil::com_ptr<IDxcBlob>> GetShader(ShaderHash shader_hash);
 		bool RemoveShader(ShaderHash shader_hash);
 
+		ShaderCacheStats GetCacheStats() const;
+
 		std::vector<ShaderModificationData> VerifyAnyShaderChanged();
 	private:
 		uint64_t shader_cache_hits = 0;
 
-		std::wstring GetShaderProfile(ShaderType type) const;
-
 		std::unordered_map<ShaderHash, wil::com_ptr<IDxcBlob>> m_compiled_shaders;
 
 		std::optional<std::time_t> GetShaderModificationTime(const std::filesystem::path& shader_path);
@@ -106,43 +90,13 @@ export namespace ysn
 		std::wstring m_debug_data_path = L"ShadersDebugData";
 		std::wstring m_binary_data_path = L"ShadersBinaryData";
 
-		bool m_treat_warnings_as_errors = false;
+		std::unique_ptr<ShaderCache> m_shader_cache;
 
 		wil::com_ptr<IDxcUtils> m_dxc_utils;
-		wil::com_ptr<IDxcCompiler3> m_dxc_compiler;
-		wil::com_ptr<IDxcIncludeHandler> m_dxc_include_handler;
-		std::vector<wil::com_ptr<IDxcBlob>> m_dxc_included_files;
 	};
 
 }
 
-export namespace std
-{
-	template <>
-	struct hash<ysn::ShaderCompileParameters>
-	{
-		std::size_t operator()(const ysn::ShaderCompileParameters& params) const
-		{
-			static_assert(ysn::ShaderCompileParameters::VERSION == 1, "ShaderCompileParameters changed, update the hash function");
-
-			std::size_t seed = 0;
-
-			seed ^= std::hash<int>{}((int)params.type);
-
-			for (const auto& define : params.defines)
-			{
-				seed ^= std::hash<std::wstring>{}(define) << 1;
-			}
-
-			seed ^= std::hash<std::wstring>{}(params.shader_path) << 2;
-			seed ^= std::hash<std::wstring>{}(params.entry_point) << 3;
-			seed ^= std::hash<bool>{}(params.disable_optimizations) << 4;
-
-			return seed;
-		}
-	};
-} // namespace std
-
 module :private;
 
 namespace ysn
@@ -180,118 +134,96 @@ namespace ysn
 //	std::unordered_set<std::string> IncludedFiles;
 //};
 
-	bool ShaderStorage::Initialize()
+	static std::filesystem::path GetExecutableDirectory()
+	{
+		char buffer[MAX_PATH];
+		GetModuleFileNameA(nullptr, buffer, MAX_PATH);
+
+		return std::filesystem::path(buffer).parent_path();
+	}
+
+	bool DxcShaderCompiler::Initialize(const std::wstring& debug_data_path, std::span<const std::filesystem::path> include_directories)
 	{
-		if (auto result = DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(m_dxc_compiler.addressof())); result != S_OK)
+		wil::com_ptr<IDxcCompiler3> dxc_compiler;
+
+		if (auto result = DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(dxc_compiler.addressof())); result != S_OK)
 		{
 			LogError << "Can't create dxc compiler\n";
 			return false;
 		}
 
-		if (auto result = DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(m_dxc_utils.addressof())); result != S_OK)
-		{
-			LogError << "Can't create dxc utils\n";
-			return false;
-		}
+		m_version = "dxc";
 
-		// Some common include files
+		if (wil::com_ptr<IDxcVersionInfo> version_info = dxc_compiler.try_query<IDxcVersionInfo>())
 		{
-			HRESULT hr = m_dxc_utils->CreateDefaultIncludeHandler(m_dxc_include_handler.addressof());
-
-			if (hr != S_OK)
-			{
-				LogError << "Can't create include handler\n";
-				return false;
-			}
-
-			{
-				wil::com_ptr<IDxcBlob> new_included_file;
-
-				const std::wstring shared_path = ysn::VfsPath(L"shaders/include/shared.hlsl");
-				hr = m_dxc_include_handler->LoadSource(shared_path.c_str(), new_included_file.addressof());
-
-				if (hr != S_OK)
-				{
-					LogError << "Can't load shaders/include/shared.hlsl\n";
-					return false;
-				}
-
-				m_dxc_included_files.push_back(new_included_file);
-			}
-
-
-			{
-				wil::com_ptr<IDxcBlob> new_included_file;
-
-				const std::wstring shared_path = ysn::VfsPath(L"shaders/include/brdf.hlsl");
-				hr = m_dxc_include_handler->LoadSource(shared_path.c_str(), new_included_file.addressof());
+			UINT32 major = 0;
+			UINT32 minor = 0;
+			version_info->GetVersion(&major, &minor);
 
-				if (hr != S_OK)
-				{
-					LogError << "Can't load shaders/include/brdf.hlsl\n";
-					return false;
-				}
+			m_version += std::format(" {}.{}", major, minor);
+		}
 
-				m_dxc_included_files.push_back(new_included_file);
-			}
+		if (wil::com_ptr<IDxcVersionInfo2> version_info = dxc_compiler.try_query<IDxcVersionInfo2>())
+		{
+			UINT32 commit_count = 0;
+			char* commit_hash = nullptr;
 
+			if (SUCCEEDED(version_info->GetCommitInfo(&commit_count, &commit_hash)))
 			{
-				wil::com_ptr<IDxcBlob> new_included_file;
-
-				const std::wstring shared_path = ysn::VfsPath(L"shaders/include/shader_structs.h");
-				hr = m_dxc_include_handler->LoadSource(shared_path.c_str(), new_included_file.addressof());
-
-				if (hr != S_OK)
-				{
-					LogError << "Can't load shaders/include/shader_structs.h\n";
-					return false;
-				}
-
-				m_dxc_included_files.push_back(new_included_file);
+				m_version += std::format(" {} {}", commit_count, commit_hash);
+				CoTaskMemFree(commit_hash);
 			}
 		}
 
-		return true;
-	}
+		// Flags which are not part of compile parameters change output too
+		m_version += std::format(" WX {}", m_treat_warnings_as_errors);
 
-	std::optional<wil::com_ptr<IDxcBlob>> ShaderStorage::GetShader(ShaderHash shader_hash)
-	{
-		if (m_compiled_shaders.contains(shader_hash))
+		m_debug_data_path = debug_data_path;
+
+		for (const std::filesystem::path& include_directory : include_directories)
 		{
-			return m_compiled_shaders[shader_hash];
+			m_include_directories.push_back(include_directory.wstring());
 		}
 
-		return std::nullopt;
+		LogInfo << "Shader compiler: " << m_version << "\n";
+
+		return true;
 	}
 
-	bool ShaderStorage::RemoveShader(ShaderHash shader_hash)
+	std::string DxcShaderCompiler::GetVersion() const
 	{
-		m_compiled_shaders.erase(shader_hash);
-		return true;
+		return m_version;
 	}
 
-	std::optional<ShaderHash> ShaderStorage::CompileShader(const ShaderCompileParameters& parameters)
+	std::optional<ShaderBytecode> DxcShaderCompiler::Compile(const ShaderCompileParameters& parameters, const std::string& source, const std::wstring& profile)
 	{
-		std::filesystem::path fullpath(parameters.shader_path);
+		LogInfo << "Compiling shader: " << WStringToString(parameters.shader_path) << "\n";
 
-		const std::hash<ShaderCompileParameters> hasher;
-		const ShaderHash shader_hash = hasher(parameters);
+		// DXC objects aren't thread safe
+		wil::com_ptr<IDxcCompiler3> dxc_compiler;
+		wil::com_ptr<IDxcUtils> dxc_utils;
+		wil::com_ptr<IDxcIncludeHandler> dxc_include_handler;
 
-		if (m_compiled_shaders.contains(shader_hash))
+		if (auto result = DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(dxc_compiler.addressof())); result != S_OK)
 		{
-			LogInfo << "Shader cache hit: " << fullpath.string().c_str() << "\n";
-			shader_cache_hits += 1;
-			return shader_hash;
+			LogError << "Can't create dxc compiler\n";
+			return std::nullopt;
 		}
 
-		const std::wstring filename = fullpath.filename();
+		if (auto result = DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(dxc_utils.addressof())); result != S_OK)
+		{
+			LogError << "Can't create dxc utils\n";
+			return std::nullopt;
+		}
 
-		LogInfo << "Compiling shader: " << fullpath.string().c_str() << "\n";
+		if (auto result = dxc_utils->CreateDefaultIncludeHandler(dxc_include_handler.addressof()); result != S_OK)
+		{
+			LogError << "Can't create include handler\n";
+			return std::nullopt;
+		}
 
 		std::vector<LPCWSTR> arguments;
 
-		const std::wstring shader_profile = GetShaderProfile(parameters.type);
-
 		if (!parameters.disable_optimizations)
 		{
 			arguments.push_back(DXC_ARG_DEBUG);
@@ -308,12 +240,19 @@ namespace ysn
 		arguments.push_back(L"-E");
 		arguments.push_back(parameters.entry_point.c_str());
 
-		// Shaders include dir
-		arguments.push_back(L"-I shaders/include");
+		// Source buffer is unnamed, name makes includes relative to shader file resolve like shader cache does
+		arguments.push_back(parameters.shader_path.c_str());
+
+		// Searched after shader file directory
+		for (const std::wstring& include_directory : m_include_directories)
+		{
+			arguments.push_back(L"-I");
+			arguments.push_back(include_directory.c_str());
+		}
 
 		// Profile
 		arguments.push_back(L"-T");
-		arguments.push_back(shader_profile.c_str());
+		arguments.push_back(profile.c_str());
 
 		// Defines
 		for (const std::wstring& define : parameters.defines)
@@ -326,39 +265,18 @@ namespace ysn
 		//arguments.push_back(L"-Qstrip_debug");
 		//arguments.push_back(L"-Qstrip_reflect");
 
-		std::ifstream shader_file(parameters.shader_path);
-		if (shader_file.good() == false)
-		{
-			LogError << "Cannot find shader file :" << WStringToString(parameters.shader_path) << "\n";
-			return std::nullopt;
-		}
-
-		std::stringstream str_stream;
-		str_stream << shader_file.rdbuf();
-		std::string shader_code = str_stream.str();
-
-		wil::com_ptr<IDxcBlobEncoding> dxc_text_blob;
-
-		if (auto result = m_dxc_utils->CreateBlob(
-			shader_code.c_str(), static_cast<uint32_t>(shader_code.size()), CP_UTF8, dxc_text_blob.addressof());
-			result != S_OK)
-		{
-			LogError << "Can't create shader blob\n";
-			return std::nullopt;
-		}
-
 		DxcBuffer source_buffer;
-		source_buffer.Ptr = dxc_text_blob->GetBufferPointer();
-		source_buffer.Size = dxc_text_blob->GetBufferSize();
+		source_buffer.Ptr = source.data();
+		source_buffer.Size = source.size();
 		source_buffer.Encoding = DXC_CP_UTF8;
 
 		IDxcResult* dxc_op_result; // TODO: Make this wil_comptr and result would be corrupted -> investigate
 
-		if (auto result = m_dxc_compiler->Compile(
+		if (auto result = dxc_compiler->Compile(
 			&source_buffer,
 			arguments.data(),
 			static_cast<uint32_t>(arguments.size()),
-			m_dxc_include_handler.get(),
+			dxc_include_handler.get(),
 			__uuidof(IDxcResult),
 			(void**)&dxc_op_result);
 			result != S_OK)
@@ -393,7 +311,7 @@ namespace ysn
 			std::string error_msg = "Shader Compiler Error: ";
 			error_msg.append(info_log.data());
 
-			LogError << "Failed compile shader\n" << error_msg.c_str() << "\n";
+			LogError << "Failed compile shader " << WStringToString(parameters.shader_path) << "\n" << error_msg.c_str() << "\n";
 			return std::nullopt;
 		}
 
@@ -406,6 +324,15 @@ namespace ysn
 			return std::nullopt;
 		}
 
+		StoreDebugData(dxc_op_result);
+
+		const std::uint8_t* shader_bytes = static_cast<const std::uint8_t*>(shader_data->GetBufferPointer());
+
+		return ShaderBytecode(shader_bytes, shader_bytes + shader_data->GetBufferSize());
+	}
+
+	void DxcShaderCompiler::StoreDebugData(IDxcResult* dxc_op_result)
+	{
 		wil::com_ptr<IDxcBlob> shader_debug_data;
 		wil::com_ptr<IDxcBlobUtf16> shader_debug_data_path;
 		if (auto result =
@@ -413,23 +340,12 @@ namespace ysn
 			FAILED(result))
 		{
 			LogError << "Can't get shader blob DXC_OUT_PDB\n";
-			return std::nullopt;
+			return;
 		}
 
 		if (shader_debug_data && shader_debug_data_path)
 		{
-			char buffer[MAX_PATH];
-			GetModuleFileNameA(nullptr, buffer, MAX_PATH);
-
-			std::string executable_path(buffer);
-			std::string directory_path = executable_path.substr(0, executable_path.find_last_of("\\/"));
-
-			std::filesystem::path executable_dir(directory_path);
-
-			std::wstring pdb_path;
-			pdb_path.append(executable_dir.wstring());
-			pdb_path.append(L"\\");
-			pdb_path.append(m_debug_data_path);
+			std::wstring pdb_path = m_debug_data_path;
 
 			if (CreateDirectoryIfNotExists(pdb_path))
 			{
@@ -456,75 +372,152 @@ namespace ysn
 				LogError << "Can't create pdb storage directory \n";
 			}
 		}
+	}
 
-		// Read reflection data
-		wil::com_ptr<IDxcBlob> reflection_data;
-		if (auto result = dxc_op_result->GetOutput(DXC_OUT_REFLECTION, IID_PPV_ARGS(reflection_data.addressof()), nullptr); FAILED(result))
+	bool ShaderStorage::Initialize(std::shared_ptr<JobSystem> job_system)
+	{
+		if (auto result = DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(m_dxc_utils.addressof())); result != S_OK)
 		{
-			LogError << "Can't get shader blob DXC_OUT_REFLECTION\n";
-			return std::nullopt;
+			LogError << "Can't create dxc utils\n";
+			return false;
 		}
 
-		// Not using it right now but can be handy in the future
-		DxcBuffer reflection_buffer;
-		reflection_buffer.Ptr = reflection_data->GetBufferPointer();
-		reflection_buffer.Size = reflection_data->GetBufferSize();
-		reflection_buffer.Encoding = 0;
-		wil::com_ptr<ID3D12ShaderReflection> shader_reflection;
-		m_dxc_utils->CreateReflection(&reflection_buffer, IID_PPV_ARGS(shader_reflection.addressof()));
-
-	// Read shader hash, currently we not really need it
-	#if 0
-		wil::com_ptr<IDxcBlob> hash;
-		if (auto result = dxc_op_result->GetOutput(DXC_OUT_SHADER_HASH, IID_PPV_ARGS(hash.addressof()), nullptr); FAILED(result))
-		{
-			LogError << "Can't get shader blob DXC_OUT_SHADER_HASH\n";
-			return std::nullopt;
-		}
+		const std::vector<std::filesystem::path> include_directories = { VfsPath(L"shaders/include") };
 
-		DxcShaderHash* hash_buffer = (DxcShaderHash*)hash->GetBufferPointer();
-		std::vector<uint8_t> hash_vec;
-		for (int i = 0; i < _countof(hash_buffer->HashDigest); i++)
+		auto compiler = std::make_shared<DxcShaderCompiler>();
+
+		if (!compiler->Initialize((GetExecutableDirectory() / m_debug_data_path).wstring(), include_directories))
 		{
-			hash_vec.push_back(hash_buffer->HashDigest[i]);
+			LogError << "Can't initialize shader compiler\n";
+			return false;
 		}
-	#endif
 
-		m_compiled_shaders.emplace(shader_hash, shader_data);
+		ShaderCompileExecutor executor;
 
-	#ifndef YSN_RELEASE
+		if (job_system)
+		{
+			executor = [job_system](std::uint32_t count, const std::function<void(std::uint32_t)>& function) { job_system->ParallelFor(count, 1, function); };
+		}
 
-		const auto shader_modification_time = GetShaderModificationTime(parameters.shader_path);
+		m_shader_cache = std::make_unique<ShaderCache>(compiler, GetExecutableDirectory() / m_binary_data_path, include_directories, std::move(executor));
 
-		if (shader_modification_time.has_value())
+		if (!m_shader_cache->Initialize())
 		{
-			ShaderModificationData data(shader_hash, parameters, shader_modification_time.value());
-			m_shaders_modified_data[parameters.shader_path] = data;
+			LogError << "Can't initialize shader cache\n";
+			return false;
 		}
-		else
+
+		return true;
+	}
+
+	std::optional<wil::com_ptr<IDxcBlob>> ShaderStorage::GetShader(ShaderHash shader_hash)
+	{
+		if (m_compiled_shaders.contains(shader_hash))
 		{
-			LogError << "Can't get shader modification time: " << WStringToString(parameters.shader_path) << "\n";
+			return m_compiled_shaders[shader_hash];
 		}
 
-	#endif
+		return std::nullopt;
+	}
+
+	bool ShaderStorage::RemoveShader(ShaderHash shader_hash)
+	{
+		m_compiled_shaders.erase(shader_hash);
+		return true;
+	}
+
+	ShaderCacheStats ShaderStorage::GetCacheStats() const
+	{
+		ShaderCacheStats stats = m_shader_cache->GetStats();
+		stats.memory_hits += shader_cache_hits;
+
+		return stats;
+	}
+
+	std::optional<ShaderHash> ShaderStorage::CompileShader(const ShaderCompileParameters& parameters)
+	{
+		const auto shader_hashes = CompileShaders(std::span<const ShaderCompileParameters>(&parameters, 1));
+
+		if (!shader_hashes.has_value())
+			return std::nullopt;
 
-		return shader_hash;
+		return shader_hashes->front();
 	}
 
-	std::wstring ShaderStorage::GetShaderProfile(ShaderType type) const
+	std::optional<std::vector<ShaderHash>> ShaderStorage::CompileShaders(std::span<const ShaderCompileParameters> parameters)
 	{
-		if (type == ShaderType::Library)
-			return L"lib_6_6";
-		else if (type == ShaderType::Pixel)
-			return L"ps_6_6";
-		else if (type == ShaderType::Vertex)
-			return L"vs_6_6";
-		else if (type == ShaderType::Compute)
-			return L"cs_6_6";
-		else
-			AssertMsg(false, "ShaderProfile type is not specified");
-
-		return L"";
+		const std::hash<ShaderCompileParameters> hasher;
+
+		std::vector<ShaderHash> shader_hashes;
+		std::vector<ShaderCompileParameters> missing_shaders;
+
+		for (const ShaderCompileParameters& shader_parameters : parameters)
+		{
+			const ShaderHash shader_hash = hasher(shader_parameters);
+
+			if (m_compiled_shaders.contains(shader_hash))
+			{
+				shader_cache_hits += 1;
+			}
+			else
+			{
+				missing_shaders.push_back(shader_parameters);
+			}
+
+			shader_hashes.push_back(shader_hash);
+		}
+
+		const auto compiled_shaders = m_shader_cache->GetOrCompile(missing_shaders);
+
+		bool is_succeeded = true;
+
+		for (std::size_t i = 0; i < missing_shaders.size(); i++)
+		{
+			const ShaderCompileParameters& shader_parameters = missing_shaders[i];
+
+			if (!compiled_shaders[i])
+			{
+				LogError << "Can't compile shader " << WStringToString(shader_parameters.shader_path) << "\n";
+				is_succeeded = false;
+				continue;
+			}
+
+			wil::com_ptr<IDxcBlobEncoding> shader_blob;
+
+			if (auto result = m_dxc_utils->CreateBlob(
+				compiled_shaders[i]->data(), static_cast<uint32_t>(compiled_shaders[i]->size()), 0, shader_blob.addressof());
+				result != S_OK)
+			{
+				LogError << "Can't create shader blob\n";
+				is_succeeded = false;
+				continue;
+			}
+
+			const ShaderHash shader_hash = hasher(shader_parameters);
+
+			m_compiled_shaders.emplace(shader_hash, shader_blob);
+
+		#ifndef YSN_RELEASE
+
+			const auto shader_modification_time = GetShaderModificationTime(shader_parameters.shader_path);
+
+			if (shader_modification_time.has_value())
+			{
+				ShaderModificationData data(shader_hash, shader_parameters, shader_modification_time.value());
+				m_shaders_modified_data[shader_parameters.shader_path] = data;
+			}
+			else
+			{
+				LogError << "Can't get shader modification time: " << WStringToString(shader_parameters.shader_path) << "\n";
+			}
+
+		#endif
+		}
+
+		if (!is_succeeded)
+			return std::nullopt;
+
+		return shader_hashes;
 	}
 
 #ifndef YSN_RELEASE
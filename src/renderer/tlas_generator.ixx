@@ -74,7 +74,8 @@ namespace ysn
 		device->GetRaytracingAccelerationStructurePrebuildInfo(&prebuildDesc, &info);
 
 		info.ResultDataMaxSizeInBytes = AlignPow2(info.ResultDataMaxSizeInBytes, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
-		info.ScratchDataSizeInBytes = AlignPow2(info.ScratchDataSizeInBytes, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+		// Same scratch buffer serves both builds and updates
+		info.ScratchDataSizeInBytes = AlignPow2(std::max(info.ScratchDataSizeInBytes, info.UpdateScratchDataSizeInBytes), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
 
 		m_result_size_in_bytes = info.ResultDataMaxSizeInBytes;
 		m_scratch_size_in_bytes = info.ScratchDataSizeInBytes;
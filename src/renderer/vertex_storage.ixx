@@ -2,6 +2,7 @@ module;
 
 #include <d3dx12.h>
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
 
 export module renderer.vertex_storage;
 
@@ -32,6 +33,39 @@ export namespace ysn
 		static std::vector<D3D12_INPUT_ELEMENT_DESC> GetVertexLayoutDesc();
 	};
 
+	enum class VertexFormat : uint8_t
+	{
+		Full,	 // Vertex
+		Compact, // CompactVertex
+	};
+
+	// 16 bytes, position is quantized to primitive bounds, normal is octahedral encoded and uv is half precision
+	struct CompactVertex
+	{
+		PackedVector::XMUSHORTN4 position; // w is unused
+		PackedVector::XMSHORTN2 normal;
+		PackedVector::XMHALF2 uv0;
+
+		static std::vector<D3D12_INPUT_ELEMENT_DESC> GetVertexLayoutDesc();
+	};
+	static_assert(sizeof(CompactVertex) == 16);
+
+	// Decoded position = position_offset + quantized_position * position_scale
+	struct PositionQuantization
+	{
+		XMFLOAT3 position_offset = { 0.0f, 0.0f, 0.0f };
+		XMFLOAT3 position_scale = { 1.0f, 1.0f, 1.0f };
+	};
+
+	PositionQuantization GetPositionQuantization(const XMFLOAT3& bbox_min, const XMFLOAT3& bbox_max);
+
+	void EncodeCompactVertices(std::span<const Vertex> vertices, const PositionQuantization& quantization, std::span<CompactVertex> result);
+	void DecodeCompactVertices(std::span<const CompactVertex> vertices, const PositionQuantization& quantization, std::span<Vertex> result);
+
+	uint32_t GetVertexStride(VertexFormat format);
+	std::vector<D3D12_INPUT_ELEMENT_DESC> GetVertexLayoutDesc(VertexFormat format);
+	std::set<std::wstring> GetVertexFormatDefines(VertexFormat format);
+
 	struct DebugRenderVertex
 	{
 		XMFLOAT3 position;
@@ -91,6 +125,127 @@ namespace ysn
 		return result;
 	}
 
+	std::vector<D3D12_INPUT_ELEMENT_DESC> CompactVertex::GetVertexLayoutDesc()
+	{
+		std::vector<D3D12_INPUT_ELEMENT_DESC> result;
+
+		result.push_back(
+			{ .SemanticName = "POSITION",
+			 .Format = DXGI_FORMAT_R16G16B16A16_UNORM,
+			 .AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT,
+			 .InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA });
+
+		result.push_back(
+			{ .SemanticName = "NORMAL",
+			 .Format = DXGI_FORMAT_R16G16_SNORM,
+			 .AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT,
+			 .InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA });
+
+		result.push_back(
+			{ .SemanticName = "TEXCOORD_",
+			 .SemanticIndex = 0,
+			 .Format = DXGI_FORMAT_R16G16_FLOAT,
+			 .AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT,
+			 .InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA });
+
+		return result;
+	}
+
+	PositionQuantization GetPositionQuantization(const XMFLOAT3& bbox_min, const XMFLOAT3& bbox_max)
+	{
+		const XMVECTOR min = XMLoadFloat3(&bbox_min);
+		const XMVECTOR extent = XMVectorSubtract(XMLoadFloat3(&bbox_max), min);
+
+		// Flat axis keeps unit scale, otherwise dequantization matrix becomes singular
+		const XMVECTOR scale = XMVectorSelect(extent, XMVectorSplatOne(), XMVectorLessOrEqual(extent, XMVectorZero()));
+
+		PositionQuantization result;
+		XMStoreFloat3(&result.position_offset, min);
+		XMStoreFloat3(&result.position_scale, scale);
+
+		return result;
+	}
+
+	void EncodeCompactVertices(std::span<const Vertex> vertices, const PositionQuantization& quantization, std::span<CompactVertex> result)
+	{
+		const XMVECTOR one = XMVectorSplatOne();
+		const XMVECTOR zero = XMVectorZero();
+		const XMVECTOR position_offset = XMLoadFloat3(&quantization.position_offset);
+		const XMVECTOR position_inv_scale = XMVectorReciprocal(XMLoadFloat3(&quantization.position_scale));
+
+		const std::size_t count = std::min(vertices.size(), result.size());
+
+		for (std::size_t i = 0; i < count; i++)
+		{
+			const Vertex& vertex = vertices[i];
+			CompactVertex& compact_vertex = result[i];
+
+			// Store saturates to [0, 1] and rounds to nearest
+			const XMVECTOR position = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&vertex.position), position_offset), position_inv_scale);
+			PackedVector::XMStoreUShortN4(&compact_vertex.position, XMVectorSelect(position, zero, g_XMSelect0001));
+
+			// Octahedral projection, lower hemisphere is folded over the diagonals
+			const XMVECTOR normal = XMLoadFloat3(&vertex.normal);
+			const XMVECTOR l1_norm = XMVectorMax(XMVector3Dot(XMVectorAbs(normal), one), g_XMEpsilon);
+			const XMVECTOR octahedron = XMVectorDivide(normal, l1_norm);
+
+			const XMVECTOR sign = XMVectorSelect(one, XMVectorNegate(one), XMVectorLess(octahedron, zero));
+			const XMVECTOR folded = XMVectorMultiply(XMVectorSubtract(one, XMVectorAbs(XMVectorSwizzle<1, 0, 2, 3>(octahedron))), sign);
+			const XMVECTOR encoded_normal = XMVectorSelect(octahedron, folded, XMVectorLess(XMVectorSplatZ(octahedron), zero));
+
+			PackedVector::XMStoreShortN2(&compact_vertex.normal, encoded_normal);
+			PackedVector::XMStoreHalf2(&compact_vertex.uv0, XMLoadFloat2(&vertex.uv0));
+		}
+	}
+
+	void DecodeCompactVertices(std::span<const CompactVertex> vertices, const PositionQuantization& quantization, std::span<Vertex> result)
+	{
+		const XMVECTOR zero = XMVectorZero();
+		const XMVECTOR position_offset = XMLoadFloat3(&quantization.position_offset);
+		const XMVECTOR position_scale = XMLoadFloat3(&quantization.position_scale);
+
+		const std::size_t count = std::min(vertices.size(), result.size());
+
+		for (std::size_t i = 0; i < count; i++)
+		{
+			const CompactVertex& compact_vertex = vertices[i];
+			Vertex& vertex = result[i];
+
+			const XMVECTOR position = PackedVector::XMLoadUShortN4(&compact_vertex.position);
+			XMStoreFloat3(&vertex.position, XMVectorMultiplyAdd(position, position_scale, position_offset));
+
+			// z = 1 - |x| - |y|, negative z means folded lower hemisphere
+			const XMVECTOR octahedron = PackedVector::XMLoadShortN2(&compact_vertex.normal);
+			const XMVECTOR octahedron_abs = XMVectorAbs(octahedron);
+			const XMVECTOR z = XMVectorSubtract(XMVectorSplatOne(), XMVectorAdd(XMVectorSplatX(octahedron_abs), XMVectorSplatY(octahedron_abs)));
+
+			const XMVECTOR fold = XMVectorMax(XMVectorNegate(z), zero);
+			const XMVECTOR unfolded = XMVectorAdd(octahedron, XMVectorSelect(fold, XMVectorNegate(fold), XMVectorGreaterOrEqual(octahedron, zero)));
+			const XMVECTOR normal = XMVectorSelect(z, unfolded, g_XMSelect1100);
+
+			XMStoreFloat3(&vertex.normal, XMVector3Normalize(normal));
+			XMStoreFloat2(&vertex.uv0, PackedVector::XMLoadHalf2(&compact_vertex.uv0));
+		}
+	}
+
+	uint32_t GetVertexStride(VertexFormat format)
+	{
+		return format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+	}
+
+	std::vector<D3D12_INPUT_ELEMENT_DESC> GetVertexLayoutDesc(VertexFormat format)
+	{
+		return format == VertexFormat::Compact ? CompactVertex::GetVertexLayoutDesc() : Vertex::GetVertexLayoutDesc();
+	}
+
+	std::set<std::wstring> GetVertexFormatDefines(VertexFormat format)
+	{
+		if (format == VertexFormat::Compact)
+			return { L"COMPACT_VERTICES" };
+
+		return {};
+	}
+
 	std::vector<D3D12_INPUT_ELEMENT_DESC> ysn::DebugRenderVertex::GetVertexLayoutDesc()
 	{
 		std::vector<D3D12_INPUT_ELEMENT_DESC> result;
@@ -26,6 +26,8 @@ import system.clock;
 import system.helpers;
 import system.asserts;
 import system.compilation;
+import system.job_system;
+import system.profiler;
 import external.implementaion;
 
 export namespace ysn
@@ -62,6 +64,7 @@ export namespace ysn
 		//std::shared_ptr<CommandQueue> GetCopyQueue() const;
 
 		std::shared_ptr<ysn::DxRenderer> GetRenderer() const;
+		std::shared_ptr<JobSystem> GetJobSystem() const;
 
 		void Flush();
 
@@ -76,6 +79,7 @@ export namespace ysn
 		HINSTANCE m_hInstance;
 
 		std::shared_ptr<ysn::DxRenderer> m_dx_renderer;
+		std::shared_ptr<JobSystem> m_job_system;
 
 		bool is_initialized = false;
 	};
@@ -291,9 +295,11 @@ namespace ysn
 			MessageBoxA(NULL, "Unable to register the window class.", "Error", MB_OK | MB_ICONERROR);
 		}
 
+		m_job_system = std::make_shared<JobSystem>();
+
 		m_dx_renderer = std::make_shared<ysn::DxRenderer>();
 
-		if (!m_dx_renderer->Initialize())
+		if (!m_dx_renderer->Initialize(m_job_system))
 		{
 			LogError << "Can't initialize renderer\n";
 			return;
@@ -326,6 +332,7 @@ namespace ysn
 			gs_pSingelton = nullptr;
 
 			LogInfo << "Shutting down application\n";
+			FlushLogger();
 		}
 	}
 
@@ -474,6 +481,11 @@ namespace ysn
 		return m_dx_renderer;
 	}
 
+	std::shared_ptr<JobSystem> Application::GetJobSystem() const
+	{
+		return m_job_system;
+	}
+
 	// Remove a window from our window lists.
 	static void RemoveWindow(HWND hWnd)
 	{
@@ -749,6 +761,8 @@ namespace ysn
 
 	void Window::OnUpdate(UpdateEventArgs&)
 	{
+		ScopedZone zone("Update");
+
 		m_UpdateClock.Tick();
 
 		if (auto pGame = m_game.lock())
@@ -766,9 +780,13 @@ namespace ysn
 
 		if (auto pGame = m_game.lock())
 		{
+			ScopedZone zone("Render");
+
 			RenderEventArgs renderEventArgs(m_RenderClock.GetDeltaSeconds(), m_RenderClock.GetTotalSeconds());
 			pGame->OnRender(renderEventArgs);
 		}
+
+		ProfilerFrameMark();
 	}
 
 	bool Window::OnResize(ResizeEventArgs& e)
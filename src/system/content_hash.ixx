@@ -0,0 +1,122 @@
+export module system.content_hash;
+
+import std;
+
+// Plain C++ without intrinsics, so tools and tests can address content the same way on any platform
+export namespace ysn
+{
+	struct Hash128
+	{
+		std::uint64_t low = 0;
+		std::uint64_t high = 0;
+
+		bool operator==(const Hash128& other) const = default;
+
+		std::string ToString() const
+		{
+			return std::format("{:016x}{:016x}", high, low);
+		}
+	};
+
+	// MurmurHash3 x64 128, strong enough for content addressing, not for security
+	inline Hash128 HashBytes128(const void* data, std::size_t size, std::uint64_t seed = 0)
+	{
+		constexpr std::uint64_t c1 = 0x87c37b91114253d5ull;
+		constexpr std::uint64_t c2 = 0x4cf5ad432745937full;
+
+		const auto fmix = [](std::uint64_t k) {
+			k ^= k >> 33;
+			k *= 0xff51afd7ed558ccdull;
+			k ^= k >> 33;
+			k *= 0xc4ceb9fe1a85ec53ull;
+			k ^= k >> 33;
+			return k;
+		};
+
+		const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+		const std::size_t blocks_count = size / 16;
+
+		std::uint64_t h1 = seed;
+		std::uint64_t h2 = seed;
+
+		for (std::size_t i = 0; i < blocks_count; i++)
+		{
+			std::uint64_t k1 = 0;
+			std::uint64_t k2 = 0;
+			std::memcpy(&k1, bytes + i * 16, 8);
+			std::memcpy(&k2, bytes + i * 16 + 8, 8);
+
+			k1 *= c1;
+			k1 = std::rotl(k1, 31);
+			k1 *= c2;
+			h1 ^= k1;
+
+			h1 = std::rotl(h1, 27);
+			h1 += h2;
+			h1 = h1 * 5 + 0x52dce729;
+
+			k2 *= c2;
+			k2 = std::rotl(k2, 33);
+			k2 *= c1;
+			h2 ^= k2;
+
+			h2 = std::rotl(h2, 31);
+			h2 += h1;
+			h2 = h2 * 5 + 0x38495ab5;
+		}
+
+		const std::uint8_t* tail = bytes + blocks_count * 16;
+		const std::size_t tail_size = size & 15;
+
+		std::uint64_t k1 = 0;
+		std::uint64_t k2 = 0;
+
+		for (std::size_t i = tail_size; i > 8; i--)
+			k2 ^= static_cast<std::uint64_t>(tail[i - 1]) << ((i - 9) * 8);
+
+		for (std::size_t i = std::min<std::size_t>(tail_size, 8); i > 0; i--)
+			k1 ^= static_cast<std::uint64_t>(tail[i - 1]) << ((i - 1) * 8);
+
+		if (tail_size > 8)
+		{
+			k2 *= c2;
+			k2 = std::rotl(k2, 33);
+			k2 *= c1;
+			h2 ^= k2;
+		}
+
+		if (tail_size > 0)
+		{
+			k1 *= c1;
+			k1 = std::rotl(k1, 31);
+			k1 *= c2;
+			h1 ^= k1;
+		}
+
+		h1 ^= size;
+		h2 ^= size;
+
+		h1 += h2;
+		h2 += h1;
+
+		h1 = fmix(h1);
+		h2 = fmix(h2);
+
+		h1 += h2;
+		h2 += h1;
+
+		return { .low = h1, .high = h2 };
+	}
+}
+
+export namespace std
+{
+	template <>
+	struct hash<ysn::Hash128>
+	{
+		std::size_t operator()(const ysn::Hash128& hash) const
+		{
+			return static_cast<std::size_t>(hash.low);
+		}
+	};
+}
@@ -11,6 +11,36 @@ export namespace ysn
 	bool DirectoryExists(const std::wstring_view path);
 	bool CreateDirectoryIfNotExists(const std::wstring_view path);
 	std::wstring VfsPath(const std::wstring_view path);
+
+	// Read-only view of a whole file mapped into the address space
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::wstring_view path);
+		void Close();
+
+		const std::uint8_t* Data() const
+		{
+			return m_data;
+		}
+
+		std::size_t Size() const
+		{
+			return m_size;
+		}
+
+	private:
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = nullptr;
+		const std::uint8_t* m_data = nullptr;
+		std::size_t m_size = 0;
+	};
 }
 
 namespace ysn
@@ -54,4 +84,72 @@ namespace ysn
 		wsource_dir += path;
 		return wsource_dir;
 	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool MappedFile::Open(const std::wstring_view path)
+	{
+		Close();
+
+		m_file = CreateFileW(std::wstring(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+		if (m_file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER file_size = {};
+
+		if (!GetFileSizeEx(m_file, &file_size) || file_size.QuadPart == 0)
+		{
+			Close();
+			return false;
+		}
+
+		m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (m_mapping == nullptr)
+		{
+			Close();
+			return false;
+		}
+
+		m_data = static_cast<const std::uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+
+		if (m_data == nullptr)
+		{
+			Close();
+			return false;
+		}
+
+		m_size = static_cast<std::size_t>(file_size.QuadPart);
+
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_data)
+		{
+			UnmapViewOfFile(m_data);
+			m_data = nullptr;
+		}
+
+		if (m_mapping)
+		{
+			CloseHandle(m_mapping);
+			m_mapping = nullptr;
+		}
+
+		if (m_file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_file);
+			m_file = INVALID_HANDLE_VALUE;
+		}
+
+		m_size = 0;
+	}
 }
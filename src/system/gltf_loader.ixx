@@ -6,6 +6,7 @@ module;
 #include <d3dx12.h>
 #include <wil/com.h>
 #include <tiny_gltf.h>
+#include <stb_image.h>
 
 #include <shader_structs.h>
 
@@ -13,7 +14,10 @@ export module system.gltf_loader;
 
 import std;
 import graphics.render_scene;
+import graphics.mesh;
 import graphics.primitive;
+import graphics.mesh_optimizer;
+import graphics.texture_cooker;
 import renderer.dx_renderer;
 import renderer.gpu_texture;
 import renderer.command_queue;
@@ -21,17 +25,36 @@ import renderer.dx_types;
 import system.string_helpers;
 import system.math;
 import system.application;
+import system.job_system;
 import system.logger;
 import system.asserts;
+import system.hash;
+import system.scene_cache;
 
 export namespace ysn
 {
 	struct LoadingParameters
 	{
 		DirectX::XMMATRIX model_modifier = DirectX::XMMatrixIdentity(); // Applies matrix modifier for nodes and RTX BVH generation
+		bool use_scene_cache = true; // Load cooked scene cache next to the GLTF if it is up to date, cook it otherwise
+		bool optimize_meshes = true; // Weld and reorder triangle list primitives, build their LOD chains
+		bool compress_textures = true; // Cook images into BC formats, cooked images are cached next to image files
+		MeshOptimizationParameters mesh_optimization;
 	};
 
 	bool LoadGltfFromFile(RenderScene& render_scene, const std::wstring& path, const LoadingParameters& loading_parameters);
+
+	// CPU part of the import only, primitives are converted and optimized on the job system and no GPU resources are created
+	std::optional<std::vector<Mesh>> ImportGltfMeshes(const std::wstring& path, const LoadingParameters& loading_parameters, JobSystem& job_system);
+
+	// Same CPU import with materials, samplers and node transforms, model has no textures and material texture indices point into GLTF images
+	std::optional<Model> ImportGltfModel(const std::wstring& path, const LoadingParameters& loading_parameters, JobSystem& job_system);
+
+	// Imports GLTF on CPU and writes scene cache next to it, images are only referenced by cache
+	bool CookGltfSceneCache(const std::wstring& path, const LoadingParameters& loading_parameters, JobSystem& job_system);
+
+	// Scene cache cooked with other parameters is stale
+	std::uint64_t HashLoadingParameters(const LoadingParameters& loading_parameters);
 }
 
 module :private;
@@ -44,6 +67,16 @@ struct LoadGltfContext
 	std::vector<wil::com_ptr<ID3D12Resource>> staging_resources;
 };
 
+// Staging memory of a texture, filled from job threads after texture is created
+struct TextureUpload
+{
+	uint8_t* upload_data = nullptr;
+	ysn::TextureUsage usage = ysn::TextureUsage::Unknown;
+	ysn::CookedTextureFormat format = ysn::CookedTextureFormat::Rgba8;
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints; // Per mip
+	std::vector<UINT> row_counts;
+};
+
 struct BuildMeshResult
 {
 	uint32_t mesh_indices_count = 0;
@@ -81,186 +114,394 @@ static DXGI_FORMAT GetSrgbFormat(DXGI_FORMAT format)
 	}
 }
 
-// TODO: Move to ColorBuffer
-// Compute the number of texture levels needed to reduce to 1x1.  This uses
-// _BitScanReverse to find the highest set bit.  Each dimension reduces by
-// half and truncates bits.  The dimension 256 (0x100) has 9 mip levels, same
-// as the dimension 511 (0x1FF).
-static inline uint32_t ComputeNumMips(uint32_t Width, uint32_t Height)
+static DXGI_FORMAT GetDxgiFormat(ysn::CookedTextureFormat format, bool is_srgb)
 {
-	uint32_t HighBit;
-	_BitScanReverse((unsigned long*)&HighBit, Width | Height);
-	return HighBit + 1;
+	DXGI_FORMAT dxgi_format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	switch (format)
+	{
+		case ysn::CookedTextureFormat::Bc1:
+			dxgi_format = DXGI_FORMAT_BC1_UNORM;
+			break;
+
+		case ysn::CookedTextureFormat::Bc5:
+			dxgi_format = DXGI_FORMAT_BC5_UNORM;
+			break;
+
+		case ysn::CookedTextureFormat::Bc7:
+			dxgi_format = DXGI_FORMAT_BC7_UNORM;
+			break;
+
+		default:
+			break;
+	}
+
+	return is_srgb ? GetSrgbFormat(dxgi_format) : dxgi_format;
 }
 
-void FindAllSrgbTextures(std::unordered_set<int>& srgb_textures, const tinygltf::Model& gltf_model)
+static bool IsExternalUri(const std::string& uri)
 {
-	for (const tinygltf::Material& gltf_material : gltf_model.materials)
+	return !uri.empty() && !uri.starts_with("data:");
+}
+
+// Role of every image in materials, decides its mip filtering and compression
+static std::vector<ysn::TextureUsage> FindTextureUsages(const tinygltf::Model& gltf_model)
+{
+	std::vector<ysn::TextureUsage> usages(gltf_model.images.size(), ysn::TextureUsage::Unknown);
+
+	const auto mark_usage = [&](int texture_index, ysn::TextureUsage usage)
 	{
-		const tinygltf::PbrMetallicRoughness& pbr_material = gltf_material.pbrMetallicRoughness;
+		if (texture_index < 0)
+			return;
 
-		const tinygltf::TextureInfo& base_color = pbr_material.baseColorTexture;
+		const int image_index = gltf_model.textures[texture_index].source;
 
-		if (base_color.index >= 0)
-		{
-			const tinygltf::Texture& texture = gltf_model.textures[base_color.index];
+		if (image_index < 0 || static_cast<size_t>(image_index) >= usages.size())
+			return;
 
-			if (srgb_textures.contains(texture.source))
-			{
-				ysn::LogError << "Base color texture sRGB search collision\n";
-			}
+		ysn::TextureUsage& image_usage = usages[image_index];
 
-			srgb_textures.emplace(texture.source);
+		// Occlusion is often packed into metallic roughness image, which keeps all channels
+		if (image_usage == ysn::TextureUsage::Unknown || (image_usage == ysn::TextureUsage::Mask && usage == ysn::TextureUsage::Data))
+		{
+			image_usage = usage;
+		}
+		else if (image_usage != usage && !(image_usage == ysn::TextureUsage::Data && usage == ysn::TextureUsage::Mask))
+		{
+			ysn::LogWarning << "GLTF image " << image_index << " has conflicting usages, first one is kept\n";
 		}
+	};
+
+	for (const tinygltf::Material& gltf_material : gltf_model.materials)
+	{
+		mark_usage(gltf_material.pbrMetallicRoughness.baseColorTexture.index, ysn::TextureUsage::Color);
+		mark_usage(gltf_material.emissiveTexture.index, ysn::TextureUsage::Color);
+		mark_usage(gltf_material.normalTexture.index, ysn::TextureUsage::Normal);
+		mark_usage(gltf_material.pbrMetallicRoughness.metallicRoughnessTexture.index, ysn::TextureUsage::Data);
+		mark_usage(gltf_material.occlusionTexture.index, ysn::TextureUsage::Mask);
 	}
+
+	return usages;
 }
 
-static bool BuildImages(ysn::Model& model, LoadGltfContext& build_context, const tinygltf::Model& gltf_model)
+// Creates texture and records upload of all its mips, data itself is copied later by CopyTextureData
+static std::optional<TextureUpload> BuildTexture(ysn::Model& model,
+	LoadGltfContext& build_context,
+	uint32_t width,
+	uint32_t height,
+	const std::string& name,
+	ysn::TextureUsage usage,
+	bool compress_textures)
 {
 	auto dx_renderer = ysn::Application::Get().GetRenderer();
 
 	HRESULT hr = S_OK;
 
-	// Mark all albedo and emissive images as srgb
-	std::unordered_set<int> srgb_textures;
-	FindAllSrgbTextures(srgb_textures, gltf_model);
+	const uint32_t num_mips = ysn::GetCookedMipsCount(width, height);
+	const bool is_srgb = ysn::IsSrgbUsage(usage);
+	const ysn::CookedTextureFormat format = compress_textures ? ysn::ChooseCookedTextureFormat(usage, width, height) : ysn::CookedTextureFormat::Rgba8;
 
-	for (int i = 0; i < gltf_model.images.size(); i++)
+	ID3D12Resource* dst_texture = nullptr;
 	{
-		const tinygltf::Image& image = gltf_model.images[i];
-
-		const uint32_t num_mips = ComputeNumMips(image.width, image.height);
-		bool is_srgb = srgb_textures.contains(i);
-
-		ID3D12Resource* dst_texture = nullptr;
-		{
-			D3D12_HEAP_PROPERTIES heap_properties = {};
-			heap_properties.Type = D3D12_HEAP_TYPE_DEFAULT;
-			heap_properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-			heap_properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-
-			// TODO: HDR textures?
-			D3D12_RESOURCE_DESC resource_desc = {};
-			resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-			resource_desc.Alignment = 0;
-			resource_desc.Width = image.width;
-			resource_desc.Height = image.height;
-			resource_desc.DepthOrArraySize = 1;
-			resource_desc.MipLevels = static_cast<UINT16>(num_mips);
-			resource_desc.Format = is_srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM; // GetSrgbFormat
-			resource_desc.SampleDesc = { 1, 0 };
-			resource_desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-			resource_desc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS; // FIXME: UAV / SRV?
-
-			hr = dx_renderer->GetDevice()->CreateCommittedResource(
-				&heap_properties, D3D12_HEAP_FLAG_NONE, &resource_desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&dst_texture));
-
-			if (hr != S_OK)
-			{
-				ysn::LogError << "Can't allocate GLTF dst texture\n";
-				return false;
-			}
+		D3D12_HEAP_PROPERTIES heap_properties = {};
+		heap_properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+		heap_properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+		heap_properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+
+		// TODO: HDR textures?
+		D3D12_RESOURCE_DESC resource_desc = {};
+		resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+		resource_desc.Alignment = 0;
+		resource_desc.Width = width;
+		resource_desc.Height = height;
+		resource_desc.DepthOrArraySize = 1;
+		resource_desc.MipLevels = static_cast<UINT16>(num_mips);
+		resource_desc.Format = GetDxgiFormat(format, is_srgb);
+		resource_desc.SampleDesc = { 1, 0 };
+		resource_desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+		resource_desc.Flags = D3D12_RESOURCE_FLAG_NONE; // Mips are cooked on CPU
+
+		hr = dx_renderer->GetDevice()->CreateCommittedResource(
+			&heap_properties, D3D12_HEAP_FLAG_NONE, &resource_desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&dst_texture));
+
+		if (hr != S_OK)
+		{
+			ysn::LogError << "Can't allocate GLTF dst texture\n";
+			return std::nullopt;
+		}
 
-			ysn::GpuTexture new_texture(dst_texture);
-			new_texture.SetName(image.uri);
-			new_texture.is_srgb = is_srgb;
-			new_texture.num_mips = num_mips;
-			new_texture.width = image.width;
-			new_texture.height = image.height;
+		ysn::GpuTexture new_texture(dst_texture);
+		new_texture.SetName(name);
+		new_texture.is_srgb = is_srgb;
+		new_texture.num_mips = num_mips;
+		new_texture.width = width;
+		new_texture.height = height;
 
-			const auto srv_handle = dx_renderer->GetCbvSrvUavDescriptorHeap()->GetNewHandle();
+		const auto srv_handle = dx_renderer->GetCbvSrvUavDescriptorHeap()->GetNewHandle();
 
-			D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
-			srv_desc.Format = is_srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
-			srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-			srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-			srv_desc.Texture2D.MipLevels = num_mips;
+		D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+		srv_desc.Format = GetDxgiFormat(format, is_srgb);
+		srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srv_desc.Texture2D.MipLevels = num_mips;
 
-			dx_renderer->GetDevice()->CreateShaderResourceView(new_texture.Resource(), &srv_desc, srv_handle.cpu);
+		dx_renderer->GetDevice()->CreateShaderResourceView(new_texture.Resource(), &srv_desc, srv_handle.cpu);
 
-			new_texture.descriptor_handle = srv_handle;
+		new_texture.descriptor_handle = srv_handle;
 
-			model.textures.push_back(new_texture);
-		}
+		model.textures.push_back(new_texture);
+	}
 
-		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+	TextureUpload upload;
+	upload.usage = usage;
+	upload.format = format;
+	upload.footprints.resize(num_mips);
+	upload.row_counts.resize(num_mips);
 
-		UINT row_count = 0;
-		UINT64 row_size = 0;
-		UINT64 size = 0;
+	std::vector<UINT64> row_sizes(num_mips);
+	UINT64 size = 0;
 
-		const D3D12_RESOURCE_DESC texture_desc = dst_texture->GetDesc();
+	const D3D12_RESOURCE_DESC texture_desc = dst_texture->GetDesc();
 
-		dx_renderer->GetDevice()->GetCopyableFootprints(&texture_desc, 0, 1, 0, &footprint, &row_count, &row_size, &size);
+	dx_renderer->GetDevice()->GetCopyableFootprints(
+		&texture_desc, 0, num_mips, 0, upload.footprints.data(), upload.row_counts.data(), row_sizes.data(), &size);
 
-		wil::com_ptr<ID3D12Resource> src_resource;
+	wil::com_ptr<ID3D12Resource> src_resource;
+	{
+		D3D12_HEAP_PROPERTIES heap_properties = {};
+		heap_properties.Type = D3D12_HEAP_TYPE_UPLOAD;
+		heap_properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+		heap_properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+
+		D3D12_RESOURCE_DESC resource_desc = {};
+		resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		resource_desc.Alignment = 0;
+		resource_desc.Width = size;
+		resource_desc.Height = 1;
+		resource_desc.DepthOrArraySize = 1;
+		resource_desc.MipLevels = 1;
+		resource_desc.Format = DXGI_FORMAT_UNKNOWN;
+		resource_desc.SampleDesc = { 1, 0 };
+		resource_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		resource_desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+		hr = dx_renderer->GetDevice()->CreateCommittedResource(
+			&heap_properties, D3D12_HEAP_FLAG_NONE, &resource_desc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&src_resource));
+
+		if (hr != S_OK)
 		{
-			D3D12_HEAP_PROPERTIES heap_properties = {};
-			heap_properties.Type = D3D12_HEAP_TYPE_UPLOAD;
-			heap_properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-			heap_properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-
-			D3D12_RESOURCE_DESC resource_desc = {};
-			resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-			resource_desc.Alignment = 0;
-			resource_desc.Width = size;
-			resource_desc.Height = 1;
-			resource_desc.DepthOrArraySize = 1;
-			resource_desc.MipLevels = 1;
-			resource_desc.Format = DXGI_FORMAT_UNKNOWN;
-			resource_desc.SampleDesc = { 1, 0 };
-			resource_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-			resource_desc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-			hr = dx_renderer->GetDevice()->CreateCommittedResource(
-				&heap_properties, D3D12_HEAP_FLAG_NONE, &resource_desc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&src_resource));
-
-			if (hr != S_OK)
-			{
-				ysn::LogError << "Can't allocate GLTF src texture resource\n";
-				return false;
-			}
+			ysn::LogError << "Can't allocate GLTF src texture resource\n";
+			return std::nullopt;
+		}
 
-			build_context.staging_resources.push_back(src_resource);
+		build_context.staging_resources.push_back(src_resource);
 
-			void* data_ptr;
-			hr = src_resource->Map(0, nullptr, &data_ptr);
+		void* data_ptr;
+		hr = src_resource->Map(0, nullptr, &data_ptr);
 
-			if (hr != S_OK)
-			{
-				ysn::LogError << "Can't map GLTF src texture resource\n";
-				return false;
-			}
+		if (hr != S_OK)
+		{
+			ysn::LogError << "Can't map GLTF src texture resource\n";
+			return std::nullopt;
+		}
 
-			// Move data from gltf texture to resource
-			for (UINT row = 0; row != row_count; row++)
-			{
-				memcpy(
-					static_cast<uint8_t*>(data_ptr) + row_size * row,
-					&image.image[0] + image.width * image.component * row,
-					image.width * image.component);
-			}
+		upload.upload_data = static_cast<uint8_t*>(data_ptr);
 
-			// TODO: try to unmap here?
-		}
+		// TODO: try to unmap here?
+	}
 
+	// Copy texture to GPU
+	for (uint32_t mip = 0; mip < num_mips; mip++)
+	{
 		D3D12_TEXTURE_COPY_LOCATION dst_copy_location = {};
 		dst_copy_location.pResource = dst_texture;
 		dst_copy_location.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-		dst_copy_location.SubresourceIndex = 0;
+		dst_copy_location.SubresourceIndex = mip;
 
 		D3D12_TEXTURE_COPY_LOCATION src_copy_location = {};
 		src_copy_location.pResource = src_resource.get();
 		src_copy_location.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-		src_copy_location.PlacedFootprint = footprint;
+		src_copy_location.PlacedFootprint = upload.footprints[mip];
 
-		// Copy texture to GPU
 		build_context.copy_cmd_list->CopyTextureRegion(&dst_copy_location, 0, 0, 0, &src_copy_location, nullptr);
 	}
 
+	CD3DX12_RESOURCE_BARRIER barrier =
+		CD3DX12_RESOURCE_BARRIER::Transition(dst_texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	build_context.copy_cmd_list->ResourceBarrier(1, &barrier);
+
+	return upload;
+}
+
+// Failed load gives back textures and descriptors it has created, so GLTF fallback starts from the same heap state.
+// Command list is dropped if it wasn't submitted yet.
+static void RollbackTextures(ysn::Model& model, LoadGltfContext& build_context, uint32_t descriptors_count)
+{
+	if (build_context.copy_cmd_list)
+	{
+		ysn::Application::Get().GetDirectQueue()->DiscardCommandList(build_context.copy_cmd_list);
+		build_context.copy_cmd_list = nullptr;
+	}
+
+	model.textures.clear();
+	ysn::Application::Get().GetRenderer()->GetCbvSrvUavDescriptorHeap()->ReleaseHandlesAfter(descriptors_count);
+}
+
+// Thread safe, every upload owns its own staging memory
+static bool CopyTextureData(const TextureUpload& upload, const ysn::CookedTexture& cooked_texture)
+{
+	if (cooked_texture.format != upload.format || cooked_texture.mips.size() != upload.footprints.size())
+		return false;
+
+	for (uint32_t mip = 0; mip < upload.footprints.size(); mip++)
+	{
+		const ysn::CookedMip& cooked_mip = cooked_texture.mips[mip];
+		const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = upload.footprints[mip];
+
+		if (cooked_mip.rows_count != upload.row_counts[mip] || cooked_mip.row_size > footprint.Footprint.RowPitch)
+			return false;
+
+		for (uint32_t row = 0; row != cooked_mip.rows_count; row++)
+		{
+			memcpy(upload.upload_data + footprint.Offset + static_cast<uint64_t>(footprint.Footprint.RowPitch) * row,
+				cooked_texture.data.data() + cooked_mip.offset + static_cast<uint64_t>(cooked_mip.row_size) * row,
+				cooked_mip.row_size);
+		}
+	}
+
+	return true;
+}
+
+// Cooked image is taken from disk while it is up to date with source image, otherwise decoded pixels are cooked and stored
+// Embedded images have no path and are cooked on every load
+template <typename DecodeFunc>
+static bool CookImage(const TextureUpload& upload, const std::wstring& image_path, DecodeFunc decode_image, ysn::JobSystem& job_system)
+{
+	const std::wstring cooked_path = ysn::GetCookedTexturePath(image_path);
+	const std::optional<ysn::CookedTextureKey> key =
+		image_path.empty() ? std::nullopt : ysn::MakeCookedTextureKey(image_path, upload.usage, upload.format);
+
+	if (key.has_value())
+	{
+		const std::optional<ysn::CookedTexture> cooked_texture = ysn::ReadCookedTexture(cooked_path, key.value());
+
+		if (cooked_texture.has_value() && CopyTextureData(upload, cooked_texture.value()))
+			return true;
+	}
+
+	const auto cook_start_time = std::chrono::high_resolution_clock::now();
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> rgba;
+
+	if (!decode_image(rgba, width, height))
+		return false;
+
+	const ysn::CookedTexture cooked_texture = ysn::CookTexture(rgba, width, height, upload.usage, upload.format, &job_system);
+
+	if (!CopyTextureData(upload, cooked_texture))
+	{
+		ysn::LogError << "Cooked texture doesn't match created one\n";
+		return false;
+	}
+
+	if (upload.format != ysn::CookedTextureFormat::Rgba8)
+	{
+		const double psnr = ysn::ComputePsnr(rgba, ysn::DecodeCookedMip(cooked_texture, 0), ysn::GetCookedChannelsMask(upload.format));
+		const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - cook_start_time);
+
+		ysn::LogInfo << "Texture cooked: " << (image_path.empty() ? "embedded" : ysn::WStringToString(image_path)) << ", " << width << "x" << height
+					 << ", " << ysn::GetCookedTextureFormatName(upload.format) << ", PSNR " << static_cast<float>(psnr) << " dB, duration "
+					 << static_cast<uint32_t>(duration.count()) << " ms\n";
+	}
+
+	if (key.has_value())
+	{
+		ysn::WriteCookedTexture(cooked_path, cooked_texture, key.value());
+	}
+
+	return true;
+}
+
+// Cooker takes 8 bit RGBA, tinygltf keeps 16 bit images as they are
+static bool GetImageRgba8(const tinygltf::Image& image, std::vector<uint8_t>& rgba)
+{
+	if (image.component != 4 || (image.bits != 8 && image.bits != 16))
+	{
+		ysn::LogError << "GLTF image has unsupported layout: " << image.uri << "\n";
+		return false;
+	}
+
+	const size_t samples_count = static_cast<size_t>(image.width) * image.height * 4;
+
+	if (image.image.size() < samples_count * (image.bits / 8))
+		return false;
+
+	if (image.bits == 8)
+	{
+		rgba.assign(image.image.begin(), image.image.begin() + samples_count);
+		return true;
+	}
+
+	rgba.resize(samples_count);
+
+	for (size_t i = 0; i < samples_count; i++)
+		rgba[i] = image.image[i * 2 + 1]; // Little endian high byte
+
 	return true;
 }
 
+// Textures are created in order on the calling thread, so descriptor indices are the same for any workers count
+static std::optional<ysn::JobHandle> BuildImages(ysn::Model& model,
+	LoadGltfContext& build_context,
+	std::atomic<bool>& images_cooked,
+	const tinygltf::Model& gltf_model,
+	const std::filesystem::path& base_dir,
+	const ysn::LoadingParameters& loading_parameters,
+	ysn::JobSystem& job_system)
+{
+	const std::vector<ysn::TextureUsage> usages = FindTextureUsages(gltf_model);
+
+	auto texture_uploads = std::make_shared<std::vector<TextureUpload>>();
+	texture_uploads->reserve(gltf_model.images.size());
+
+	for (int i = 0; i < gltf_model.images.size(); i++)
+	{
+		const tinygltf::Image& image = gltf_model.images[i];
+
+		const std::optional<TextureUpload> upload =
+			BuildTexture(model, build_context, image.width, image.height, image.uri, usages[i], loading_parameters.compress_textures);
+
+		if (!upload.has_value())
+		{
+			return std::nullopt;
+		}
+
+		texture_uploads->push_back(upload.value());
+	}
+
+	// Images are cooked in parallel and every image spreads its blocks over workers too
+	return job_system.ScheduleParallelFor(static_cast<uint32_t>(texture_uploads->size()), 1, [texture_uploads, &images_cooked, &gltf_model, base_dir, &job_system](uint32_t i)
+	{
+		const tinygltf::Image& image = gltf_model.images[i];
+		const std::wstring image_path = IsExternalUri(image.uri) ? (base_dir / ysn::StringToWString(image.uri)).wstring() : std::wstring();
+
+		const auto decode_image = [&image](std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height)
+		{
+			width = image.width;
+			height = image.height;
+			return GetImageRgba8(image, rgba);
+		};
+
+		if (!CookImage((*texture_uploads)[i], image_path, decode_image, job_system))
+		{
+			ysn::LogError << "GLTF loader can't cook image: " << image.uri << "\n";
+			images_cooked = false;
+		}
+	});
+}
+
 static void BuildSamplerDescs(ysn::Model& model, const tinygltf::Model& gltf_model)
 {
 	model.sampler_descs.reserve(gltf_model.samplers.size());
@@ -593,35 +834,114 @@ static uint32_t BuildVertexBuffer(ysn::Primitive& primitive, const tinygltf::Pri
 	return static_cast<uint32_t>(position_accessor.count);
 }
 
-static BuildMeshResult BuildMeshes(ysn::Model& model, const tinygltf::Model& gltf_model)
+// Mesh layout is built on the calling thread, then every primitive is converted by its own job into preallocated slot.
+// Output doesn't depend on workers count or execution order.
+static ysn::JobHandle BuildMeshes(
+	ysn::Model& model,
+	std::vector<ysn::MeshOptimizationStatistics>& optimization_statistics,
+	const tinygltf::Model& gltf_model,
+	const ysn::LoadingParameters& loading_parameters,
+	ysn::JobSystem& job_system)
 {
-	BuildMeshResult result;
+	struct PrimitiveTask
+	{
+		ysn::Primitive* primitive = nullptr;
+		const tinygltf::Primitive* gltf_primitive = nullptr;
+	};
+
+	auto primitive_tasks = std::make_shared<std::vector<PrimitiveTask>>();
 
 	uint32_t primitive_index_count = 0;
 
+	model.meshes.reserve(gltf_model.meshes.size());
+
 	for (const tinygltf::Mesh& gltf_mesh : gltf_model.meshes)
 	{
-		ysn::Mesh mesh;
+		ysn::Mesh& mesh = model.meshes.emplace_back();
 		mesh.name = gltf_mesh.name;
+		mesh.primitives.resize(gltf_mesh.primitives.size());
 
-		for (const tinygltf::Primitive& gltf_primitive : gltf_mesh.primitives)
+		for (int i = 0; i < gltf_mesh.primitives.size(); i++)
 		{
-			ysn::Primitive primitive;
-			result.mesh_vertices_count += BuildVertexBuffer(primitive, gltf_primitive, gltf_model);
-			result.mesh_indices_count += BuildIndexBuffer(primitive, gltf_primitive.indices, gltf_model);
+			const tinygltf::Primitive& gltf_primitive = gltf_mesh.primitives[i];
+
+			ysn::Primitive& primitive = mesh.primitives[i];
 			BuildPrimitiveTopology(primitive, gltf_primitive.mode);
 
 			primitive.material_id = gltf_primitive.material;
 			primitive.index = primitive_index_count;
 
-			mesh.primitives.push_back(primitive);
+			primitive_tasks->push_back({ .primitive = &primitive, .gltf_primitive = &gltf_primitive });
 
 			primitive_index_count++;
 		}
+	}
 
-		result.primitives_count += static_cast<uint32_t>(gltf_mesh.primitives.size());
+	optimization_statistics.resize(primitive_tasks->size());
 
-		model.meshes.push_back(mesh);
+	return job_system.ScheduleParallelFor(static_cast<uint32_t>(primitive_tasks->size()), 1,
+		[primitive_tasks, &optimization_statistics, &gltf_model, &loading_parameters](uint32_t i)
+	{
+		const PrimitiveTask& task = (*primitive_tasks)[i];
+
+		BuildVertexBuffer(*task.primitive, *task.gltf_primitive, gltf_model);
+		BuildIndexBuffer(*task.primitive, task.gltf_primitive->indices, gltf_model);
+
+		if (loading_parameters.optimize_meshes)
+		{
+			optimization_statistics[i] = ysn::OptimizePrimitive(*task.primitive, loading_parameters.mesh_optimization);
+		}
+	});
+}
+
+static void LogMeshOptimizationStatistics(const ysn::Model& model, std::span<const ysn::MeshOptimizationStatistics> optimization_statistics)
+{
+	uint64_t vertices_before = 0;
+	uint64_t vertices_after = 0;
+	double acmr_before = 0.0;
+	double acmr_after = 0.0;
+	uint64_t triangles_count = 0;
+
+	for (const ysn::MeshOptimizationStatistics& statistics : optimization_statistics)
+	{
+		vertices_before += statistics.vertices_before;
+		vertices_after += statistics.vertices_after;
+		acmr_before += statistics.acmr_before * statistics.triangles_count;
+		acmr_after += statistics.acmr_after * statistics.triangles_count;
+		triangles_count += statistics.triangles_count;
+	}
+
+	uint64_t lods_count = 0;
+
+	for (const ysn::Mesh& mesh : model.meshes)
+	{
+		for (const ysn::Primitive& primitive : mesh.primitives)
+		{
+			lods_count += primitive.lods.size();
+		}
+	}
+
+	if (triangles_count == 0)
+		return;
+
+	ysn::LogInfo << "Mesh optimization: vertices " << std::to_string(vertices_before) << " -> " << std::to_string(vertices_after)
+				 << ", ACMR " << std::to_string(acmr_before / triangles_count) << " -> " << std::to_string(acmr_after / triangles_count)
+				 << ", LODs " << std::to_string(lods_count) << "\n";
+}
+
+static BuildMeshResult CountMeshes(const ysn::Model& model)
+{
+	BuildMeshResult result;
+
+	for (const ysn::Mesh& mesh : model.meshes)
+	{
+		for (const ysn::Primitive& primitive : mesh.primitives)
+		{
+			result.mesh_vertices_count += static_cast<uint32_t>(primitive.vertices.size());
+			result.mesh_indices_count += static_cast<uint32_t>(primitive.indices.size());
+		}
+
+		result.primitives_count += static_cast<uint32_t>(mesh.primitives.size());
 	}
 
 	return result;
@@ -629,8 +949,6 @@ static BuildMeshResult BuildMeshes(ysn::Model& model, const tinygltf::Model& glt
 
 static void BuildNodes(ysn::Model& model, const tinygltf::Model& gltf_model, const ysn::LoadingParameters& loading_parameters)
 {
-	auto dx_renderer = ysn::Application::Get().GetRenderer();
-
 	for (const tinygltf::Node& gltf_node : gltf_model.nodes)
 	{
 		if(gltf_node.mesh == -1)
@@ -711,10 +1029,9 @@ static void BuildNodes(ysn::Model& model, const tinygltf::Model& gltf_model, con
 	}
 }
 
+// Texture indices point into GLTF images, BindMaterialTextures turns them into descriptor indices once textures exist
 static uint32_t BuildMaterials(ysn::Model& model, const tinygltf::Model& gltf_model)
 {
-	auto dx_renderer = ysn::Application::Get().GetRenderer();
-
 	for (const tinygltf::Material& gltf_material : gltf_model.materials)
 	{
 		ysn::Material material(gltf_material.name);
@@ -778,68 +1095,36 @@ static uint32_t BuildMaterials(ysn::Model& model, const tinygltf::Model& gltf_mo
 		{
 			shader_parameters.texture_enable_bitmask |= 1 << ALBEDO_ENABLED_BIT;
 
-			const tinygltf::Texture& gltf_texture = gltf_model.textures[gltf_pbr_material.baseColorTexture.index];
-
-			ysn::GpuTexture& texture = model.textures[gltf_texture.source]; // TODO: use it for srgb?
-			texture.is_srgb = true;
-
-			shader_parameters.albedo_texture_index =
-				dx_renderer->GetCbvSrvUavDescriptorHeap()->GetDescriptorIndex(texture.descriptor_handle);
-
-			texture.SetName("Albedo Texture");
+			shader_parameters.albedo_texture_index = gltf_model.textures[gltf_pbr_material.baseColorTexture.index].source;
 		}
 
 		if (gltf_material.pbrMetallicRoughness.metallicRoughnessTexture.index >= 0)
 		{
 			shader_parameters.texture_enable_bitmask |= 1 << METALLIC_ROUGHNESS_ENABLED_BIT;
 
-			const tinygltf::Texture& gltfTexture =
-				gltf_model.textures[gltf_material.pbrMetallicRoughness.metallicRoughnessTexture.index];
-			ysn::GpuTexture& texture = model.textures[gltfTexture.source];
-
 			shader_parameters.metallic_roughness_texture_index =
-				dx_renderer->GetCbvSrvUavDescriptorHeap()->GetDescriptorIndex(texture.descriptor_handle);
-
-			texture.SetName("Metallic Roughness Texture");
+				gltf_model.textures[gltf_material.pbrMetallicRoughness.metallicRoughnessTexture.index].source;
 		}
 
 		if (gltf_material.normalTexture.index >= 0)
 		{
 			shader_parameters.texture_enable_bitmask |= 1 << NORMAL_ENABLED_BIT;
 
-			const tinygltf::Texture& gltf_texture = gltf_model.textures[gltf_material.normalTexture.index];
-			ysn::GpuTexture& texture = model.textures[gltf_texture.source];
-
-			shader_parameters.normal_texture_index =
-				dx_renderer->GetCbvSrvUavDescriptorHeap()->GetDescriptorIndex(texture.descriptor_handle);
-
-			texture.SetName("Normals Texture");
+			shader_parameters.normal_texture_index = gltf_model.textures[gltf_material.normalTexture.index].source;
 		}
 
 		if (gltf_material.occlusionTexture.index >= 0)
 		{
 			shader_parameters.texture_enable_bitmask |= 1 << OCCLUSION_ENABLED_BIT;
 
-			const tinygltf::Texture& gltf_texture = gltf_model.textures[gltf_material.occlusionTexture.index];
-			ysn::GpuTexture& texture = model.textures[gltf_texture.source];
-
-			shader_parameters.occlusion_texture_index =
-				dx_renderer->GetCbvSrvUavDescriptorHeap()->GetDescriptorIndex(texture.descriptor_handle);
-
-			texture.SetName("Occlusion Texture");
+			shader_parameters.occlusion_texture_index = gltf_model.textures[gltf_material.occlusionTexture.index].source;
 		}
 
 		if (gltf_material.emissiveTexture.index >= 0)
 		{
 			shader_parameters.texture_enable_bitmask |= 1 << EMISSIVE_ENABLED_BIT;
 
-			const tinygltf::Texture& gltf_texture = gltf_model.textures[gltf_material.emissiveTexture.index];
-			ysn::GpuTexture& texture = model.textures[gltf_texture.source];
-
-			shader_parameters.emissive_texture_index =
-				dx_renderer->GetCbvSrvUavDescriptorHeap()->GetDescriptorIndex(texture.descriptor_handle);
-
-			texture.SetName("Emissive Texture");
+			shader_parameters.emissive_texture_index = gltf_model.textures[gltf_material.emissiveTexture.index].source;
 		}
 
 		model.materials.push_back(material);
@@ -849,9 +1134,223 @@ static uint32_t BuildMaterials(ysn::Model& model, const tinygltf::Model& gltf_mo
 	return static_cast<uint32_t>(gltf_model.materials.size());
 }
 
+template <typename RemapFunc>
+static void RemapTextureIndices(SurfaceShaderParameters& shader_parameters, RemapFunc remap)
+{
+	if (shader_parameters.texture_enable_bitmask & (1 << ALBEDO_ENABLED_BIT))
+		shader_parameters.albedo_texture_index = remap(shader_parameters.albedo_texture_index);
+
+	if (shader_parameters.texture_enable_bitmask & (1 << METALLIC_ROUGHNESS_ENABLED_BIT))
+		shader_parameters.metallic_roughness_texture_index = remap(shader_parameters.metallic_roughness_texture_index);
+
+	if (shader_parameters.texture_enable_bitmask & (1 << NORMAL_ENABLED_BIT))
+		shader_parameters.normal_texture_index = remap(shader_parameters.normal_texture_index);
+
+	if (shader_parameters.texture_enable_bitmask & (1 << OCCLUSION_ENABLED_BIT))
+		shader_parameters.occlusion_texture_index = remap(shader_parameters.occlusion_texture_index);
+
+	if (shader_parameters.texture_enable_bitmask & (1 << EMISSIVE_ENABLED_BIT))
+		shader_parameters.emissive_texture_index = remap(shader_parameters.emissive_texture_index);
+}
+
+// Textures are created in image order, so image index of material is index of model texture
+static void BindMaterialTextures(ysn::Model& model)
+{
+	auto dx_renderer = ysn::Application::Get().GetRenderer();
+
+	for (SurfaceShaderParameters& shader_parameters : model.shader_parameters)
+	{
+		RemapTextureIndices(shader_parameters, [&](int image_index)
+		{
+			return static_cast<int>(dx_renderer->GetCbvSrvUavDescriptorHeap()->GetDescriptorIndex(model.textures[image_index].descriptor_handle));
+		});
+	}
+}
+
+// Flattens loaded model into cache layout, geometry is merged into vertices and indices
+static bool CookSceneCache(
+	ysn::SceneCache& scene_cache,
+	std::vector<ysn::Vertex>& vertices,
+	std::vector<uint32_t>& indices,
+	const ysn::Model& model,
+	const tinygltf::Model& gltf_model,
+	const std::filesystem::path& gltf_path)
+{
+	const std::filesystem::path base_dir = gltf_path.parent_path();
+
+	std::vector<std::string> dependency_paths = { ysn::WStringToString(gltf_path.filename().wstring()) };
+
+	for (const tinygltf::Buffer& gltf_buffer : gltf_model.buffers)
+	{
+		if (IsExternalUri(gltf_buffer.uri))
+			dependency_paths.push_back(gltf_buffer.uri);
+	}
+
+	// Cache references images by path, embedded ones would need to be cooked too
+	for (const tinygltf::Image& gltf_image : gltf_model.images)
+	{
+		if (!IsExternalUri(gltf_image.uri))
+		{
+			ysn::LogInfo << "Scene cache skipped, GLTF has embedded images\n";
+			return false;
+		}
+
+		dependency_paths.push_back(gltf_image.uri);
+	}
+
+	for (const std::string& dependency_path : dependency_paths)
+	{
+		const std::optional<ysn::SceneCacheDependency> dependency = ysn::MakeSceneCacheDependency(base_dir, dependency_path);
+
+		if (!dependency.has_value())
+		{
+			ysn::LogWarning << "Scene cache skipped, can't stat " << dependency_path << "\n";
+			return false;
+		}
+
+		scene_cache.dependencies.push_back(dependency.value());
+	}
+
+	const std::vector<ysn::TextureUsage> usages = FindTextureUsages(gltf_model);
+
+	for (size_t i = 0; i < gltf_model.images.size(); i++)
+	{
+		scene_cache.images.push_back({ .uri = gltf_model.images[i].uri, .usage = usages[i] });
+	}
+
+	scene_cache.samplers = model.sampler_descs;
+
+	for (int i = 0; i < model.materials.size(); i++)
+	{
+		ysn::CookedMaterial& cooked_material = scene_cache.materials.emplace_back();
+		cooked_material.name = model.materials[i].name;
+		cooked_material.blend_desc = model.materials[i].blend_desc;
+		cooked_material.rasterizer_desc = model.materials[i].rasterizer_desc;
+		cooked_material.shader_parameters = model.shader_parameters[i];
+	}
+
+	for (const ysn::Mesh& mesh : model.meshes)
+	{
+		ysn::CookedMesh& cooked_mesh = scene_cache.meshes.emplace_back();
+		cooked_mesh.name = mesh.name;
+		cooked_mesh.first_primitive = static_cast<uint32_t>(scene_cache.primitives.size());
+		cooked_mesh.primitives_count = static_cast<uint32_t>(mesh.primitives.size());
+
+		for (const ysn::Primitive& primitive : mesh.primitives)
+		{
+			ysn::CookedPrimitive& cooked_primitive = scene_cache.primitives.emplace_back();
+			cooked_primitive.topology = primitive.topology;
+			cooked_primitive.material_id = primitive.material_id;
+			cooked_primitive.bbox = primitive.bbox;
+			cooked_primitive.vertex_offset = static_cast<uint32_t>(vertices.size());
+			cooked_primitive.vertex_count = static_cast<uint32_t>(primitive.vertices.size());
+			cooked_primitive.index_offset = static_cast<uint32_t>(indices.size());
+			cooked_primitive.index_count = static_cast<uint32_t>(primitive.indices.size());
+			cooked_primitive.first_lod = static_cast<uint32_t>(scene_cache.lods.size());
+			cooked_primitive.lods_count = static_cast<uint32_t>(primitive.lods.size());
+
+			scene_cache.lods.insert(scene_cache.lods.end(), primitive.lods.begin(), primitive.lods.end());
+
+			vertices.insert(vertices.end(), primitive.vertices.begin(), primitive.vertices.end());
+			indices.insert(indices.end(), primitive.indices.begin(), primitive.indices.end());
+		}
+	}
+
+	for (const DirectX::XMMATRIX& transform : model.transforms)
+	{
+		DirectX::XMStoreFloat4x4(&scene_cache.transforms.emplace_back(), transform);
+	}
+
+	scene_cache.vertices = vertices;
+	scene_cache.indices = indices;
+
+	return true;
+}
+
+static bool WriteGltfSceneCache(const ysn::Model& model, const tinygltf::Model& gltf_model, const std::filesystem::path& gltf_path, uint64_t loading_parameters_hash)
+{
+	ysn::SceneCache scene_cache;
+	scene_cache.loading_parameters_hash = loading_parameters_hash;
+
+	std::vector<ysn::Vertex> vertices;
+	std::vector<uint32_t> indices;
+
+	const std::wstring cache_path = ysn::GetSceneCachePath(gltf_path.wstring());
+
+	if (!CookSceneCache(scene_cache, vertices, indices, model, gltf_model, gltf_path) || !ysn::WriteSceneCache(cache_path, scene_cache))
+		return false;
+
+	ysn::LogInfo << "Scene cache cooked: " << ysn::WStringToString(cache_path) << "\n";
+
+	return true;
+}
+
+// CPU only part of model, primitives are converted on the job system meanwhile materials and nodes are built
+static void BuildModel(ysn::Model& model, const tinygltf::Model& gltf_model, const ysn::LoadingParameters& loading_parameters, ysn::JobSystem& job_system)
+{
+	std::vector<ysn::MeshOptimizationStatistics> optimization_statistics;
+	const ysn::JobHandle meshes_job = BuildMeshes(model, optimization_statistics, gltf_model, loading_parameters, job_system);
+
+	BuildMaterials(model, gltf_model);
+	BuildSamplerDescs(model, gltf_model);
+	BuildNodes(model, gltf_model, loading_parameters);
+
+	job_system.Wait(meshes_job);
+}
+
+static bool ReadGltfFile(tinygltf::Model& gltf_model, const std::string& load_path)
+{
+	tinygltf::TinyGLTF gltf_loader;
+
+	std::string error_str;
+	std::string warning_str;
+
+	const bool result = gltf_loader.LoadASCIIFromFile(&gltf_model, &error_str, &warning_str, load_path.c_str());
+
+	ysn::LogInfo << "GLTF loading: " << load_path << "\n";
+
+	if (!warning_str.empty())
+	{
+		ysn::LogInfo << "GLTF loading: " << warning_str.c_str() << "\n";
+	}
+
+	if (!error_str.empty())
+	{
+		ysn::LogError << "GLTF loading: " << error_str.c_str() << "\n";
+	}
+
+	if (!result)
+	{
+		ysn::LogError << "Failed to read: " << load_path << "\n";
+		return false;
+	}
+
+	return true;
+}
+
 namespace ysn
 {
-	bool ReadModel(RenderScene& render_scene, Model& model, const tinygltf::Model& gltf_model, const LoadingParameters& loading_parameters)
+	uint64_t HashLoadingParameters(const LoadingParameters& loading_parameters)
+	{
+		const MeshOptimizationParameters& mesh_optimization = loading_parameters.mesh_optimization;
+
+		const uint32_t optimization_state[] = {
+			loading_parameters.optimize_meshes,
+			mesh_optimization.max_lods_count,
+			std::bit_cast<uint32_t>(mesh_optimization.lod_reduction),
+			std::bit_cast<uint32_t>(mesh_optimization.lod_max_error),
+			std::bit_cast<uint32_t>(mesh_optimization.lod_error_growth),
+		};
+
+		return HashState(optimization_state, std::size(optimization_state), HashState(&loading_parameters.model_modifier));
+	}
+
+	// Material texture indices are left pointing into GLTF images, so model can be cooked before textures are bound
+	bool ReadModel(RenderScene& render_scene,
+		Model& model,
+		const tinygltf::Model& gltf_model,
+		const std::filesystem::path& base_dir,
+		const LoadingParameters& loading_parameters)
 	{
 		auto dx_renderer = Application::Get().GetRenderer();
 		auto command_queue = Application::Get().GetDirectQueue();
@@ -865,19 +1364,42 @@ namespace ysn
 		load_gltf_context.staging_resources.reserve(256);
 		load_gltf_context.copy_cmd_list = cmd_list_result.value();
 
-		if (!BuildImages(model, load_gltf_context, gltf_model))
+		const uint32_t descriptors_count = dx_renderer->GetCbvSrvUavDescriptorHeap()->GetHandlesCount();
+
+		auto job_system = Application::Get().GetJobSystem();
+
+		// Image cooking and primitives conversion run on workers, rest is cheap and stays on this thread meanwhile
+		std::atomic<bool> images_cooked = true;
+		const std::optional<JobHandle> images_job =
+			BuildImages(model, load_gltf_context, images_cooked, gltf_model, base_dir, loading_parameters, *job_system);
+
+		if (!images_job.has_value())
 		{
-			ysn::LogError << "GLTF loader can't build materials\n";
+			ysn::LogError << "GLTF loader can't build images\n";
+			RollbackTextures(model, load_gltf_context, descriptors_count);
 			return false;
 		}
 
-		render_scene.materials_count += BuildMaterials(model, gltf_model);
+		std::vector<MeshOptimizationStatistics> optimization_statistics;
+		const JobHandle meshes_job = BuildMeshes(model, optimization_statistics, gltf_model, loading_parameters, *job_system);
+
+		BuildMeshResult mesh_result;
+		const JobHandle count_job = job_system->Schedule([&mesh_result, &model]() { mesh_result = CountMeshes(model); }, std::array{ meshes_job });
+
+		const uint32_t materials_count = BuildMaterials(model, gltf_model);
 
 		BuildSamplerDescs(model, gltf_model);
-		const BuildMeshResult mesh_result = BuildMeshes(model, gltf_model);
 		BuildNodes(model, gltf_model, loading_parameters);
 
+		job_system->Wait(std::array{ images_job.value(), count_job });
+
+		if (loading_parameters.optimize_meshes)
+		{
+			LogMeshOptimizationStatistics(model, optimization_statistics);
+		}
+
 		command_queue->CloseCommandList(load_gltf_context.copy_cmd_list);
+		load_gltf_context.copy_cmd_list = nullptr;
 
 		auto fence_value = command_queue->ExecuteCommandLists();
 
@@ -888,6 +1410,13 @@ namespace ysn
 
 		command_queue->WaitForFenceValue(fence_value.value());
 
+		if (!images_cooked)
+		{
+			RollbackTextures(model, load_gltf_context, descriptors_count);
+			return false;
+		}
+
+		render_scene.materials_count += materials_count;
 		render_scene.indices_count += mesh_result.mesh_indices_count;
 		render_scene.vertices_count += mesh_result.mesh_vertices_count;
 		render_scene.primitives_count += mesh_result.primitives_count;
@@ -895,47 +1424,276 @@ namespace ysn
 		return true;
 	}
 
-	bool LoadGltfFromFile(RenderScene& render_scene, const std::wstring& load_path, const LoadingParameters& loading_parameters)
+	// Geometry stays in the mapped cache, only textures are cooked or read from their own cache and uploaded
+	bool ReadModelFromCache(RenderScene& render_scene,
+		Model& model,
+		const SceneCache& scene_cache,
+		const std::filesystem::path& base_dir,
+		const LoadingParameters& loading_parameters)
 	{
-		tinygltf::Model gltf_model;
-		tinygltf::TinyGLTF gltf_loader;
+		auto dx_renderer = Application::Get().GetRenderer();
+		auto command_queue = Application::Get().GetDirectQueue();
 
-		std::string error_str;
-		std::string warning_str;
-		const std::string load_path_str = ysn::WStringToString(load_path);
+		std::vector<std::wstring> image_paths;
+		std::vector<std::pair<uint32_t, uint32_t>> image_sizes;
+
+		// Only headers are read here, all of them are checked before any GPU resource is created
+		for (const CookedImage& image : scene_cache.images)
+		{
+			const std::wstring& image_path = image_paths.emplace_back((base_dir / StringToWString(image.uri)).wstring());
+
+			int width = 0;
+			int height = 0;
+			int components = 0;
 
-		const bool result = gltf_loader.LoadASCIIFromFile(&gltf_model, &error_str, &warning_str, load_path_str.c_str());
+			if (!stbi_info(WStringToString(image_path).c_str(), &width, &height, &components))
+			{
+				LogError << "Scene cache can't load image: " << WStringToString(image_path) << "\n";
+				return false;
+			}
+
+			image_sizes.emplace_back(width, height);
+		}
+
+		const auto cmd_list_result = command_queue->GetCommandList("Scene cache upload");
+
+		if (!cmd_list_result.has_value())
+			return false;
+
+		LoadGltfContext load_gltf_context;
+		load_gltf_context.staging_resources.reserve(256);
+		load_gltf_context.copy_cmd_list = cmd_list_result.value();
 
-		ysn::LogInfo << "GLTF loading: " << load_path_str << "\n";
+		const uint32_t descriptors_count = dx_renderer->GetCbvSrvUavDescriptorHeap()->GetHandlesCount();
 
-		if (!warning_str.empty())
+		auto job_system = Application::Get().GetJobSystem();
+
+		std::vector<TextureUpload> texture_uploads;
+
+		// Textures have to be created in order to keep descriptor indices stable
+		for (size_t i = 0; i < scene_cache.images.size(); i++)
 		{
-			ysn::LogInfo << "GLTF loading: " << warning_str.c_str() << "\n";
+			const auto [width, height] = image_sizes[i];
+
+			const std::optional<TextureUpload> upload = BuildTexture(
+				model, load_gltf_context, width, height, scene_cache.images[i].uri, scene_cache.images[i].usage, loading_parameters.compress_textures);
+
+			if (!upload.has_value())
+			{
+				RollbackTextures(model, load_gltf_context, descriptors_count);
+				return false;
+			}
+
+			texture_uploads.push_back(upload.value());
 		}
 
-		if (!error_str.empty())
+		// Images are decoded only when their cooked version is stale, result goes straight into staging memory
+		std::atomic<bool> images_decoded = true;
+
+		const JobHandle images_job = job_system->ScheduleParallelFor(static_cast<uint32_t>(texture_uploads.size()), 1, [&](uint32_t i)
 		{
-			ysn::LogError << "GLTF loading: " << error_str.c_str() << "\n";
+			const auto decode_image = [&](std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height)
+			{
+				int image_width = 0;
+				int image_height = 0;
+				uint8_t* image_data = stbi_load(WStringToString(image_paths[i]).c_str(), &image_width, &image_height, nullptr, STBI_rgb_alpha);
+
+				if (image_data == nullptr)
+					return false;
+
+				width = image_width;
+				height = image_height;
+				rgba.assign(image_data, image_data + static_cast<size_t>(width) * height * STBI_rgb_alpha);
+
+				stbi_image_free(image_data);
+
+				return true;
+			};
+
+			if (!CookImage(texture_uploads[i], image_paths[i], decode_image, *job_system))
+			{
+				LogError << "Scene cache can't load image: " << WStringToString(image_paths[i]) << "\n";
+				images_decoded = false;
+			}
+		});
+
+		model.sampler_descs = scene_cache.samplers;
+
+		for (const CookedMaterial& cooked_material : scene_cache.materials)
+		{
+			Material material(cooked_material.name);
+			material.blend_desc = cooked_material.blend_desc;
+			material.rasterizer_desc = cooked_material.rasterizer_desc;
+
+			model.materials.push_back(material);
+			model.shader_parameters.push_back(cooked_material.shader_parameters);
 		}
 
-		if (!result)
+		BindMaterialTextures(model);
+
+		uint32_t primitive_index_count = 0;
+
+		for (const CookedMesh& cooked_mesh : scene_cache.meshes)
+		{
+			Mesh mesh;
+			mesh.name = cooked_mesh.name;
+
+			for (uint32_t i = 0; i < cooked_mesh.primitives_count; i++)
+			{
+				const CookedPrimitive& cooked_primitive = scene_cache.primitives[cooked_mesh.first_primitive + i];
+
+				Primitive primitive;
+				primitive.topology = cooked_primitive.topology;
+				primitive.material_id = cooked_primitive.material_id;
+				primitive.bbox = cooked_primitive.bbox;
+				primitive.index = primitive_index_count;
+				primitive.cooked_vertices = scene_cache.vertices.subspan(cooked_primitive.vertex_offset, cooked_primitive.vertex_count);
+				primitive.cooked_indices = scene_cache.indices.subspan(cooked_primitive.index_offset, cooked_primitive.index_count);
+				primitive.lods.assign(
+					scene_cache.lods.begin() + cooked_primitive.first_lod, scene_cache.lods.begin() + cooked_primitive.first_lod + cooked_primitive.lods_count);
+
+				mesh.primitives.push_back(primitive);
+
+				primitive_index_count++;
+			}
+
+			model.meshes.push_back(mesh);
+		}
+
+		for (const DirectX::XMFLOAT4X4& transform : scene_cache.transforms)
+		{
+			model.transforms.push_back(DirectX::XMLoadFloat4x4(&transform));
+		}
+
+		model.cooked_data = scene_cache.file;
+
+		job_system->Wait(images_job);
+
+		command_queue->CloseCommandList(load_gltf_context.copy_cmd_list);
+		load_gltf_context.copy_cmd_list = nullptr;
+
+		auto fence_value = command_queue->ExecuteCommandLists();
+
+		if (!fence_value.has_value())
 		{
-			ysn::LogError << "Failed to read: " << load_path_str << "\n";
 			return false;
 		}
 
+		command_queue->WaitForFenceValue(fence_value.value());
+
+		if (!images_decoded)
+		{
+			RollbackTextures(model, load_gltf_context, descriptors_count);
+			return false;
+		}
+
+		render_scene.materials_count += static_cast<uint32_t>(scene_cache.materials.size());
+		render_scene.indices_count += static_cast<uint32_t>(scene_cache.indices.size());
+		render_scene.vertices_count += static_cast<uint32_t>(scene_cache.vertices.size());
+		render_scene.primitives_count += primitive_index_count;
+
+		return true;
+	}
+
+	bool LoadGltfFromFile(RenderScene& render_scene, const std::wstring& load_path, const LoadingParameters& loading_parameters)
+	{
+		const auto load_start_time = std::chrono::high_resolution_clock::now();
+
+		const std::string load_path_str = ysn::WStringToString(load_path);
+		const std::wstring cache_path = GetSceneCachePath(load_path);
+		const uint64_t loading_parameters_hash = HashLoadingParameters(loading_parameters);
+
+		if (loading_parameters.use_scene_cache)
+		{
+			const std::optional<SceneCache> scene_cache = ReadSceneCache(cache_path, loading_parameters_hash);
+
+			if (scene_cache.has_value())
+			{
+				Model model;
+
+				if (ReadModelFromCache(render_scene, model, scene_cache.value(), std::filesystem::path(load_path).parent_path(), loading_parameters))
+				{
+					render_scene.models.push_back(model);
+
+					const auto duration =
+						std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - load_start_time);
+					ysn::LogInfo << "Scene cache loaded successfully: " << load_path_str << ", duration: " << std::to_string(duration.count())
+								<< " ms, workers: " << std::to_string(Application::Get().GetJobSystem()->GetWorkersCount()) << "\n";
+
+					return true;
+				}
+
+				ysn::LogWarning << "Scene cache can't be used, falling back to GLTF: " << load_path_str << "\n";
+			}
+		}
+
+		tinygltf::Model gltf_model;
+
+		if (!ReadGltfFile(gltf_model, load_path_str))
+			return false;
+
 		Model model;
 
-		if (!ReadModel(render_scene, model, gltf_model, loading_parameters))
+		if (!ReadModel(render_scene, model, gltf_model, std::filesystem::path(load_path).parent_path(), loading_parameters))
 		{
 			ysn::LogInfo << "GLTF can't load model\n";
 			return false;
 		}
 
-		render_scene.models.push_back(model);
+		const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - load_start_time);
+		ysn::LogInfo << "GLTF loaded successfully: " << load_path_str << ", duration: " << std::to_string(duration.count())
+					<< " ms, workers: " << std::to_string(Application::Get().GetJobSystem()->GetWorkersCount()) << "\n";
+
+		if (loading_parameters.use_scene_cache)
+		{
+			WriteGltfSceneCache(model, gltf_model, std::filesystem::path(load_path), loading_parameters_hash);
+		}
+
+		BindMaterialTextures(model);
 
-		ysn::LogInfo << "GLTF loaded successfully: " << load_path_str << "\n";
+		render_scene.models.push_back(model);
 
 		return true;
 	}
+
+	std::optional<std::vector<Mesh>> ImportGltfMeshes(const std::wstring& path, const LoadingParameters& loading_parameters, JobSystem& job_system)
+	{
+		tinygltf::Model gltf_model;
+
+		if (!ReadGltfFile(gltf_model, WStringToString(path)))
+			return std::nullopt;
+
+		Model model;
+		std::vector<MeshOptimizationStatistics> optimization_statistics;
+
+		job_system.Wait(BuildMeshes(model, optimization_statistics, gltf_model, loading_parameters, job_system));
+
+		return std::move(model.meshes);
+	}
+
+	std::optional<Model> ImportGltfModel(const std::wstring& path, const LoadingParameters& loading_parameters, JobSystem& job_system)
+	{
+		tinygltf::Model gltf_model;
+
+		if (!ReadGltfFile(gltf_model, WStringToString(path)))
+			return std::nullopt;
+
+		Model model;
+		BuildModel(model, gltf_model, loading_parameters, job_system);
+
+		return model;
+	}
+
+	bool CookGltfSceneCache(const std::wstring& path, const LoadingParameters& loading_parameters, JobSystem& job_system)
+	{
+		tinygltf::Model gltf_model;
+
+		if (!ReadGltfFile(gltf_model, WStringToString(path)))
+			return false;
+
+		Model model;
+		BuildModel(model, gltf_model, loading_parameters, job_system);
+
+		return WriteGltfSceneCache(model, gltf_model, std::filesystem::path(path), HashLoadingParameters(loading_parameters));
+	}
 }
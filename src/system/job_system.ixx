@@ -0,0 +1,337 @@
+export module system.job_system;
+
+import std;
+import system.profiler;
+import system.logger;
+
+export namespace ysn
+{
+	struct Job
+	{
+		std::function<void()> function;
+
+		std::atomic<std::uint32_t> unfinished_dependencies = 0;
+		std::atomic<bool> finished = false;
+
+		// Jobs waiting for this one, released when it finishes
+		std::mutex continuations_mutex;
+		std::vector<std::shared_ptr<Job>> continuations;
+	};
+
+	using JobHandle = std::shared_ptr<Job>;
+
+	// Work stealing scheduler, every worker owns a deque, pops newest jobs from its back and steals oldest from others front.
+	// Threads outside of the pool push into shared queue and help with execution while waiting.
+	// Without workers every job runs on the thread which waits for it, that is serial reference for tests.
+	class JobSystem
+	{
+	public:
+		explicit JobSystem(std::uint32_t workers_count = std::max(std::thread::hardware_concurrency(), 2u) - 1);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		std::uint32_t GetWorkersCount() const
+		{
+			return static_cast<std::uint32_t>(m_workers.size());
+		}
+
+		// Job starts only after all dependencies are finished
+		JobHandle Schedule(std::function<void()> function, std::span<const JobHandle> dependencies = {});
+
+		// Splits [0, count) into batches, returned job finishes when every index is processed
+		JobHandle ScheduleParallelFor(
+			std::uint32_t count, std::uint32_t batch_size, std::function<void(std::uint32_t)> function, std::span<const JobHandle> dependencies = {});
+
+		void ParallelFor(std::uint32_t count, std::uint32_t batch_size, std::function<void(std::uint32_t)> function);
+
+		// Executes pending jobs on the calling thread until handle is finished
+		void Wait(const JobHandle& handle);
+		void Wait(std::span<const JobHandle> handles);
+
+	private:
+		struct WorkQueue
+		{
+			std::mutex mutex;
+			std::deque<JobHandle> jobs;
+		};
+
+		void WorkerLoop(std::uint32_t worker_index);
+
+		void Enqueue(JobHandle job);
+		bool TryExecuteJob();
+		JobHandle PopJob(std::uint32_t queue_index);
+		JobHandle StealJob(std::uint32_t queue_index);
+		void Finish(const JobHandle& job);
+
+		std::uint32_t GetQueueIndex() const;
+
+		std::vector<std::thread> m_workers;
+		std::vector<std::unique_ptr<WorkQueue>> m_queues; // One per worker, last one is shared by external threads
+
+		std::atomic<std::uint32_t> m_queued_jobs = 0;
+		std::atomic<bool> m_is_running = true;
+
+		std::mutex m_wake_mutex;
+		std::condition_variable m_wake_condition;
+	};
+}
+
+module :private;
+
+namespace ysn
+{
+	static thread_local const JobSystem* g_current_job_system = nullptr;
+	static thread_local std::uint32_t g_current_worker_index = 0;
+
+	JobSystem::JobSystem(std::uint32_t workers_count)
+	{
+		for (std::uint32_t i = 0; i < workers_count + 1; i++)
+		{
+			m_queues.push_back(std::make_unique<WorkQueue>());
+		}
+
+		for (std::uint32_t i = 0; i < workers_count; i++)
+		{
+			m_workers.emplace_back([this, i]() { WorkerLoop(i); });
+		}
+
+		LogInfo << "Job system started with " << std::to_string(workers_count) << " workers\n";
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard lock(m_wake_mutex);
+			m_is_running = false;
+		}
+
+		m_wake_condition.notify_all();
+
+		for (std::thread& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	JobHandle JobSystem::Schedule(std::function<void()> function, std::span<const JobHandle> dependencies)
+	{
+		JobHandle job = std::make_shared<Job>();
+		job->function = std::move(function);
+
+		// Extra reference keeps job from being released while dependencies are still registering
+		job->unfinished_dependencies = 1;
+
+		for (const JobHandle& dependency : dependencies)
+		{
+			if (!dependency)
+				continue;
+
+			std::lock_guard lock(dependency->continuations_mutex);
+
+			if (!dependency->finished.load(std::memory_order_acquire))
+			{
+				job->unfinished_dependencies.fetch_add(1, std::memory_order_relaxed);
+				dependency->continuations.push_back(job);
+			}
+		}
+
+		if (job->unfinished_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			Enqueue(job);
+		}
+
+		return job;
+	}
+
+	JobHandle JobSystem::ScheduleParallelFor(
+		std::uint32_t count, std::uint32_t batch_size, std::function<void(std::uint32_t)> function, std::span<const JobHandle> dependencies)
+	{
+		batch_size = std::max(batch_size, 1u);
+
+		// Shared between batches, lives until the last one is done
+		auto shared_function = std::make_shared<std::function<void(std::uint32_t)>>(std::move(function));
+
+		std::vector<JobHandle> batches;
+		batches.reserve((count + batch_size - 1) / batch_size);
+
+		for (std::uint32_t begin = 0; begin < count; begin += batch_size)
+		{
+			const std::uint32_t end = std::min(begin + batch_size, count);
+
+			batches.push_back(Schedule(
+				[shared_function, begin, end]()
+				{
+					for (std::uint32_t i = begin; i < end; i++)
+					{
+						(*shared_function)(i);
+					}
+				},
+				dependencies));
+		}
+
+		if (batches.empty())
+		{
+			return Schedule([]() {}, dependencies);
+		}
+
+		return Schedule([]() {}, batches);
+	}
+
+	void JobSystem::ParallelFor(std::uint32_t count, std::uint32_t batch_size, std::function<void(std::uint32_t)> function)
+	{
+		Wait(ScheduleParallelFor(count, batch_size, std::move(function)));
+	}
+
+	void JobSystem::Wait(const JobHandle& handle)
+	{
+		while (handle && !handle->finished.load(std::memory_order_acquire))
+		{
+			if (!TryExecuteJob())
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void JobSystem::Wait(std::span<const JobHandle> handles)
+	{
+		for (const JobHandle& handle : handles)
+		{
+			Wait(handle);
+		}
+	}
+
+	void JobSystem::WorkerLoop(std::uint32_t worker_index)
+	{
+		g_current_job_system = this;
+		g_current_worker_index = worker_index;
+
+		ProfilerSetThreadName(std::format("Job Worker {}", worker_index));
+
+		while (true)
+		{
+			if (TryExecuteJob())
+				continue;
+
+			std::unique_lock lock(m_wake_mutex);
+			m_wake_condition.wait(lock, [this]() { return m_queued_jobs.load(std::memory_order_acquire) > 0 || !m_is_running; });
+
+			if (!m_is_running)
+				break;
+		}
+	}
+
+	void JobSystem::Enqueue(JobHandle job)
+	{
+		WorkQueue& queue = *m_queues[GetQueueIndex()];
+
+		{
+			std::lock_guard lock(queue.mutex);
+			queue.jobs.push_back(std::move(job));
+		}
+
+		const std::uint32_t queued_jobs = m_queued_jobs.fetch_add(1, std::memory_order_release) + 1;
+		ProfilerCounter("Queued Jobs", static_cast<double>(queued_jobs));
+
+		// Empty lock orders this notify after sleeping worker predicate check, otherwise wake up could be lost
+		{
+			std::lock_guard lock(m_wake_mutex);
+		}
+
+		m_wake_condition.notify_one();
+	}
+
+	bool JobSystem::TryExecuteJob()
+	{
+		const std::uint32_t queue_index = GetQueueIndex();
+
+		JobHandle job = PopJob(queue_index);
+
+		if (!job)
+		{
+			job = StealJob(queue_index);
+		}
+
+		if (!job)
+			return false;
+
+		m_queued_jobs.fetch_sub(1, std::memory_order_acq_rel);
+
+		{
+			ScopedZone zone("Job");
+			job->function();
+		}
+
+		job->function = nullptr;
+
+		Finish(job);
+
+		return true;
+	}
+
+	JobHandle JobSystem::PopJob(std::uint32_t queue_index)
+	{
+		WorkQueue& queue = *m_queues[queue_index];
+
+		std::lock_guard lock(queue.mutex);
+
+		if (queue.jobs.empty())
+			return nullptr;
+
+		JobHandle job = std::move(queue.jobs.back());
+		queue.jobs.pop_back();
+
+		return job;
+	}
+
+	JobHandle JobSystem::StealJob(std::uint32_t queue_index)
+	{
+		const std::uint32_t queues_count = static_cast<std::uint32_t>(m_queues.size());
+
+		for (std::uint32_t i = 1; i < queues_count; i++)
+		{
+			WorkQueue& queue = *m_queues[(queue_index + i) % queues_count];
+
+			std::lock_guard lock(queue.mutex);
+
+			if (queue.jobs.empty())
+				continue;
+
+			JobHandle job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+
+			return job;
+		}
+
+		return nullptr;
+	}
+
+	void JobSystem::Finish(const JobHandle& job)
+	{
+		std::vector<JobHandle> continuations;
+
+		{
+			std::lock_guard lock(job->continuations_mutex);
+			job->finished.store(true, std::memory_order_release);
+			continuations.swap(job->continuations);
+		}
+
+		for (JobHandle& continuation : continuations)
+		{
+			if (continuation->unfinished_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				Enqueue(std::move(continuation));
+			}
+		}
+	}
+
+	std::uint32_t JobSystem::GetQueueIndex() const
+	{
+		if (g_current_job_system == this)
+			return g_current_worker_index;
+
+		return static_cast<std::uint32_t>(m_queues.size() - 1);
+	}
+}
@@ -1,121 +1,891 @@
 module;
 
-#pragma warning(push)
-#pragma warning(disable : 4505) // warning C4505: 'AixLog::operator <<': unreferenced function with internal linkage has been removed
-#pragma warning(disable : 4100) // warning C4100: 'metadata': unreferenced formal parameter
-#include <aixlog.hpp>
-#pragma warning(pop)
+#ifdef _WIN32
+#include <Windows.h>
+#endif
 
 export module system.logger;
 
 import std;
 import system.compilation;
 
-namespace logger
+export namespace ysn
 {
-	struct Info
+	enum class LogSeverity : std::uint8_t
 	{
-		Info& operator<<(std::string_view msg);
+		Debug,
+		Info,
+		Warning,
+		Error,
+		Fatal
 	};
 
-	struct Warning
+	std::string_view GetLogSeverityName(LogSeverity severity);
+
+	// Formatted on logger thread and handed to every sink
+	struct LogMessage
 	{
-		Warning& operator<<(std::string_view msg);
+		LogSeverity severity = LogSeverity::Info;
+		std::chrono::system_clock::time_point time;
+		std::uint64_t sequence = 0; // Statement order across all threads, sinks get it increasing
+		std::uint32_t thread_index = 0;
+		std::string_view text; // Statement text without trailing new line
+		std::string_view line; // Text with time and severity prefix
 	};
 
-	struct Error
+	// Sinks are called only from logger thread
+	class LogSink
 	{
-		Error& operator<<(std::string_view msg);
+	public:
+		virtual ~LogSink() = default;
+
+		virtual void Write(const LogMessage& message) = 0;
+		virtual void Flush()
+		{
+		}
 	};
 
-	struct Debug
+	class FileLogSink : public LogSink
 	{
-		Debug& operator<<(std::string_view msg);
+	public:
+		FileLogSink(const std::filesystem::path& path);
+
+		void Write(const LogMessage& message) override;
+		void Flush() override;
+
+	private:
+		std::ofstream m_file;
 	};
 
-	struct Fatal
+	// Debugger output on Windows, standard error elsewhere
+	class DebugOutputLogSink : public LogSink
 	{
-		Fatal& operator<<(std::string_view msg);
+	public:
+		void Write(const LogMessage& message) override;
 	};
-}; // namespace logger
 
-export namespace ysn
-{
-	logger::Info LogInfo;
-	logger::Warning LogWarning;
-	logger::Error LogError;
-	logger::Debug LogDebug;
-	logger::Fatal LogFatal;
+	enum class LogArgumentType : std::uint8_t
+	{
+		String,
+		Signed,
+		Unsigned,
+		Float
+	};
 
-	void InitializeLogger();
-}
+	// Raw statement arguments, formatting is deferred to logger thread
+	struct LogRecord
+	{
+		static constexpr std::uint32_t payload_capacity = 200;
 
-module :private;
+		std::chrono::system_clock::time_point time;
+		std::uint64_t sequence = 0; // Taken when statement ends, every value is pushed so sequence has no gaps
+		std::string* overflow = nullptr; // Payload moves here when it doesn't fit, owned by record
+		std::uint32_t thread_index = 0;
+		std::uint32_t suppressed_count = 0; // Statements of same call site dropped by rate limit before this one
+		std::uint16_t payload_size = 0;
+		LogSeverity severity = LogSeverity::Info;
+		std::array<char, payload_capacity> payload;
+	};
 
-namespace logger
-{
-	Info& Info::operator<<(std::string_view msg)
+	// Single producer single consumer ring, owning thread pushes and logger thread drains
+	class LogThreadQueue
 	{
-		LOG(AixLog::Severity::info) << msg;
-		return *this;
+	public:
+		static constexpr std::uint32_t capacity = 512;
+
+		LogThreadQueue(std::uint32_t thread_index) : m_thread_index(thread_index)
+		{
+		}
+
+		bool TryPush(const LogRecord& record)
+		{
+			const std::uint64_t write_position = m_write_position.load(std::memory_order_relaxed);
+
+			if (write_position - m_cached_read_position >= capacity)
+			{
+				m_cached_read_position = m_read_position.load(std::memory_order_acquire);
+
+				if (write_position - m_cached_read_position >= capacity)
+					return false;
+			}
+
+			m_records[write_position & (capacity - 1)] = record;
+			m_write_position.store(write_position + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		template <typename Function>
+		void Drain(Function&& function)
+		{
+			const std::uint64_t read_position = m_read_position.load(std::memory_order_relaxed);
+			const std::uint64_t write_position = m_write_position.load(std::memory_order_acquire);
+
+			for (std::uint64_t i = read_position; i < write_position; i++)
+			{
+				function(m_records[i & (capacity - 1)]);
+			}
+
+			m_read_position.store(write_position, std::memory_order_release);
+		}
+
+		// Producer side only
+		bool IsHalfFull()
+		{
+			const std::uint64_t write_position = m_write_position.load(std::memory_order_relaxed);
+
+			if (write_position - m_cached_read_position < capacity / 2)
+				return false;
+
+			m_cached_read_position = m_read_position.load(std::memory_order_acquire);
+
+			return write_position - m_cached_read_position >= capacity / 2;
+		}
+
+		std::uint32_t GetThreadIndex() const
+		{
+			return m_thread_index;
+		}
+
+	private:
+		std::array<LogRecord, capacity> m_records;
+		std::uint32_t m_thread_index = 0;
+
+		// Padding keeps producer and consumer positions on separate cache lines
+		std::atomic<std::uint64_t> m_write_position = 0;
+		std::uint64_t m_cached_read_position = 0;
+		std::array<std::uint8_t, 64> m_padding = {};
+		std::atomic<std::uint64_t> m_read_position = 0;
 	};
 
-	Warning& Warning::operator<<(std::string_view msg)
+	struct LoggerStats
 	{
-		LOG(AixLog::Severity::warning) << msg;
-		return *this;
+		std::uint64_t records = 0;
+		std::uint64_t suppressed = 0; // Dropped by rate limit
+		std::uint64_t duplicates = 0; // Collapsed into "repeated" line
 	};
 
-	Error& Error::operator<<(std::string_view msg)
+	class Logger
 	{
-		LOG(AixLog::Severity::error) << msg;
-		return *this;
+	public:
+		static constexpr std::uint32_t rate_limit_slots = 4096;
+
+		// Statement hit every frame is cut to this many lines, loading bursts of a few dozen lines per statement pass
+		static constexpr std::uint32_t default_max_records_per_second = 50;
+
+		static Logger& Get()
+		{
+			static Logger logger;
+			return logger;
+		}
+
+		Logger();
+		~Logger();
+
+		Logger(const Logger&) = delete;
+		Logger& operator=(const Logger&) = delete;
+
+		void AddSink(std::shared_ptr<LogSink> sink);
+		void RemoveSink(const std::shared_ptr<LogSink>& sink);
+
+		// Limit per statement location in source, zero disables it
+		void SetMaxRecordsPerSecond(std::uint32_t max_records_per_second);
+
+		void Push(LogRecord& record);
+
+		// Returns false when statement has to be dropped
+		bool AcquireRateLimit(const std::source_location& location, const LogRecord& record, std::uint32_t& suppressed_count);
+
+		// Blocks until everything logged before the call reached sinks
+		void Flush();
+
+		LoggerStats GetStats() const;
+
+	private:
+		struct ThreadState
+		{
+			std::unique_ptr<LogThreadQueue> queue;
+		};
+
+		// Colliding call sites take over the slot, limiting is best effort
+		struct RateLimitSlot
+		{
+			std::atomic<std::uint64_t> key = 0;
+			std::atomic<std::int64_t> window = -1;
+			std::atomic<std::uint32_t> count = 0;
+			std::atomic<std::uint32_t> suppressed = 0;
+		};
+
+		LogThreadQueue& GetThreadQueue()
+		{
+			if (!t_queue || t_logger != this)
+			{
+				t_queue = &RegisterThread();
+				t_logger = this;
+			}
+
+			return *t_queue;
+		}
+
+		LogThreadQueue& RegisterThread();
+		void WakeUp();
+
+		void WorkerLoop();
+		bool ProcessRecords(bool is_stopping);
+		void WriteRecord(const LogRecord& record);
+		void WriteRepeatedMessage();
+		void WriteMessage(
+			LogSeverity severity, std::chrono::system_clock::time_point time, std::uint64_t sequence, std::uint32_t thread_index, std::string_view text);
+
+		static inline thread_local LogThreadQueue* t_queue = nullptr;
+		static inline thread_local Logger* t_logger = nullptr;
+
+		std::atomic<std::uint64_t> m_sequence = 0;
+		std::atomic<std::uint32_t> m_max_records_per_second = default_max_records_per_second;
+		std::array<RateLimitSlot, rate_limit_slots> m_rate_limits;
+
+		std::mutex m_threads_mutex;
+		std::vector<std::unique_ptr<ThreadState>> m_threads;
+
+		std::mutex m_sinks_mutex;
+		std::vector<std::shared_ptr<LogSink>> m_sinks;
+
+		// Guarded by m_wake_mutex
+		std::mutex m_wake_mutex;
+		std::condition_variable m_wake_condition;
+		std::condition_variable m_flush_condition;
+		std::uint64_t m_flush_sequence = 0; // Statements below it have to reach sinks
+		std::uint64_t m_flushed_sequence = 0; // Statements below it reached sinks and sinks are flushed
+		bool m_is_running = true;
+
+		std::atomic<bool> m_is_wake_pending = false; // Coalesces wake ups from producers until logger thread runs
+		std::atomic<bool> m_is_stopped = false;
+		std::thread m_worker;
+
+		// Logger thread only
+		std::vector<LogRecord> m_batch; // Drained records after lowest sequence not pushed yet are held back here
+		std::uint64_t m_next_sequence = 0;
+		std::string m_text;
+		std::string m_line;
+		std::string m_last_text;
+		LogSeverity m_last_severity = LogSeverity::Info;
+		std::uint64_t m_last_sequence = 0;
+		std::uint32_t m_last_thread_index = 0;
+		std::uint32_t m_repeat_count = 0;
+
+		std::atomic<std::uint64_t> m_records_count = 0;
+		std::atomic<std::uint64_t> m_suppressed_count = 0;
+		std::atomic<std::uint64_t> m_duplicates_count = 0;
 	};
 
-	Debug& Debug::operator<<(std::string_view msg)
+	class LogStatementStart;
+
+	// Collects one statement, record is enqueued when statement ends
+	class LogRecordBuilder
 	{
-		LOG(AixLog::Severity::debug) << msg;
-		return *this;
+	public:
+		LogRecordBuilder(LogSeverity severity, const LogStatementStart& first_value);
+
+		~LogRecordBuilder()
+		{
+			if (m_is_suppressed)
+				return;
+
+			Logger::Get().Push(m_record);
+
+			if (m_record.severity == LogSeverity::Fatal)
+			{
+				Logger::Get().Flush();
+			}
+		}
+
+		LogRecordBuilder(const LogRecordBuilder&) = delete;
+		LogRecordBuilder& operator=(const LogRecordBuilder&) = delete;
+
+		template <typename T>
+		LogRecordBuilder&& operator<<(const T& value) &&
+		{
+			Append(value);
+			return std::move(*this);
+		}
+
+	private:
+		template <typename T>
+		void Append(const T& value)
+		{
+			if (m_is_suppressed)
+				return;
+
+			if constexpr (std::is_same_v<T, bool>)
+			{
+				AppendString(value ? "true" : "false");
+			}
+			else if constexpr (std::is_same_v<T, char>)
+			{
+				AppendString(std::string_view(&value, 1));
+			}
+			else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+			{
+				AppendValue(LogArgumentType::Signed, static_cast<std::int64_t>(value));
+			}
+			else if constexpr (std::is_integral_v<T>)
+			{
+				AppendValue(LogArgumentType::Unsigned, static_cast<std::uint64_t>(value));
+			}
+			else if constexpr (std::is_floating_point_v<T>)
+			{
+				AppendValue(LogArgumentType::Float, static_cast<double>(value));
+			}
+			else
+			{
+				AppendString(std::string_view(value));
+			}
+		}
+
+		void AppendString(std::string_view value)
+		{
+			const LogArgumentType type = LogArgumentType::String;
+			const std::uint32_t size = static_cast<std::uint32_t>(value.size());
+
+			AppendBytes(&type, sizeof(type));
+			AppendBytes(&size, sizeof(size));
+			AppendBytes(value.data(), value.size());
+		}
+
+		template <typename T>
+		void AppendValue(LogArgumentType type, T value)
+		{
+			AppendBytes(&type, sizeof(type));
+			AppendBytes(&value, sizeof(value));
+		}
+
+		void AppendBytes(const void* data, std::size_t size)
+		{
+			if (!m_record.overflow && m_record.payload_size + size <= LogRecord::payload_capacity)
+			{
+				std::memcpy(m_record.payload.data() + m_record.payload_size, data, size);
+				m_record.payload_size += static_cast<std::uint16_t>(size);
+				return;
+			}
+
+			if (!m_record.overflow)
+			{
+				m_record.overflow = new std::string(m_record.payload.data(), m_record.payload_size);
+			}
+
+			m_record.overflow->append(static_cast<const char*>(data), size);
+		}
+
+		LogRecord m_record;
+		bool m_is_suppressed = false;
 	};
 
-	Fatal& Fatal::operator<<(std::string_view msg)
+	// First argument of statement, conversion into it captures where statement is
+	class LogStatementStart
 	{
-		LOG(AixLog::Severity::fatal) << msg;
-		return *this;
+	public:
+		template <typename T>
+		LogStatementStart(const T& value, std::source_location location = std::source_location::current()) :
+			m_value(&value),
+			m_append([](LogRecordBuilder&& builder, const void* argument) { std::move(builder) << *static_cast<const T*>(argument); }),
+			m_location(location)
+		{
+		}
+
+		void AppendTo(LogRecordBuilder&& builder) const
+		{
+			m_append(std::move(builder), m_value);
+		}
+
+		const std::source_location& GetLocation() const
+		{
+			return m_location;
+		}
+
+	private:
+		const void* m_value = nullptr;
+		void (*m_append)(LogRecordBuilder&& builder, const void* argument) = nullptr;
+		std::source_location m_location;
 	};
-} // namespace logger
+
+	inline LogRecordBuilder::LogRecordBuilder(LogSeverity severity, const LogStatementStart& first_value)
+	{
+		m_record.severity = severity;
+		m_record.time = std::chrono::system_clock::now();
+
+		if (severity != LogSeverity::Fatal)
+		{
+			m_is_suppressed = !Logger::Get().AcquireRateLimit(first_value.GetLocation(), m_record, m_record.suppressed_count);
+		}
+
+		first_value.AppendTo(std::move(*this));
+	}
+
+	template <LogSeverity severity>
+	struct LogChannel
+	{
+		LogRecordBuilder operator<<(const LogStatementStart& first_value) const
+		{
+			return LogRecordBuilder(severity, first_value);
+		}
+	};
+
+	LogChannel<LogSeverity::Info> LogInfo;
+	LogChannel<LogSeverity::Warning> LogWarning;
+	LogChannel<LogSeverity::Error> LogError;
+	LogChannel<LogSeverity::Debug> LogDebug;
+	LogChannel<LogSeverity::Fatal> LogFatal;
+
+	void InitializeLogger();
+	void FlushLogger();
+}
+
+module :private;
 
 namespace ysn
 {
-	struct OutputDebugWindows : public AixLog::SinkFormat
+	std::string_view GetLogSeverityName(LogSeverity severity)
 	{
-		OutputDebugWindows(const AixLog::Filter& filter, const std::string& format) : AixLog::SinkFormat(filter, format)
+		switch (severity)
 		{
+			case LogSeverity::Debug:
+				return "Debug";
+			case LogSeverity::Info:
+				return "Info";
+			case LogSeverity::Warning:
+				return "Warning";
+			case LogSeverity::Error:
+				return "Error";
+			case LogSeverity::Fatal:
+				return "Fatal";
 		}
 
-		void log(const AixLog::Metadata& metadata, const std::string& message) override
+		return "Unknown";
+	}
+
+	FileLogSink::FileLogSink(const std::filesystem::path& path) : m_file(path, std::ios::out | std::ios::trunc)
+	{
+	}
+
+	void FileLogSink::Write(const LogMessage& message)
+	{
+		m_file << message.line << '\n';
+	}
+
+	void FileLogSink::Flush()
+	{
+		m_file.flush();
+	}
+
+	void DebugOutputLogSink::Write(const LogMessage& message)
+	{
+#ifdef _WIN32
+		const std::string line = std::string(message.line) + "\n";
+		OutputDebugStringA(line.c_str());
+#else
+		std::cerr << message.line << '\n';
+#endif
+	}
+
+	Logger::Logger()
+	{
+		m_batch.reserve(LogThreadQueue::capacity);
+		m_worker = std::thread([this]() { WorkerLoop(); });
+	}
+
+	Logger::~Logger()
+	{
 		{
-			std::stringstream ss;
-			do_log(ss, metadata, message);
-			OutputDebugStringA(ss.str().c_str());
+			std::lock_guard lock(m_wake_mutex);
+			m_is_running = false;
 		}
-	};
 
-	void InitializeLogger()
+		m_wake_condition.notify_one();
+		m_worker.join();
+
+		m_is_stopped = true;
+	}
+
+	void Logger::AddSink(std::shared_ptr<LogSink> sink)
+	{
+		std::lock_guard lock(m_sinks_mutex);
+		m_sinks.push_back(std::move(sink));
+	}
+
+	void Logger::RemoveSink(const std::shared_ptr<LogSink>& sink)
+	{
+		std::lock_guard lock(m_sinks_mutex);
+		std::erase(m_sinks, sink);
+	}
+
+	void Logger::SetMaxRecordsPerSecond(std::uint32_t max_records_per_second)
+	{
+		m_max_records_per_second.store(max_records_per_second, std::memory_order_relaxed);
+	}
+
+	LogThreadQueue& Logger::RegisterThread()
+	{
+		std::lock_guard lock(m_threads_mutex);
+
+		auto thread = std::make_unique<ThreadState>();
+		thread->queue = std::make_unique<LogThreadQueue>(static_cast<std::uint32_t>(m_threads.size()));
+
+		// Queues stay alive after thread exit so its records still can be written
+		m_threads.push_back(std::move(thread));
+
+		return *m_threads.back()->queue;
+	}
+
+	void Logger::WakeUp()
+	{
+		if (!m_is_wake_pending.exchange(true, std::memory_order_acq_rel))
+		{
+			m_wake_condition.notify_one();
+		}
+	}
+
+	void Logger::Push(LogRecord& record)
+	{
+		// Nothing drains queues anymore
+		if (m_is_stopped.load(std::memory_order_relaxed))
+		{
+			delete record.overflow;
+			return;
+		}
+
+		LogThreadQueue& queue = GetThreadQueue();
+
+		record.thread_index = queue.GetThreadIndex();
+		record.sequence = m_sequence.fetch_add(1, std::memory_order_relaxed);
+
+		// Full queue waits for logger thread instead of losing records
+		while (!queue.TryPush(record))
+		{
+			WakeUp();
+			std::this_thread::yield();
+		}
+
+		if (queue.IsHalfFull())
+		{
+			WakeUp();
+		}
+	}
+
+	bool Logger::AcquireRateLimit(const std::source_location& location, const LogRecord& record, std::uint32_t& suppressed_count)
+	{
+		const std::uint32_t max_records_per_second = m_max_records_per_second.load(std::memory_order_relaxed);
+
+		if (max_records_per_second == 0)
+			return true;
+
+		// File name of one statement is always the same string, so its address is enough, high bits are folded into slot index
+		const std::uint64_t location_key =
+			reinterpret_cast<std::uintptr_t>(location.file_name()) ^ (static_cast<std::uint64_t>(location.line()) << 16) ^ location.column();
+
+		std::uint64_t call_site_key = location_key * 0x9E3779B97F4A7C15ull;
+		call_site_key ^= call_site_key >> 32;
+
+		RateLimitSlot& slot = m_rate_limits[call_site_key % rate_limit_slots];
+
+		const std::int64_t window = std::chrono::duration_cast<std::chrono::seconds>(record.time.time_since_epoch()).count();
+
+		if (slot.key.load(std::memory_order_relaxed) != call_site_key)
+		{
+			slot.key.store(call_site_key, std::memory_order_relaxed);
+			slot.window.store(window, std::memory_order_relaxed);
+			slot.count.store(0, std::memory_order_relaxed);
+			slot.suppressed.store(0, std::memory_order_relaxed);
+		}
+
+		std::int64_t slot_window = slot.window.load(std::memory_order_relaxed);
+
+		if (slot_window != window && slot.window.compare_exchange_strong(slot_window, window, std::memory_order_relaxed))
+		{
+			slot.count.store(0, std::memory_order_relaxed);
+		}
+
+		if (slot.count.fetch_add(1, std::memory_order_relaxed) < max_records_per_second)
+		{
+			suppressed_count = slot.suppressed.exchange(0, std::memory_order_relaxed);
+			return true;
+		}
+
+		slot.suppressed.fetch_add(1, std::memory_order_relaxed);
+		m_suppressed_count.fetch_add(1, std::memory_order_relaxed);
+
+		return false;
+	}
+
+	void Logger::Flush()
+	{
+		if (m_is_stopped.load(std::memory_order_relaxed) || std::this_thread::get_id() == m_worker.get_id())
+			return;
+
+		std::unique_lock lock(m_wake_mutex);
+
+		// Statements logged before the call have lower sequence, ones other threads are still pushing are waited for
+		const std::uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+
+		m_flush_sequence = std::max(m_flush_sequence, sequence);
+
+		m_wake_condition.notify_one();
+		m_flush_condition.wait(lock, [&]() { return m_flushed_sequence >= sequence || !m_is_running; });
+	}
+
+	LoggerStats Logger::GetStats() const
+	{
+		LoggerStats stats;
+		stats.records = m_records_count.load(std::memory_order_relaxed);
+		stats.suppressed = m_suppressed_count.load(std::memory_order_relaxed);
+		stats.duplicates = m_duplicates_count.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	void Logger::WorkerLoop()
+	{
+		while (true)
+		{
+			bool is_flush_requested = false;
+			bool is_running = true;
+
+			{
+				std::unique_lock lock(m_wake_mutex);
+				m_wake_condition.wait_for(lock, std::chrono::milliseconds(10), [&]() {
+					return m_is_wake_pending.load(std::memory_order_acquire) || m_flush_sequence > m_flushed_sequence || !m_is_running;
+				});
+
+				is_flush_requested = m_flush_sequence > m_flushed_sequence;
+				is_running = m_is_running;
+			}
+
+			m_is_wake_pending.store(false, std::memory_order_release);
+
+			// Producers are gone when stopping, so held back records are written as well
+			const bool has_written = ProcessRecords(!is_running);
+
+			{
+				std::lock_guard sinks_lock(m_sinks_mutex);
+
+				if (is_flush_requested || !is_running)
+				{
+					WriteRepeatedMessage();
+				}
+
+				// Cheap enough at this rate and keeps file complete after crash
+				if (has_written || is_flush_requested || !is_running)
+				{
+					for (const auto& sink : m_sinks)
+					{
+						sink->Flush();
+					}
+				}
+			}
+
+			if (is_flush_requested)
+			{
+				bool is_flush_reached = false;
+
+				{
+					std::lock_guard lock(m_wake_mutex);
+					m_flushed_sequence = m_next_sequence;
+					is_flush_reached = m_flushed_sequence >= m_flush_sequence;
+				}
+
+				m_flush_condition.notify_all();
+
+				// Some producer took its sequence but didn't push yet, it is about to
+				if (!is_flush_reached)
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			if (!is_running)
+				break;
+		}
+	}
+
+	bool Logger::ProcessRecords(bool is_stopping)
 	{
-		const std::string format = "%H:%M:%S.#ms %d.%m [#severity] ";
+		std::vector<LogThreadQueue*> queues;
+
+		{
+			std::lock_guard lock(m_threads_mutex);
+
+			queues.reserve(m_threads.size());
+
+			for (const auto& thread : m_threads)
+			{
+				queues.push_back(thread->queue.get());
+			}
+		}
+
+		for (LogThreadQueue* queue : queues)
+		{
+			queue->Drain([&](const LogRecord& record) { m_batch.push_back(record); });
+		}
+
+		// Every queue is ordered already, merge keeps statement order across threads
+		std::sort(m_batch.begin(), m_batch.end(), [](const LogRecord& a, const LogRecord& b) { return a.sequence < b.sequence; });
+
+		// Statement with lower sequence may still be on its way into other queue, everything after it waits for next drain
+		std::size_t written_count = 0;
+
+		while (written_count < m_batch.size() && (m_batch[written_count].sequence == m_next_sequence || is_stopping))
+		{
+			m_next_sequence = m_batch[written_count].sequence + 1;
+			written_count++;
+		}
+
+		if (written_count == 0)
+			return false;
+
+		std::lock_guard lock(m_sinks_mutex);
+
+		for (std::size_t i = 0; i < written_count; i++)
+		{
+			WriteRecord(m_batch[i]);
+			delete m_batch[i].overflow;
+		}
+
+		m_batch.erase(m_batch.begin(), m_batch.begin() + written_count);
+		m_records_count.fetch_add(written_count, std::memory_order_relaxed);
+
+		return true;
+	}
+
+	void Logger::WriteRecord(const LogRecord& record)
+	{
+		const char* data = record.overflow ? record.overflow->data() : record.payload.data();
+		const std::size_t size = record.overflow ? record.overflow->size() : record.payload_size;
+
+		m_text.clear();
+
+		for (std::size_t offset = 0; offset < size;)
+		{
+			LogArgumentType type;
+			std::memcpy(&type, data + offset, sizeof(type));
+			offset += sizeof(type);
+
+			char buffer[32];
 
-		std::vector<AixLog::log_sink_ptr> sinks;
+			switch (type)
+			{
+				case LogArgumentType::String:
+				{
+					std::uint32_t length = 0;
+					std::memcpy(&length, data + offset, sizeof(length));
+					offset += sizeof(length);
 
-		auto sink_file = std::make_shared<AixLog::SinkFile>(AixLog::Severity::trace, "yasno.log", format);
-		sinks.push_back(sink_file);
+					m_text.append(data + offset, length);
+					offset += length;
+					break;
+				}
+				case LogArgumentType::Signed:
+				{
+					std::int64_t value = 0;
+					std::memcpy(&value, data + offset, sizeof(value));
+					offset += sizeof(value);
+
+					m_text.append(buffer, std::to_chars(std::begin(buffer), std::end(buffer), value).ptr);
+					break;
+				}
+				case LogArgumentType::Unsigned:
+				{
+					std::uint64_t value = 0;
+					std::memcpy(&value, data + offset, sizeof(value));
+					offset += sizeof(value);
+
+					m_text.append(buffer, std::to_chars(std::begin(buffer), std::end(buffer), value).ptr);
+					break;
+				}
+				case LogArgumentType::Float:
+				{
+					double value = 0.0;
+					std::memcpy(&value, data + offset, sizeof(value));
+					offset += sizeof(value);
+
+					m_text.append(buffer, std::to_chars(std::begin(buffer), std::end(buffer), value).ptr);
+					break;
+				}
+			}
+		}
+
+		// Sinks put every statement on its own line
+		while (!m_text.empty() && (m_text.back() == '\n' || m_text.back() == '\r' || m_text.back() == ' '))
+		{
+			m_text.pop_back();
+		}
+
+		if (record.suppressed_count == 0 && record.severity == m_last_severity && m_text == m_last_text)
+		{
+			m_last_sequence = record.sequence;
+			m_repeat_count++;
+			m_duplicates_count.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		WriteRepeatedMessage();
+
+		m_last_text = m_text;
+		m_last_severity = record.severity;
+		m_last_sequence = record.sequence;
+		m_last_thread_index = record.thread_index;
+
+		if (record.suppressed_count)
+		{
+			m_text += std::format(" ({} similar messages suppressed)", record.suppressed_count);
+		}
+
+		WriteMessage(record.severity, record.time, record.sequence, record.thread_index, m_text);
+	}
+
+	void Logger::WriteRepeatedMessage()
+	{
+		if (m_repeat_count == 0)
+			return;
+
+		const std::string text = std::format("Last message repeated {} times", m_repeat_count);
+		m_repeat_count = 0;
+
+		WriteMessage(m_last_severity, std::chrono::system_clock::now(), m_last_sequence, m_last_thread_index, text);
+	}
+
+	void Logger::WriteMessage(
+		LogSeverity severity, std::chrono::system_clock::time_point time, std::uint64_t sequence, std::uint32_t thread_index, std::string_view text)
+	{
+		const auto local_time = std::chrono::zoned_time(std::chrono::current_zone(), std::chrono::floor<std::chrono::milliseconds>(time));
+
+		m_line = std::format("{:%H:%M:%S %d.%m} [{}] {}", local_time, GetLogSeverityName(severity), text);
+
+		LogMessage message;
+		message.severity = severity;
+		message.time = time;
+		message.sequence = sequence;
+		message.thread_index = thread_index;
+		message.text = text;
+		message.line = m_line;
+
+		for (const auto& sink : m_sinks)
+		{
+			sink->Write(message);
+		}
+	}
+
+	void InitializeLogger()
+	{
+		Logger& logger = Logger::Get();
+
+		logger.AddSink(std::make_shared<FileLogSink>("yasno.log"));
 
 		if constexpr (!IsReleaseActive())
 		{
-			auto sink_debug_output = std::make_shared<OutputDebugWindows>(AixLog::Severity::trace, format);
-			sinks.push_back(sink_debug_output);
+			logger.AddSink(std::make_shared<DebugOutputLogSink>());
 		}
+	}
 
-		AixLog::Log::init(std::move(sinks));
+	void FlushLogger()
+	{
+		Logger::Get().Flush();
 	}
 }
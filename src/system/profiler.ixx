@@ -1,5 +1,11 @@
 module;
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
 #ifdef SUPERLUMINAL_API_EXIST
 #include <Superluminal/PerformanceAPI_capi.h>
 #endif
@@ -7,38 +13,567 @@ module;
 export module system.profiler;
 
 import std;
+import system.logger;
 
 export namespace ysn
 {
-	void ProfilerSetThreadName(std::string_view name)
+	enum class ProfilerEventType : std::uint8_t
+	{
+		ZoneBegin,
+		ZoneEnd,
+		Counter,
+		FrameMark
+	};
+
+	// Events keep only pointer to name, so it can be made only from string literal and can't dangle
+	class ProfilerName
+	{
+	public:
+		template <std::size_t N>
+		consteval ProfilerName(const char (&literal)[N]) : m_value(literal, N - 1)
+		{
+		}
+
+		std::string_view GetValue() const
+		{
+			return m_value;
+		}
+
+	private:
+		std::string_view m_value;
+	};
+
+	struct ProfilerEvent
+	{
+		std::uint64_t timestamp = 0; // TSC ticks
+		const char* name = nullptr;
+		std::uint32_t name_length = 0;
+		ProfilerEventType type = ProfilerEventType::ZoneBegin;
+		double value = 0.0; // Counter value
+	};
+
+	// Single producer single consumer ring, owning thread pushes and profiler drains once per frame
+	class ProfilerThreadBuffer
+	{
+	public:
+		static constexpr std::uint32_t capacity = 1 << 14;
+
+		ProfilerThreadBuffer(std::uint32_t thread_index) : m_thread_index(thread_index)
+		{
+		}
+
+		// Event is dropped when buffer is full
+		bool Push(const ProfilerEvent& event)
+		{
+			const std::uint64_t write_position = m_write_position.load(std::memory_order_relaxed);
+
+			if (write_position - m_cached_read_position >= capacity)
+			{
+				m_cached_read_position = m_read_position.load(std::memory_order_acquire);
+
+				if (write_position - m_cached_read_position >= capacity)
+				{
+					m_dropped_events.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+			}
+
+			m_events[write_position & (capacity - 1)] = event;
+			m_write_position.store(write_position + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		template <typename Function>
+		std::uint64_t Drain(Function&& function)
+		{
+			const std::uint64_t read_position = m_read_position.load(std::memory_order_relaxed);
+			const std::uint64_t write_position = m_write_position.load(std::memory_order_acquire);
+
+			for (std::uint64_t i = read_position; i < write_position; i++)
+			{
+				function(m_events[i & (capacity - 1)]);
+			}
+
+			m_read_position.store(write_position, std::memory_order_release);
+
+			return write_position - read_position;
+		}
+
+		std::uint32_t GetThreadIndex() const
+		{
+			return m_thread_index;
+		}
+
+		std::uint64_t GetDroppedEventsCount() const
+		{
+			return m_dropped_events.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::array<ProfilerEvent, capacity> m_events;
+		std::uint32_t m_thread_index = 0;
+
+		// Padding keeps producer and consumer positions on separate cache lines
+		std::atomic<std::uint64_t> m_write_position = 0;
+		std::uint64_t m_cached_read_position = 0;
+		std::array<std::uint8_t, 64> m_padding = {};
+		std::atomic<std::uint64_t> m_read_position = 0;
+		std::atomic<std::uint64_t> m_dropped_events = 0;
+	};
+
+	struct ProfilerZoneStats
+	{
+		std::string name;
+		std::uint32_t samples = 0; // In rolling window
+		double p50_ms = 0.0;
+		double p95_ms = 0.0;
+		double p99_ms = 0.0;
+	};
+
+	class Profiler
+	{
+	public:
+		static constexpr std::uint32_t zone_history_size = 256;
+		static constexpr std::uint32_t max_trace_events = 1 << 18;
+
+		static Profiler& Get()
+		{
+			static Profiler profiler;
+			return profiler;
+		}
+
+		Profiler();
+
+		Profiler(const Profiler&) = delete;
+		Profiler& operator=(const Profiler&) = delete;
+
+		ProfilerThreadBuffer& GetThreadBuffer()
+		{
+			if (!t_thread_buffer || t_profiler != this)
+			{
+				t_thread_buffer = &RegisterThread();
+				t_profiler = this;
+			}
+
+			return *t_thread_buffer;
+		}
+
+		void SetThreadName(std::string_view name);
+
+		// Drains every thread buffer, updates zone statistics and keeps recent events for trace dump
+		void Collect();
+
+		std::vector<ProfilerZoneStats> GetZoneStats() const;
+		std::uint64_t GetDroppedEventsCount() const;
+
+		// Collected events in Chrome trace event format, can be opened in chrome://tracing or Perfetto
+		bool DumpChromeTrace(const std::filesystem::path& path);
+
+		double TicksToMicroseconds(std::uint64_t ticks) const;
+
+	private:
+		struct ThreadState
+		{
+			std::unique_ptr<ProfilerThreadBuffer> buffer;
+			std::string name;
+			std::vector<ProfilerEvent> open_zones; // Begin events waiting for end, consumer side
+		};
+
+		struct TraceEvent
+		{
+			std::string_view name;
+			ProfilerEventType type = ProfilerEventType::ZoneBegin;
+			std::uint32_t thread_index = 0;
+			std::uint64_t timestamp = 0;
+			std::uint64_t duration = 0; // Zones only
+			double value = 0.0;
+		};
+
+		struct ZoneHistory
+		{
+			std::array<double, zone_history_size> durations_ms = {};
+			std::uint32_t next = 0;
+			std::uint32_t count = 0;
+		};
+
+		struct StringHash
+		{
+			using is_transparent = void;
+
+			std::size_t operator()(std::string_view value) const
+			{
+				return std::hash<std::string_view>{}(value);
+			}
+		};
+
+		ProfilerThreadBuffer& RegisterThread();
+
+		void ProcessEvent(ThreadState& thread, const ProfilerEvent& event);
+		void AddTraceEvent(const TraceEvent& event);
+
+		static inline thread_local ProfilerThreadBuffer* t_thread_buffer = nullptr;
+		static inline thread_local Profiler* t_profiler = nullptr;
+
+		// Registration happens once per thread, everything else on hot path is lock free
+		mutable std::mutex m_threads_mutex;
+		std::vector<std::unique_ptr<ThreadState>> m_threads;
+
+		// Consumer side, touched only by Collect caller and readers below
+		mutable std::mutex m_collect_mutex;
+		std::unordered_map<std::string, ZoneHistory, StringHash, std::equal_to<>> m_zones;
+		std::vector<TraceEvent> m_trace_events; // Ring of most recent events
+		std::size_t m_trace_next = 0;
+
+		// TSC calibration against steady clock, refined on every collect
+		std::uint64_t m_start_ticks = 0;
+		std::chrono::steady_clock::time_point m_start_time;
+		double m_microseconds_per_tick = 0.0;
+	};
+
+	inline std::uint64_t ProfilerGetTicks()
+	{
+		return __rdtsc();
+	}
+
+	inline void ProfilerPushEvent(ProfilerEventType type, ProfilerName name, double value = 0.0)
+	{
+		Profiler::Get().GetThreadBuffer().Push(
+			ProfilerEvent{ ProfilerGetTicks(), name.GetValue().data(), static_cast<std::uint32_t>(name.GetValue().size()), type, value });
+	}
+
+	inline void ProfilerSetThreadName(std::string_view name)
 	{
 	#ifdef SUPERLUMINAL_API_EXIST
-		PerformanceAPI_SetCurrentThreadName(name.data());
-	#else
-		(void)name;
+		PerformanceAPI_SetCurrentThreadName_N(name.data(), static_cast<std::uint16_t>(name.size()));
 	#endif
+
+		Profiler::Get().SetThreadName(name);
+	}
+
+	inline void ProfilerCounter(ProfilerName name, double value)
+	{
+		ProfilerPushEvent(ProfilerEventType::Counter, name, value);
+	}
+
+	// Marks frame boundary and collects events of the finished frame, call once per frame from main thread
+	inline void ProfilerFrameMark()
+	{
+		ProfilerPushEvent(ProfilerEventType::FrameMark, "Frame");
+		Profiler::Get().Collect();
 	}
 
 	struct ScopedZone
 	{
 		ScopedZone() = delete;
-		ScopedZone(std::string_view name)
+		ScopedZone(ProfilerName name) : m_name(name)
 		{
 		#ifdef SUPERLUMINAL_API_EXIST
-			PerformanceAPI_BeginEvent(name.data(), nullptr, PERFORMANCEAPI_DEFAULT_COLOR);
-		#else
-			(void)name;
+			PerformanceAPI_BeginEvent_N(
+				name.GetValue().data(), static_cast<std::uint16_t>(name.GetValue().size()), nullptr, 0, PERFORMANCEAPI_DEFAULT_COLOR);
 		#endif
+
+			ProfilerPushEvent(ProfilerEventType::ZoneBegin, m_name);
 		}
 
 		~ScopedZone()
 		{
+			ProfilerPushEvent(ProfilerEventType::ZoneEnd, m_name);
+
 		#ifdef SUPERLUMINAL_API_EXIST
 			PerformanceAPI_EndEvent();
+		#endif
 		}
-	#endif
-	};
 
+		ScopedZone(const ScopedZone&) = delete;
+		ScopedZone& operator=(const ScopedZone&) = delete;
+
+	private:
+		ProfilerName m_name;
+	};
 }
 
 module :private;
+
+namespace ysn
+{
+	static double Percentile(std::vector<double>& values, double percentile)
+	{
+		const std::size_t index = std::min(values.size() - 1, static_cast<std::size_t>(percentile * static_cast<double>(values.size())));
+		std::nth_element(values.begin(), values.begin() + index, values.end());
+		return values[index];
+	}
+
+	static void WriteJsonString(std::ostream& stream, std::string_view value)
+	{
+		stream << '"';
+
+		for (const char c : value)
+		{
+			switch (c)
+			{
+				case '"':
+					stream << "\\\"";
+					break;
+				case '\\':
+					stream << "\\\\";
+					break;
+				case '\n':
+					stream << "\\n";
+					break;
+				case '\t':
+					stream << "\\t";
+					break;
+				default:
+					if (static_cast<unsigned char>(c) < 0x20)
+						stream << ' ';
+					else
+						stream << c;
+			}
+		}
+
+		stream << '"';
+	}
+
+	Profiler::Profiler()
+	{
+		m_start_ticks = ProfilerGetTicks();
+		m_start_time = std::chrono::steady_clock::now();
+	}
+
+	ProfilerThreadBuffer& Profiler::RegisterThread()
+	{
+		std::lock_guard lock(m_threads_mutex);
+
+		auto thread = std::make_unique<ThreadState>();
+		thread->buffer = std::make_unique<ProfilerThreadBuffer>(static_cast<std::uint32_t>(m_threads.size()));
+		thread->name = std::format("Thread {}", m_threads.size());
+
+		// Buffers stay alive after thread exit so its events still can be collected
+		m_threads.push_back(std::move(thread));
+
+		return *m_threads.back()->buffer;
+	}
+
+	void Profiler::SetThreadName(std::string_view name)
+	{
+		const std::uint32_t thread_index = GetThreadBuffer().GetThreadIndex();
+
+		std::lock_guard lock(m_threads_mutex);
+		m_threads[thread_index]->name = name;
+	}
+
+	double Profiler::TicksToMicroseconds(std::uint64_t ticks) const
+	{
+		return static_cast<double>(ticks) * m_microseconds_per_tick;
+	}
+
+	void Profiler::Collect()
+	{
+		std::vector<ThreadState*> threads;
+
+		{
+			std::lock_guard lock(m_threads_mutex);
+
+			threads.reserve(m_threads.size());
+
+			for (const auto& thread : m_threads)
+			{
+				threads.push_back(thread.get());
+			}
+		}
+
+		std::lock_guard lock(m_collect_mutex);
+
+		const std::uint64_t elapsed_ticks = ProfilerGetTicks() - m_start_ticks;
+		const std::chrono::duration<double, std::micro> elapsed_time = std::chrono::steady_clock::now() - m_start_time;
+
+		if (elapsed_ticks > 0)
+		{
+			m_microseconds_per_tick = elapsed_time.count() / static_cast<double>(elapsed_ticks);
+		}
+
+		for (ThreadState* thread : threads)
+		{
+			thread->buffer->Drain([&](const ProfilerEvent& event) { ProcessEvent(*thread, event); });
+		}
+	}
+
+	void Profiler::ProcessEvent(ThreadState& thread, const ProfilerEvent& event)
+	{
+		const std::string_view name(event.name, event.name_length);
+		const std::uint32_t thread_index = thread.buffer->GetThreadIndex();
+
+		switch (event.type)
+		{
+			case ProfilerEventType::ZoneBegin:
+				thread.open_zones.push_back(event);
+				break;
+			case ProfilerEventType::ZoneEnd:
+			{
+				// Begin could be dropped on full buffer, unmatched ends are skipped
+				auto begin = std::find_if(thread.open_zones.rbegin(), thread.open_zones.rend(), [&](const ProfilerEvent& open_zone) {
+					return std::string_view(open_zone.name, open_zone.name_length) == name;
+				});
+
+				if (begin == thread.open_zones.rend())
+					break;
+
+				const std::uint64_t begin_timestamp = begin->timestamp;
+				thread.open_zones.erase(std::next(begin).base(), thread.open_zones.end());
+
+				const std::uint64_t duration = event.timestamp - begin_timestamp;
+
+				auto zone = m_zones.find(name);
+
+				if (zone == m_zones.end())
+				{
+					zone = m_zones.emplace(std::string(name), ZoneHistory{}).first;
+				}
+
+				ZoneHistory& history = zone->second;
+				history.durations_ms[history.next] = TicksToMicroseconds(duration) / 1000.0;
+				history.next = (history.next + 1) % zone_history_size;
+				history.count = std::min(history.count + 1, zone_history_size);
+
+				AddTraceEvent({ name, ProfilerEventType::ZoneBegin, thread_index, begin_timestamp, duration, 0.0 });
+				break;
+			}
+			case ProfilerEventType::Counter:
+			case ProfilerEventType::FrameMark:
+				AddTraceEvent({ name, event.type, thread_index, event.timestamp, 0, event.value });
+				break;
+		}
+	}
+
+	void Profiler::AddTraceEvent(const TraceEvent& event)
+	{
+		if (m_trace_events.size() < max_trace_events)
+		{
+			m_trace_events.push_back(event);
+			return;
+		}
+
+		m_trace_events[m_trace_next] = event;
+		m_trace_next = (m_trace_next + 1) % max_trace_events;
+	}
+
+	std::vector<ProfilerZoneStats> Profiler::GetZoneStats() const
+	{
+		std::lock_guard lock(m_collect_mutex);
+
+		std::vector<ProfilerZoneStats> zone_stats;
+		zone_stats.reserve(m_zones.size());
+
+		std::vector<double> durations;
+
+		for (const auto& [name, history] : m_zones)
+		{
+			durations.assign(history.durations_ms.begin(), history.durations_ms.begin() + history.count);
+
+			ProfilerZoneStats stats;
+			stats.name = name;
+			stats.samples = history.count;
+			stats.p50_ms = Percentile(durations, 0.50);
+			stats.p95_ms = Percentile(durations, 0.95);
+			stats.p99_ms = Percentile(durations, 0.99);
+
+			zone_stats.push_back(std::move(stats));
+		}
+
+		std::sort(zone_stats.begin(), zone_stats.end(), [](const ProfilerZoneStats& a, const ProfilerZoneStats& b) { return a.name < b.name; });
+
+		return zone_stats;
+	}
+
+	std::uint64_t Profiler::GetDroppedEventsCount() const
+	{
+		std::lock_guard lock(m_threads_mutex);
+
+		std::uint64_t dropped_events = 0;
+
+		for (const auto& thread : m_threads)
+		{
+			dropped_events += thread->buffer->GetDroppedEventsCount();
+		}
+
+		return dropped_events;
+	}
+
+	bool Profiler::DumpChromeTrace(const std::filesystem::path& path)
+	{
+		Collect();
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+		if (!file)
+		{
+			LogError << "Can't open profiler trace file " << path.string() << "\n";
+			return false;
+		}
+
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+		bool is_first_event = true;
+
+		auto begin_event = [&]() {
+			if (!is_first_event)
+				file << ",\n";
+			is_first_event = false;
+		};
+
+		{
+			std::lock_guard lock(m_threads_mutex);
+
+			for (const auto& thread : m_threads)
+			{
+				begin_event();
+				file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread->buffer->GetThreadIndex() << ",\"args\":{\"name\":";
+				WriteJsonString(file, thread->name);
+				file << "}}";
+			}
+		}
+
+		std::lock_guard lock(m_collect_mutex);
+
+		file << std::fixed << std::setprecision(3);
+
+		// Oldest first, ring wraps at m_trace_next
+		for (std::size_t i = 0; i < m_trace_events.size(); i++)
+		{
+			const TraceEvent& event = m_trace_events[(m_trace_next + i) % m_trace_events.size()];
+			const double timestamp_us = TicksToMicroseconds(event.timestamp - m_start_ticks);
+
+			begin_event();
+			file << "{\"name\":";
+			WriteJsonString(file, event.name);
+			file << ",\"pid\":0,\"tid\":" << event.thread_index << ",\"ts\":" << timestamp_us;
+
+			switch (event.type)
+			{
+				case ProfilerEventType::ZoneBegin:
+					file << ",\"ph\":\"X\",\"dur\":" << TicksToMicroseconds(event.duration) << "}";
+					break;
+				case ProfilerEventType::Counter:
+					file << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+					break;
+				case ProfilerEventType::FrameMark:
+				case ProfilerEventType::ZoneEnd:
+					file << ",\"ph\":\"i\",\"s\":\"g\"}";
+					break;
+			}
+		}
+
+		file << "]}\n";
+
+		if (!file)
+		{
+			LogError << "Can't write profiler trace file " << path.string() << "\n";
+			return false;
+		}
+
+		LogInfo << "Profiler trace saved to " << path.string() << "\n";
+
+		return true;
+	}
+}
@@ -0,0 +1,474 @@
+module;
+
+#include <DirectXMath.h>
+#include <d3d12.h>
+
+#include <shader_structs.h>
+
+export module system.scene_cache;
+
+import std;
+import graphics.aabb;
+import graphics.primitive;
+import graphics.texture_cooker;
+import renderer.vertex_storage;
+import system.filesystem;
+import system.string_helpers;
+import system.logger;
+
+export namespace ysn
+{
+	// Bump when layout of any cooked structure below changes
+	constexpr std::uint32_t SCENE_CACHE_VERSION = 3;
+
+	// Source file the cache was cooked from, cache is stale as soon as any of them changes
+	struct SceneCacheDependency
+	{
+		std::string path; // Relative to the cache file directory
+		std::uint64_t size = 0;
+		std::int64_t write_time = 0;
+	};
+
+	struct CookedImage
+	{
+		std::string uri; // Relative to the cache file directory
+		TextureUsage usage = TextureUsage::Unknown;
+	};
+
+	struct CookedMaterial
+	{
+		std::string name;
+		D3D12_BLEND_DESC blend_desc = {};
+		D3D12_RASTERIZER_DESC rasterizer_desc = {};
+		SurfaceShaderParameters shader_parameters = {}; // Texture indices point into images, not into descriptor heap
+	};
+
+	struct CookedPrimitive
+	{
+		D3D_PRIMITIVE_TOPOLOGY topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		std::int32_t material_id = -1;
+		AABB bbox;
+		std::uint32_t vertex_offset = 0;
+		std::uint32_t vertex_count = 0;
+		std::uint32_t index_offset = 0;
+		std::uint32_t index_count = 0; // All LODs together
+		std::uint32_t first_lod = 0;
+		std::uint32_t lods_count = 0;
+	};
+
+	struct CookedMesh
+	{
+		std::string name;
+		std::uint32_t first_primitive = 0;
+		std::uint32_t primitives_count = 0;
+	};
+
+	struct SceneCache
+	{
+		std::uint64_t loading_parameters_hash = 0;
+
+		std::vector<SceneCacheDependency> dependencies;
+		std::vector<CookedImage> images;
+		std::vector<D3D12_SAMPLER_DESC> samplers;
+		std::vector<CookedMaterial> materials;
+		std::vector<CookedMesh> meshes;
+		std::vector<CookedPrimitive> primitives;
+		std::vector<PrimitiveLod> lods;
+		std::vector<DirectX::XMFLOAT4X4> transforms;
+
+		// Point into mapped file after ReadSceneCache, into caller owned storage for WriteSceneCache
+		std::span<const Vertex> vertices;
+		std::span<const std::uint32_t> indices;
+
+		std::shared_ptr<MappedFile> file;
+	};
+
+	std::wstring GetSceneCachePath(const std::wstring& source_path);
+	std::optional<SceneCacheDependency> MakeSceneCacheDependency(const std::filesystem::path& base_dir, const std::string& relative_path);
+
+	bool WriteSceneCache(const std::wstring& cache_path, const SceneCache& scene_cache);
+
+	// Returns nullopt when cache is missing, corrupted or stale, caller should fallback to source asset then
+	std::optional<SceneCache> ReadSceneCache(const std::wstring& cache_path, std::uint64_t loading_parameters_hash);
+}
+
+module :private;
+
+namespace ysn
+{
+	constexpr std::uint32_t SCENE_CACHE_MAGIC = 0x434E5359; // 'YSNC'
+	constexpr std::uint64_t SCENE_CACHE_STREAM_ALIGNMENT = 16;
+
+	// Geometry streams are mapped as is, so layout of these should never silently change
+	static_assert(sizeof(Vertex) == 32);
+	static_assert(sizeof(CookedPrimitive) == 56);
+	static_assert(sizeof(PrimitiveLod) == 12);
+
+	struct SceneCacheHeader
+	{
+		std::uint32_t magic = SCENE_CACHE_MAGIC;
+		std::uint32_t version = SCENE_CACHE_VERSION;
+		std::uint64_t loading_parameters_hash = 0;
+		std::uint64_t vertices_count = 0;
+		std::uint64_t vertices_offset = 0;
+		std::uint64_t indices_count = 0;
+		std::uint64_t indices_offset = 0;
+	};
+
+	class CacheWriter
+	{
+	public:
+		template <typename T>
+		void Write(const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			WriteBytes(&value, sizeof(T));
+		}
+
+		void WriteString(const std::string& value)
+		{
+			Write(static_cast<std::uint32_t>(value.size()));
+			WriteBytes(value.data(), value.size());
+		}
+
+		template <typename T>
+		void WriteArray(std::span<const T> values)
+		{
+			Write(static_cast<std::uint64_t>(values.size()));
+			WriteBytes(values.data(), values.size_bytes());
+		}
+
+		void WriteBytes(const void* data, std::size_t size)
+		{
+			const auto* bytes = static_cast<const std::uint8_t*>(data);
+			m_data.insert(m_data.end(), bytes, bytes + size);
+		}
+
+		std::uint64_t Align(std::uint64_t alignment)
+		{
+			const std::uint64_t aligned_size = (m_data.size() + alignment - 1) & ~(alignment - 1);
+			m_data.resize(aligned_size, 0);
+			return aligned_size;
+		}
+
+		std::vector<std::uint8_t>& Data()
+		{
+			return m_data;
+		}
+
+	private:
+		std::vector<std::uint8_t> m_data;
+	};
+
+	class CacheReader
+	{
+	public:
+		CacheReader(const std::uint8_t* data, std::size_t size) : m_current(data), m_end(data + size)
+		{
+		}
+
+		template <typename T>
+		bool Read(T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			return ReadBytes(&value, sizeof(T));
+		}
+
+		bool ReadString(std::string& value)
+		{
+			std::uint32_t size = 0;
+
+			if (!Read(size) || !CanRead(size))
+				return false;
+
+			value.assign(reinterpret_cast<const char*>(m_current), size);
+			m_current += size;
+			return true;
+		}
+
+		template <typename T>
+		bool ReadArray(std::vector<T>& values)
+		{
+			std::uint64_t count = 0;
+
+			if (!Read(count) || count > std::numeric_limits<std::size_t>::max() / sizeof(T) || !CanRead(count * sizeof(T)))
+				return false;
+
+			values.resize(count);
+			return ReadBytes(values.data(), count * sizeof(T));
+		}
+
+		bool ReadBytes(void* data, std::size_t size)
+		{
+			if (!CanRead(size))
+				return false;
+
+			std::memcpy(data, m_current, size);
+			m_current += size;
+			return true;
+		}
+
+	private:
+		bool CanRead(std::uint64_t size) const
+		{
+			return size <= static_cast<std::uint64_t>(m_end - m_current);
+		}
+
+		const std::uint8_t* m_current = nullptr;
+		const std::uint8_t* m_end = nullptr;
+	};
+
+	std::wstring GetSceneCachePath(const std::wstring& source_path)
+	{
+		return source_path + L".ysncache";
+	}
+
+	std::optional<SceneCacheDependency> MakeSceneCacheDependency(const std::filesystem::path& base_dir, const std::string& relative_path)
+	{
+		const std::filesystem::path full_path = base_dir / StringToWString(relative_path);
+
+		std::error_code error_code;
+
+		const std::uintmax_t size = std::filesystem::file_size(full_path, error_code);
+
+		if (error_code)
+			return std::nullopt;
+
+		const std::filesystem::file_time_type write_time = std::filesystem::last_write_time(full_path, error_code);
+
+		if (error_code)
+			return std::nullopt;
+
+		SceneCacheDependency dependency;
+		dependency.path = relative_path;
+		dependency.size = static_cast<std::uint64_t>(size);
+		dependency.write_time = static_cast<std::int64_t>(write_time.time_since_epoch().count());
+
+		return dependency;
+	}
+
+	bool WriteSceneCache(const std::wstring& cache_path, const SceneCache& scene_cache)
+	{
+		SceneCacheHeader header;
+		header.loading_parameters_hash = scene_cache.loading_parameters_hash;
+		header.vertices_count = scene_cache.vertices.size();
+		header.indices_count = scene_cache.indices.size();
+
+		CacheWriter writer;
+		writer.Write(header); // Patched below once stream offsets are known
+
+		writer.Write(static_cast<std::uint64_t>(scene_cache.dependencies.size()));
+		for (const SceneCacheDependency& dependency : scene_cache.dependencies)
+		{
+			writer.WriteString(dependency.path);
+			writer.Write(dependency.size);
+			writer.Write(dependency.write_time);
+		}
+
+		writer.Write(static_cast<std::uint64_t>(scene_cache.images.size()));
+		for (const CookedImage& image : scene_cache.images)
+		{
+			writer.WriteString(image.uri);
+			writer.Write(static_cast<std::uint8_t>(image.usage));
+		}
+
+		writer.WriteArray(std::span(scene_cache.samplers));
+
+		writer.Write(static_cast<std::uint64_t>(scene_cache.materials.size()));
+		for (const CookedMaterial& material : scene_cache.materials)
+		{
+			writer.WriteString(material.name);
+			writer.Write(material.blend_desc);
+			writer.Write(material.rasterizer_desc);
+			writer.Write(material.shader_parameters);
+		}
+
+		writer.Write(static_cast<std::uint64_t>(scene_cache.meshes.size()));
+		for (const CookedMesh& mesh : scene_cache.meshes)
+		{
+			writer.WriteString(mesh.name);
+			writer.Write(mesh.first_primitive);
+			writer.Write(mesh.primitives_count);
+		}
+
+		writer.WriteArray(std::span(scene_cache.primitives));
+		writer.WriteArray(std::span(scene_cache.lods));
+		writer.WriteArray(std::span(scene_cache.transforms));
+
+		header.vertices_offset = writer.Align(SCENE_CACHE_STREAM_ALIGNMENT);
+		writer.WriteBytes(scene_cache.vertices.data(), scene_cache.vertices.size_bytes());
+
+		header.indices_offset = writer.Align(SCENE_CACHE_STREAM_ALIGNMENT);
+		writer.WriteBytes(scene_cache.indices.data(), scene_cache.indices.size_bytes());
+
+		std::memcpy(writer.Data().data(), &header, sizeof(header));
+
+		// Write next to the destination and swap, so interrupted cook never leaves half written cache behind
+		const std::filesystem::path final_path(cache_path);
+		std::filesystem::path temp_path = final_path;
+		temp_path += L".tmp";
+
+		{
+			std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+
+			if (!file.is_open())
+			{
+				LogError << "Scene cache can't open file for writing: " << temp_path.string() << "\n";
+				return false;
+			}
+
+			file.write(reinterpret_cast<const char*>(writer.Data().data()), static_cast<std::streamsize>(writer.Data().size()));
+
+			if (!file.good())
+			{
+				LogError << "Scene cache can't write file: " << temp_path.string() << "\n";
+				return false;
+			}
+		}
+
+		std::error_code error_code;
+		std::filesystem::rename(temp_path, final_path, error_code);
+
+		if (error_code)
+		{
+			LogError << "Scene cache can't replace file: " << final_path.string() << "\n";
+			std::filesystem::remove(temp_path, error_code);
+			return false;
+		}
+
+		return true;
+	}
+
+	std::optional<SceneCache> ReadSceneCache(const std::wstring& cache_path, std::uint64_t loading_parameters_hash)
+	{
+		auto file = std::make_shared<MappedFile>();
+
+		if (!file->Open(cache_path))
+		{
+			return std::nullopt;
+		}
+
+		const std::string cache_path_str = WStringToString(cache_path);
+
+		CacheReader reader(file->Data(), file->Size());
+
+		SceneCacheHeader header;
+
+		if (!reader.Read(header) || header.magic != SCENE_CACHE_MAGIC)
+		{
+			LogWarning << "Scene cache is corrupted: " << cache_path_str << "\n";
+			return std::nullopt;
+		}
+
+		if (header.version != SCENE_CACHE_VERSION)
+		{
+			LogInfo << "Scene cache has outdated version: " << cache_path_str << "\n";
+			return std::nullopt;
+		}
+
+		if (header.loading_parameters_hash != loading_parameters_hash)
+		{
+			LogInfo << "Scene cache was cooked with different loading parameters: " << cache_path_str << "\n";
+			return std::nullopt;
+		}
+
+		SceneCache scene_cache;
+		scene_cache.loading_parameters_hash = header.loading_parameters_hash;
+
+		bool result = true;
+		std::uint64_t count = 0;
+
+		result = result && reader.Read(count);
+		for (std::uint64_t i = 0; result && i < count; i++)
+		{
+			SceneCacheDependency& dependency = scene_cache.dependencies.emplace_back();
+			result = reader.ReadString(dependency.path) && reader.Read(dependency.size) && reader.Read(dependency.write_time);
+		}
+
+		result = result && reader.Read(count);
+		for (std::uint64_t i = 0; result && i < count; i++)
+		{
+			CookedImage& image = scene_cache.images.emplace_back();
+			std::uint8_t usage = 0;
+			result = reader.ReadString(image.uri) && reader.Read(usage) && usage <= static_cast<std::uint8_t>(TextureUsage::Mask);
+			image.usage = static_cast<TextureUsage>(usage);
+		}
+
+		result = result && reader.ReadArray(scene_cache.samplers);
+
+		result = result && reader.Read(count);
+		for (std::uint64_t i = 0; result && i < count; i++)
+		{
+			CookedMaterial& material = scene_cache.materials.emplace_back();
+			result = reader.ReadString(material.name) && reader.Read(material.blend_desc) && reader.Read(material.rasterizer_desc) &&
+				reader.Read(material.shader_parameters);
+		}
+
+		result = result && reader.Read(count);
+		for (std::uint64_t i = 0; result && i < count; i++)
+		{
+			CookedMesh& mesh = scene_cache.meshes.emplace_back();
+			result = reader.ReadString(mesh.name) && reader.Read(mesh.first_primitive) && reader.Read(mesh.primitives_count);
+		}
+
+		result = result && reader.ReadArray(scene_cache.primitives);
+		result = result && reader.ReadArray(scene_cache.lods);
+		result = result && reader.ReadArray(scene_cache.transforms);
+
+		const std::uint64_t file_size = file->Size();
+		const std::uint64_t vertices_size = header.vertices_count * sizeof(Vertex);
+		const std::uint64_t indices_size = header.indices_count * sizeof(std::uint32_t);
+
+		result = result && header.vertices_offset % SCENE_CACHE_STREAM_ALIGNMENT == 0 && header.indices_offset % SCENE_CACHE_STREAM_ALIGNMENT == 0;
+		result = result && header.vertices_offset <= file_size && vertices_size <= file_size - header.vertices_offset;
+		result = result && header.indices_offset <= file_size && indices_size <= file_size - header.indices_offset;
+
+		for (const CookedPrimitive& primitive : scene_cache.primitives)
+		{
+			result = result && std::uint64_t(primitive.vertex_offset) + primitive.vertex_count <= header.vertices_count;
+			result = result && std::uint64_t(primitive.index_offset) + primitive.index_count <= header.indices_count;
+			result = result && std::uint64_t(primitive.first_lod) + primitive.lods_count <= scene_cache.lods.size();
+
+			for (std::uint32_t i = 0; result && i < primitive.lods_count; i++)
+			{
+				const PrimitiveLod& lod = scene_cache.lods[primitive.first_lod + i];
+				result = std::uint64_t(lod.index_offset) + lod.index_count <= primitive.index_count;
+			}
+		}
+
+		for (const CookedMesh& mesh : scene_cache.meshes)
+		{
+			result = result && std::uint64_t(mesh.first_primitive) + mesh.primitives_count <= scene_cache.primitives.size();
+		}
+
+		if (!result)
+		{
+			LogWarning << "Scene cache is corrupted: " << cache_path_str << "\n";
+			return std::nullopt;
+		}
+
+		// Any touched source file invalidates whole cache
+		const std::filesystem::path base_dir = std::filesystem::path(cache_path).parent_path();
+
+		for (const SceneCacheDependency& dependency : scene_cache.dependencies)
+		{
+			const std::optional<SceneCacheDependency> current = MakeSceneCacheDependency(base_dir, dependency.path);
+
+			if (!current.has_value() || current->size != dependency.size || current->write_time != dependency.write_time)
+			{
+				LogInfo << "Scene cache is stale, " << dependency.path << " has changed\n";
+				return std::nullopt;
+			}
+		}
+
+		// Zero copy, geometry streams stay in the mapped file
+		scene_cache.vertices = std::span<const Vertex>(
+			reinterpret_cast<const Vertex*>(file->Data() + header.vertices_offset), static_cast<std::size_t>(header.vertices_count));
+		scene_cache.indices = std::span<const std::uint32_t>(
+			reinterpret_cast<const std::uint32_t*>(file->Data() + header.indices_offset), static_cast<std::size_t>(header.indices_count));
+
+		scene_cache.file = std::move(file);
+
+		return scene_cache;
+	}
+}
@@ -1,5 +1,7 @@
 export module yasno.settings;
 
+import renderer.vertex_storage;
+
 export namespace ysn
 {
 	struct GraphicsSettings
@@ -9,6 +11,12 @@ export namespace ysn
 		bool is_raster_mode = true;
 	};
 
+	// Applied by LoadContent before any model is loaded, can't be changed afterwards
+	struct ContentSettings
+	{
+		VertexFormat vertex_format = VertexFormat::Full; // Compact one takes 16 bytes per vertex instead of 32
+	};
+
 	class YasnoSettings
 	{
 		GraphicsSettings graphics;
@@ -36,6 +36,8 @@ import renderer.gpu_texture;
 import renderer.rtx_context;
 import renderer.command_queue;
 import renderer.gpu_pixel_buffer;
+import renderer.vertex_storage;
+import renderer.shader_cache;
 import system.math;
 import system.filesystem;
 import system.application;
@@ -47,6 +49,7 @@ import system.logger;
 import system.asserts;
 import system.string_helpers;
 import system.profiler;
+import yasno.settings;
 
 enum class SkyboxCubemap : uint8_t
 {
@@ -60,7 +63,7 @@ export namespace ysn
 	class Yasno : public Game
 	{
 	public:
-		Yasno(const std::wstring& name, int width, int height, bool vsync = false);
+		Yasno(const std::wstring& name, int width, int height, bool vsync = false, const ContentSettings& content_settings = {});
 
 		std::expected<bool, std::string> LoadContent() override;
 		void UnloadContent() override;
@@ -74,6 +77,7 @@ export namespace ysn
 
 	private:
 		GameInput game_input;
+		ContentSettings m_content_settings;
 		RenderScene m_render_scene;
 
 		bool CreateGpuCameraBuffer();
@@ -81,6 +85,7 @@ export namespace ysn
 
 		void UpdateGpuCameraBuffer();
 		void UpdateGpuSceneParametersBuffer();
+		bool UpdateGpuInstanceTransforms(uint32_t frame_index);
 
 		bool UpdateBufferResource(
 			wil::com_ptr<ID3D12GraphicsCommandList2> commandList,
@@ -138,6 +143,14 @@ export namespace ysn
 		bool m_reset_rtx_accumulation = true;
 		bool m_is_rtx_accumulation_enabled = false;
 
+		// Mesh moved by gizmo, model id -1 hides it
+		int m_gizmo_model_id = -1;
+		int m_gizmo_mesh_id = 0;
+
+		// Per instance data is kept on CPU, so moved instances are reuploaded without rebuilding it
+		std::vector<PerInstanceData> m_per_instance_data;
+		uint32_t m_uploaded_transforms_version = 0;
+
 		// Techniques
 		ForwardPass m_forward_pass;
 		ShadowMapPass m_shadow_pass;
@@ -192,8 +205,9 @@ namespace ysn
 		return cubemap_gpu_texture;
 	}
 
-	Yasno::Yasno(const std::wstring& name, int width, int height, bool vsync) :
+	Yasno::Yasno(const std::wstring& name, int width, int height, bool vsync, const ContentSettings& content_settings) :
 		Game(name, width, height, vsync),
+		m_content_settings(content_settings),
 		m_viewport(CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height))),
 		m_scissors_rect(CD3DX12_RECT(0, 0, LONG_MAX, LONG_MAX))
 	{
@@ -369,6 +383,52 @@ namespace ysn
 		m_scene_parameters_gpu_buffer->Unmap(0, nullptr);
 	}
 
+	bool Yasno::UpdateGpuInstanceTransforms(uint32_t frame_index)
+	{
+		std::shared_ptr<ysn::CommandQueue> command_queue = Application::Get().GetDirectQueue();
+
+		const auto command_list_result = command_queue->GetCommandList("Update Instance Transforms");
+
+		if (!command_list_result.has_value())
+			return false;
+
+		auto command_list = command_list_result.value();
+
+		// Same order as instance buffer was filled in
+		std::size_t instance_id = 0;
+
+		for (const Model& model : m_render_scene.models)
+		{
+			for (std::size_t mesh_id = 0; mesh_id < model.meshes.size(); mesh_id++)
+			{
+				for (std::size_t primitive_id = 0; primitive_id < model.meshes[mesh_id].primitives.size() && instance_id < m_per_instance_data.size(); primitive_id++)
+				{
+					m_per_instance_data[instance_id++].model_matrix = model.transforms[mesh_id];
+				}
+			}
+		}
+
+		const CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+			m_render_scene.instance_buffer.Resource(), D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+		command_list->ResourceBarrier(1, &barrier);
+
+		if (!UploadToGpuBuffer(command_list, m_render_scene.instance_buffer, m_per_instance_data.data(), {}, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE))
+		{
+			LogError << "Can't upload instance transforms\n";
+			command_queue->CloseCommandList(command_list);
+			return false;
+		}
+
+		m_rtx_context.UpdateTlasTransforms(command_list, m_render_scene, frame_index);
+
+		command_queue->CloseCommandList(command_list);
+
+		m_uploaded_transforms_version = m_render_scene.transforms_version;
+		m_reset_rtx_accumulation = true;
+
+		return true;
+	}
+
 	std::expected<bool, std::string> Yasno::LoadContent()
 	{
 		const auto init_start_time = std::chrono::high_resolution_clock::now();
@@ -417,6 +477,9 @@ namespace ysn
 		m_render_scene.camera = std::make_shared<ysn::Camera>(DirectX::XMVectorSet(0, 0, 23, 1));
 		m_render_scene.camera_controler.p_camera = m_render_scene.camera;
 
+		// Vertices are encoded while scene buffers are built and PSOs depend on format, so it is fixed before any model is loaded
+		m_render_scene.vertex_format = m_content_settings.vertex_format;
+
 		bool load_result = false;
 
 		// Simplify simple primitive creation
@@ -515,11 +578,6 @@ namespace ysn
 			return std::unexpected("Can't load scenes\n");
 		}
 
-		// Build mips
-		for (Model& model : m_render_scene.models)
-			for (GpuTexture& texture : model.textures)
-				m_generate_mips_pass.GenerateMips(renderer, command_list, texture);
-
 		// Build scene buffers
 		{
 			// Index buffer
@@ -548,15 +606,18 @@ namespace ysn
 					{
 						for (auto& primitive : mesh.primitives)
 						{
+							const std::span<const uint32_t> indices = primitive.GetIndices();
+
 							primitive.index_buffer_view.BufferLocation =
 								m_render_scene.indices_buffer.GPUVirtualAddress() + all_indices_buffer.size() * sizeof(uint32_t);
-							primitive.index_buffer_view.SizeInBytes = static_cast<uint32_t>(primitive.indices.size()) * sizeof(uint32_t);
+							primitive.index_buffer_view.SizeInBytes = static_cast<uint32_t>(indices.size()) * sizeof(uint32_t);
 							primitive.index_buffer_view.Format = DXGI_FORMAT_R32_UINT;
 
-							primitive.index_count = static_cast<uint32_t>(primitive.indices.size());
+							// Only LOD0 counts as primitive geometry, coarser LODs follow it in the same range
+							primitive.index_count = primitive.lods.empty() ? static_cast<uint32_t>(indices.size()) : primitive.lods[0].index_count;
 
 							// Append indices
-							all_indices_buffer.insert(all_indices_buffer.end(), primitive.indices.begin(), primitive.indices.end());
+							all_indices_buffer.insert(all_indices_buffer.end(), indices.begin(), indices.end());
 						}
 					}
 				}
@@ -566,7 +627,9 @@ namespace ysn
 
 			// Vertex Buffer
 			{
-				const uint32_t vertices_buffer_size = m_render_scene.vertices_count * sizeof(Vertex);
+				const bool is_compact = m_render_scene.vertex_format == VertexFormat::Compact;
+				const uint32_t vertex_stride = GetVertexStride(m_render_scene.vertex_format);
+				const uint32_t vertices_buffer_size = m_render_scene.vertices_count * vertex_stride;
 
 				GpuBufferCreateInfo create_info{
 					.size = vertices_buffer_size, .heap_type = D3D12_HEAP_TYPE_DEFAULT, .state = D3D12_RESOURCE_STATE_COPY_DEST };
@@ -582,7 +645,14 @@ namespace ysn
 				m_render_scene.vertices_buffer = vertices_buffer_result.value();
 
 				std::vector<Vertex> all_vertices_buffer;
-				all_vertices_buffer.reserve(m_render_scene.vertices_count);
+				std::vector<CompactVertex> all_compact_vertices_buffer;
+
+				if (is_compact)
+					all_compact_vertices_buffer.resize(m_render_scene.vertices_count);
+				else
+					all_vertices_buffer.reserve(m_render_scene.vertices_count);
+
+				uint32_t vertices_offset = 0;
 
 				for (auto& model : m_render_scene.models)
 				{
@@ -590,19 +660,41 @@ namespace ysn
 					{
 						for (auto& primitive : mesh.primitives)
 						{
-							primitive.vertex_buffer_view.BufferLocation = m_render_scene.vertices_buffer.GPUVirtualAddress() + all_vertices_buffer.size() * sizeof(Vertex);
-							primitive.vertex_buffer_view.SizeInBytes = UINT(primitive.vertices.size() * sizeof(Vertex));
-							primitive.vertex_buffer_view.StrideInBytes = sizeof(Vertex);
+							const std::span<const Vertex> vertices = primitive.GetVertices();
 
-							primitive.vertex_count = static_cast<uint32_t>(primitive.vertices.size());
+							primitive.vertex_buffer_view.BufferLocation = m_render_scene.vertices_buffer.GPUVirtualAddress() + vertices_offset * vertex_stride;
+							primitive.vertex_buffer_view.SizeInBytes = UINT(vertices.size() * vertex_stride);
+							primitive.vertex_buffer_view.StrideInBytes = vertex_stride;
+
+							primitive.vertex_count = static_cast<uint32_t>(vertices.size());
 
 							// Append vertices
-							all_vertices_buffer.insert(all_vertices_buffer.end(), primitive.vertices.begin(), primitive.vertices.end());
+							if (is_compact)
+							{
+								EncodeCompactVertices(vertices,
+									GetPositionQuantization(primitive.bbox.min, primitive.bbox.max),
+									std::span(all_compact_vertices_buffer).subspan(vertices_offset, vertices.size()));
+							}
+							else
+							{
+								all_vertices_buffer.insert(all_vertices_buffer.end(), vertices.begin(), vertices.end());
+							}
+
+							vertices_offset += primitive.vertex_count;
 						}
 					}
 				}
 
-				UploadToGpuBuffer(command_list, m_render_scene.vertices_buffer, all_vertices_buffer.data(), {}, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+				if (is_compact)
+				{
+					const uint64_t full_size = uint64_t(m_render_scene.vertices_count) * sizeof(Vertex);
+					LogInfo << "Compact vertices: " << std::to_string(vertices_buffer_size / 1024) << " KB instead of "
+							<< std::to_string(full_size / 1024) << " KB, saved " << std::to_string((full_size - vertices_buffer_size) / 1024) << " KB\n";
+				}
+
+				const void* vertices_data = is_compact ? static_cast<const void*>(all_compact_vertices_buffer.data()) : all_vertices_buffer.data();
+
+				UploadToGpuBuffer(command_list, m_render_scene.vertices_buffer, vertices_data, {}, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 			}
 
 			// Material buffer
@@ -696,11 +788,24 @@ namespace ysn
 							instance_data.vertices_before = total_vertices;
 							instance_data.indices_before = total_indices;
 
+							// Identity for full vertices
+							if (m_render_scene.vertex_format == VertexFormat::Compact)
+							{
+								const PositionQuantization quantization = GetPositionQuantization(primitive.bbox.min, primitive.bbox.max);
+								instance_data.position_offset = quantization.position_offset;
+								instance_data.position_scale = quantization.position_scale;
+							}
+							else
+							{
+								instance_data.position_offset = { 0.0f, 0.0f, 0.0f };
+								instance_data.position_scale = { 1.0f, 1.0f, 1.0f };
+							}
+
 							// Need for indirect commands filling later
 							primitive.global_vertex_offset = instance_data.vertices_before;
 							primitive.global_index_offset = instance_data.indices_before;
 
-							total_indices += primitive.index_count;
+							total_indices += static_cast<uint32_t>(primitive.GetIndices().size());
 							total_vertices += primitive.vertex_count;
 
 							per_instance_data_buffer.push_back(instance_data);
@@ -711,6 +816,9 @@ namespace ysn
 				UploadToGpuBuffer(
 					command_list, m_render_scene.instance_buffer, per_instance_data_buffer.data(), {}, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE);
 
+				m_per_instance_data = std::move(per_instance_data_buffer);
+				m_uploaded_transforms_version = m_render_scene.transforms_version;
+
 				// Create SRV
 				D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
 				srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
@@ -732,8 +840,8 @@ namespace ysn
 			{
 				for (auto& primitive : mesh.primitives)
 				{
-					m_forward_pass.CompilePrimitivePso(primitive, model.materials);
-					m_shadow_pass.CompilePrimitivePso(primitive, model.materials);
+					m_forward_pass.CompilePrimitivePso(primitive, model.materials, m_render_scene.vertex_format);
+					m_shadow_pass.CompilePrimitivePso(primitive, model.materials, m_render_scene.vertex_format);
 				}
 			}
 		}
@@ -794,8 +902,7 @@ namespace ysn
 			return false;
 		}
 
-		if (!m_forward_pass.Initialize(
-			m_render_scene, m_camera_gpu_buffer, m_scene_parameters_gpu_buffer, m_render_scene.instance_buffer, command_list))
+		if (!m_forward_pass.Initialize(m_render_scene))
 		{
 			LogError << "Can't initialize forward pass\n";
 			return false;
@@ -838,8 +945,8 @@ namespace ysn
 
 			D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view;
 			vertex_buffer_view.BufferLocation = m_render_scene.vertices_buffer.GPUVirtualAddress();
-			vertex_buffer_view.StrideInBytes = sizeof(Vertex);
-			vertex_buffer_view.SizeInBytes = m_render_scene.vertices_count * sizeof(Vertex);
+			vertex_buffer_view.StrideInBytes = GetVertexStride(m_render_scene.vertex_format);
+			vertex_buffer_view.SizeInBytes = m_render_scene.vertices_count * GetVertexStride(m_render_scene.vertex_format);
 
 			m_render_scene.vertex_buffer_view = vertex_buffer_view;
 		}
@@ -896,7 +1003,8 @@ namespace ysn
 			m_render_scene.vertices_count,
 			m_render_scene.indices_count,
 			m_render_scene.materials_count,
-			m_render_scene.primitives_count))
+			m_render_scene.primitives_count,
+			m_render_scene.vertex_format))
 		{
 			LogError << "Can't initialize raytracing pass\n";
 			return false;
@@ -1140,6 +1248,8 @@ namespace ysn
 		{
 			engine_stats::fps = uint32_t(m_frame_number / totalTime);
 			engine_stats::frame_ms = e.ElapsedTime;
+			engine_stats::profiler_zones = Profiler::Get().GetZoneStats();
+			engine_stats::profiler_dropped_events = Profiler::Get().GetDroppedEventsCount();
 
 			m_frame_number = 0;
 			totalTime = 0.0;
@@ -1335,6 +1445,53 @@ namespace ysn
 			ImGui::Text(std::format("frame ms: {:.3f}", engine_stats::frame_ms * 1000.f).c_str());
 			ImGui::Text(std::format("fps: {}", engine_stats::fps).c_str());
 
+			if (ImGui::CollapsingHeader("Culling"))
+			{
+				ImGui::Checkbox("Frustum Culling", &m_render_scene.is_culling_enabled);
+				ImGui::Text(std::format("instances: {}", engine_stats::culling_instances).c_str());
+				ImGui::Text(std::format("tested: {}", engine_stats::culling_tested_instances).c_str());
+				ImGui::Text(std::format("visible: {}", engine_stats::culling_visible_instances).c_str());
+				ImGui::Text(std::format("shadow visible: {}", engine_stats::culling_shadow_visible_instances).c_str());
+				ImGui::Text(std::format("cull ms: {:.3f}", engine_stats::culling_ms).c_str());
+				ImGui::InputInt("Gizmo Model", &m_gizmo_model_id);
+				ImGui::InputInt("Gizmo Mesh", &m_gizmo_mesh_id);
+			}
+
+			if (ImGui::CollapsingHeader("Render Queue"))
+			{
+				ImGui::Text(std::format("forward draws: {}", engine_stats::forward_draw_calls).c_str());
+				ImGui::Text(std::format("forward state changes: {}", engine_stats::forward_state_changes).c_str());
+				ImGui::Text(std::format("shadow draws: {}", engine_stats::shadow_draw_calls).c_str());
+				ImGui::Text(std::format("shadow state changes: {}", engine_stats::shadow_state_changes).c_str());
+				ImGui::Text(std::format("forward draws without PSO: {}", engine_stats::forward_missing_pso_draws).c_str());
+				ImGui::Text(std::format("shadow draws without PSO: {}", engine_stats::shadow_missing_pso_draws).c_str());
+			}
+
+			if (ImGui::CollapsingHeader("CPU Profiler"))
+			{
+				if (ImGui::Button("Dump Chrome Trace"))
+				{
+					Profiler::Get().DumpChromeTrace("yasno_trace.json");
+				}
+
+				ImGui::Text(std::format("dropped events: {}", engine_stats::profiler_dropped_events).c_str());
+
+				for (const ProfilerZoneStats& zone : engine_stats::profiler_zones)
+				{
+					ImGui::Text(std::format("{}: p50 {:.3f} p95 {:.3f} p99 {:.3f} ms", zone.name, zone.p50_ms, zone.p95_ms, zone.p99_ms).c_str());
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Shader Cache"))
+			{
+				const ShaderCacheStats shader_cache_stats = Application::Get().GetRenderer()->GetShaderStorage()->GetCacheStats();
+
+				ImGui::Text(std::format("memory hits: {}", shader_cache_stats.memory_hits).c_str());
+				ImGui::Text(std::format("disk hits: {}", shader_cache_stats.disk_hits).c_str());
+				ImGui::Text(std::format("misses: {}", shader_cache_stats.misses).c_str());
+				ImGui::Text(std::format("failures: {}", shader_cache_stats.failures).c_str());
+			}
+
 			if (ImGui::CollapsingHeader("Mode"), ImGuiTreeNodeFlags_DefaultOpen)
 			{
 				if (m_is_raster)
@@ -1382,13 +1539,23 @@ namespace ysn
 
 			DirectX::XMFLOAT4X4 view;
 			DirectX::XMFLOAT4X4 projection;
-			DirectX::XMFLOAT4X4 identity;
 
 			XMStoreFloat4x4(&view, m_render_scene.camera->GetViewMatrix());
 			XMStoreFloat4x4(&projection, m_render_scene.camera->GetProjectionMatrix());
-			XMStoreFloat4x4(&identity, DirectX::XMMatrixIdentity());
 
-			ImGuizmo::Manipulate(&view.m[0][0], &projection.m[0][0], ImGuizmo::TRANSLATE, ImGuizmo::WORLD, &identity.m[0][0]);
+			const bool is_gizmo_mesh_valid = m_gizmo_model_id >= 0 && m_gizmo_model_id < static_cast<int>(m_render_scene.models.size()) && m_gizmo_mesh_id >= 0 &&
+				m_gizmo_mesh_id < static_cast<int>(m_render_scene.models[m_gizmo_model_id].transforms.size());
+
+			if (is_gizmo_mesh_valid)
+			{
+				DirectX::XMFLOAT4X4 transform;
+				XMStoreFloat4x4(&transform, m_render_scene.models[m_gizmo_model_id].transforms[m_gizmo_mesh_id]);
+
+				if (ImGuizmo::Manipulate(&view.m[0][0], &projection.m[0][0], ImGuizmo::TRANSLATE, ImGuizmo::WORLD, &transform.m[0][0]))
+				{
+					m_render_scene.SetTransform(m_gizmo_model_id, m_gizmo_mesh_id, XMLoadFloat4x4(&transform));
+				}
+			}
 		}
 
 		std::shared_ptr<ysn::CommandQueue> command_queue = Application::Get().GetDirectQueue();
@@ -1398,6 +1565,13 @@ namespace ysn
 		wil::com_ptr<ID3D12Resource> current_back_buffer = m_window->GetCurrentBackBuffer();
 		D3D12_CPU_DESCRIPTOR_HANDLE backbuffer_handle = m_window->GetCurrentRenderTargetView();
 
+		// Instance BVH is refitted by culling, GPU copies of transforms follow before any pass uses them
+		if (m_uploaded_transforms_version != m_render_scene.transforms_version && !UpdateGpuInstanceTransforms(current_backbuffer_index))
+			return;
+
+		UpdatePrimitiveLods(m_render_scene, m_viewport.Height);
+		CullRenderScene(m_render_scene, m_shadow_pass.shadow_matrix);
+
 		if (m_is_raster)
 		{
 			ShadowRenderParameters parameters;
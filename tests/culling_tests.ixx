@@ -0,0 +1,241 @@
+module;
+
+#include <DirectXMath.h>
+
+export module tests.culling;
+
+import std;
+import graphics.aabb;
+import graphics.culling;
+import tests.framework;
+
+export namespace ysn::tests
+{
+	void RegisterCullingTests();
+}
+
+module :private;
+
+namespace ysn::tests
+{
+	enum class BruteForceResult : std::uint8_t
+	{
+		Outside,
+		Visible,
+		Ambiguous // Touches plane within float error, BVH may go either way
+	};
+
+	static std::vector<AABB> MakeInstanceBoxes(std::uint32_t count, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+		std::vector<AABB> boxes(count);
+
+		for (AABB& box : boxes)
+		{
+			box.min = { position(random), position(random), position(random) };
+			box.max = { box.min.x + size(random), box.min.y + size(random), box.min.z + size(random) };
+		}
+
+		return boxes;
+	}
+
+	static std::vector<Frustum> MakeFrustums(std::uint32_t count, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+
+		const DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XMConvertToRadians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+
+		std::vector<Frustum> frustums;
+
+		for (std::uint32_t i = 0; i < count; i++)
+		{
+			const DirectX::XMVECTOR eye = DirectX::XMVectorSet(position(random), position(random), position(random), 1.0f);
+			const DirectX::XMVECTOR focus = DirectX::XMVectorSet(position(random), position(random), position(random), 1.0f);
+			const DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(eye, focus, DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+			frustums.push_back(CreateFrustum(DirectX::XMMatrixMultiply(view, projection)));
+		}
+
+		return frustums;
+	}
+
+	// Same corner test as BVH leaves, in double and without any hierarchy
+	static BruteForceResult TestBox(const Frustum& frustum, const AABB& box)
+	{
+		constexpr double epsilon = 1e-3;
+
+		BruteForceResult result = BruteForceResult::Visible;
+
+		for (const DirectX::XMFLOAT4& plane : frustum.planes)
+		{
+			const double distance = static_cast<double>(plane.x) * (plane.x >= 0.0f ? box.max.x : box.min.x) +
+				static_cast<double>(plane.y) * (plane.y >= 0.0f ? box.max.y : box.min.y) +
+				static_cast<double>(plane.z) * (plane.z >= 0.0f ? box.max.z : box.min.z) + plane.w;
+
+			if (distance < -epsilon)
+				return BruteForceResult::Outside;
+
+			if (distance < epsilon)
+				result = BruteForceResult::Ambiguous;
+		}
+
+		return result;
+	}
+
+	static void CheckAgainstBruteForce(TestContext& context, const InstanceBvh& bvh, std::span<const AABB> boxes, std::span<const Frustum> frustums,
+		std::string_view description)
+	{
+		std::uint32_t mismatches_count = 0;
+		std::uint32_t duplicates_count = 0;
+		std::uint32_t visible_count = 0;
+
+		std::vector<std::uint32_t> visible_instances;
+		std::vector<std::uint8_t> is_culled_visible(boxes.size());
+
+		for (const Frustum& frustum : frustums)
+		{
+			CullingStats stats;
+			bvh.Cull(frustum, visible_instances, stats);
+
+			std::ranges::fill(is_culled_visible, std::uint8_t(0));
+
+			for (const std::uint32_t instance : visible_instances)
+			{
+				duplicates_count += is_culled_visible[instance];
+				is_culled_visible[instance] = 1;
+			}
+
+			for (std::size_t i = 0; i < boxes.size(); i++)
+			{
+				const BruteForceResult expected = TestBox(frustum, boxes[i]);
+
+				if (expected == BruteForceResult::Ambiguous)
+					continue;
+
+				mismatches_count += (expected == BruteForceResult::Visible) != (is_culled_visible[i] != 0);
+				visible_count += expected == BruteForceResult::Visible;
+			}
+		}
+
+		context.Check(visible_count > 0, std::format("{}: some instances are visible", description));
+		context.Check(duplicates_count == 0, std::format("{}: every visible instance is reported once", description));
+		context.Check(mismatches_count == 0, std::format("{}: {} instances differ from brute force test", description, mismatches_count));
+	}
+
+	static void TestBuildMatchesBruteForce(TestContext& context)
+	{
+		std::mt19937 random(7);
+
+		const std::vector<AABB> boxes = MakeInstanceBoxes(20000, random);
+		const std::vector<Frustum> frustums = MakeFrustums(16, random);
+
+		InstanceBvh bvh;
+		bvh.Build(boxes);
+
+		context.Check(bvh.GetInstancesCount() == boxes.size(), "every instance is in hierarchy");
+		CheckAgainstBruteForce(context, bvh, boxes, frustums, "built");
+	}
+
+	// Moved instances keep their leaves, so refitted bounds have to grow with them
+	static void TestRefitMatchesBruteForce(TestContext& context)
+	{
+		std::mt19937 random(11);
+
+		std::vector<AABB> boxes = MakeInstanceBoxes(20000, random);
+		const std::vector<Frustum> frustums = MakeFrustums(16, random);
+
+		InstanceBvh bvh;
+		bvh.Build(boxes);
+
+		std::uniform_real_distribution<float> offset(-60.0f, 60.0f);
+
+		for (std::uint32_t round = 0; round < 3; round++)
+		{
+			// Every other instance moves, far enough to leave its node bounds
+			for (std::size_t i = round % 2; i < boxes.size(); i += 2)
+			{
+				const DirectX::XMFLOAT3 delta = { offset(random), offset(random), offset(random) };
+
+				boxes[i].min = { boxes[i].min.x + delta.x, boxes[i].min.y + delta.y, boxes[i].min.z + delta.z };
+				boxes[i].max = { boxes[i].max.x + delta.x, boxes[i].max.y + delta.y, boxes[i].max.z + delta.z };
+			}
+
+			if (!context.Check(bvh.Refit(boxes), "refit accepts same instances count"))
+				return;
+
+			CheckAgainstBruteForce(context, bvh, boxes, frustums, std::format("refit {}", round));
+		}
+
+		boxes.pop_back();
+		context.Check(!bvh.Refit(boxes), "refit rejects different instances count");
+	}
+
+	static void BenchmarkInstanceBvh(TestContext& context)
+	{
+		constexpr std::uint32_t instances_count = 131072;
+
+		std::mt19937 random(13);
+
+		std::vector<AABB> boxes = MakeInstanceBoxes(instances_count, random);
+		const std::vector<Frustum> frustums = MakeFrustums(64, random);
+
+		InstanceBvh bvh;
+
+		const double build_duration = MeasureMilliseconds(5, [&]() { bvh.Build(boxes); });
+
+		for (AABB& box : boxes)
+		{
+			box.min.y += 1.0f;
+			box.max.y += 1.0f;
+		}
+
+		const double refit_duration = MeasureMilliseconds(5, [&]() { bvh.Refit(boxes); });
+
+		std::vector<std::uint32_t> visible_instances;
+		CullingStats stats;
+
+		const double cull_duration = MeasureMilliseconds(5,
+			[&]()
+			{
+				stats = {};
+
+				for (const Frustum& frustum : frustums)
+				{
+					bvh.Cull(frustum, visible_instances, stats);
+				}
+			});
+
+		std::uint32_t brute_force_visible_count = 0;
+
+		const double brute_force_duration = MeasureMilliseconds(5,
+			[&]()
+			{
+				brute_force_visible_count = 0;
+
+				for (const Frustum& frustum : frustums)
+				{
+					for (const AABB& box : boxes)
+					{
+						brute_force_visible_count += TestBox(frustum, box) != BruteForceResult::Outside;
+					}
+				}
+			});
+
+		const double frustums_count = static_cast<double>(frustums.size());
+
+		context.Report(std::format("{} instances: build {:.2f} ms, refit {:.2f} ms", instances_count, build_duration, refit_duration));
+		context.Report(std::format("cull {:.3f} ms per frustum, brute force {:.3f} ms, speedup {:.1f}x", cull_duration / frustums_count,
+			brute_force_duration / frustums_count, brute_force_duration / cull_duration));
+		context.Report(std::format("per frustum: {:.0f} nodes, {:.0f} instances tested, {:.0f} visible", stats.tested_nodes / frustums_count,
+			stats.tested_instances / frustums_count, stats.visible_instances / frustums_count));
+	}
+
+	void RegisterCullingTests()
+	{
+		AddTest("culling.build_matches_brute_force", TestBuildMatchesBruteForce);
+		AddTest("culling.refit_matches_brute_force", TestRefitMatchesBruteForce);
+		AddBenchmark("culling.instance_bvh", BenchmarkInstanceBvh);
+	}
+}
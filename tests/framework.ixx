@@ -0,0 +1,203 @@
+export module tests.framework;
+
+import std;
+
+export namespace ysn::tests
+{
+	// Failed checks are reported with their location and test keeps running, so one run shows every broken expectation.
+	// Not thread safe, tests collect results of their threads and check them after join.
+	class TestContext
+	{
+	public:
+		bool Check(bool condition, std::string_view description, std::source_location location = std::source_location::current());
+
+		// Numbers worth seeing in the output, benchmarks report their results through it
+		void Report(std::string_view message);
+
+		std::uint32_t GetFailedChecksCount() const
+		{
+			return m_failed_checks_count;
+		}
+
+	private:
+		std::uint32_t m_failed_checks_count = 0;
+	};
+
+	using TestFunction = std::function<void(TestContext&)>;
+
+	void AddTest(std::string name, TestFunction function);
+
+	// Benchmarks run only with --benchmark, they fail only when their own checks do
+	void AddBenchmark(std::string name, TestFunction function);
+
+	// --benchmark runs benchmarks after tests, --filter <text> runs only ones which name contains text.
+	// Returns process exit code, zero when every check passed.
+	int RunTests(std::span<const std::string_view> arguments);
+
+	// Best wall clock time of runs_count runs in milliseconds, best one filters out scheduling noise
+	double MeasureMilliseconds(std::uint32_t runs_count, const std::function<void()>& function);
+
+	// Unique empty directory inside system temp one, removed with its content by destructor
+	class TemporaryDirectory
+	{
+	public:
+		explicit TemporaryDirectory(std::string_view name);
+		~TemporaryDirectory();
+
+		TemporaryDirectory(const TemporaryDirectory&) = delete;
+		TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+		const std::filesystem::path& GetPath() const
+		{
+			return m_path;
+		}
+
+	private:
+		std::filesystem::path m_path;
+	};
+}
+
+module :private;
+
+namespace ysn::tests
+{
+	struct RegisteredTest
+	{
+		std::string name;
+		TestFunction function;
+		bool is_benchmark = false;
+	};
+
+	static std::vector<RegisteredTest>& GetRegisteredTests()
+	{
+		static std::vector<RegisteredTest> tests;
+		return tests;
+	}
+
+	bool TestContext::Check(bool condition, std::string_view description, std::source_location location)
+	{
+		if (!condition)
+		{
+			m_failed_checks_count++;
+			std::println("{}({}): check failed: {}", location.file_name(), location.line(), description);
+		}
+
+		return condition;
+	}
+
+	void TestContext::Report(std::string_view message)
+	{
+		std::println("    {}", message);
+	}
+
+	void AddTest(std::string name, TestFunction function)
+	{
+		GetRegisteredTests().push_back({ .name = std::move(name), .function = std::move(function), .is_benchmark = false });
+	}
+
+	void AddBenchmark(std::string name, TestFunction function)
+	{
+		GetRegisteredTests().push_back({ .name = std::move(name), .function = std::move(function), .is_benchmark = true });
+	}
+
+	int RunTests(std::span<const std::string_view> arguments)
+	{
+		bool run_benchmarks = false;
+		std::string_view filter;
+
+		for (std::size_t i = 0; i < arguments.size(); i++)
+		{
+			if (arguments[i] == "--benchmark")
+			{
+				run_benchmarks = true;
+			}
+			else if (arguments[i] == "--filter" && i + 1 < arguments.size())
+			{
+				filter = arguments[++i];
+			}
+			else
+			{
+				std::println("Unknown argument: {}, usage: yasno_tests [--benchmark] [--filter <text>]", arguments[i]);
+				return 2;
+			}
+		}
+
+		// Tests go first, so broken code is reported before minutes of benchmarking
+		std::vector<const RegisteredTest*> selected_tests;
+
+		for (const bool benchmarks : { false, true })
+		{
+			for (const RegisteredTest& test : GetRegisteredTests())
+			{
+				if (test.is_benchmark == benchmarks && (!test.is_benchmark || run_benchmarks) && test.name.contains(filter))
+				{
+					selected_tests.push_back(&test);
+				}
+			}
+		}
+
+		std::vector<std::string_view> failed_tests;
+
+		for (const RegisteredTest* test : selected_tests)
+		{
+			std::println("[ RUN  ] {}", test->name);
+
+			TestContext context;
+
+			const auto start_time = std::chrono::high_resolution_clock::now();
+			test->function(context);
+			const std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start_time;
+
+			if (context.GetFailedChecksCount() == 0)
+			{
+				std::println("[ OK   ] {} ({:.1f} ms)", test->name, duration.count());
+			}
+			else
+			{
+				std::println("[ FAIL ] {} ({} failed checks)", test->name, context.GetFailedChecksCount());
+				failed_tests.push_back(test->name);
+			}
+		}
+
+		std::println("{} of {} passed", selected_tests.size() - failed_tests.size(), selected_tests.size());
+
+		for (const std::string_view failed_test : failed_tests)
+		{
+			std::println("Failed: {}", failed_test);
+		}
+
+		return failed_tests.empty() ? 0 : 1;
+	}
+
+	double MeasureMilliseconds(std::uint32_t runs_count, const std::function<void()>& function)
+	{
+		double best_duration = std::numeric_limits<double>::max();
+
+		for (std::uint32_t i = 0; i < runs_count; i++)
+		{
+			const auto start_time = std::chrono::high_resolution_clock::now();
+			function();
+			const std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start_time;
+
+			best_duration = std::min(best_duration, duration.count());
+		}
+
+		return best_duration;
+	}
+
+	TemporaryDirectory::TemporaryDirectory(std::string_view name)
+	{
+		static std::atomic<std::uint32_t> directories_count = 0;
+
+		const std::uint64_t time = std::chrono::steady_clock::now().time_since_epoch().count();
+		m_path = std::filesystem::temp_directory_path() / std::format("yasno_tests_{}_{}_{}", name, time, directories_count++);
+
+		std::filesystem::create_directories(m_path);
+	}
+
+	TemporaryDirectory::~TemporaryDirectory()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(m_path, error);
+	}
+}
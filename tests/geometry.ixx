@@ -0,0 +1,224 @@
+module;
+
+#include <DirectXMath.h>
+
+export module tests.geometry;
+
+import std;
+import renderer.vertex_storage;
+
+export namespace ysn::tests
+{
+	struct TestMesh
+	{
+		std::vector<Vertex> vertices;
+		std::vector<std::uint32_t> indices;
+	};
+
+	// Height field over [-1, 1] square with smooth bumps, phase makes meshes differ from each other.
+	// Vertices are shared between triangles and emitted row by row, so there is room for cache optimization.
+	TestMesh MakeGridMesh(std::uint32_t grid_size, float phase = 0.0f);
+
+	// Same grid with every triangle owning its vertices, welding has to bring it back to shared one
+	TestMesh MakeUnweldedGridMesh(std::uint32_t grid_size, float phase = 0.0f);
+
+	// glTF with single buffer embedded as data uri, so tests don't need assets. Every mesh becomes glTF mesh with one primitive,
+	// its own material and a node with its own transform.
+	bool WriteTestGltf(const std::filesystem::path& path, std::span<const TestMesh> meshes);
+}
+
+module :private;
+
+namespace ysn::tests
+{
+	TestMesh MakeGridMesh(std::uint32_t grid_size, float phase)
+	{
+		TestMesh mesh;
+
+		const std::uint32_t row_size = grid_size + 1;
+		mesh.vertices.reserve(row_size * row_size);
+
+		for (std::uint32_t y = 0; y <= grid_size; y++)
+		{
+			for (std::uint32_t x = 0; x <= grid_size; x++)
+			{
+				const float u = static_cast<float>(x) / static_cast<float>(grid_size);
+				const float v = static_cast<float>(y) / static_cast<float>(grid_size);
+				const float px = u * 2.0f - 1.0f;
+				const float pz = v * 2.0f - 1.0f;
+
+				const float height = 0.1f * std::sin(px * 3.0f + phase) * std::cos(pz * 2.0f + phase);
+				const float dx = 0.3f * std::cos(px * 3.0f + phase) * std::cos(pz * 2.0f + phase);
+				const float dz = -0.2f * std::sin(px * 3.0f + phase) * std::sin(pz * 2.0f + phase);
+
+				DirectX::XMFLOAT3 normal;
+				DirectX::XMStoreFloat3(&normal, DirectX::XMVector3Normalize(DirectX::XMVectorSet(-dx, 1.0f, -dz, 0.0f)));
+
+				Vertex vertex;
+				vertex.position = { px, height, pz };
+				vertex.normal = normal;
+				vertex.uv0 = { u, v };
+
+				mesh.vertices.push_back(vertex);
+			}
+		}
+
+		mesh.indices.reserve(grid_size * grid_size * 6);
+
+		for (std::uint32_t y = 0; y < grid_size; y++)
+		{
+			for (std::uint32_t x = 0; x < grid_size; x++)
+			{
+				const std::uint32_t i0 = y * row_size + x;
+				const std::uint32_t i1 = i0 + 1;
+				const std::uint32_t i2 = i0 + row_size;
+				const std::uint32_t i3 = i2 + 1;
+
+				mesh.indices.insert(mesh.indices.end(), { i0, i2, i1, i1, i2, i3 });
+			}
+		}
+
+		return mesh;
+	}
+
+	TestMesh MakeUnweldedGridMesh(std::uint32_t grid_size, float phase)
+	{
+		const TestMesh grid = MakeGridMesh(grid_size, phase);
+
+		TestMesh mesh;
+		mesh.vertices.reserve(grid.indices.size());
+		mesh.indices.reserve(grid.indices.size());
+
+		for (const std::uint32_t index : grid.indices)
+		{
+			mesh.indices.push_back(static_cast<std::uint32_t>(mesh.vertices.size()));
+			mesh.vertices.push_back(grid.vertices[index]);
+		}
+
+		return mesh;
+	}
+
+	static std::string EncodeBase64(std::span<const std::uint8_t> data)
+	{
+		constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+		std::string result;
+		result.reserve((data.size() + 2) / 3 * 4);
+
+		for (std::size_t i = 0; i < data.size(); i += 3)
+		{
+			const std::size_t remaining = std::min<std::size_t>(data.size() - i, 3);
+
+			std::uint32_t triple = static_cast<std::uint32_t>(data[i]) << 16;
+
+			if (remaining > 1)
+				triple |= static_cast<std::uint32_t>(data[i + 1]) << 8;
+
+			if (remaining > 2)
+				triple |= data[i + 2];
+
+			result.push_back(alphabet[(triple >> 18) & 63]);
+			result.push_back(alphabet[(triple >> 12) & 63]);
+			result.push_back(remaining > 1 ? alphabet[(triple >> 6) & 63] : '=');
+			result.push_back(remaining > 2 ? alphabet[triple & 63] : '=');
+		}
+
+		return result;
+	}
+
+	bool WriteTestGltf(const std::filesystem::path& path, std::span<const TestMesh> meshes)
+	{
+		std::vector<std::uint8_t> buffer;
+		std::string buffer_views;
+		std::string accessors;
+		std::string gltf_meshes;
+		std::string materials;
+		std::string nodes;
+		std::string scene_nodes;
+
+		std::uint32_t accessors_count = 0;
+
+		// Every attribute gets its own buffer view, so accessor index is buffer view index too
+		const auto add_accessor = [&](const void* data, std::size_t size, std::uint32_t count, std::string_view type, std::uint32_t component_type,
+									  std::string_view bounds)
+		{
+			const std::size_t offset = buffer.size();
+			buffer.resize(offset + size);
+			std::memcpy(buffer.data() + offset, data, size);
+
+			buffer_views += std::format("{}{{\"buffer\":0,\"byteOffset\":{},\"byteLength\":{}}}", accessors_count ? "," : "", offset, size);
+			accessors += std::format("{}{{\"bufferView\":{},\"componentType\":{},\"count\":{},\"type\":\"{}\"{}}}",
+				accessors_count ? "," : "", accessors_count, component_type, count, type, bounds);
+
+			return accessors_count++;
+		};
+
+		constexpr std::uint32_t float_component = 5126;
+		constexpr std::uint32_t uint32_component = 5125;
+
+		for (std::size_t mesh_index = 0; mesh_index < meshes.size(); mesh_index++)
+		{
+			const TestMesh& mesh = meshes[mesh_index];
+			const std::uint32_t vertices_count = static_cast<std::uint32_t>(mesh.vertices.size());
+
+			std::vector<DirectX::XMFLOAT3> positions;
+			std::vector<DirectX::XMFLOAT3> normals;
+			std::vector<DirectX::XMFLOAT2> uvs;
+
+			DirectX::XMFLOAT3 min = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+			DirectX::XMFLOAT3 max = { -min.x, -min.y, -min.z };
+
+			for (const Vertex& vertex : mesh.vertices)
+			{
+				positions.push_back(vertex.position);
+				normals.push_back(vertex.normal);
+				uvs.push_back(vertex.uv0);
+
+				min = { std::min(min.x, vertex.position.x), std::min(min.y, vertex.position.y), std::min(min.z, vertex.position.z) };
+				max = { std::max(max.x, vertex.position.x), std::max(max.y, vertex.position.y), std::max(max.z, vertex.position.z) };
+			}
+
+			const std::string bounds = std::format(",\"min\":[{},{},{}],\"max\":[{},{},{}]", min.x, min.y, min.z, max.x, max.y, max.z);
+
+			const std::uint32_t position_accessor =
+				add_accessor(positions.data(), positions.size() * sizeof(DirectX::XMFLOAT3), vertices_count, "VEC3", float_component, bounds);
+			const std::uint32_t normal_accessor =
+				add_accessor(normals.data(), normals.size() * sizeof(DirectX::XMFLOAT3), vertices_count, "VEC3", float_component, "");
+			const std::uint32_t uv_accessor = add_accessor(uvs.data(), uvs.size() * sizeof(DirectX::XMFLOAT2), vertices_count, "VEC2", float_component, "");
+			const std::uint32_t index_accessor = add_accessor(mesh.indices.data(), mesh.indices.size() * sizeof(std::uint32_t),
+				static_cast<std::uint32_t>(mesh.indices.size()), "SCALAR", uint32_component, "");
+
+			const std::string_view separator = mesh_index ? "," : "";
+
+			gltf_meshes += std::format("{}{{\"name\":\"mesh_{}\",\"primitives\":[{{\"attributes\":{{\"POSITION\":{},\"NORMAL\":{},\"TEXCOORD_0\":{}}},"
+									   "\"indices\":{},\"material\":{},\"mode\":4}}]}}",
+				separator, mesh_index, position_accessor, normal_accessor, uv_accessor, index_accessor, mesh_index);
+
+			// Alternating alpha modes and culling, so materials differ in more than factors
+			const float factor = static_cast<float>(mesh_index % 8) / 8.0f;
+
+			materials += std::format("{}{{\"name\":\"material_{}\",\"alphaMode\":\"{}\",\"doubleSided\":{},"
+									 "\"pbrMetallicRoughness\":{{\"baseColorFactor\":[{},{},{},1],\"metallicFactor\":{},\"roughnessFactor\":{}}}}}",
+				separator, mesh_index, mesh_index % 2 ? "BLEND" : "OPAQUE", mesh_index % 3 ? "false" : "true", factor, 1.0f - factor, 0.5f, factor,
+				1.0f - factor * 0.5f);
+
+			// Rotation around Y axis as quaternion
+			const float half_angle = 0.15f * static_cast<float>(mesh_index);
+
+			nodes += std::format("{}{{\"mesh\":{},\"translation\":[{},0,{}],\"rotation\":[0,{},0,{}],\"scale\":[1,{},1]}}", separator, mesh_index,
+				2.5f * static_cast<float>(mesh_index), -0.5f * static_cast<float>(mesh_index), std::sin(half_angle), std::cos(half_angle),
+				1.0f + 0.1f * static_cast<float>(mesh_index));
+			scene_nodes += std::format("{}{}", separator, mesh_index);
+		}
+
+		const std::string gltf = std::format("{{\"asset\":{{\"version\":\"2.0\"}},\"scene\":0,\"scenes\":[{{\"nodes\":[{}]}}],\"nodes\":[{}],"
+											 "\"meshes\":[{}],\"materials\":[{}],\"accessors\":[{}],\"bufferViews\":[{}],"
+											 "\"buffers\":[{{\"byteLength\":{},\"uri\":\"data:application/octet-stream;base64,{}\"}}]}}",
+			scene_nodes, nodes, gltf_meshes, materials, accessors, buffer_views, buffer.size(), EncodeBase64(buffer));
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(gltf.data(), gltf.size());
+
+		return file.good();
+	}
+}
@@ -0,0 +1,192 @@
+export module tests.job_system;
+
+import std;
+import graphics.mesh;
+import graphics.primitive;
+import renderer.vertex_storage;
+import system.gltf_loader;
+import system.job_system;
+import tests.framework;
+import tests.geometry;
+
+export namespace ysn::tests
+{
+	void RegisterJobSystemTests();
+}
+
+module :private;
+
+namespace ysn::tests
+{
+	template <typename T>
+	static bool AreBitwiseEqual(std::span<const T> lhs, std::span<const T> rhs)
+	{
+		return lhs.size() == rhs.size() && std::memcmp(lhs.data(), rhs.data(), lhs.size_bytes()) == 0;
+	}
+
+	static bool ArePrimitivesEqual(const Primitive& lhs, const Primitive& rhs)
+	{
+		return lhs.index == rhs.index && lhs.material_id == rhs.material_id && lhs.topology == rhs.topology &&
+			std::memcmp(&lhs.bbox, &rhs.bbox, sizeof(lhs.bbox)) == 0 && AreBitwiseEqual(lhs.GetVertices(), rhs.GetVertices()) &&
+			AreBitwiseEqual(lhs.GetIndices(), rhs.GetIndices()) && AreBitwiseEqual(std::span<const PrimitiveLod>(lhs.lods), std::span<const PrimitiveLod>(rhs.lods));
+	}
+
+	static bool AreMeshesEqual(const std::vector<Mesh>& lhs, const std::vector<Mesh>& rhs)
+	{
+		if (lhs.size() != rhs.size())
+			return false;
+
+		for (std::size_t i = 0; i < lhs.size(); i++)
+		{
+			if (lhs[i].name != rhs[i].name || lhs[i].primitives.size() != rhs[i].primitives.size())
+				return false;
+
+			for (std::size_t j = 0; j < lhs[i].primitives.size(); j++)
+			{
+				if (!ArePrimitivesEqual(lhs[i].primitives[j], rhs[i].primitives[j]))
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	static std::vector<TestMesh> MakeTestMeshes(std::uint32_t meshes_count, std::uint32_t grid_size)
+	{
+		std::vector<TestMesh> meshes;
+
+		for (std::uint32_t i = 0; i < meshes_count; i++)
+		{
+			// Unwelded half makes welding part of the work too
+			const float phase = static_cast<float>(i) * 0.37f;
+			meshes.push_back(i % 2 ? MakeUnweldedGridMesh(grid_size, phase) : MakeGridMesh(grid_size, phase));
+		}
+
+		return meshes;
+	}
+
+	static std::vector<std::uint32_t> GetWorkersCounts()
+	{
+		std::vector<std::uint32_t> workers_counts;
+
+		for (std::uint32_t workers_count = 1; workers_count < std::thread::hardware_concurrency(); workers_count *= 2)
+		{
+			workers_counts.push_back(workers_count);
+		}
+
+		const std::uint32_t default_workers_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+		if (workers_counts.empty() || workers_counts.back() != default_workers_count)
+		{
+			workers_counts.push_back(default_workers_count);
+		}
+
+		return workers_counts;
+	}
+
+	static void TestParallelForCoversEveryIndex(TestContext& context)
+	{
+		for (const std::uint32_t workers_count : { 0u, 1u, 4u })
+		{
+			JobSystem job_system(workers_count);
+
+			for (const std::uint32_t batch_size : { 1u, 7u, 64u })
+			{
+				constexpr std::uint32_t count = 1000;
+				std::vector<std::atomic<std::uint32_t>> visits(count);
+
+				job_system.ParallelFor(count, batch_size, [&visits](std::uint32_t i) { visits[i]++; });
+
+				context.Check(std::ranges::all_of(visits, [](const std::atomic<std::uint32_t>& value) { return value == 1; }),
+					std::format("every index visited once, {} workers, batch {}", workers_count, batch_size));
+			}
+		}
+	}
+
+	static void TestDependenciesFinishFirst(TestContext& context)
+	{
+		JobSystem job_system(4);
+
+		std::atomic<std::uint32_t> finished_count = 0;
+		std::atomic<std::uint32_t> seen_by_continuation = 0;
+
+		const JobHandle parallel_job = job_system.ScheduleParallelFor(256, 1, [&finished_count](std::uint32_t) { finished_count++; });
+		const JobHandle continuation = job_system.Schedule([&]() { seen_by_continuation = finished_count.load(); }, std::array{ parallel_job });
+
+		job_system.Wait(continuation);
+
+		context.Check(seen_by_continuation == 256, "continuation starts after every batch of its dependency");
+	}
+
+	// Import result can't depend on workers count or on order jobs are executed in
+	static void TestGltfImportIsDeterministic(TestContext& context)
+	{
+		TemporaryDirectory directory("job_system");
+		const std::filesystem::path gltf_path = directory.GetPath() / "meshes.gltf";
+
+		if (!context.Check(WriteTestGltf(gltf_path, MakeTestMeshes(12, 24)), "test glTF is written"))
+			return;
+
+		LoadingParameters loading_parameters;
+		loading_parameters.use_scene_cache = false;
+
+		JobSystem serial_job_system(0);
+		const std::optional<std::vector<Mesh>> serial_meshes = ImportGltfMeshes(gltf_path.wstring(), loading_parameters, serial_job_system);
+
+		if (!context.Check(serial_meshes.has_value() && serial_meshes->size() == 12, "serial import succeeds"))
+			return;
+
+		context.Check(std::ranges::all_of(*serial_meshes, [](const Mesh& mesh) { return mesh.primitives.front().lods.size() > 1; }),
+			"meshes are optimized and have LODs");
+
+		for (const std::uint32_t workers_count : GetWorkersCounts())
+		{
+			JobSystem job_system(workers_count);
+
+			// Repeated, so different interleavings get a chance to show up
+			for (std::uint32_t run = 0; run < 3; run++)
+			{
+				const std::optional<std::vector<Mesh>> meshes = ImportGltfMeshes(gltf_path.wstring(), loading_parameters, job_system);
+
+				context.Check(meshes.has_value() && AreMeshesEqual(meshes.value(), serial_meshes.value()),
+					std::format("import with {} workers matches serial one, run {}", workers_count, run));
+			}
+		}
+	}
+
+	static void BenchmarkWorkersScaling(TestContext& context)
+	{
+		TemporaryDirectory directory("job_system_benchmark");
+		const std::filesystem::path gltf_path = directory.GetPath() / "meshes.gltf";
+
+		if (!context.Check(WriteTestGltf(gltf_path, MakeTestMeshes(64, 96)), "test glTF is written"))
+			return;
+
+		LoadingParameters loading_parameters;
+		loading_parameters.use_scene_cache = false;
+
+		const auto measure_import = [&](std::uint32_t workers_count)
+		{
+			JobSystem job_system(workers_count);
+
+			return MeasureMilliseconds(3, [&]() { context.Check(ImportGltfMeshes(gltf_path.wstring(), loading_parameters, job_system).has_value(), "import succeeds"); });
+		};
+
+		const double serial_duration = measure_import(0);
+		context.Report(std::format("serial: {:.1f} ms", serial_duration));
+
+		for (const std::uint32_t workers_count : GetWorkersCounts())
+		{
+			const double duration = measure_import(workers_count);
+			context.Report(std::format("{} workers: {:.1f} ms, speedup {:.2f}x", workers_count, duration, serial_duration / duration));
+		}
+	}
+
+	void RegisterJobSystemTests()
+	{
+		AddTest("job_system.parallel_for_covers_every_index", TestParallelForCoversEveryIndex);
+		AddTest("job_system.dependencies_finish_first", TestDependenciesFinishFirst);
+		AddTest("job_system.gltf_import_is_deterministic", TestGltfImportIsDeterministic);
+		AddBenchmark("job_system.workers_scaling", BenchmarkWorkersScaling);
+	}
+}
@@ -0,0 +1,317 @@
+export module tests.logger;
+
+import std;
+import system.logger;
+import tests.framework;
+
+export namespace ysn::tests
+{
+	void RegisterLoggerTests();
+}
+
+module :private;
+
+namespace ysn::tests
+{
+	struct CapturedMessage
+	{
+		LogSeverity severity = LogSeverity::Info;
+		std::uint64_t sequence = 0;
+		std::uint32_t thread_index = 0;
+		std::string text;
+	};
+
+	// Called from logger thread only, messages are read after flush
+	class CapturingLogSink : public LogSink
+	{
+	public:
+		void Write(const LogMessage& message) override
+		{
+			messages.push_back({ message.severity, message.sequence, message.thread_index, std::string(message.text) });
+		}
+
+		std::vector<CapturedMessage> messages;
+	};
+
+	// Sink of global logger for one test, removed before test state goes away
+	class ScopedLogSink
+	{
+	public:
+		explicit ScopedLogSink(std::shared_ptr<LogSink> sink) : m_sink(std::move(sink))
+		{
+			Logger::Get().AddSink(m_sink);
+		}
+
+		~ScopedLogSink()
+		{
+			Logger::Get().Flush();
+			Logger::Get().RemoveSink(m_sink);
+		}
+
+		ScopedLogSink(const ScopedLogSink&) = delete;
+		ScopedLogSink& operator=(const ScopedLogSink&) = delete;
+
+	private:
+		std::shared_ptr<LogSink> m_sink;
+	};
+
+	static std::uint32_t CountStartingWith(std::span<const CapturedMessage> messages, std::string_view prefix)
+	{
+		return static_cast<std::uint32_t>(std::ranges::count_if(messages, [&](const CapturedMessage& message) { return message.text.starts_with(prefix); }));
+	}
+
+	// Producers start together and race for sequence numbers, sinks have to get every statement once and in sequence order
+	static void TestManyProducersKeepOrder(TestContext& context)
+	{
+		constexpr std::uint32_t threads_count = 4;
+		constexpr std::uint32_t statements_count = 50000;
+
+		Logger& logger = Logger::Get();
+		logger.Flush();
+
+		// Two call sites log everything, so limit would drop most of it
+		logger.SetMaxRecordsPerSecond(0);
+
+		const LoggerStats stats = logger.GetStats();
+		const auto sink = std::make_shared<CapturingLogSink>();
+
+		// Some statements don't fit record payload, so overflow path races too
+		const std::string long_text(300, 'x');
+
+		{
+			ScopedLogSink scoped_sink(sink);
+
+			std::latch start(threads_count);
+			std::vector<std::jthread> threads;
+
+			for (std::uint32_t thread = 0; thread < threads_count; thread++)
+			{
+				threads.emplace_back(
+					[&, thread]()
+					{
+						start.arrive_and_wait();
+
+						for (std::uint32_t i = 0; i < statements_count; i++)
+						{
+							if (i % 64 == 0)
+							{
+								LogInfo << "Logger test " << thread << ' ' << i << ' ' << long_text;
+							}
+							else
+							{
+								LogInfo << "Logger test " << thread << ' ' << i;
+							}
+						}
+					});
+			}
+		}
+
+		logger.SetMaxRecordsPerSecond(Logger::default_max_records_per_second);
+
+		const std::vector<CapturedMessage>& messages = sink->messages;
+
+		context.Check(CountStartingWith(messages, "Logger test ") == threads_count * statements_count, "every statement reaches sink");
+		context.Check(logger.GetStats().suppressed == stats.suppressed, "nothing is dropped while limit is off");
+
+		bool is_sequence_ordered = true;
+
+		for (std::size_t i = 1; i < messages.size(); i++)
+		{
+			is_sequence_ordered &= messages[i].sequence == messages[i - 1].sequence + 1;
+		}
+
+		context.Check(is_sequence_ordered, "sink gets statements of all threads in sequence order without gaps");
+
+		std::array<std::uint32_t, threads_count> next_statements = {};
+		std::array<std::optional<std::uint32_t>, threads_count> thread_indices = {};
+		std::uint32_t broken_statements_count = 0;
+
+		for (const CapturedMessage& message : messages)
+		{
+			if (!message.text.starts_with("Logger test "))
+				continue;
+
+			std::istringstream text(message.text.substr(std::string_view("Logger test ").size()));
+
+			std::uint32_t thread = threads_count;
+			std::uint32_t statement = 0;
+			std::string tail;
+			text >> thread >> statement >> tail;
+
+			if (thread >= threads_count)
+			{
+				broken_statements_count++;
+				continue;
+			}
+
+			const bool is_tail_expected = statement % 64 == 0 ? tail == long_text : tail.empty();
+			const bool is_thread_same = thread_indices[thread].value_or(message.thread_index) == message.thread_index;
+
+			broken_statements_count += statement != next_statements[thread] || !is_tail_expected || !is_thread_same;
+
+			next_statements[thread] = statement + 1;
+			thread_indices[thread] = message.thread_index;
+		}
+
+		context.Check(broken_statements_count == 0, std::format("{} statements are reordered within thread, torn or lost", broken_statements_count));
+	}
+
+	// Engine never sets the limit, so default one is what protects log from statements hit every frame
+	static void TestDefaultRateLimitCapsCallSite(TestContext& context)
+	{
+		constexpr std::uint32_t max_records_per_second = Logger::default_max_records_per_second;
+		constexpr std::uint32_t statements_count = 10 * max_records_per_second;
+
+		static_assert(max_records_per_second > 0, "rate limit is on by default");
+
+		Logger& logger = Logger::Get();
+		const auto sink = std::make_shared<CapturingLogSink>();
+
+		std::uint64_t suppressed_count = 0;
+
+		{
+			ScopedLogSink scoped_sink(sink);
+
+			logger.Flush();
+			suppressed_count = logger.GetStats().suppressed;
+
+			for (std::uint32_t i = 0; i < statements_count; i++)
+			{
+				LogInfo << "Logger default limit test " << i;
+			}
+		}
+
+		const std::uint32_t written_count = CountStartingWith(sink->messages, "Logger default limit test ");
+
+		context.Report(std::format("{} of {} statements written", written_count, statements_count));
+
+		// Loop may cross one second boundary, then the limit applies twice
+		context.Check(written_count >= max_records_per_second && written_count <= 2 * max_records_per_second, "default limit caps call site");
+		context.Check(logger.GetStats().suppressed - suppressed_count == statements_count - written_count, "dropped statements are counted");
+	}
+
+	static void TestRateLimitIsPerCallSite(TestContext& context)
+	{
+		constexpr std::uint32_t statements_count = 20;
+		constexpr std::uint32_t max_records_per_second = 5;
+
+		Logger& logger = Logger::Get();
+		const auto sink = std::make_shared<CapturingLogSink>();
+
+		std::uint64_t suppressed_count = 0;
+
+		{
+			ScopedLogSink scoped_sink(sink);
+
+			logger.SetMaxRecordsPerSecond(0);
+
+			for (std::uint32_t i = 0; i < statements_count; i++)
+			{
+				LogWarning << "Logger unlimited test " << i;
+			}
+
+			logger.Flush();
+			suppressed_count = logger.GetStats().suppressed;
+
+			logger.SetMaxRecordsPerSecond(max_records_per_second);
+
+			for (std::uint32_t i = 0; i < statements_count; i++)
+			{
+				LogWarning << "Logger limited test first " << i;
+				LogWarning << "Logger limited test second " << i;
+			}
+
+			logger.SetMaxRecordsPerSecond(Logger::default_max_records_per_second);
+		}
+
+		const std::uint32_t first_count = CountStartingWith(sink->messages, "Logger limited test first ");
+		const std::uint32_t second_count = CountStartingWith(sink->messages, "Logger limited test second ");
+
+		context.Check(CountStartingWith(sink->messages, "Logger unlimited test ") == statements_count, "nothing is dropped while limit is off");
+
+		// Loop may cross one second boundary, then the limit applies twice
+		context.Check(first_count >= max_records_per_second && first_count <= 2 * max_records_per_second, "first call site is limited");
+		context.Check(second_count >= max_records_per_second && second_count <= 2 * max_records_per_second, "second call site is limited on its own");
+		context.Check(logger.GetStats().suppressed - suppressed_count == 2 * statements_count - first_count - second_count, "dropped statements are counted");
+	}
+
+	// What every statement cost on caller thread before: formatting, lock and flushed file write
+	static void LogSynchronously(std::mutex& mutex, std::ofstream& file, std::uint32_t i)
+	{
+		const std::string text = std::format("Logger benchmark statement {} value {}", i, static_cast<float>(i) * 0.5f);
+		const auto local_time = std::chrono::zoned_time(std::chrono::current_zone(), std::chrono::floor<std::chrono::milliseconds>(std::chrono::system_clock::now()));
+		const std::string line = std::format("{:%H:%M:%S %d.%m} [Info] {}", local_time, text);
+
+		std::lock_guard lock(mutex);
+		file << line << std::endl;
+	}
+
+	static void BenchmarkCallerLatency(TestContext& context)
+	{
+		// Half of thread queue per batch, flushed between batches so caller never waits for free space
+		constexpr std::uint32_t batch_statements_count = LogThreadQueue::capacity / 2;
+		constexpr std::uint32_t batches_count = 64;
+
+		const TemporaryDirectory directory("logger");
+
+		Logger& logger = Logger::Get();
+		const std::uint64_t records_count = logger.GetStats().records;
+
+		// Every batch comes from one call site, what is measured is queueing and not dropping
+		logger.SetMaxRecordsPerSecond(0);
+
+		double async_best_ms = std::numeric_limits<double>::max();
+		double async_total_ms = 0.0;
+
+		{
+			ScopedLogSink scoped_sink(std::make_shared<FileLogSink>(directory.GetPath() / "async.log"));
+
+			for (std::uint32_t batch = 0; batch < batches_count; batch++)
+			{
+				const auto start_time = std::chrono::steady_clock::now();
+
+				for (std::uint32_t i = 0; i < batch_statements_count; i++)
+				{
+					LogInfo << "Logger benchmark statement " << i << " value " << static_cast<float>(i) * 0.5f;
+				}
+
+				const double duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+
+				async_best_ms = std::min(async_best_ms, duration);
+				async_total_ms += duration;
+
+				logger.Flush();
+			}
+		}
+
+		logger.SetMaxRecordsPerSecond(Logger::default_max_records_per_second);
+
+		std::mutex mutex;
+		std::ofstream file(directory.GetPath() / "sync.log", std::ios::out | std::ios::trunc);
+
+		const double sync_ms = MeasureMilliseconds(5,
+			[&]()
+			{
+				for (std::uint32_t i = 0; i < batch_statements_count; i++)
+				{
+					LogSynchronously(mutex, file, i);
+				}
+			});
+
+		const double statements_count = static_cast<double>(batch_statements_count);
+		const double async_ns = async_total_ms * 1e6 / (statements_count * batches_count);
+		const double sync_ns = sync_ms * 1e6 / statements_count;
+
+		context.Report(std::format("caller side per statement: async {:.0f} ns (best batch {:.0f} ns), synchronous formatted file write {:.0f} ns, {:.1f}x", async_ns,
+			async_best_ms * 1e6 / statements_count, sync_ns, sync_ns / async_ns));
+		context.Check(logger.GetStats().records - records_count >= batch_statements_count * batches_count, "every statement is written");
+	}
+
+	void RegisterLoggerTests()
+	{
+		AddTest("logger.many_producers_keep_order", TestManyProducersKeepOrder);
+		AddTest("logger.default_rate_limit_caps_call_site", TestDefaultRateLimitCapsCallSite);
+		AddTest("logger.rate_limit_is_per_call_site", TestRateLimitIsPerCallSite);
+		AddBenchmark("logger.caller_latency", BenchmarkCallerLatency);
+	}
+}
@@ -0,0 +1,30 @@
+import std;
+import tests.culling;
+import tests.framework;
+import tests.job_system;
+import tests.logger;
+import tests.mesh_optimizer;
+import tests.profiler;
+import tests.render_queue;
+import tests.scene_cache;
+import tests.shader_cache;
+import tests.texture_cooker;
+import tests.vertex_storage;
+
+int main(int argc, char** argv)
+{
+	ysn::tests::RegisterCullingTests();
+	ysn::tests::RegisterJobSystemTests();
+	ysn::tests::RegisterLoggerTests();
+	ysn::tests::RegisterMeshOptimizerTests();
+	ysn::tests::RegisterProfilerTests();
+	ysn::tests::RegisterRenderQueueTests();
+	ysn::tests::RegisterSceneCacheTests();
+	ysn::tests::RegisterShaderCacheTests();
+	ysn::tests::RegisterTextureCookerTests();
+	ysn::tests::RegisterVertexStorageTests();
+
+	const std::vector<std::string_view> arguments(argv + 1, argv + argc);
+
+	return ysn::tests::RunTests(arguments);
+}
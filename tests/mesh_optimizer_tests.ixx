@@ -0,0 +1,258 @@
+module;
+
+#include <d3d12.h>
+
+export module tests.mesh_optimizer;
+
+import std;
+import graphics.aabb;
+import graphics.mesh_optimizer;
+import graphics.primitive;
+import renderer.vertex_storage;
+import tests.framework;
+import tests.geometry;
+
+export namespace ysn::tests
+{
+	void RegisterMeshOptimizerTests();
+}
+
+module :private;
+
+namespace ysn::tests
+{
+	static Primitive MakePrimitive(const TestMesh& mesh)
+	{
+		Primitive primitive;
+		primitive.topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		primitive.vertices = mesh.vertices;
+		primitive.indices = mesh.indices;
+
+		primitive.bbox.min = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		primitive.bbox.max = { -primitive.bbox.min.x, -primitive.bbox.min.y, -primitive.bbox.min.z };
+
+		for (const Vertex& vertex : mesh.vertices)
+		{
+			AABB& bbox = primitive.bbox;
+			bbox.min = { std::min(bbox.min.x, vertex.position.x), std::min(bbox.min.y, vertex.position.y), std::min(bbox.min.z, vertex.position.z) };
+			bbox.max = { std::max(bbox.max.x, vertex.position.x), std::max(bbox.max.y, vertex.position.y), std::max(bbox.max.z, vertex.position.z) };
+		}
+
+		return primitive;
+	}
+
+	static void ShuffleTriangles(std::vector<std::uint32_t>& indices, std::uint32_t seed)
+	{
+		std::vector<std::array<std::uint32_t, 3>> triangles(indices.size() / 3);
+		std::memcpy(triangles.data(), indices.data(), indices.size() * sizeof(std::uint32_t));
+
+		std::mt19937 random(seed);
+		std::ranges::shuffle(triangles, random);
+
+		std::memcpy(indices.data(), triangles.data(), indices.size() * sizeof(std::uint32_t));
+	}
+
+	using Point = std::array<double, 3>;
+
+	static Point ToPoint(const Vertex& vertex)
+	{
+		return { vertex.position.x, vertex.position.y, vertex.position.z };
+	}
+
+	static Point Sub(const Point& lhs, const Point& rhs)
+	{
+		return { lhs[0] - rhs[0], lhs[1] - rhs[1], lhs[2] - rhs[2] };
+	}
+
+	static double Dot(const Point& lhs, const Point& rhs)
+	{
+		return lhs[0] * rhs[0] + lhs[1] * rhs[1] + lhs[2] * rhs[2];
+	}
+
+	// Closest point on triangle by Voronoi regions, Real-Time Collision Detection 5.1.5
+	static double DistanceToTriangle(const Point& p, const Point& a, const Point& b, const Point& c)
+	{
+		const Point ab = Sub(b, a);
+		const Point ac = Sub(c, a);
+		const Point ap = Sub(p, a);
+
+		const auto distance_to = [&p](const Point& base, const Point& direction, double t)
+		{
+			const Point closest = { base[0] + direction[0] * t, base[1] + direction[1] * t, base[2] + direction[2] * t };
+			const Point offset = Sub(p, closest);
+			return std::sqrt(Dot(offset, offset));
+		};
+
+		const double d1 = Dot(ab, ap);
+		const double d2 = Dot(ac, ap);
+
+		if (d1 <= 0.0 && d2 <= 0.0)
+			return distance_to(a, ab, 0.0);
+
+		const Point bp = Sub(p, b);
+		const double d3 = Dot(ab, bp);
+		const double d4 = Dot(ac, bp);
+
+		if (d3 >= 0.0 && d4 <= d3)
+			return distance_to(b, ab, 0.0);
+
+		const double vc = d1 * d4 - d3 * d2;
+
+		if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+			return distance_to(a, ab, d1 / (d1 - d3));
+
+		const Point cp = Sub(p, c);
+		const double d5 = Dot(ab, cp);
+		const double d6 = Dot(ac, cp);
+
+		if (d6 >= 0.0 && d5 <= d6)
+			return distance_to(c, ab, 0.0);
+
+		const double vb = d5 * d2 - d1 * d6;
+
+		if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+			return distance_to(a, ac, d2 / (d2 - d6));
+
+		const double va = d3 * d6 - d5 * d4;
+
+		if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+			return distance_to(b, Sub(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		const double denominator = 1.0 / (va + vb + vc);
+		const double v = vb * denominator;
+		const double w = vc * denominator;
+		const Point closest = { a[0] + ab[0] * v + ac[0] * w, a[1] + ab[1] * v + ac[1] * w, a[2] + ab[2] * v + ac[2] * w };
+		const Point offset = Sub(p, closest);
+
+		return std::sqrt(Dot(offset, offset));
+	}
+
+	// Largest distance from LOD0 vertices to LOD surface, one sided Hausdorff distance sampled at vertices
+	static double MeasureLodDistance(const Primitive& primitive, const PrimitiveLod& lod)
+	{
+		const std::span<const std::uint32_t> lod0_indices = std::span(primitive.indices).first(primitive.lods[0].index_count);
+		const std::span<const std::uint32_t> lod_indices = std::span(primitive.indices).subspan(lod.index_offset, lod.index_count);
+
+		double max_distance = 0.0;
+
+		for (const std::uint32_t index : lod0_indices)
+		{
+			const Point point = ToPoint(primitive.vertices[index]);
+			double distance = std::numeric_limits<double>::max();
+
+			for (std::size_t i = 0; i < lod_indices.size(); i += 3)
+			{
+				distance = std::min(distance, DistanceToTriangle(point, ToPoint(primitive.vertices[lod_indices[i + 0]]),
+												  ToPoint(primitive.vertices[lod_indices[i + 1]]), ToPoint(primitive.vertices[lod_indices[i + 2]])));
+			}
+
+			max_distance = std::max(max_distance, distance);
+		}
+
+		return max_distance;
+	}
+
+	static void TestVertexCacheImprovesAcmr(TestContext& context)
+	{
+		TestMesh mesh = MakeGridMesh(64);
+		ShuffleTriangles(mesh.indices, 1);
+
+		const std::uint32_t vertices_count = static_cast<std::uint32_t>(mesh.vertices.size());
+		const float acmr_before = AnalyzeVertexCache(mesh.indices, vertices_count).acmr;
+
+		OptimizeVertexCache(mesh.indices, vertices_count);
+
+		const float acmr_after = AnalyzeVertexCache(mesh.indices, vertices_count).acmr;
+
+		context.Report(std::format("ACMR {:.3f} -> {:.3f}", acmr_before, acmr_after));
+
+		// Regular grid can't go below 0.5, Forsyth with 16 entries cache gets close to 0.7 on it
+		context.Check(acmr_after < acmr_before * 0.5f, "ACMR of shuffled grid is at least halved");
+		context.Check(acmr_after < 0.8f, "ACMR is close to optimal one of a grid");
+
+		std::vector<std::uint32_t> sorted_indices = mesh.indices;
+		std::vector<std::uint32_t> source_indices = MakeGridMesh(64).indices;
+		std::ranges::sort(sorted_indices);
+		std::ranges::sort(source_indices);
+
+		context.Check(sorted_indices == source_indices, "reordering keeps every triangle corner");
+	}
+
+	static void TestWeldingReducesVertices(TestContext& context)
+	{
+		constexpr std::uint32_t grid_size = 32;
+
+		Primitive primitive = MakePrimitive(MakeUnweldedGridMesh(grid_size));
+		const MeshOptimizationStatistics statistics = OptimizePrimitive(primitive, {});
+
+		context.Report(std::format("vertices {} -> {}, ACMR {:.3f} -> {:.3f}", statistics.vertices_before, statistics.vertices_after,
+			statistics.acmr_before, statistics.acmr_after));
+
+		context.Check(statistics.vertices_before == grid_size * grid_size * 6, "every triangle corner is own vertex before welding");
+		context.Check(statistics.vertices_after == (grid_size + 1) * (grid_size + 1), "welding brings grid back to shared vertices");
+		context.Check(statistics.acmr_after < 0.8f, "welded grid is cache optimized");
+		context.Check(statistics.triangles_count == grid_size * grid_size * 2 && primitive.lods[0].index_count == grid_size * grid_size * 6,
+			"LOD0 keeps every triangle");
+	}
+
+	static void CheckLodErrors(TestContext& context, const MeshOptimizationParameters& parameters)
+	{
+		Primitive primitive = MakePrimitive(MakeGridMesh(48, 0.5f));
+		OptimizePrimitive(primitive, parameters);
+
+		if (!context.Check(primitive.lods.size() == parameters.max_lods_count, "every LOD is built"))
+			return;
+
+		const float extent = std::max({ primitive.bbox.max.x - primitive.bbox.min.x, primitive.bbox.max.y - primitive.bbox.min.y,
+			primitive.bbox.max.z - primitive.bbox.min.z });
+
+		float max_error = parameters.lod_max_error * extent;
+
+		for (std::uint32_t lod = 1; lod < primitive.lods.size(); lod++, max_error *= parameters.lod_error_growth)
+		{
+			const PrimitiveLod& current = primitive.lods[lod];
+			const PrimitiveLod& previous = primitive.lods[lod - 1];
+			const double measured_error = MeasureLodDistance(primitive, current);
+
+			context.Report(std::format("LOD{}: {} indices, error {:.5f}, measured {:.5f}, bound {:.5f}", lod, current.index_count, current.error,
+				measured_error, max_error));
+
+			context.Check(current.index_count < previous.index_count, std::format("LOD{} has fewer indices than previous one", lod));
+			context.Check(current.error >= previous.error, std::format("LOD{} error doesn't go down", lod));
+			// Relative slack covers rounding of error to float
+			context.Check(current.error <= max_error * 1.0001f, std::format("LOD{} error fits its bound", lod));
+
+			context.Check(measured_error <= current.error + extent * 1e-5, std::format("LOD{} surface is within reported error", lod));
+		}
+	}
+
+	static void TestLodErrorIsBounded(TestContext& context)
+	{
+		// Default parameters run out of indices budget first, tight ones run into error bound which grows per LOD
+		CheckLodErrors(context, {});
+		CheckLodErrors(context, { .max_lods_count = 4, .lod_reduction = 0.05f, .lod_max_error = 0.001f, .lod_error_growth = 2.0f });
+	}
+
+	static void BenchmarkOptimizePrimitive(TestContext& context)
+	{
+		const TestMesh mesh = MakeUnweldedGridMesh(128);
+
+		const double duration = MeasureMilliseconds(3,
+			[&]()
+			{
+				Primitive primitive = MakePrimitive(mesh);
+				OptimizePrimitive(primitive, {});
+			});
+
+		const double triangles_count = static_cast<double>(mesh.indices.size() / 3);
+		context.Report(std::format("{:.0f} triangles: {:.1f} ms, {:.2f} M triangles/s", triangles_count, duration, triangles_count / duration / 1000.0));
+	}
+
+	void RegisterMeshOptimizerTests()
+	{
+		AddTest("mesh_optimizer.vertex_cache_improves_acmr", TestVertexCacheImprovesAcmr);
+		AddTest("mesh_optimizer.welding_reduces_vertices", TestWeldingReducesVertices);
+		AddTest("mesh_optimizer.lod_error_is_bounded", TestLodErrorIsBounded);
+		AddBenchmark("mesh_optimizer.optimize_primitive", BenchmarkOptimizePrimitive);
+	}
+}
@@ -0,0 +1,186 @@
+export module tests.profiler;
+
+import std;
+import system.profiler;
+import tests.framework;
+
+export namespace ysn::tests
+{
+	void RegisterProfilerTests();
+}
+
+module :private;
+
+namespace ysn::tests
+{
+	// Every field is derived from sequence number, so torn event can't pass the check
+	static ProfilerEvent MakeSequenceEvent(std::uint64_t sequence)
+	{
+		constexpr std::array<std::string_view, 3> names = { "A", "Profiler Test", "Profiler Test Event With Longer Name" };
+
+		const std::string_view name = names[sequence % names.size()];
+
+		return { .timestamp = sequence,
+			.name = name.data(),
+			.name_length = static_cast<std::uint32_t>(name.size()),
+			.type = sequence % 2 ? ProfilerEventType::ZoneEnd : ProfilerEventType::ZoneBegin,
+			.value = static_cast<double>(sequence) };
+	}
+
+	static bool IsSequenceEvent(const ProfilerEvent& event, std::uint64_t sequence)
+	{
+		const ProfilerEvent expected = MakeSequenceEvent(sequence);
+
+		return event.timestamp == expected.timestamp && event.name == expected.name && event.name_length == expected.name_length &&
+			event.type == expected.type && event.value == expected.value;
+	}
+
+	// Producer retries on full buffer, consumer drains concurrently and has to see every event once, in order and whole
+	static void TestThreadBufferIsLosslessAndUntorn(TestContext& context)
+	{
+		constexpr std::uint64_t events_count = 4'000'000;
+
+		auto buffer = std::make_unique<ProfilerThreadBuffer>(0);
+
+		std::atomic<bool> is_producing = true;
+		std::uint64_t rejected_pushes_count = 0;
+
+		std::jthread producer(
+			[&]()
+			{
+				for (std::uint64_t i = 0; i < events_count; i++)
+				{
+					const ProfilerEvent event = MakeSequenceEvent(i);
+
+					while (!buffer->Push(event))
+					{
+						rejected_pushes_count++;
+						std::this_thread::yield();
+					}
+				}
+
+				is_producing = false;
+			});
+
+		std::uint64_t received_count = 0;
+		std::uint64_t broken_events_count = 0;
+
+		const auto consume = [&](const ProfilerEvent& event) { broken_events_count += !IsSequenceEvent(event, received_count++); };
+
+		while (is_producing)
+		{
+			buffer->Drain(consume);
+		}
+
+		producer.join();
+		buffer->Drain(consume);
+
+		context.Report(std::format("{} events, producer waited on full buffer {} times", events_count, rejected_pushes_count));
+
+		context.Check(received_count == events_count, "every pushed event is drained");
+		context.Check(broken_events_count == 0, std::format("{} events are lost, reordered or torn", broken_events_count));
+		context.Check(buffer->GetDroppedEventsCount() == rejected_pushes_count, "every rejected push is counted as dropped");
+	}
+
+	// Zones of several threads are collected while they are recorded, every begin has to meet its end
+	static void TestZonesFromManyThreads(TestContext& context)
+	{
+		constexpr std::uint32_t zones_count = 200; // Fits zone history, so every sample is kept
+
+		Profiler& profiler = Profiler::Get();
+		profiler.Collect();
+
+		const std::uint64_t dropped_events_count = profiler.GetDroppedEventsCount();
+
+		std::atomic<std::uint32_t> running_threads_count = 4;
+
+		const auto record_zones = [&](ProfilerName name)
+		{
+			for (std::uint32_t i = 0; i < zones_count; i++)
+			{
+				ScopedZone outer(name);
+				ScopedZone inner("Profiler Test Inner");
+				ProfilerCounter("Profiler Test Counter", static_cast<double>(i));
+			}
+
+			running_threads_count--;
+		};
+
+		{
+			// Literals are passed right here, names can't be forwarded through thread arguments
+			std::array<std::jthread, 4> threads = { std::jthread([&]() { record_zones("Profiler Test Thread 0"); }),
+				std::jthread([&]() { record_zones("Profiler Test Thread 1"); }), std::jthread([&]() { record_zones("Profiler Test Thread 2"); }),
+				std::jthread([&]() { record_zones("Profiler Test Thread 3"); }) };
+
+			while (running_threads_count > 0)
+			{
+				profiler.Collect();
+			}
+		}
+
+		profiler.Collect();
+
+		const std::vector<ProfilerZoneStats> zone_stats = profiler.GetZoneStats();
+
+		const auto get_samples = [&zone_stats](std::string_view name)
+		{
+			const auto zone = std::ranges::find(zone_stats, name, &ProfilerZoneStats::name);
+			return zone != zone_stats.end() ? zone->samples : 0;
+		};
+
+		for (const std::string_view name : { "Profiler Test Thread 0", "Profiler Test Thread 1", "Profiler Test Thread 2", "Profiler Test Thread 3" })
+		{
+			context.Check(get_samples(name) == zones_count, std::format("every zone of {} is collected", name));
+		}
+
+		context.Check(get_samples("Profiler Test Inner") == std::min(zones_count * 4, Profiler::zone_history_size), "nested zones are collected");
+		context.Check(profiler.GetDroppedEventsCount() == dropped_events_count, "no events are dropped");
+	}
+
+	static void BenchmarkScopedZone(TestContext& context)
+	{
+		// Half of thread buffer per batch, collected between batches so nothing is dropped
+		constexpr std::uint32_t batch_zones_count = ProfilerThreadBuffer::capacity / 4;
+		constexpr std::uint32_t batches_count = 64;
+
+		Profiler& profiler = Profiler::Get();
+		profiler.Collect();
+
+		const std::uint64_t dropped_events_count = profiler.GetDroppedEventsCount();
+
+		double best_batch_ms = std::numeric_limits<double>::max();
+		double collect_ms = 0.0;
+
+		for (std::uint32_t batch = 0; batch < batches_count; batch++)
+		{
+			const auto start_time = std::chrono::steady_clock::now();
+
+			for (std::uint32_t i = 0; i < batch_zones_count; i++)
+			{
+				ScopedZone zone("Profiler Benchmark Zone");
+			}
+
+			const auto end_time = std::chrono::steady_clock::now();
+
+			profiler.Collect();
+
+			const auto collect_end_time = std::chrono::steady_clock::now();
+
+			best_batch_ms = std::min(best_batch_ms, std::chrono::duration<double, std::milli>(end_time - start_time).count());
+			collect_ms += std::chrono::duration<double, std::milli>(collect_end_time - end_time).count();
+		}
+
+		const double zone_ns = best_batch_ms * 1e6 / batch_zones_count;
+		const double collect_event_ns = collect_ms * 1e6 / (2.0 * batch_zones_count * batches_count);
+
+		context.Report(std::format("scoped zone {:.1f} ns, collect {:.1f} ns per event", zone_ns, collect_event_ns));
+		context.Check(profiler.GetDroppedEventsCount() == dropped_events_count, "no events are dropped");
+	}
+
+	void RegisterProfilerTests()
+	{
+		AddTest("profiler.thread_buffer_is_lossless_and_untorn", TestThreadBufferIsLosslessAndUntorn);
+		AddTest("profiler.zones_from_many_threads", TestZonesFromManyThreads);
+		AddBenchmark("profiler.scoped_zone", BenchmarkScopedZone);
+	}
+}
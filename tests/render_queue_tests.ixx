@@ -0,0 +1,238 @@
+module;
+
+#include <d3d12.h>
+
+export module tests.render_queue;
+
+import std;
+import renderer.render_queue;
+import tests.framework;
+
+export namespace ysn::tests
+{
+	void RegisterRenderQueueTests();
+}
+
+module :private;
+
+namespace ysn::tests
+{
+	// Counts emitted commands without GPU and remembers instances in the order they are drawn
+	class CountingCommandRecorder : public CommandRecorder
+	{
+	public:
+		void SetPipelineState(ID3D12PipelineState*) override
+		{
+			stats.pipeline_states++;
+		}
+		void SetRootSignature(ID3D12RootSignature*) override
+		{
+			stats.root_signatures++;
+		}
+		void SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY) override
+		{
+			stats.topologies++;
+		}
+		void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW&) override
+		{
+			stats.vertex_buffers++;
+		}
+		void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW&) override
+		{
+			stats.index_buffers++;
+		}
+		void SetInstanceId(std::uint32_t instance_id) override
+		{
+			stats.instance_ids++;
+			m_instance_id = instance_id;
+		}
+		void DrawIndexed(std::uint32_t, std::uint32_t, std::int32_t) override
+		{
+			stats.draws++;
+			drawn_instances.push_back(m_instance_id);
+		}
+		void Draw(std::uint32_t, std::uint32_t) override
+		{
+			stats.draws++;
+			drawn_instances.push_back(m_instance_id);
+		}
+
+		CommandRecorderStats stats;
+		std::vector<std::uint32_t> drawn_instances;
+
+	private:
+		std::uint32_t m_instance_id = 0;
+	};
+
+	// Scene order, meshes of one model share PSO and material and are scattered over depth
+	static std::vector<DrawCommand> MakeSceneDraws(std::uint32_t count, std::uint32_t psos_count, std::uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_int_distribution<std::uint32_t> pso(0, psos_count - 1);
+		std::uniform_int_distribution<std::uint32_t> material(0, 31);
+		std::uniform_int_distribution<std::uint32_t> mesh(0, 63);
+		std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+		std::bernoulli_distribution is_translucent(0.1);
+		std::bernoulli_distribution is_strip(0.05);
+
+		std::vector<DrawCommand> draws(count);
+
+		for (std::uint32_t i = 0; i < count; i++)
+		{
+			const std::uint32_t mesh_id = mesh(random);
+
+			DrawCommand& draw = draws[i];
+			draw.pso_id = static_cast<PsoId>(pso(random));
+			draw.material_id = material(random);
+			draw.depth = depth(random);
+			draw.is_translucent = is_translucent(random);
+			draw.instance_id = i; // Unique, so instance changes show draw order
+			draw.topology = is_strip(random) ? D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP : D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+			draw.vertex_buffer_view = { .BufferLocation = 0x10000ull * (mesh_id + 1), .SizeInBytes = 0x1000, .StrideInBytes = 32 };
+			draw.index_buffer_view = { .BufferLocation = 0x10000ull * (mesh_id + 1) + 0x8000, .SizeInBytes = 0x800, .Format = DXGI_FORMAT_R32_UINT };
+			draw.count = 36;
+		}
+
+		return draws;
+	}
+
+	// What recording in scene order emits when only redundant state is skipped, there is no root signature without PSOs
+	static CommandRecorderStats CountSceneOrderStateChanges(std::span<const DrawCommand> draws)
+	{
+		CommandRecorderStats stats;
+		stats.root_signatures = draws.empty() ? 0 : 1;
+
+		const DrawCommand* previous = nullptr;
+
+		for (const DrawCommand& draw : draws)
+		{
+			stats.pipeline_states += !previous || previous->pso_id != draw.pso_id;
+			stats.topologies += !previous || previous->topology != draw.topology;
+			stats.vertex_buffers += !previous || previous->vertex_buffer_view.BufferLocation != draw.vertex_buffer_view.BufferLocation;
+			stats.index_buffers += !previous || previous->index_buffer_view.BufferLocation != draw.index_buffer_view.BufferLocation;
+			stats.instance_ids++;
+			stats.draws++;
+
+			previous = &draw;
+		}
+
+		return stats;
+	}
+
+	static CountingCommandRecorder SubmitSorted(RenderQueue& render_queue, std::span<const DrawCommand> draws)
+	{
+		render_queue.Clear();
+
+		for (const DrawCommand& draw : draws)
+		{
+			render_queue.Add(draw);
+		}
+
+		render_queue.Sort();
+
+		CountingCommandRecorder recorder;
+		render_queue.Submit(recorder);
+
+		return recorder;
+	}
+
+	static void TestSortingReducesStateChanges(TestContext& context)
+	{
+		constexpr std::uint32_t psos_count = 8;
+
+		const std::vector<DrawCommand> draws = MakeSceneDraws(2000, psos_count, 1);
+		const CommandRecorderStats scene_order = CountSceneOrderStateChanges(draws);
+
+		RenderQueue render_queue;
+		const CommandRecorderStats sorted = SubmitSorted(render_queue, draws).stats;
+
+		context.Report(std::format("state changes {} -> {}, pipeline states {} -> {}, topologies {} -> {}", scene_order.GetStateChanges(),
+			sorted.GetStateChanges(), scene_order.pipeline_states, sorted.pipeline_states, scene_order.topologies, sorted.topologies));
+
+		context.Check(sorted.draws == draws.size(), "every draw is submitted");
+		context.Check(sorted.GetStateChanges() < scene_order.GetStateChanges(), "sorted queue emits fewer state changes than scene order");
+
+		// Opaque ones set every PSO once, translucent ones are ordered by depth and may switch on every draw
+		const auto translucent_count = static_cast<std::uint32_t>(std::ranges::count_if(draws, [](const DrawCommand& draw) { return draw.is_translucent; }));
+		context.Check(sorted.pipeline_states <= psos_count + translucent_count, "opaque draws set each pipeline state once");
+		context.Check(sorted.pipeline_states * 4 < scene_order.pipeline_states, "pipeline state changes drop at least four times");
+	}
+
+	static void TestSortOrder(TestContext& context)
+	{
+		const std::vector<DrawCommand> draws = MakeSceneDraws(2000, 8, 2);
+
+		RenderQueue render_queue;
+		const CountingCommandRecorder recorder = SubmitSorted(render_queue, draws);
+
+		if (!context.Check(recorder.drawn_instances.size() == draws.size(), "every draw is submitted"))
+			return;
+
+		std::vector<std::uint32_t> drawn_instances = recorder.drawn_instances;
+		std::ranges::sort(drawn_instances);
+		context.Check(std::ranges::equal(drawn_instances, std::views::iota(0u, static_cast<std::uint32_t>(draws.size()))), "every draw is submitted once");
+
+		bool is_translucent_reached = false;
+		bool is_opaque_after_translucent = false;
+		bool is_opaque_depth_ordered = true;
+		bool is_translucent_depth_ordered = true;
+		std::set<PsoId> finished_psos;
+		bool is_pso_grouped = true;
+
+		for (std::size_t i = 0; i < recorder.drawn_instances.size(); i++)
+		{
+			const DrawCommand& draw = draws[recorder.drawn_instances[i]];
+
+			is_opaque_after_translucent |= is_translucent_reached && !draw.is_translucent;
+			is_translucent_reached |= draw.is_translucent;
+
+			if (i == 0)
+				continue;
+
+			const DrawCommand& previous = draws[recorder.drawn_instances[i - 1]];
+
+			if (!draw.is_translucent && !previous.is_translucent)
+			{
+				if (previous.pso_id != draw.pso_id)
+				{
+					is_pso_grouped &= finished_psos.insert(previous.pso_id).second && !finished_psos.contains(draw.pso_id);
+				}
+				else if (previous.material_id == draw.material_id)
+				{
+					is_opaque_depth_ordered &= previous.depth <= draw.depth;
+				}
+			}
+
+			if (draw.is_translucent && previous.is_translucent)
+			{
+				is_translucent_depth_ordered &= previous.depth >= draw.depth;
+			}
+		}
+
+		context.Check(!is_opaque_after_translucent, "translucent draws go after opaque ones");
+		context.Check(is_pso_grouped, "opaque draws are grouped by pipeline state");
+		context.Check(is_opaque_depth_ordered, "opaque draws of one state go front to back");
+		context.Check(is_translucent_depth_ordered, "translucent draws go back to front");
+	}
+
+	static void BenchmarkRenderQueue(TestContext& context)
+	{
+		const std::vector<DrawCommand> draws = MakeSceneDraws(100000, 32, 3);
+		const CommandRecorderStats scene_order = CountSceneOrderStateChanges(draws);
+
+		RenderQueue render_queue;
+		CommandRecorderStats sorted;
+
+		const double duration = MeasureMilliseconds(5, [&]() { sorted = SubmitSorted(render_queue, draws).stats; });
+
+		context.Report(std::format("{} draws: fill, sort and submit {:.2f} ms", draws.size(), duration));
+		context.Report(std::format("state changes {} -> {}", scene_order.GetStateChanges(), sorted.GetStateChanges()));
+	}
+
+	void RegisterRenderQueueTests()
+	{
+		AddTest("render_queue.sorting_reduces_state_changes", TestSortingReducesStateChanges);
+		AddTest("render_queue.sort_order", TestSortOrder);
+		AddBenchmark("render_queue.fill_sort_submit", BenchmarkRenderQueue);
+	}
+}
@@ -0,0 +1,264 @@
+module;
+
+#include <DirectXMath.h>
+#include <d3d12.h>
+
+#include <shader_structs.h>
+
+export module tests.scene_cache;
+
+import std;
+import graphics.mesh;
+import graphics.primitive;
+import graphics.render_scene;
+import renderer.vertex_storage;
+import system.gltf_loader;
+import system.job_system;
+import system.scene_cache;
+import tests.framework;
+import tests.geometry;
+
+export namespace ysn::tests
+{
+	void RegisterSceneCacheTests();
+}
+
+module :private;
+
+namespace ysn::tests
+{
+	template <typename T>
+	static bool AreBitwiseEqual(std::span<const T> lhs, std::span<const T> rhs)
+	{
+		return lhs.size() == rhs.size() && std::memcmp(lhs.data(), rhs.data(), lhs.size_bytes()) == 0;
+	}
+
+	template <typename T>
+	static bool AreBitwiseEqual(const T& lhs, const T& rhs)
+	{
+		return std::memcmp(&lhs, &rhs, sizeof(T)) == 0;
+	}
+
+	static std::vector<TestMesh> MakeTestMeshes(std::uint32_t meshes_count, std::uint32_t grid_size)
+	{
+		std::vector<TestMesh> meshes;
+
+		for (std::uint32_t i = 0; i < meshes_count; i++)
+		{
+			meshes.push_back(MakeGridMesh(grid_size, static_cast<float>(i) * 0.37f));
+		}
+
+		return meshes;
+	}
+
+	// Counts primitives of cache which don't match imported ones, streams are compared bit by bit
+	static std::uint32_t CountMismatchedPrimitives(const SceneCache& scene_cache, const Model& model)
+	{
+		std::uint32_t mismatched_count = 0;
+
+		for (std::size_t mesh_index = 0; mesh_index < model.meshes.size(); mesh_index++)
+		{
+			const Mesh& mesh = model.meshes[mesh_index];
+			const CookedMesh& cooked_mesh = scene_cache.meshes[mesh_index];
+
+			if (cooked_mesh.name != mesh.name || cooked_mesh.primitives_count != mesh.primitives.size())
+			{
+				mismatched_count++;
+				continue;
+			}
+
+			for (std::size_t i = 0; i < mesh.primitives.size(); i++)
+			{
+				const Primitive& primitive = mesh.primitives[i];
+				const CookedPrimitive& cooked_primitive = scene_cache.primitives[cooked_mesh.first_primitive + i];
+
+				const std::span<const PrimitiveLod> cooked_lods(scene_cache.lods.data() + cooked_primitive.first_lod, cooked_primitive.lods_count);
+
+				const bool is_equal = cooked_primitive.topology == primitive.topology && cooked_primitive.material_id == primitive.material_id &&
+					AreBitwiseEqual(cooked_primitive.bbox, primitive.bbox) &&
+					AreBitwiseEqual(scene_cache.vertices.subspan(cooked_primitive.vertex_offset, cooked_primitive.vertex_count), primitive.GetVertices()) &&
+					AreBitwiseEqual(scene_cache.indices.subspan(cooked_primitive.index_offset, cooked_primitive.index_count), primitive.GetIndices()) &&
+					AreBitwiseEqual(cooked_lods, std::span<const PrimitiveLod>(primitive.lods));
+
+				mismatched_count += !is_equal;
+			}
+		}
+
+		return mismatched_count;
+	}
+
+	static std::uint32_t CountMismatchedMaterials(const SceneCache& scene_cache, const Model& model)
+	{
+		std::uint32_t mismatched_count = 0;
+
+		for (std::size_t i = 0; i < model.materials.size(); i++)
+		{
+			const CookedMaterial& cooked_material = scene_cache.materials[i];
+
+			const bool is_equal = cooked_material.name == model.materials[i].name &&
+				AreBitwiseEqual(cooked_material.blend_desc, model.materials[i].blend_desc) &&
+				AreBitwiseEqual(cooked_material.rasterizer_desc, model.materials[i].rasterizer_desc) &&
+				AreBitwiseEqual(cooked_material.shader_parameters, model.shader_parameters[i]);
+
+			mismatched_count += !is_equal;
+		}
+
+		return mismatched_count;
+	}
+
+	static std::uint32_t CountMismatchedTransforms(const SceneCache& scene_cache, const Model& model)
+	{
+		std::uint32_t mismatched_count = 0;
+
+		for (std::size_t i = 0; i < model.transforms.size(); i++)
+		{
+			DirectX::XMFLOAT4X4 transform;
+			DirectX::XMStoreFloat4x4(&transform, model.transforms[i]);
+
+			mismatched_count += !AreBitwiseEqual(transform, scene_cache.transforms[i]);
+		}
+
+		return mismatched_count;
+	}
+
+	// Everything cache gives back has to be exactly what GLTF import builds
+	static void TestMatchesGltfImport(TestContext& context)
+	{
+		constexpr std::uint32_t meshes_count = 6;
+
+		TemporaryDirectory directory("scene_cache");
+		const std::filesystem::path gltf_path = directory.GetPath() / "scene.gltf";
+
+		if (!context.Check(WriteTestGltf(gltf_path, MakeTestMeshes(meshes_count, 24)), "test glTF is written"))
+			return;
+
+		LoadingParameters loading_parameters;
+		JobSystem job_system(2);
+
+		const std::optional<Model> model = ImportGltfModel(gltf_path.wstring(), loading_parameters, job_system);
+
+		if (!context.Check(model.has_value() && model->meshes.size() == meshes_count, "glTF is imported"))
+			return;
+
+		context.Check(model->materials.size() == meshes_count && model->transforms.size() == meshes_count, "import has material and transform of every mesh");
+
+		if (!context.Check(CookGltfSceneCache(gltf_path.wstring(), loading_parameters, job_system), "scene cache is cooked"))
+			return;
+
+		const std::optional<SceneCache> scene_cache = ReadSceneCache(GetSceneCachePath(gltf_path.wstring()), HashLoadingParameters(loading_parameters));
+
+		if (!context.Check(scene_cache.has_value(), "scene cache is read back"))
+			return;
+
+		if (!context.Check(scene_cache->meshes.size() == model->meshes.size() && scene_cache->materials.size() == model->materials.size() &&
+							   scene_cache->transforms.size() == model->transforms.size() && scene_cache->images.empty(),
+				"cache has the same meshes, materials and transforms count"))
+			return;
+
+		context.Check(CountMismatchedPrimitives(scene_cache.value(), model.value()) == 0, "vertices, indices, LODs and bboxes of every primitive match");
+		context.Check(CountMismatchedMaterials(scene_cache.value(), model.value()) == 0, "materials match");
+		context.Check(CountMismatchedTransforms(scene_cache.value(), model.value()) == 0, "node transforms match");
+		context.Check(AreBitwiseEqual(std::span<const D3D12_SAMPLER_DESC>(scene_cache->samplers), std::span<const D3D12_SAMPLER_DESC>(model->sampler_descs)),
+			"samplers match");
+	}
+
+	// Cache keeps size and write time of every source file, any of them changed makes it stale
+	static void TestChangedDependencyIsStale(TestContext& context)
+	{
+		TemporaryDirectory directory("scene_cache_stale");
+		const std::filesystem::path gltf_path = directory.GetPath() / "scene.gltf";
+		const std::wstring cache_path = GetSceneCachePath(gltf_path.wstring());
+
+		if (!context.Check(WriteTestGltf(gltf_path, MakeTestMeshes(2, 8)), "test glTF is written"))
+			return;
+
+		LoadingParameters loading_parameters;
+		JobSystem job_system(0);
+
+		const std::uint64_t loading_parameters_hash = HashLoadingParameters(loading_parameters);
+
+		if (!context.Check(CookGltfSceneCache(gltf_path.wstring(), loading_parameters, job_system), "scene cache is cooked"))
+			return;
+
+		context.Check(ReadSceneCache(cache_path, loading_parameters_hash).has_value(), "fresh cache is used");
+
+		LoadingParameters other_loading_parameters;
+		other_loading_parameters.optimize_meshes = false;
+
+		context.Check(!ReadSceneCache(cache_path, HashLoadingParameters(other_loading_parameters)).has_value(), "cache of other loading parameters is stale");
+
+		const std::filesystem::file_time_type write_time = std::filesystem::last_write_time(gltf_path);
+
+		// Trailing whitespace changes size only, file keeps its write time
+		{
+			std::ofstream file(gltf_path, std::ios::binary | std::ios::app);
+			file << ' ';
+		}
+
+		std::filesystem::last_write_time(gltf_path, write_time);
+
+		context.Check(!ReadSceneCache(cache_path, loading_parameters_hash).has_value(), "cache is stale when dependency size changes");
+
+		if (!context.Check(CookGltfSceneCache(gltf_path.wstring(), loading_parameters, job_system), "scene cache is cooked again"))
+			return;
+
+		context.Check(ReadSceneCache(cache_path, loading_parameters_hash).has_value(), "cooked again cache is used");
+
+		std::filesystem::last_write_time(gltf_path, write_time + std::chrono::hours(1));
+
+		context.Check(!ReadSceneCache(cache_path, loading_parameters_hash).has_value(), "cache is stale when dependency write time changes");
+	}
+
+	// Cache maps geometry as is, GLTF path parses JSON and base64 buffer, then converts every vertex and index on its own
+	static void BenchmarkLoad(TestContext& context)
+	{
+		constexpr std::uint32_t meshes_count = 32;
+		constexpr std::uint32_t grid_size = 128;
+
+		TemporaryDirectory directory("scene_cache_benchmark");
+		const std::filesystem::path gltf_path = directory.GetPath() / "scene.gltf";
+
+		if (!context.Check(WriteTestGltf(gltf_path, MakeTestMeshes(meshes_count, grid_size)), "test glTF is written"))
+			return;
+
+		// Both sides load the same geometry on one thread
+		LoadingParameters loading_parameters;
+		loading_parameters.optimize_meshes = false;
+
+		JobSystem job_system(0);
+
+		if (!context.Check(CookGltfSceneCache(gltf_path.wstring(), loading_parameters, job_system), "scene cache is cooked"))
+			return;
+
+		const std::wstring cache_path = GetSceneCachePath(gltf_path.wstring());
+		const std::uint64_t loading_parameters_hash = HashLoadingParameters(loading_parameters);
+
+		std::uint64_t vertices_count = 0;
+
+		const double gltf_duration = MeasureMilliseconds(5,
+			[&]()
+			{
+				const std::optional<std::vector<Mesh>> meshes = ImportGltfMeshes(gltf_path.wstring(), loading_parameters, job_system);
+				context.Check(meshes.has_value(), "glTF is imported");
+			});
+
+		const double cache_duration = MeasureMilliseconds(5,
+			[&]()
+			{
+				const std::optional<SceneCache> scene_cache = ReadSceneCache(cache_path, loading_parameters_hash);
+
+				if (context.Check(scene_cache.has_value(), "scene cache is read"))
+					vertices_count = scene_cache->vertices.size();
+			});
+
+		context.Report(std::format("{} vertices: glTF parse and conversion {:.2f} ms, scene cache {:.2f} ms, {:.1f}x", vertices_count, gltf_duration,
+			cache_duration, gltf_duration / cache_duration));
+	}
+
+	void RegisterSceneCacheTests()
+	{
+		AddTest("scene_cache.matches_gltf_import", TestMatchesGltfImport);
+		AddTest("scene_cache.changed_dependency_is_stale", TestChangedDependencyIsStale);
+		AddBenchmark("scene_cache.load", BenchmarkLoad);
+	}
+}
@@ -0,0 +1,285 @@
+export module tests.shader_cache;
+
+import std;
+import renderer.shader_cache;
+import tests.framework;
+
+export namespace ysn::tests
+{
+	void RegisterShaderCacheTests();
+}
+
+module :private;
+
+namespace ysn::tests
+{
+	// Bytecode is compiler version and main source, so tests can tell what entry was built from
+	class StubShaderCompiler : public ShaderCompiler
+	{
+	public:
+		explicit StubShaderCompiler(std::string version) : m_version(std::move(version))
+		{
+		}
+
+		std::string GetVersion() const override
+		{
+			return m_version;
+		}
+
+		std::optional<ShaderBytecode> Compile(const ShaderCompileParameters&, const std::string& source, const std::wstring&) override
+		{
+			compilations_count++;
+
+			const std::string text = m_version + "|" + source;
+			return ShaderBytecode(text.begin(), text.end());
+		}
+
+		std::atomic<std::uint32_t> compilations_count = 0;
+
+	private:
+		std::string m_version;
+	};
+
+	// Shader files with include closures of every kind cache has to follow
+	class ShaderCacheFixture
+	{
+	public:
+		ShaderCacheFixture() : m_directory("shader_cache")
+		{
+			std::filesystem::create_directories(GetIncludeDirectory());
+
+			WriteShaderFile("include/common.hlsli", "float4 Common() { return 1; }\n");
+			WriteShaderFile("local.hlsli", "float4 Local() { return 2; }\n");
+			WriteShaderFile("lit.hlsl", "#include \"common.hlsli\"\nfloat4 main() : SV_Target { return Common(); }\n");
+			WriteShaderFile("local.hlsl", "  #  include \"local.hlsli\"\nfloat4 main() : SV_Target { return Local(); }\n");
+			WriteShaderFile("plain.hlsl", "float4 main() : SV_Target { return 0; }\n");
+
+			for (const std::string_view name : { "lit.hlsl", "local.hlsl", "plain.hlsl" })
+			{
+				parameters.emplace_back(ShaderType::Pixel, (GetShadersDirectory() / name).wstring());
+			}
+		}
+
+		std::filesystem::path GetShadersDirectory() const
+		{
+			return m_directory.GetPath() / "shaders";
+		}
+
+		std::filesystem::path GetIncludeDirectory() const
+		{
+			return GetShadersDirectory() / "include";
+		}
+
+		std::filesystem::path GetCacheDirectory() const
+		{
+			return m_directory.GetPath() / "cache";
+		}
+
+		void WriteShaderFile(std::string_view name, std::string_view text) const
+		{
+			std::ofstream file(GetShadersDirectory() / name, std::ios::binary | std::ios::trunc);
+			file.write(text.data(), text.size());
+		}
+
+		// Fresh cache over the same directory behaves like next run of the engine
+		std::unique_ptr<ShaderCache> CreateCache(std::shared_ptr<StubShaderCompiler> compiler, ShaderCompileExecutor executor = nullptr) const
+		{
+			return std::make_unique<ShaderCache>(
+				std::move(compiler), GetCacheDirectory(), std::vector<std::filesystem::path>{ GetIncludeDirectory() }, std::move(executor));
+		}
+
+		std::uint32_t CountEntries() const
+		{
+			std::uint32_t entries_count = 0;
+
+			for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(GetCacheDirectory()))
+			{
+				entries_count += entry.path().extension() == ".dxil";
+			}
+
+			return entries_count;
+		}
+
+		std::vector<ShaderCompileParameters> parameters;
+
+	private:
+		TemporaryDirectory m_directory;
+	};
+
+	static std::string_view ToText(const ShaderBytecode& bytecode)
+	{
+		return { reinterpret_cast<const char*>(bytecode.data()), bytecode.size() };
+	}
+
+	static bool AreAllCompiled(std::span<const std::shared_ptr<const ShaderBytecode>> shaders)
+	{
+		return std::ranges::all_of(shaders, [](const std::shared_ptr<const ShaderBytecode>& shader) { return shader && !shader->empty(); });
+	}
+
+	// Compiles everything of the fixture into empty cache
+	static std::vector<std::shared_ptr<const ShaderBytecode>> CompileCold(TestContext& context, const ShaderCacheFixture& fixture, const std::string& version)
+	{
+		auto compiler = std::make_shared<StubShaderCompiler>(version);
+		std::unique_ptr<ShaderCache> cache = fixture.CreateCache(compiler);
+
+		context.Check(cache->Initialize(), "cache is initialized");
+
+		std::vector<std::shared_ptr<const ShaderBytecode>> shaders = cache->GetOrCompile(fixture.parameters);
+
+		context.Check(AreAllCompiled(shaders) && compiler->compilations_count == fixture.parameters.size(), "cold cache compiles every shader");
+
+		return shaders;
+	}
+
+	static void TestColdAndWarm(TestContext& context)
+	{
+		ShaderCacheFixture fixture;
+
+		// One thread per shader, so compilations really overlap
+		const ShaderCompileExecutor executor = [](std::uint32_t count, const std::function<void(std::uint32_t)>& function)
+		{
+			std::vector<std::jthread> threads;
+
+			for (std::uint32_t i = 0; i < count; i++)
+			{
+				threads.emplace_back(function, i);
+			}
+		};
+
+		auto cold_compiler = std::make_shared<StubShaderCompiler>("1.0");
+		std::unique_ptr<ShaderCache> cold_cache = fixture.CreateCache(cold_compiler, executor);
+
+		if (!context.Check(cold_cache->Initialize(), "cold cache is initialized"))
+			return;
+
+		const std::vector<std::shared_ptr<const ShaderBytecode>> cold_shaders = cold_cache->GetOrCompile(fixture.parameters);
+		const ShaderCacheStats cold_stats = cold_cache->GetStats();
+
+		context.Check(AreAllCompiled(cold_shaders), "cold cache compiles every shader");
+		context.Check(cold_compiler->compilations_count == 3 && cold_stats.misses == 3 && cold_stats.disk_hits == 0, "cold run misses every shader");
+		context.Check(fixture.CountEntries() == 3, "every shader is stored on disk");
+
+		const std::vector<std::shared_ptr<const ShaderBytecode>> memory_shaders = cold_cache->GetOrCompile(fixture.parameters);
+
+		context.Check(cold_cache->GetStats().memory_hits == 3 && cold_compiler->compilations_count == 3, "repeated request is served from memory");
+		context.Check(memory_shaders == cold_shaders, "memory hits return the same bytecode objects");
+
+		auto warm_compiler = std::make_shared<StubShaderCompiler>("1.0");
+		std::unique_ptr<ShaderCache> warm_cache = fixture.CreateCache(warm_compiler, executor);
+
+		if (!context.Check(warm_cache->Initialize(), "warm cache is initialized"))
+			return;
+
+		context.Check(warm_cache->GetStats().disk_hits == 3, "warm startup loads every shader of previous run from disk");
+
+		const std::vector<std::shared_ptr<const ShaderBytecode>> warm_shaders = warm_cache->GetOrCompile(fixture.parameters);
+
+		context.Check(warm_compiler->compilations_count == 0, "warm run compiles nothing");
+		context.Check(warm_cache->GetStats().memory_hits == 3, "warm run requests are served from memory");
+		context.Check(AreAllCompiled(warm_shaders) && std::ranges::equal(warm_shaders, cold_shaders, [](const auto& lhs, const auto& rhs) { return *lhs == *rhs; }),
+			"warm bytecode matches cold one");
+	}
+
+	static void TestIncludeChange(TestContext& context)
+	{
+		ShaderCacheFixture fixture;
+		CompileCold(context, fixture, "1.0");
+
+		const std::optional<ShaderDigest> lit_digest = fixture.CreateCache(std::make_shared<StubShaderCompiler>("1.0"))->ComputeDigest(fixture.parameters[0]);
+
+		// Found through include directory
+		fixture.WriteShaderFile("include/common.hlsli", "float4 Common() { return 3; }\n");
+
+		auto compiler = std::make_shared<StubShaderCompiler>("1.0");
+		std::unique_ptr<ShaderCache> cache = fixture.CreateCache(compiler);
+
+		if (!context.Check(cache->Initialize(), "cache is initialized"))
+			return;
+
+		context.Check(cache->ComputeDigest(fixture.parameters[0]) != lit_digest, "include change gives new digest");
+		context.Check(compiler->compilations_count == 1 && cache->GetStats().disk_hits == 2, "only shader using changed include is recompiled");
+		context.Check(fixture.CountEntries() == 3, "stale entry is removed");
+
+		// Found next to including file
+		fixture.WriteShaderFile("local.hlsli", "float4 Local() { return 4; }\n");
+
+		compiler = std::make_shared<StubShaderCompiler>("1.0");
+		cache = fixture.CreateCache(compiler);
+
+		if (!context.Check(cache->Initialize(), "cache is initialized"))
+			return;
+
+		context.Check(compiler->compilations_count == 1 && cache->GetStats().disk_hits == 2, "shader using changed relative include is recompiled");
+
+		const std::vector<std::shared_ptr<const ShaderBytecode>> shaders = cache->GetOrCompile(fixture.parameters);
+		context.Check(AreAllCompiled(shaders) && compiler->compilations_count == 1, "requests after startup are served from memory");
+	}
+
+	static void TestCompilerVersionChange(TestContext& context)
+	{
+		ShaderCacheFixture fixture;
+		CompileCold(context, fixture, "1.0");
+
+		auto compiler = std::make_shared<StubShaderCompiler>("1.1");
+		std::unique_ptr<ShaderCache> cache = fixture.CreateCache(compiler);
+
+		if (!context.Check(cache->Initialize(), "cache is initialized"))
+			return;
+
+		context.Check(compiler->compilations_count == 3 && cache->GetStats().disk_hits == 0, "compiler update recompiles every shader");
+		context.Check(fixture.CountEntries() == 3, "entries of previous compiler are removed");
+
+		const std::vector<std::shared_ptr<const ShaderBytecode>> shaders = cache->GetOrCompile(fixture.parameters);
+		context.Check(AreAllCompiled(shaders) && std::ranges::all_of(shaders, [](const auto& shader) { return ToText(*shader).starts_with("1.1|"); }),
+			"bytecode comes from new compiler");
+	}
+
+	static void TestCorruptedEntry(TestContext& context)
+	{
+		ShaderCacheFixture fixture;
+		const std::vector<std::shared_ptr<const ShaderBytecode>> cold_shaders = CompileCold(context, fixture, "1.0");
+
+		const std::unique_ptr<ShaderCache> digest_cache = fixture.CreateCache(std::make_shared<StubShaderCompiler>("1.0"));
+		const std::optional<ShaderDigest> lit_digest = digest_cache->ComputeDigest(fixture.parameters[0]);
+		const std::optional<ShaderDigest> plain_digest = digest_cache->ComputeDigest(fixture.parameters[2]);
+
+		if (!context.Check(lit_digest.has_value() && plain_digest.has_value(), "digests are computed"))
+			return;
+
+		// Flipped bytecode byte and truncated file
+		{
+			std::fstream file(digest_cache->GetEntryPath(lit_digest.value()), std::ios::binary | std::ios::in | std::ios::out);
+			file.seekg(-1, std::ios::end);
+			const char last = static_cast<char>(file.get());
+			file.seekp(-1, std::ios::end);
+			file.put(static_cast<char>(last ^ 0x20));
+		}
+
+		std::filesystem::resize_file(digest_cache->GetEntryPath(plain_digest.value()), 10);
+
+		auto compiler = std::make_shared<StubShaderCompiler>("1.0");
+		std::unique_ptr<ShaderCache> cache = fixture.CreateCache(compiler);
+
+		if (!context.Check(cache->Initialize(), "cache is initialized"))
+			return;
+
+		context.Check(compiler->compilations_count == 2 && cache->GetStats().disk_hits == 1, "corrupted entries are recompiled, valid one is loaded");
+
+		const std::vector<std::shared_ptr<const ShaderBytecode>> shaders = cache->GetOrCompile(fixture.parameters);
+		context.Check(AreAllCompiled(shaders) && std::ranges::equal(shaders, cold_shaders, [](const auto& lhs, const auto& rhs) { return *lhs == *rhs; }),
+			"recompiled bytecode matches original one");
+
+		compiler = std::make_shared<StubShaderCompiler>("1.0");
+		cache = fixture.CreateCache(compiler);
+
+		context.Check(cache->Initialize() && compiler->compilations_count == 0 && cache->GetStats().disk_hits == 3, "recompiled entries are stored again");
+	}
+
+	void RegisterShaderCacheTests()
+	{
+		AddTest("shader_cache.cold_and_warm", TestColdAndWarm);
+		AddTest("shader_cache.include_change", TestIncludeChange);
+		AddTest("shader_cache.compiler_version_change", TestCompilerVersionChange);
+		AddTest("shader_cache.corrupted_entry", TestCorruptedEntry);
+	}
+}
@@ -0,0 +1,182 @@
+export module tests.texture_cooker;
+
+import std;
+import graphics.texture_cooker;
+import system.job_system;
+import tests.framework;
+
+export namespace ysn::tests
+{
+	void RegisterTextureCookerTests();
+}
+
+module :private;
+
+namespace ysn::tests
+{
+	struct CookerCase
+	{
+		std::string_view name;
+		TextureUsage usage = TextureUsage::Unknown;
+		double min_psnr = 0.0; // dB over channels format keeps
+	};
+
+	// Thresholds are a few dB under what each encoder reaches, BC1 loses most with 5:6:5 endpoints and 4 levels
+	constexpr std::array<CookerCase, 4> cooker_cases = { {
+		{ "color", TextureUsage::Color, 40.0 },
+		{ "normal", TextureUsage::Normal, 45.0 },
+		{ "data", TextureUsage::Data, 40.0 },
+		{ "mask", TextureUsage::Mask, 38.0 },
+	} };
+
+	static std::uint8_t ToByte(float value)
+	{
+		return static_cast<std::uint8_t>(std::clamp(value, 0.0f, 255.0f) + 0.5f);
+	}
+
+	// Gradients, waves, hard edges and a bit of noise, what photographed and painted textures have
+	static std::vector<std::uint8_t> MakeSourceImage(TextureUsage usage, std::uint32_t width, std::uint32_t height, std::uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> noise(-6.0f, 6.0f);
+
+		std::vector<std::uint8_t> image(static_cast<std::size_t>(width) * height * 4);
+
+		for (std::uint32_t y = 0; y < height; y++)
+		{
+			for (std::uint32_t x = 0; x < width; x++)
+			{
+				const float u = static_cast<float>(x) / static_cast<float>(width);
+				const float v = static_cast<float>(y) / static_cast<float>(height);
+
+				std::uint8_t* pixel = &image[(static_cast<std::size_t>(y) * width + x) * 4];
+
+				switch (usage)
+				{
+					case TextureUsage::Normal:
+					{
+						const float normal_x = 0.4f * std::sin(u * 30.0f);
+						const float normal_y = 0.4f * std::cos(v * 25.0f);
+						const float normal_z = std::sqrt(std::max(0.0f, 1.0f - normal_x * normal_x - normal_y * normal_y));
+
+						pixel[0] = ToByte((normal_x * 0.5f + 0.5f) * 255.0f + noise(random));
+						pixel[1] = ToByte((normal_y * 0.5f + 0.5f) * 255.0f + noise(random));
+						pixel[2] = ToByte((normal_z * 0.5f + 0.5f) * 255.0f);
+						pixel[3] = 255;
+						break;
+					}
+					case TextureUsage::Data:
+					{
+						pixel[0] = ToByte(200.0f * v + noise(random));
+						pixel[1] = ToByte(255.0f * (0.5f + 0.5f * std::sin(u * 9.0f)) + noise(random));
+						pixel[2] = x > width / 2 ? 255 : 0;
+						pixel[3] = ToByte(255.0f * u);
+						break;
+					}
+					default:
+					{
+						pixel[0] = ToByte(255.0f * u + noise(random));
+						pixel[1] = ToByte(128.0f + 100.0f * std::sin(v * 20.0f) + noise(random));
+						pixel[2] = (x / 32 + y / 32) % 2 ? 200 : 40;
+						pixel[3] = 255;
+						break;
+					}
+				}
+			}
+		}
+
+		return image;
+	}
+
+	// Top mip against the source image, over channels the format keeps
+	static void TestPsnrAgainstSource(TestContext& context)
+	{
+		constexpr std::uint32_t size = 256;
+
+		for (const CookerCase& cooker_case : cooker_cases)
+		{
+			const std::vector<std::uint8_t> source = MakeSourceImage(cooker_case.usage, size, size, 1);
+			const CookedTextureFormat format = ChooseCookedTextureFormat(cooker_case.usage, size, size);
+			const CookedTexture cooked = CookTexture(source, size, size, cooker_case.usage, format);
+
+			if (!context.Check(cooked.mips.size() == GetCookedMipsCount(size, size), std::format("{} has full mip chain", cooker_case.name)))
+				continue;
+
+			const double psnr = ComputePsnr(source, DecodeCookedMip(cooked, 0), GetCookedChannelsMask(format));
+
+			context.Report(std::format("{} {}: {:.1f} dB", cooker_case.name, GetCookedTextureFormatName(format), psnr));
+			context.Check(psnr >= cooker_case.min_psnr, std::format("{} is at least {} dB", cooker_case.name, cooker_case.min_psnr));
+		}
+	}
+
+	// Black and white checker averages to linear half, which is 188 in sRGB
+	static void TestSrgbMipFiltering(TestContext& context)
+	{
+		std::vector<std::uint8_t> checker(4 * 4 * 4);
+
+		for (std::uint32_t i = 0; i < 16; i++)
+		{
+			const std::uint8_t value = (i % 4 + i / 4) % 2 ? 255 : 0;
+
+			checker[i * 4 + 0] = value;
+			checker[i * 4 + 1] = value;
+			checker[i * 4 + 2] = value;
+			checker[i * 4 + 3] = 255;
+		}
+
+		const std::vector<std::uint8_t> color_mip = DecodeCookedMip(CookTexture(checker, 4, 4, TextureUsage::Color, CookedTextureFormat::Rgba8), 1);
+		const std::vector<std::uint8_t> data_mip = DecodeCookedMip(CookTexture(checker, 4, 4, TextureUsage::Data, CookedTextureFormat::Rgba8), 1);
+
+		context.Check(std::abs(color_mip[0] - 188) <= 1, std::format("color mip is filtered in linear space, got {}", color_mip[0]));
+		context.Check(std::abs(data_mip[0] - 128) <= 1, std::format("data mip is filtered as is, got {}", data_mip[0]));
+	}
+
+	static void TestThreadedMatchesSerial(TestContext& context)
+	{
+		constexpr std::uint32_t size = 256;
+
+		JobSystem job_system(4);
+
+		for (const CookerCase& cooker_case : cooker_cases)
+		{
+			const std::vector<std::uint8_t> source = MakeSourceImage(cooker_case.usage, size, size, 2);
+			const CookedTextureFormat format = ChooseCookedTextureFormat(cooker_case.usage, size, size);
+
+			const CookedTexture serial = CookTexture(source, size, size, cooker_case.usage, format);
+			const CookedTexture threaded = CookTexture(source, size, size, cooker_case.usage, format, &job_system);
+
+			context.Check(threaded.data == serial.data, std::format("threaded {} cook is identical to serial one", cooker_case.name));
+		}
+	}
+
+	static void BenchmarkCookThroughput(TestContext& context)
+	{
+		constexpr std::uint32_t size = 1024;
+
+		JobSystem job_system;
+
+		// Source pixels, full mip chain is filtered and encoded for them
+		const double megapixels = static_cast<double>(size) * size / 1e6;
+
+		for (const CookerCase& cooker_case : cooker_cases)
+		{
+			const std::vector<std::uint8_t> source = MakeSourceImage(cooker_case.usage, size, size, 3);
+			const CookedTextureFormat format = ChooseCookedTextureFormat(cooker_case.usage, size, size);
+
+			const double serial_duration = MeasureMilliseconds(3, [&]() { CookTexture(source, size, size, cooker_case.usage, format); });
+			const double threaded_duration = MeasureMilliseconds(3, [&]() { CookTexture(source, size, size, cooker_case.usage, format, &job_system); });
+
+			context.Report(std::format("{} {} {}x{}: {:.2f} MP/s on one thread, {:.2f} MP/s on {} threads", cooker_case.name,
+				GetCookedTextureFormatName(format), size, size, megapixels * 1e3 / serial_duration, megapixels * 1e3 / threaded_duration,
+				job_system.GetWorkersCount() + 1));
+		}
+	}
+
+	void RegisterTextureCookerTests()
+	{
+		AddTest("texture_cooker.psnr_against_source", TestPsnrAgainstSource);
+		AddTest("texture_cooker.srgb_mip_filtering", TestSrgbMipFiltering);
+		AddTest("texture_cooker.threaded_matches_serial", TestThreadedMatchesSerial);
+		AddBenchmark("texture_cooker.cook_throughput", BenchmarkCookThroughput);
+	}
+}
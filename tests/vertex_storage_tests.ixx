@@ -0,0 +1,260 @@
+module;
+
+#include <DirectXMath.h>
+
+export module tests.vertex_storage;
+
+import std;
+import graphics.mesh;
+import graphics.primitive;
+import renderer.vertex_storage;
+import system.filesystem;
+import system.gltf_loader;
+import system.job_system;
+import tests.framework;
+import tests.geometry;
+
+export namespace ysn::tests
+{
+	void RegisterVertexStorageTests();
+}
+
+module :private;
+
+namespace ysn::tests
+{
+	struct RoundTripErrors
+	{
+		float position = 0.0f; // Relative to quantization step
+		float normal = 0.0f;   // Angle in radians
+		float uv = 0.0f;       // Relative to uv magnitude
+	};
+
+	// Float acos near one can't resolve angles below 1e-3, atan2 of double cross and dot products can
+	static double MeasureAngle(const DirectX::XMFLOAT3& lhs, const DirectX::XMFLOAT3& rhs)
+	{
+		const std::array<double, 3> a = { lhs.x, lhs.y, lhs.z };
+		const std::array<double, 3> b = { rhs.x, rhs.y, rhs.z };
+
+		const std::array<double, 3> cross = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+		const double dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+
+		return std::atan2(std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), dot);
+	}
+
+	static RoundTripErrors MeasureRoundTrip(std::span<const Vertex> vertices)
+	{
+		DirectX::XMFLOAT3 bbox_min = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		DirectX::XMFLOAT3 bbox_max = { -bbox_min.x, -bbox_min.y, -bbox_min.z };
+
+		for (const Vertex& vertex : vertices)
+		{
+			bbox_min = { std::min(bbox_min.x, vertex.position.x), std::min(bbox_min.y, vertex.position.y), std::min(bbox_min.z, vertex.position.z) };
+			bbox_max = { std::max(bbox_max.x, vertex.position.x), std::max(bbox_max.y, vertex.position.y), std::max(bbox_max.z, vertex.position.z) };
+		}
+
+		const PositionQuantization quantization = GetPositionQuantization(bbox_min, bbox_max);
+
+		std::vector<CompactVertex> compact_vertices(vertices.size());
+		std::vector<Vertex> decoded_vertices(vertices.size());
+
+		EncodeCompactVertices(vertices, quantization, compact_vertices);
+		DecodeCompactVertices(compact_vertices, quantization, decoded_vertices);
+
+		// 16 bit unorm splits bounds into 65535 steps
+		const std::array<float, 3> position_steps = { quantization.position_scale.x / 65535.0f, quantization.position_scale.y / 65535.0f,
+			quantization.position_scale.z / 65535.0f };
+
+		RoundTripErrors errors;
+
+		for (std::size_t i = 0; i < vertices.size(); i++)
+		{
+			const Vertex& source = vertices[i];
+			const Vertex& decoded = decoded_vertices[i];
+
+			errors.position = std::max({ errors.position, std::abs(decoded.position.x - source.position.x) / position_steps[0],
+				std::abs(decoded.position.y - source.position.y) / position_steps[1],
+				std::abs(decoded.position.z - source.position.z) / position_steps[2] });
+
+			errors.normal = std::max(errors.normal, static_cast<float>(MeasureAngle(source.normal, decoded.normal)));
+
+			// Halfs keep 11 significant bits, values below smallest normal one have absolute precision
+			constexpr float min_normal_half = 6.1035e-05f;
+			errors.uv = std::max({ errors.uv, std::abs(decoded.uv0.x - source.uv0.x) / std::max(std::abs(source.uv0.x), min_normal_half),
+				std::abs(decoded.uv0.y - source.uv0.y) / std::max(std::abs(source.uv0.y), min_normal_half) });
+		}
+
+		return errors;
+	}
+
+	// Normals spread evenly over the whole sphere including poles and axes, so both octahedron hemispheres and its folds are covered
+	static std::vector<Vertex> MakeSphereVertices(std::uint32_t count)
+	{
+		std::vector<Vertex> vertices;
+
+		const std::array<DirectX::XMFLOAT3, 6> axes = { DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f), DirectX::XMFLOAT3(-1.0f, 0.0f, 0.0f),
+			DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f), DirectX::XMFLOAT3(0.0f, -1.0f, 0.0f), DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f),
+			DirectX::XMFLOAT3(0.0f, 0.0f, -1.0f) };
+
+		for (const DirectX::XMFLOAT3& axis : axes)
+		{
+			Vertex vertex;
+			vertex.position = axis;
+			vertex.normal = axis;
+			vertex.uv0 = { 0.0f, 0.0f };
+
+			vertices.push_back(vertex);
+		}
+
+		const float golden_angle = std::numbers::pi_v<float> * (3.0f - std::sqrt(5.0f));
+
+		for (std::uint32_t i = 0; i < count; i++)
+		{
+			const float y = 1.0f - 2.0f * (static_cast<float>(i) + 0.5f) / static_cast<float>(count);
+			const float radius = std::sqrt(1.0f - y * y);
+			const float angle = golden_angle * static_cast<float>(i);
+
+			const float t = static_cast<float>(i) / static_cast<float>(count);
+
+			Vertex vertex;
+			vertex.normal = { radius * std::cos(angle), y, radius * std::sin(angle) };
+			vertex.position = { vertex.normal.x * 50.0f, vertex.normal.y * 50.0f, vertex.normal.z * 50.0f };
+			vertex.uv0 = { t * 8.0f - 2.0f, 1.0f - t }; // Tiled uvs go outside of [0, 1] and below zero
+
+			vertices.push_back(vertex);
+		}
+
+		return vertices;
+	}
+
+	static void CheckRoundTrip(TestContext& context, std::string_view name, std::span<const Vertex> vertices)
+	{
+		const RoundTripErrors errors = MeasureRoundTrip(vertices);
+
+		context.Report(std::format("{}: position {:.3f} steps, normal {:.5f} rad, uv {:.6f} relative", name, errors.position, errors.normal, errors.uv));
+
+		// Rounding to nearest step, float math of encoding and decoding adds a bit
+		context.Check(errors.position <= 0.55f, std::format("{} positions are within half quantization step", name));
+
+		// 16 bit octahedral encoding is good to a few thousandths of a degree
+		context.Check(errors.normal <= 0.0002f, std::format("{} normals are within 0.01 degree", name));
+
+		// Half keeps 11 significant bits, rounding to nearest one is within 2^-11 of value
+		context.Check(errors.uv <= 0.0005f, std::format("{} uvs are within half precision", name));
+	}
+
+	static void TestCompactVertexRoundTrip(TestContext& context)
+	{
+		CheckRoundTrip(context, "grid", MakeGridMesh(64, 0.3f).vertices);
+		CheckRoundTrip(context, "sphere", MakeSphereVertices(16384));
+	}
+
+	static void TestFlatAxisIsExact(TestContext& context)
+	{
+		std::vector<Vertex> vertices = MakeGridMesh(16).vertices;
+
+		for (Vertex& vertex : vertices)
+		{
+			vertex.position.y = 3.25f;
+		}
+
+		const PositionQuantization quantization = GetPositionQuantization({ -1.0f, 3.25f, -1.0f }, { 1.0f, 3.25f, 1.0f });
+
+		std::vector<CompactVertex> compact_vertices(vertices.size());
+		std::vector<Vertex> decoded_vertices(vertices.size());
+
+		EncodeCompactVertices(vertices, quantization, compact_vertices);
+		DecodeCompactVertices(compact_vertices, quantization, decoded_vertices);
+
+		context.Check(std::ranges::all_of(decoded_vertices, [](const Vertex& vertex) { return vertex.position.y == 3.25f; }),
+			"flat axis decodes to its exact value");
+	}
+
+	// Primitive with quantization of its bounds, same way geometry is uploaded in compact format
+	struct CompactPrimitive
+	{
+		std::span<const Vertex> vertices;
+		PositionQuantization quantization;
+		std::vector<CompactVertex> compact_vertices;
+		std::vector<Vertex> decoded_vertices;
+	};
+
+	// Bundled assets, ones which aren't on disk are skipped
+	constexpr std::array<std::wstring_view, 3> benchmark_assets = {
+		L"assets/Sponza/Sponza.gltf",
+		L"assets/DamagedHelmet/DamagedHelmet.gltf",
+		L"assets/BoomBoxWithAxes/glTF/BoomBoxWithAxes.gltf",
+	};
+
+	static void BenchmarkBytesSaved(TestContext& context)
+	{
+		JobSystem job_system;
+
+		LoadingParameters loading_parameters;
+
+		for (const std::wstring_view asset : benchmark_assets)
+		{
+			const std::wstring path = VfsPath(asset);
+			const std::string name = std::filesystem::path(path).filename().string();
+
+			if (!std::filesystem::exists(path))
+			{
+				context.Report(std::format("{}: skipped, not found", name));
+				continue;
+			}
+
+			const std::optional<std::vector<Mesh>> meshes = ImportGltfMeshes(path, loading_parameters, job_system);
+
+			if (!context.Check(meshes.has_value(), std::format("{} is imported", name)))
+				continue;
+
+			std::vector<CompactPrimitive> primitives;
+			std::uint64_t vertices_count = 0;
+
+			for (const Mesh& mesh : meshes.value())
+			{
+				for (const Primitive& primitive : mesh.primitives)
+				{
+					CompactPrimitive& compact_primitive = primitives.emplace_back();
+					compact_primitive.vertices = primitive.GetVertices();
+					compact_primitive.quantization = GetPositionQuantization(primitive.bbox.min, primitive.bbox.max);
+					compact_primitive.compact_vertices.resize(compact_primitive.vertices.size());
+					compact_primitive.decoded_vertices.resize(compact_primitive.vertices.size());
+
+					vertices_count += compact_primitive.vertices.size();
+				}
+			}
+
+			const double encode_duration = MeasureMilliseconds(5,
+				[&]()
+				{
+					for (CompactPrimitive& primitive : primitives)
+						EncodeCompactVertices(primitive.vertices, primitive.quantization, primitive.compact_vertices);
+				});
+
+			const double decode_duration = MeasureMilliseconds(5,
+				[&]()
+				{
+					for (CompactPrimitive& primitive : primitives)
+						DecodeCompactVertices(primitive.compact_vertices, primitive.quantization, primitive.decoded_vertices);
+				});
+
+			const double full_megabytes = static_cast<double>(vertices_count * GetVertexStride(VertexFormat::Full)) / (1024.0 * 1024.0);
+			const double compact_megabytes = static_cast<double>(vertices_count * GetVertexStride(VertexFormat::Compact)) / (1024.0 * 1024.0);
+			const double vertices_millions = static_cast<double>(vertices_count) / 1e6;
+
+			context.Report(std::format("{}: {} vertices, {} bytes {:.2f} MB -> {} bytes {:.2f} MB, {:.2f} MB saved, encode {:.2f} ms ({:.0f} M/s), "
+									   "decode {:.2f} ms ({:.0f} M/s)",
+				name, vertices_count, GetVertexStride(VertexFormat::Full), full_megabytes, GetVertexStride(VertexFormat::Compact), compact_megabytes,
+				full_megabytes - compact_megabytes, encode_duration, vertices_millions * 1e3 / encode_duration, decode_duration,
+				vertices_millions * 1e3 / decode_duration));
+		}
+	}
+
+	void RegisterVertexStorageTests()
+	{
+		AddTest("vertex_storage.compact_vertex_round_trip", TestCompactVertexRoundTrip);
+		AddTest("vertex_storage.flat_axis_is_exact", TestFlatAxisIsExact);
+		AddBenchmark("vertex_storage.bytes_saved", BenchmarkBytesSaved);
+	}
+}